@@ -0,0 +1,180 @@
+/*
+ * CPU Accounting Benchmark
+ *
+ * 1. Known load: two tasks burn the CPU for a fixed share of every 10 ms
+ *    and time themselves. The kernel's cycle-based accounting must agree
+ *    with them, and get_cpu_utilization with their sum. The task list
+ *    shows the load per task and the average ready-to-run wait.
+ * 2. Histograms: how long HEAVY's runs lasted, and how long LIGHT waited
+ *    for the CPU after waking (it often has to wait for HEAVY to finish).
+ * 3. Cost: a task_get_runtime snapshot, and the switch cost with the
+ *    accounting in place.
+ *
+ * Build and run:  make bench_accounting && ./bench_accounting
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define RUN_MS 3000
+#define PERIOD_MS 10
+#define HEAVY_MS 3
+#define LIGHT_MS 1
+#define SNAPSHOTS 1000000
+#define PINGPONG_ROUNDS 200000
+
+typedef struct {
+    uint32_t burn_ms;                // CPU time to use every PERIOD_MS
+    uint32_t task_id;
+    uint64_t burned_ns;              // What the task measured itself
+} load_t;
+
+static load_t heavy = {HEAVY_MS, 0, 0};
+static load_t light = {LIGHT_MS, 0, 0};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void start_kernel(void) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 || rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+}
+
+/*
+ * BENCHMARK 1: Known load
+ */
+static void load_task(void* param) {
+    load_t* load = param;
+
+    while (1) {
+        uint64_t start = now_ns();
+        while (now_ns() - start < load->burn_ms * 1000000ull) {
+        }
+        load->burned_ns += now_ns() - start;
+
+        if (get_system_uptime() >= RUN_MS) {
+            rtos_stop();
+        }
+        task_sleep(PERIOD_MS - load->burn_ms);
+    }
+}
+
+static void print_histogram(const char* label, const uint32_t* histogram) {
+    uint32_t total = 0;
+    for (int i = 0; i < RUNTIME_BUCKETS; i++) {
+        total += histogram[i];
+    }
+
+    printf("%s\n", label);
+    for (int i = 0; i < RUNTIME_BUCKETS; i++) {
+        if (histogram[i] == 0) {
+            continue;
+        }
+        char range[32];
+        if (i == 0) {
+            snprintf(range, sizeof(range), "< 1 us");
+        } else if (i == RUNTIME_BUCKETS - 1) {
+            snprintf(range, sizeof(range), ">= %u us", 1u << (i - 1));
+        } else {
+            snprintf(range, sizeof(range), "%u-%u us", 1u << (i - 1), 1u << i);
+        }
+        int bar = (int)(40.0 * histogram[i] / total + 0.5);
+        printf("  %-14s %7u  %.*s\n", range, histogram[i], bar,
+               "########################################");
+    }
+}
+
+static void run_known_load(void) {
+    start_kernel();
+    heavy.task_id = task_create("HEAVY", load_task, &heavy, 1, 0);
+    light.task_id = task_create("LIGHT", load_task, &light, 1, 0);
+
+    rtos_start();
+
+    task_runtime_t heavy_rt, light_rt;
+    task_get_runtime(heavy.task_id, &heavy_rt);
+    task_get_runtime(light.task_id, &light_rt);
+    double elapsed = (double)heavy_rt.elapsed_ns;
+
+    printf("%-8s %14s %14s\n", "task", "self-timed", "accounted");
+    printf("%-8s %13.2f%% %13.2f%%\n", "HEAVY", 100.0 * heavy.burned_ns / elapsed,
+           100.0 * heavy_rt.cpu_ns / elapsed);
+    printf("%-8s %13.2f%% %13.2f%%\n", "LIGHT", 100.0 * light.burned_ns / elapsed,
+           100.0 * light_rt.cpu_ns / elapsed);
+    printf("%-8s %13.2f%% %13u%%\n", "all", 100.0 * (heavy.burned_ns + light.burned_ns) / elapsed,
+           get_cpu_utilization());
+
+    print_task_list();
+    printf("\n");
+
+    print_histogram("HEAVY run lengths", heavy_rt.run_histogram);
+    print_histogram("LIGHT ready-to-run waits", light_rt.ready_histogram);
+    printf("  worst wait %.1f us\n\n", light_rt.max_ready_ns / 1000.0);
+}
+
+/*
+ * BENCHMARK 3: Cost
+ */
+static semaphore_t ping_sem;
+static semaphore_t pong_sem;
+static double round_ns;
+static double snapshot_ns;
+
+static void ping_task(void* param) {
+    uint32_t pong_id = (uint32_t)(uintptr_t)param;
+    task_runtime_t runtime;
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < SNAPSHOTS; i++) {
+        task_get_runtime(pong_id, &runtime);
+    }
+    snapshot_ns = (double)(now_ns() - start) / SNAPSHOTS;
+
+    start = now_ns();
+    for (int i = 0; i < PINGPONG_ROUNDS; i++) {
+        semaphore_signal(&ping_sem);
+        semaphore_wait(&pong_sem);
+    }
+    round_ns = (double)(now_ns() - start) / PINGPONG_ROUNDS;
+    rtos_stop();
+}
+
+static void pong_task(void* param) {
+    (void)param;
+    while (1) {
+        semaphore_wait(&ping_sem);
+        semaphore_signal(&pong_sem);
+    }
+}
+
+static void run_cost(void) {
+    start_kernel();
+    semaphore_init(&ping_sem, 0);
+    semaphore_init(&pong_sem, 0);
+    uint32_t pong_id = task_create("PONG", pong_task, NULL, 1, 0);
+    task_create("PING", ping_task, (void*)(uintptr_t)pong_id, 1, 0);
+    rtos_start();
+
+    printf("%-36s %8.1f ns\n", "task_get_runtime snapshot", snapshot_ns);
+    printf("%-36s %8.1f ns\n", "context switch (ping-pong / 2)", round_ns / 2);
+}
+
+int main(void) {
+    printf("🧪 RTOS CPU ACCOUNTING BENCHMARK\n");
+    printf("================================\n\n");
+
+    printf("HEAVY burns %d ms and LIGHT %d ms of every %d ms, for %d ms\n",
+           HEAVY_MS, LIGHT_MS, PERIOD_MS, RUN_MS);
+    run_known_load();
+    run_cost();
+
+    return 0;
+}
@@ -0,0 +1,325 @@
+/*
+ * Asynchronous I/O Benchmark
+ *
+ * Echo servers run as RTOS tasks, each blocked in task_wait_fd on its
+ * end of a Unix socket pair; a host thread outside the kernel plays the
+ * clients. Runs in context-switch mode on one core, so every server task
+ * shares one host thread.
+ *
+ * 1. Round trip: one client sends a message, waits for the echo, and
+ *    sends the next. First with the system otherwise idle, where the
+ *    idle core sleeps in the multiplexer; then with a task computing for
+ *    LOAD_BUSY_US between yields, where the multiplexer is only looked at
+ *    once per tick. For comparison, the same echo served by a plain host
+ *    thread blocking in read().
+ * 2. Many connections: ECHO_TASKS servers; the client sends a message on
+ *    every connection, then collects all the echoes, for SCALE_ROUNDS
+ *    rounds. Reports echoes per second, resident memory per connection,
+ *    and how many tasks one look at the multiplexer readies on average.
+ *
+ * Build and run:  make bench_io && ./bench_io
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ROUND_TRIPS 20000
+#define LOAD_ROUND_TRIPS 2000
+#define LOAD_BUSY_US 200
+#define ECHO_TASKS 2000
+#define SCALE_ROUNDS 50
+#define MESSAGE_SIZE 32
+
+typedef struct {
+    int* fds;                            // Client ends
+    uint32_t count;                      // Connections
+    uint32_t rounds;                     // Messages per connection
+    uint64_t* samples;                   // Round trips (single connection only)
+} client_t;
+
+static bool client_done;
+static bool with_load;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static size_t read_rss(void) {
+    unsigned long vm_pages = 0;
+    unsigned long rss_pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+
+    if (statm != NULL) {
+        if (fscanf(statm, "%lu %lu", &vm_pages, &rss_pages) != 2) {
+            rss_pages = 0;
+        }
+        fclose(statm);
+    }
+    return rss_pages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_round_trips(const char* label, uint64_t* samples, uint32_t count,
+                              double seconds) {
+    uint64_t sum = 0;
+
+    qsort(samples, count, sizeof(uint64_t), compare_u64);
+    for (uint32_t i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    printf("  %-26s %8.1f %8.1f %8.1f %8.1f %10.0f\n", label, samples[0] / 1000.0,
+           sum / 1000.0 / count, samples[count * 99 / 100] / 1000.0,
+           samples[count - 1] / 1000.0, count / seconds);
+}
+
+static void make_pair(int* client, int* server) {
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) != 0) {
+        perror("socketpair");
+        exit(1);
+    }
+    *client = fds[0];
+    *server = fds[1];
+}
+
+// Read or write a whole message, sleeping in poll() until the socket is
+// ready (spinning would take the CPU from the server on a small host)
+static void transfer(int fd, char* buffer, bool send) {
+    struct pollfd pfd = { fd, send ? POLLOUT : POLLIN, 0 };
+    size_t done = 0;
+
+    while (done < MESSAGE_SIZE) {
+        ssize_t n = send ? write(fd, buffer + done, MESSAGE_SIZE - done) :
+                           read(fd, buffer + done, MESSAGE_SIZE - done);
+        if (n > 0) {
+            done += (size_t)n;
+        } else if (n < 0 && errno == EAGAIN) {
+            poll(&pfd, 1, -1);
+        } else {
+            perror("transfer");
+            exit(1);
+        }
+    }
+}
+
+/*
+ * THE CLIENTS (a host thread outside the kernel)
+ */
+static void* client_thread(void* param) {
+    client_t* client = param;
+    char message[MESSAGE_SIZE] = "ping";
+
+    for (uint32_t round = 0; round < client->rounds; round++) {
+        uint64_t start = now_ns();
+
+        for (uint32_t i = 0; i < client->count; i++) {
+            transfer(client->fds[i], message, true);
+        }
+        for (uint32_t i = 0; i < client->count; i++) {
+            transfer(client->fds[i], message, false);
+        }
+
+        if (client->samples != NULL) {
+            client->samples[round] = now_ns() - start;
+        }
+    }
+
+    __atomic_store_n(&client_done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/*
+ * THE SERVERS
+ */
+static void echo_task(void* param) {
+    int fd = (int)(intptr_t)param;
+    char buffer[MESSAGE_SIZE];
+
+    while (1) {
+        if (task_wait_fd(fd, IO_READABLE, RTOS_WAIT_FOREVER) <= 0) {
+            return;
+        }
+
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n == 0 || (n < 0 && errno != EAGAIN)) {
+            return; // Client gone
+        }
+        if (n > 0 && write(fd, buffer, (size_t)n) != n) {
+            return; // Small echoes always fit the socket buffer
+        }
+    }
+}
+
+// The usual thread-per-connection server, on a blocking socket
+static void* echo_thread(void* param) {
+    int fd = (int)(intptr_t)param;
+    char buffer[MESSAGE_SIZE];
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    while (1) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0 || write(fd, buffer, (size_t)n) != n) {
+            return NULL;
+        }
+    }
+}
+
+static void load_task(void* param) {
+    (void)param;
+    while (1) {
+        uint64_t start = now_ns();
+        while (now_ns() - start < LOAD_BUSY_US * 1000ull) {
+        }
+        task_yield();
+    }
+}
+
+static void control_task(void* param) {
+    (void)param;
+    while (!__atomic_load_n(&client_done, __ATOMIC_ACQUIRE)) {
+        task_sleep(10);
+    }
+    rtos_stop();
+}
+
+// Serve count connections with echo tasks while a client thread runs
+static double run_servers(client_t* client, int* server_fds, size_t* rss_per_task) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 || rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+
+    size_t rss_before = read_rss();
+    for (uint32_t i = 0; i < client->count; i++) {
+        if (task_create("ECHO", echo_task, (void*)(intptr_t)server_fds[i], 1, 0) == 0) {
+            printf("❌ Creating echo task %u failed\n", i);
+            exit(1);
+        }
+    }
+    if (rss_per_task != NULL) {
+        *rss_per_task = (read_rss() - rss_before) / client->count;
+    }
+    task_create("CONTROL", control_task, NULL, 2, 0);
+    if (with_load) {
+        task_create("LOAD", load_task, NULL, PRIORITY_LEVELS - 2, 0);
+    }
+
+    client_done = false;
+    pthread_t thread;
+    uint64_t start = now_ns();
+    pthread_create(&thread, NULL, client_thread, client);
+    rtos_start();
+    pthread_join(thread, NULL);
+
+    return (now_ns() - start) / 1e9;
+}
+
+/*
+ * BENCHMARK 1: Round trip
+ */
+static void bench_round_trip(void) {
+    static uint64_t samples[ROUND_TRIPS];
+    int client_fd;
+    int server_fd;
+    client_t client = { &client_fd, 1, ROUND_TRIPS, samples };
+
+    printf("Echo round trips over a Unix socket, %d byte messages\n", MESSAGE_SIZE);
+    printf("  %-26s %8s %8s %8s %8s %10s\n", "server", "min us", "avg us", "p99 us",
+           "max us", "per sec");
+
+    make_pair(&client_fd, &server_fd);
+    pthread_t thread;
+    uint64_t start = now_ns();
+    pthread_create(&thread, NULL, echo_thread, (void*)(intptr_t)server_fd);
+    client_thread(&client);
+    double seconds = (now_ns() - start) / 1e9;
+    close(client_fd);
+    pthread_join(thread, NULL);
+    close(server_fd);
+    print_round_trips("host thread, blocking read", samples, ROUND_TRIPS, seconds);
+
+    make_pair(&client_fd, &server_fd);
+    with_load = false;
+    seconds = run_servers(&client, &server_fd, NULL);
+    print_round_trips("task, idle system", samples, ROUND_TRIPS, seconds);
+    close(client_fd);
+    close(server_fd);
+
+    make_pair(&client_fd, &server_fd);
+    with_load = true;
+    client.rounds = LOAD_ROUND_TRIPS;
+    seconds = run_servers(&client, &server_fd, NULL);
+    char label[64];
+    snprintf(label, sizeof(label), "task, %d us busy load", LOAD_BUSY_US);
+    print_round_trips(label, samples, LOAD_ROUND_TRIPS, seconds);
+    close(client_fd);
+    close(server_fd);
+    with_load = false;
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        printf("  (one host CPU: under load the client thread also waits for the CPU)\n");
+    }
+    printf("\n");
+}
+
+/*
+ * BENCHMARK 2: Many connections
+ */
+static void bench_connections(void) {
+    int* client_fds = calloc(ECHO_TASKS, sizeof(int));
+    int* server_fds = calloc(ECHO_TASKS, sizeof(int));
+    client_t client = { client_fds, ECHO_TASKS, SCALE_ROUNDS, NULL };
+    size_t rss_per_task = 0;
+
+    for (uint32_t i = 0; i < ECHO_TASKS; i++) {
+        make_pair(&client_fds[i], &server_fds[i]);
+    }
+
+    double seconds = run_servers(&client, server_fds, &rss_per_task);
+    scheduler_stats_t* stats = get_scheduler_stats();
+
+    printf("%d echo tasks on one host thread, %d rounds of one message each\n", ECHO_TASKS,
+           SCALE_ROUNDS);
+    printf("  %-34s %10.0f\n", "echoes per second", ECHO_TASKS * SCALE_ROUNDS / seconds);
+    printf("  %-34s %10.1f\n", "resident KiB per connection task", rss_per_task / 1024.0);
+    printf("  %-34s %10u\n", "tasks readied by I/O", stats->io_wakeups);
+    printf("  %-34s %10u\n", "looks that found events", stats->io_polls);
+    printf("  %-34s %10.1f\n", "tasks readied per look",
+           stats->io_polls ? (double)stats->io_wakeups / stats->io_polls : 0.0);
+    printf("  %-34s %10.2f\n", "context switches per echo",
+           (double)stats->total_context_switches / (ECHO_TASKS * SCALE_ROUNDS));
+
+    for (uint32_t i = 0; i < ECHO_TASKS; i++) {
+        close(client_fds[i]);
+        close(server_fds[i]);
+    }
+    free(client_fds);
+    free(server_fds);
+}
+
+int main(void) {
+    printf("🧪 RTOS ASYNCHRONOUS I/O BENCHMARK\n");
+    printf("==================================\n\n");
+
+    bench_round_trip();
+    bench_connections();
+
+    return 0;
+}
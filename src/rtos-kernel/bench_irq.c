@@ -0,0 +1,247 @@
+/*
+ * Interrupt and Deferred Work Benchmark
+ *
+ * A host thread plays a device that raises IRQ line 0. The top half only
+ * queues a work item; the bottom half runs in the IRQ worker task.
+ *
+ * 1. Latency: the device interrupts at 1 kHz. Measured are the time from
+ *    the device raising the line to the top half running (signal
+ *    delivery), and from the top half to the bottom half running in its
+ *    task (IRQ to task). Once with the system idle, where the worker is
+ *    readied by waking the idle core, and once with a lower priority task
+ *    computing for LOAD_BUSY_US between kernel calls, which is how long
+ *    the cooperative kernel can leave queued work unnoticed.
+ * 2. Bursts: the device raises the line BURST_LENGTH times back to back.
+ *    Events for an item that is still queued coalesce, so the bottom half
+ *    runs about once per burst and is told how many events it covers.
+ *
+ * Build and run:  make bench_irq && ./bench_irq
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEVICE_IRQ 0
+#define PERIODIC_INTERRUPTS 2000
+#define PERIODIC_INTERVAL_US 1000
+#define LOAD_BUSY_US 200
+#define BURSTS 200
+#define BURST_LENGTH 64
+#define BURST_INTERVAL_US 5000
+
+typedef struct {
+    uint64_t samples;
+    uint64_t sum_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t* values;                    // For percentiles
+} latency_stats_t;
+
+static deferred_work_t device_work;
+static latency_stats_t top_half_latency;
+static latency_stats_t bottom_half_latency;
+static uint64_t device_raised_ns;        // When the device last raised the line
+static uint32_t events_handled;
+static bool device_done;
+static bool with_load;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t deadline_ns) {
+    struct timespec ts = { (time_t)(deadline_ns / 1000000000u), (long)(deadline_ns % 1000000000u) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+static void stats_reset(latency_stats_t* stats, uint64_t capacity) {
+    free(stats->values);
+    *stats = (latency_stats_t){0};
+    stats->values = calloc(capacity, sizeof(uint64_t));
+}
+
+static void stats_add(latency_stats_t* stats, uint64_t ns) {
+    if (stats->samples == 0 || ns < stats->min_ns) {
+        stats->min_ns = ns;
+    }
+    if (ns > stats->max_ns) {
+        stats->max_ns = ns;
+    }
+    stats->sum_ns += ns;
+    stats->values[stats->samples++] = ns;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_row(const char* label, latency_stats_t* stats) {
+    if (stats->samples == 0) {
+        printf("  %-22s %8s\n", label, "-");
+        return;
+    }
+    qsort(stats->values, stats->samples, sizeof(uint64_t), compare_u64);
+    printf("  %-22s %8llu %9.1f %9.1f %9.1f %9.1f\n", label, (unsigned long long)stats->samples,
+           stats->min_ns / 1000.0, stats->sum_ns / 1000.0 / stats->samples,
+           stats->values[stats->samples * 99 / 100] / 1000.0, stats->max_ns / 1000.0);
+}
+
+/*
+ * THE DEVICE (a host thread outside the kernel)
+ */
+static void* periodic_device(void* param) {
+    (void)param;
+    uint64_t next = now_ns() + 20000000u; // Let the kernel start
+
+    for (int i = 0; i < PERIODIC_INTERRUPTS; i++) {
+        sleep_until_ns(next);
+        __atomic_store_n(&device_raised_ns, now_ns(), __ATOMIC_RELEASE);
+        rtos_irq_raise(DEVICE_IRQ);
+        next += PERIODIC_INTERVAL_US * 1000u;
+    }
+
+    __atomic_store_n(&device_done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void* burst_device(void* param) {
+    (void)param;
+    uint64_t next = now_ns() + 20000000u;
+
+    for (int i = 0; i < BURSTS; i++) {
+        sleep_until_ns(next);
+        for (int j = 0; j < BURST_LENGTH; j++) {
+            rtos_irq_raise(DEVICE_IRQ);
+        }
+        next += BURST_INTERVAL_US * 1000u;
+    }
+
+    __atomic_store_n(&device_done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/*
+ * TOP AND BOTTOM HALVES
+ */
+static void timed_top_half(uint32_t irq, void* param) {
+    (void)irq;
+    (void)param;
+    stats_add(&top_half_latency, now_ns() - __atomic_load_n(&device_raised_ns, __ATOMIC_ACQUIRE));
+    deferred_work_queue(&device_work);
+}
+
+static void plain_top_half(uint32_t irq, void* param) {
+    (void)irq;
+    (void)param;
+    deferred_work_queue(&device_work);
+}
+
+static void bottom_half(deferred_work_t* work, uint32_t events) {
+    if (work->param != NULL) {
+        stats_add(&bottom_half_latency, work->last_latency_ns);
+    }
+    events_handled += events;
+}
+
+/*
+ * TASKS
+ */
+static void load_task(void* param) {
+    (void)param;
+    while (1) {
+        uint64_t start = now_ns();
+        while (now_ns() - start < LOAD_BUSY_US * 1000ull) {
+        }
+        task_yield();
+    }
+}
+
+static void control_task(void* param) {
+    (void)param;
+    while (!__atomic_load_n(&device_done, __ATOMIC_ACQUIRE)) {
+        task_sleep(10);
+    }
+    task_sleep(10); // Let the last bottom half run
+    rtos_stop();
+}
+
+static void run(void* (*device)(void*), rtos_irq_handler_t top_half, bool timed) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 || rtos_init() != 0 ||
+        rtos_irq_attach(DEVICE_IRQ, top_half, NULL) != 0 ||
+        deferred_work_init(&device_work, bottom_half, timed ? &device_work : NULL) != 0) {
+        printf("❌ Kernel setup failed\n");
+        exit(1);
+    }
+
+    device_done = false;
+    events_handled = 0;
+    task_create("CONTROL", control_task, NULL, 1, 0);
+    if (with_load) {
+        task_create("LOAD", load_task, NULL, PRIORITY_LEVELS - 2, 0);
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, device, NULL);
+    rtos_start();
+    pthread_join(thread, NULL);
+}
+
+static void bench_latency(bool load) {
+    with_load = load;
+    stats_reset(&top_half_latency, PERIODIC_INTERRUPTS);
+    stats_reset(&bottom_half_latency, PERIODIC_INTERRUPTS);
+
+    run(periodic_device, timed_top_half, true);
+
+    if (load) {
+        printf("%d interrupts at %d us, load task computing %d us between kernel calls\n",
+               PERIODIC_INTERRUPTS, PERIODIC_INTERVAL_US, LOAD_BUSY_US);
+    } else {
+        printf("%d interrupts at %d us, system otherwise idle\n",
+               PERIODIC_INTERRUPTS, PERIODIC_INTERVAL_US);
+    }
+    printf("  %-22s %8s %9s %9s %9s %9s\n", "latency", "samples", "min us", "avg us",
+           "p99 us", "max us");
+    print_row("device to top half", &top_half_latency);
+    print_row("top half to task", &bottom_half_latency);
+    printf("  %u interrupts, %u bottom halves, %u events handled\n\n",
+           get_scheduler_stats()->interrupts, get_scheduler_stats()->deferred_runs,
+           events_handled);
+}
+
+static void bench_bursts(void) {
+    with_load = false;
+    run(burst_device, plain_top_half, false);
+
+    scheduler_stats_t* stats = get_scheduler_stats();
+    printf("%d bursts of %d interrupts\n", BURSTS, BURST_LENGTH);
+    printf("  %-34s %8u\n", "interrupts taken", stats->interrupts);
+    printf("  %-34s %8u\n", "bottom halves run", stats->deferred_runs);
+    printf("  %-34s %8u\n", "events coalesced", stats->deferred_coalesced);
+    printf("  %-34s %8u\n", "events handled", events_handled);
+    printf("  %-34s %8.1f\n", "events per bottom half",
+           stats->deferred_runs ? (double)events_handled / stats->deferred_runs : 0.0);
+    printf("  %-34s %8.3f\n", "context switches per interrupt",
+           stats->interrupts ? (double)stats->total_context_switches / stats->interrupts : 0.0);
+    printf("  %-34s %8.1f us\n", "worst queued to bottom half", device_work.max_latency_ns / 1000.0);
+}
+
+int main(void) {
+    printf("🧪 RTOS INTERRUPT AND DEFERRED WORK BENCHMARK\n");
+    printf("=============================================\n\n");
+
+    bench_latency(false);
+    bench_latency(true);
+    bench_bursts();
+
+    return 0;
+}
@@ -0,0 +1,552 @@
+/*
+ * Wake-up Latency Benchmark (cyclictest-style)
+ *
+ * The number that matters most for an RTOS is how late a high-priority
+ * task really runs after the moment it should have woken up. Like the
+ * Linux cyclictest tool, this benchmark runs periodic measurement tasks
+ * at the highest priority, each sleeping for a fixed interval, and
+ * compares the host time it gets the CPU with the time its wake-up tick
+ * was due (rtos_tick_time_ns). Background load competes with them:
+ *
+ *   - RTOS load tasks at a lower priority, which burn the CPU for a
+ *     configurable time between kernel calls (the only preemption points)
+ *   - optional host threads spinning next to the kernel, the way other
+ *     processes compete with a real-time thread on Linux
+ *
+ * Both execution modes are measured:
+ *
+ *   - tick-driven (RTOS_MODE_SIMULATED): the 1 ms tick loop wakes the
+ *     task and switches to it at once. Task functions do not run here, so
+ *     the measurement tasks follow a sleep script and the latency is taken
+ *     in the switch hook when they are switched in.
+ *   - context switch (RTOS_MODE_CONTEXT_SWITCH): the measurement task takes
+ *     the time itself when task_sleep returns, and the gap between the
+ *     switch hook and that moment is the cost of the switch to it.
+ *
+ * In context-switch mode every wake-up also times one rtos_malloc/rtos_free
+ * pair and one partition-pool pair, while the load tasks keep replacing
+ * blocks of random sizes to fragment the heap. The worst case is what a
+ * real-time task has to budget for; libc malloc is timed the same way for
+ * comparison.
+ *
+ * Results are min/avg/max/p99.99 per mode, the host CPU time the kernel's
+ * thread used (with -l 0 the system is idle between wake-ups, so this
+ * shows what tickless idle saves), the context-switch cost, the
+ * allocation latencies, and a histogram file with one row per microsecond
+ * and one column per mode.
+ * Plot it with gnuplot:
+ *
+ *   set logscale y; plot for [c=2:3] 'latency_hist.dat' using 1:c with steps title columnhead
+ *
+ * Build and run:  make bench_latency && ./bench_latency [options]
+ *   -t N   measurement tasks (default 2)
+ *   -i MS  sleep interval of each measurement task (default 1)
+ *   -d MS  length of each run (default 5000)
+ *   -l N   RTOS load tasks (default 2)
+ *   -b US  work a load task does between kernel calls (default 200)
+ *   -H N   spinning host threads (default 0)
+ *   -m M   mode: sim, switch or both (default both)
+ *   -o F   histogram file (default latency_hist.dat)
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_PROBES 8
+#define MAX_LOAD_TASKS 16
+#define MAX_HOST_THREADS 16
+#define HIST_BUCKETS 20000           // 1 us each; 20 ms and longer share the last
+#define PROBE_PRIORITY 0
+#define LOAD_PRIORITY 2
+#define PINGPONG_ROUNDS 100000
+#define CHURN_BLOCKS 64              // Live blocks each load task keeps
+#define CHURN_MAX_SIZE 8192
+#define PROBE_MAX_SIZE 4096
+#define POOL_BLOCK_SIZE 64
+#define POOL_BLOCKS 256
+
+typedef enum {
+    MODE_TICK = 0,
+    MODE_SWITCH,
+    MODE_COUNT
+} bench_mode_t;
+
+static const char* mode_names[MODE_COUNT] = {"tick-driven", "context-switch"};
+
+typedef enum {
+    ALLOC_RTOS_MALLOC = 0,
+    ALLOC_RTOS_FREE,
+    ALLOC_POOL_ALLOC,
+    ALLOC_POOL_FREE,
+    ALLOC_LIBC_MALLOC,
+    ALLOC_LIBC_FREE,
+    ALLOC_KINDS
+} alloc_kind_t;
+
+static const char* alloc_names[ALLOC_KINDS] = {
+    "rtos_malloc", "rtos_free", "pool_alloc", "pool_free", "malloc (libc)", "free (libc)",
+};
+
+typedef struct {
+    uint64_t samples;
+    uint64_t sum_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+} latency_stats_t;
+
+typedef struct {
+    uint32_t task_id;
+    uint32_t due_tick;               // Tick the current sleep ends at
+    bool armed;                      // due_tick is set
+    uint64_t switched_in_ns;         // Switch hook time of the last wake
+    latency_stats_t latency;
+} probe_t;
+
+// Options
+static int probe_count = 2;
+static uint32_t interval_ms = 1;
+static uint32_t duration_ms = 5000;
+static int load_count = 2;
+static uint32_t busy_us = 200;
+static int host_threads = 0;
+static bool run_mode[MODE_COUNT] = {true, true};
+static const char* hist_path = "latency_hist.dat";
+
+// Results
+static probe_t probes[MAX_PROBES];
+static bench_mode_t current_mode;
+static uint64_t histogram[MODE_COUNT][HIST_BUCKETS];
+static latency_stats_t mode_latency[MODE_COUNT];
+static double mode_cpu_use[MODE_COUNT];       // Kernel thread CPU time / run time
+static latency_stats_t switch_cost;
+static latency_stats_t alloc_latency[ALLOC_KINDS];
+static mem_pool_t message_pool;
+static uint32_t random_state = 1;
+static volatile bool host_load_running;
+
+static uint64_t thread_cpu_ns(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return ((uint64_t)usage.ru_utime.tv_sec + (uint64_t)usage.ru_stime.tv_sec) * 1000000000u +
+           ((uint64_t)usage.ru_utime.tv_usec + (uint64_t)usage.ru_stime.tv_usec) * 1000u;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void stats_add(latency_stats_t* stats, uint64_t ns) {
+    if (stats->samples == 0 || ns < stats->min_ns) {
+        stats->min_ns = ns;
+    }
+    if (ns > stats->max_ns) {
+        stats->max_ns = ns;
+    }
+    stats->sum_ns += ns;
+    stats->samples++;
+}
+
+static uint32_t bench_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void record_latency(probe_t* probe, uint64_t woke_ns) {
+    uint64_t due_ns = rtos_tick_time_ns(probe->due_tick);
+    uint64_t latency = woke_ns > due_ns ? woke_ns - due_ns : 0;
+    uint64_t bucket = latency / 1000;
+
+    stats_add(&probe->latency, latency);
+    stats_add(&mode_latency[current_mode], latency);
+    histogram[current_mode][bucket < HIST_BUCKETS ? bucket : HIST_BUCKETS - 1]++;
+    probe->armed = false;
+}
+
+/*
+ * SWITCH HOOK
+ *
+ * Only measurement tasks have a parameter. A measurement task leaving the
+ * CPU blocked tells us when its sleep ends; one coming back is the moment
+ * it gets the CPU.
+ */
+static void latency_hook(tcb_t* from, tcb_t* to) {
+    if (from != NULL && from->task_parameter != NULL &&
+        from->state == TASK_BLOCKED && from->wake_time > 0) {
+        probe_t* probe = from->task_parameter;
+        probe->due_tick = from->wake_time;
+        probe->armed = true;
+    }
+
+    if (to->task_parameter != NULL) {
+        probe_t* probe = to->task_parameter;
+        uint64_t now = now_ns();
+
+        if (current_mode == MODE_TICK) {
+            if (probe->armed) {
+                record_latency(probe, now);
+            }
+        } else {
+            probe->switched_in_ns = now;
+        }
+    }
+}
+
+/*
+ * TASKS (context-switch mode)
+ */
+static void time_allocation(alloc_kind_t alloc_kind, void* (*alloc)(size_t),
+                            void (*release)(void*)) {
+    size_t size = 16 + bench_random() % PROBE_MAX_SIZE;
+
+    uint64_t start = now_ns();
+    void* block = alloc(size);
+    uint64_t allocated = now_ns();
+    release(block);
+    uint64_t released = now_ns();
+
+    stats_add(&alloc_latency[alloc_kind], allocated - start);
+    stats_add(&alloc_latency[alloc_kind + 1], released - allocated);
+}
+
+static void time_pool(void) {
+    uint64_t start = now_ns();
+    void* block = pool_alloc(&message_pool);
+    uint64_t allocated = now_ns();
+    pool_free(&message_pool, block);
+    uint64_t released = now_ns();
+
+    stats_add(&alloc_latency[ALLOC_POOL_ALLOC], allocated - start);
+    stats_add(&alloc_latency[ALLOC_POOL_FREE], released - allocated);
+}
+
+static void probe_task(void* param) {
+    probe_t* probe = param;
+
+    while (1) {
+        task_sleep(interval_ms);
+
+        uint64_t now = now_ns();
+        if (probe->armed) {
+            stats_add(&switch_cost, now - probe->switched_in_ns);
+            record_latency(probe, now);
+        }
+
+        time_allocation(ALLOC_RTOS_MALLOC, rtos_malloc, rtos_free);
+        time_allocation(ALLOC_LIBC_MALLOC, malloc, free);
+        time_pool();
+    }
+}
+
+// Replace one random block on each heap per slice, to fragment both
+static void load_task(void* param) {
+    (void)param;
+    void* rtos_blocks[CHURN_BLOCKS] = {0};
+    void* libc_blocks[CHURN_BLOCKS] = {0};
+
+    while (1) {
+        uint32_t victim = bench_random() % CHURN_BLOCKS;
+        size_t size = 16 + bench_random() % CHURN_MAX_SIZE;
+        rtos_free(rtos_blocks[victim]);
+        rtos_blocks[victim] = rtos_malloc(size);
+        free(libc_blocks[victim]);
+        libc_blocks[victim] = malloc(size);
+
+        uint64_t start = now_ns();
+        while (now_ns() - start < busy_us * 1000ull) {
+        }
+        task_yield();
+    }
+}
+
+/*
+ * HOST LOAD AND RUN LENGTH
+ */
+static void* host_spin_thread(void* param) {
+    (void)param;
+    while (host_load_running) {
+    }
+    return NULL;
+}
+
+// Ends the run from outside, since nothing runs task code in tick mode
+static void* stopper_thread(void* param) {
+    (void)param;
+    usleep(duration_ms * 1000u);
+    rtos_stop();
+    return NULL;
+}
+
+/*
+ * ONE MEASUREMENT RUN
+ */
+static script_step_t probe_script[] = {
+    {SCRIPT_SLEEP, 1, 0}, {SCRIPT_REPEAT, 0, 0},   // Sleep length set from -i
+};
+
+static void run_latency(bench_mode_t mode) {
+    current_mode = mode;
+    if (rtos_set_mode(mode == MODE_TICK ? RTOS_MODE_SIMULATED : RTOS_MODE_CONTEXT_SWITCH) != 0 ||
+        rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+    rtos_set_switch_hook(latency_hook);
+    if (pool_create(&message_pool, POOL_BLOCK_SIZE, POOL_BLOCKS) != 0) {
+        printf("❌ pool_create failed\n");
+        exit(1);
+    }
+
+    probe_script[0].ticks = interval_ms;
+
+    for (int i = 0; i < probe_count; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "PROBE%d", i);
+        memset(&probes[i], 0, sizeof(probes[i]));
+        probes[i].task_id = task_create(name, probe_task, &probes[i], PROBE_PRIORITY, 0);
+        if (probes[i].task_id == 0 ||
+            (mode == MODE_TICK && task_set_script(probes[i].task_id, probe_script) != 0)) {
+            printf("❌ Could not create %s\n", name);
+            exit(1);
+        }
+    }
+    for (int i = 0; i < load_count; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "LOAD%d", i);
+        task_create(name, load_task, NULL, LOAD_PRIORITY, 0);
+    }
+
+    pthread_t hosts[MAX_HOST_THREADS];
+    pthread_t stopper;
+    host_load_running = true;
+    for (int i = 0; i < host_threads; i++) {
+        pthread_create(&hosts[i], NULL, host_spin_thread, NULL);
+    }
+    pthread_create(&stopper, NULL, stopper_thread, NULL);
+
+    // The kernel (one core) runs on this thread in both modes
+    uint64_t cpu_start = thread_cpu_ns();
+    uint64_t wall_start = now_ns();
+    rtos_start();
+    mode_cpu_use[mode] = (double)(thread_cpu_ns() - cpu_start) / (now_ns() - wall_start);
+
+    pthread_join(stopper, NULL);
+    host_load_running = false;
+    for (int i = 0; i < host_threads; i++) {
+        pthread_join(hosts[i], NULL);
+    }
+}
+
+/*
+ * CONTEXT-SWITCH COST: semaphore ping-pong, two switches per round
+ */
+static semaphore_t ping_sem;
+static semaphore_t pong_sem;
+static double round_ns;
+
+static void ping_task(void* param) {
+    (void)param;
+    uint64_t start = now_ns();
+    for (int i = 0; i < PINGPONG_ROUNDS; i++) {
+        semaphore_signal(&ping_sem);
+        semaphore_wait(&pong_sem);
+    }
+    round_ns = (double)(now_ns() - start) / PINGPONG_ROUNDS;
+    rtos_stop();
+}
+
+static void pong_task(void* param) {
+    (void)param;
+    while (1) {
+        semaphore_wait(&ping_sem);
+        semaphore_signal(&pong_sem);
+    }
+}
+
+static double run_pingpong(void) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 || rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+    semaphore_init(&ping_sem, 0);
+    semaphore_init(&pong_sem, 0);
+    task_create("PING", ping_task, NULL, 1, 0);
+    task_create("PONG", pong_task, NULL, 1, 0);
+    rtos_start();
+    return round_ns / 2;
+}
+
+/*
+ * REPORTING
+ */
+static double clock_read_ns(void) {
+    uint64_t start = now_ns();
+    for (int i = 0; i < 100000; i++) {
+        now_ns();
+    }
+    return (now_ns() - start) / 100000.0;
+}
+
+static uint64_t percentile_us(const uint64_t* hist, uint64_t samples, double fraction) {
+    uint64_t needed = (uint64_t)(samples * fraction);
+    uint64_t seen = 0;
+
+    if (needed >= samples) {
+        needed = samples - 1;
+    }
+    for (uint64_t bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+        seen += hist[bucket];
+        if (seen > needed) {
+            return bucket + 1; // Upper edge of the bucket
+        }
+    }
+    return HIST_BUCKETS;
+}
+
+static void print_row(const char* label, const latency_stats_t* stats) {
+    printf("  %-16s %8llu %9.1f %9.1f %9.1f", label, (unsigned long long)stats->samples,
+           stats->min_ns / 1000.0, stats->sum_ns / 1000.0 / stats->samples,
+           stats->max_ns / 1000.0);
+}
+
+static void report_mode(bench_mode_t mode) {
+    latency_stats_t* total = &mode_latency[mode];
+
+    printf("%s mode, %d measurement task(s) every %u ms, %d load task(s) x %u us, "
+           "%d host spinner(s)\n", mode_names[mode], probe_count, interval_ms,
+           load_count, busy_us, host_threads);
+    if (total->samples == 0) {
+        printf("  no samples ❌\n\n");
+        return;
+    }
+
+    printf("  %-16s %8s %9s %9s %9s %10s\n", "task", "samples", "min us", "avg us",
+           "max us", "p99.99 us");
+    for (int i = 0; i < probe_count; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "PROBE%d", i);
+        print_row(name, &probes[i].latency);
+        printf("\n");
+    }
+    char p9999[24];
+    snprintf(p9999, sizeof(p9999), "<%llu", (unsigned long long)percentile_us(
+             histogram[mode], total->samples, 0.9999));
+    print_row("all", total);
+    printf(" %10s\n", p9999);
+    if (mode == MODE_SWITCH && switch_cost.samples > 0) {
+        print_row("switch-in cost", &switch_cost);
+        printf("  (switch hook to task running)\n");
+    }
+    printf("  host CPU used by the kernel thread: %.1f%%\n\n", 100.0 * mode_cpu_use[mode]);
+}
+
+static void report_allocation(void) {
+    printf("Allocation latency at each wake-up (%u..%u bytes; load tasks churn %d blocks "
+           "of up to %u bytes each)\n", 16, 16 + PROBE_MAX_SIZE - 1, CHURN_BLOCKS, CHURN_MAX_SIZE);
+    printf("  %-16s %8s %9s %9s %9s\n", "call", "samples", "min us", "avg us", "max us");
+    for (int kind = 0; kind < ALLOC_KINDS; kind++) {
+        if (alloc_latency[kind].samples > 0) {
+            print_row(alloc_names[kind], &alloc_latency[kind]);
+            printf("\n");
+        }
+    }
+    printf("  (each includes one clock read, ~%.0f ns)\n\n", clock_read_ns());
+}
+
+static int write_histogram(void) {
+    FILE* file = fopen(hist_path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+
+    uint64_t last = 0;
+    for (uint64_t bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+        for (int mode = 0; mode < MODE_COUNT; mode++) {
+            if (histogram[mode][bucket] != 0) {
+                last = bucket;
+            }
+        }
+    }
+
+    fprintf(file, "# Wake-up latency histogram, 1 us buckets (last bucket: %d us and up)\n",
+            HIST_BUCKETS - 1);
+    fprintf(file, "latency_us tick-driven context-switch\n");
+    for (uint64_t bucket = 0; bucket <= last; bucket++) {
+        fprintf(file, "%llu %llu %llu\n", (unsigned long long)bucket,
+                (unsigned long long)histogram[MODE_TICK][bucket],
+                (unsigned long long)histogram[MODE_SWITCH][bucket]);
+    }
+
+    fclose(file);
+    return 0;
+}
+
+static void usage(const char* program) {
+    printf("usage: %s [-t tasks] [-i interval_ms] [-d duration_ms] [-l load_tasks]\n"
+           "          [-b busy_us] [-H host_threads] [-m sim|switch|both] [-o file]\n", program);
+    exit(1);
+}
+
+static void parse_options(int argc, char** argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "t:i:d:l:b:H:m:o:")) != -1) {
+        switch (opt) {
+            case 't': probe_count = atoi(optarg); break;
+            case 'i': interval_ms = (uint32_t)atoi(optarg); break;
+            case 'd': duration_ms = (uint32_t)atoi(optarg); break;
+            case 'l': load_count = atoi(optarg); break;
+            case 'b': busy_us = (uint32_t)atoi(optarg); break;
+            case 'H': host_threads = atoi(optarg); break;
+            case 'o': hist_path = optarg; break;
+            case 'm':
+                run_mode[MODE_TICK] = strcmp(optarg, "switch") != 0;
+                run_mode[MODE_SWITCH] = strcmp(optarg, "sim") != 0;
+                break;
+            default: usage(argv[0]);
+        }
+    }
+
+    if (probe_count < 1 || probe_count > MAX_PROBES || interval_ms == 0 ||
+        duration_ms == 0 || load_count < 0 || load_count > MAX_LOAD_TASKS ||
+        host_threads < 0 || host_threads > MAX_HOST_THREADS) {
+        usage(argv[0]);
+    }
+}
+
+int main(int argc, char** argv) {
+    parse_options(argc, argv);
+
+    printf("🧪 RTOS WAKE-UP LATENCY BENCHMARK\n");
+    printf("=================================\n\n");
+
+    for (int mode = 0; mode < MODE_COUNT; mode++) {
+        if (run_mode[mode]) {
+            run_latency((bench_mode_t)mode);
+            report_mode((bench_mode_t)mode);
+        }
+    }
+
+    if (run_mode[MODE_SWITCH]) {
+        report_allocation();
+    }
+
+    printf("Context switch, semaphore ping-pong: %.1f ns per switch\n", run_pingpong());
+
+    if (write_histogram() != 0) {
+        printf("❌ Could not write %s\n", hist_path);
+        return 1;
+    }
+    printf("Histogram written to %s ✅\n", hist_path);
+
+    return 0;
+}
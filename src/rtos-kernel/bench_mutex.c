@@ -0,0 +1,173 @@
+/*
+ * Mutex Benchmark
+ *
+ * Runs in context-switch mode so tasks really block and resume.
+ *
+ * 1. Uncontended lock/unlock: the single-CAS fast path
+ * 2. Contended handoff: two tasks forced to block on each other every time
+ * 3. Priority inversion: LOW holds a mutex that HIGH needs while MED hogs
+ *    the CPU. With priority inheritance HIGH waits at most for the rest of
+ *    LOW's critical section; without it HIGH also waits for all of MED.
+ *
+ * Build and run:  make bench_mutex && ./bench_mutex
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define UNCONTENDED_ITERATIONS 10000000
+#define HANDOFF_ITERATIONS 100000
+#define CRITICAL_SECTION_UNITS 500     // LOW's work while holding the mutex
+#define MEDIUM_UNITS 5000              // MED's CPU-bound work
+#define WORK_UNIT_SPINS 5000           // Busy loop per work unit
+
+static mutex_t bench_mutex;
+static double high_wait_ms;
+static double critical_section_ms;
+static int handoff_done;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// One unit of CPU work followed by a preemption point
+static void work_unit(void) {
+    for (volatile int i = 0; i < WORK_UNIT_SPINS; i++) {
+    }
+    task_yield();
+}
+
+static void start_kernel(void) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 || rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+    mutex_init(&bench_mutex);
+}
+
+/*
+ * BENCHMARK 1: Uncontended fast path
+ */
+static void uncontended_task(void* param) {
+    (void)param;
+
+    double start = now_seconds();
+    for (int i = 0; i < UNCONTENDED_ITERATIONS; i++) {
+        mutex_lock(&bench_mutex);
+        mutex_unlock(&bench_mutex);
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("%-30s %12.0f pairs/s  %7.1f ns/pair\n", "uncontended lock+unlock",
+           UNCONTENDED_ITERATIONS / elapsed, elapsed * 1e9 / UNCONTENDED_ITERATIONS);
+
+    rtos_stop();
+}
+
+static void bench_uncontended(void) {
+    start_kernel();
+    task_create("FAST", uncontended_task, NULL, 0, 0);
+    rtos_start();
+}
+
+/*
+ * BENCHMARK 2: Contended handoff
+ *
+ * Each task yields while holding the mutex, so the other task always finds
+ * it locked, blocks, and is handed the mutex on unlock.
+ */
+static void handoff_task(void* param) {
+    (void)param;
+
+    double start = now_seconds();
+    for (int i = 0; i < HANDOFF_ITERATIONS; i++) {
+        mutex_lock(&bench_mutex);
+        task_yield();
+        mutex_unlock(&bench_mutex);
+    }
+    double elapsed = now_seconds() - start;
+
+    if (++handoff_done == 2) {
+        uint32_t contentions = get_scheduler_stats()->mutex_contentions;
+        printf("%-30s %12.0f handoffs/s  %5.2f us/handoff  (%u contentions)\n",
+               "contended handoff", contentions / elapsed,
+               elapsed * 1e6 / contentions, contentions);
+        rtos_stop();
+    }
+}
+
+static void bench_handoff(void) {
+    start_kernel();
+    handoff_done = 0;
+    task_create("PING", handoff_task, NULL, 1, 0);
+    task_create("PONG", handoff_task, NULL, 1, 0);
+    rtos_start();
+}
+
+/*
+ * BENCHMARK 3: Priority inversion
+ */
+static void low_task(void* param) {
+    (void)param;
+
+    mutex_lock(&bench_mutex);
+    double start = now_seconds();
+    for (int i = 0; i < CRITICAL_SECTION_UNITS; i++) {
+        work_unit();
+    }
+    critical_section_ms = (now_seconds() - start) * 1e3;
+    mutex_unlock(&bench_mutex);
+}
+
+static void medium_task(void* param) {
+    (void)param;
+
+    task_sleep(1);
+    for (int i = 0; i < MEDIUM_UNITS; i++) {
+        work_unit();
+    }
+}
+
+static void high_task(void* param) {
+    (void)param;
+
+    task_sleep(2);
+
+    double start = now_seconds();
+    mutex_lock(&bench_mutex);
+    high_wait_ms = (now_seconds() - start) * 1e3;
+    mutex_unlock(&bench_mutex);
+
+    rtos_stop();
+}
+
+static void bench_inversion(bool inheritance) {
+    start_kernel();
+    bench_mutex.priority_inheritance = inheritance;
+
+    task_create("HIGH", high_task, NULL, 0, 0);
+    task_create("MED", medium_task, NULL, 1, 0);
+    task_create("LOW", low_task, NULL, 2, 0);
+    rtos_start();
+
+    printf("%-30s HIGH blocked %8.2f ms  (LOW critical section %6.2f ms, %u boosts)\n",
+           inheritance ? "inversion, inheritance on" : "inversion, inheritance off",
+           high_wait_ms, critical_section_ms, get_scheduler_stats()->priority_boosts);
+}
+
+int main(void) {
+    printf("🧪 RTOS MUTEX BENCHMARK\n");
+    printf("=======================\n");
+
+    bench_uncontended();
+    bench_handoff();
+    bench_inversion(true);
+    bench_inversion(false);
+
+    return 0;
+}
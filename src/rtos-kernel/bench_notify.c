@@ -0,0 +1,209 @@
+/*
+ * Notification and Event Group Benchmark
+ *
+ * Runs in context-switch mode so tasks really block and resume.
+ *
+ * 1. Signal with nobody waiting: semaphore_signal, task_notify and
+ *    event_group_set_bits on their fast paths
+ * 2. Ping-pong: two tasks waking each other in turn, through a pair of
+ *    semaphores, direct notifications, or two bits of one event group
+ *    (two switches per round trip)
+ * 3. The event group ping-pong again while a thousand other tasks wait on
+ *    other bits of the same group: waiters are kept per bit, so the cost
+ *    of setting a bit must not depend on them
+ *
+ * Build and run:  make bench_notify && ./bench_notify
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define FAST_PATH_ITERATIONS 10000000
+#define PINGPONG_ROUNDS 200000
+#define BYSTANDER_TASKS 1000
+
+#define PING_BIT (1u << 0)
+#define PONG_BIT (1u << 1)
+#define BYSTANDER_BITS (0xFFFFFFFFu & ~(PING_BIT | PONG_BIT))
+
+typedef enum {
+    SIGNAL_SEMAPHORE = 0,
+    SIGNAL_NOTIFY,
+    SIGNAL_EVENT_GROUP
+} signal_kind_t;
+
+static const char* signal_names[] = { "semaphore", "task notification", "event group" };
+
+static semaphore_t ping_sem;
+static semaphore_t pong_sem;
+static semaphore_t never_sem;
+static event_group_t group;
+static signal_kind_t kind;
+static uint32_t ping_id;
+static uint32_t pong_id;
+static uint32_t sleeper_id;
+static double round_trip_ns;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void start_kernel(void) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 || rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+    semaphore_init(&ping_sem, 0);
+    semaphore_init(&pong_sem, 0);
+    semaphore_init(&never_sem, 0);
+    event_group_init(&group);
+}
+
+/*
+ * BENCHMARK 1: Fast paths
+ */
+// Notified, but never waiting for a notification
+static void sleeper_task(void* param) {
+    (void)param;
+    semaphore_wait(&never_sem);
+}
+
+static void fast_path_task(void* param) {
+    (void)param;
+
+    double start = now_seconds();
+    for (int i = 0; i < FAST_PATH_ITERATIONS; i++) {
+        semaphore_signal(&ping_sem);
+    }
+    double semaphore_ns = (now_seconds() - start) * 1e9 / FAST_PATH_ITERATIONS;
+
+    start = now_seconds();
+    for (int i = 0; i < FAST_PATH_ITERATIONS; i++) {
+        task_notify(sleeper_id, 0, NOTIFY_INCREMENT);
+    }
+    double notify_ns = (now_seconds() - start) * 1e9 / FAST_PATH_ITERATIONS;
+
+    start = now_seconds();
+    for (int i = 0; i < FAST_PATH_ITERATIONS; i++) {
+        event_group_set_bits(&group, PING_BIT);
+    }
+    double event_ns = (now_seconds() - start) * 1e9 / FAST_PATH_ITERATIONS;
+
+    printf("Signal with nobody waiting\n");
+    printf("  %-22s %7.1f ns   (%zu byte object)\n", "semaphore_signal", semaphore_ns,
+           sizeof(semaphore_t));
+    printf("  %-22s %7.1f ns   (no object; %zu bytes in every TCB)\n", "task_notify", notify_ns,
+           sizeof(uint32_t) + 2 * sizeof(bool));
+    printf("  %-22s %7.1f ns   (%zu byte object)\n\n", "event_group_set_bits", event_ns,
+           sizeof(event_group_t));
+
+    rtos_stop();
+}
+
+static void bench_fast_paths(void) {
+    start_kernel();
+    sleeper_id = task_create("SLEEPER", sleeper_task, NULL, 1, 0);
+    task_create("FAST", fast_path_task, NULL, 2, 0);
+    rtos_start();
+}
+
+/*
+ * BENCHMARK 2 AND 3: Ping-pong
+ */
+static void signal_other(bool from_ping) {
+    switch (kind) {
+        case SIGNAL_SEMAPHORE:
+            semaphore_signal(from_ping ? &ping_sem : &pong_sem);
+            break;
+        case SIGNAL_NOTIFY:
+            task_notify(from_ping ? pong_id : ping_id, 0, NOTIFY_INCREMENT);
+            break;
+        case SIGNAL_EVENT_GROUP:
+            event_group_set_bits(&group, from_ping ? PING_BIT : PONG_BIT);
+            break;
+    }
+}
+
+static void wait_other(bool in_ping) {
+    switch (kind) {
+        case SIGNAL_SEMAPHORE:
+            semaphore_wait(in_ping ? &pong_sem : &ping_sem);
+            break;
+        case SIGNAL_NOTIFY:
+            task_notify_take(false, RTOS_WAIT_FOREVER);
+            break;
+        case SIGNAL_EVENT_GROUP:
+            event_group_wait(&group, in_ping ? PONG_BIT : PING_BIT, false, true,
+                             RTOS_WAIT_FOREVER, NULL);
+            break;
+    }
+}
+
+static void ping_task(void* param) {
+    (void)param;
+
+    double start = now_seconds();
+    for (int i = 0; i < PINGPONG_ROUNDS; i++) {
+        signal_other(true);
+        wait_other(true);
+    }
+    round_trip_ns = (now_seconds() - start) * 1e9 / PINGPONG_ROUNDS;
+
+    rtos_stop();
+}
+
+static void pong_task(void* param) {
+    (void)param;
+
+    while (1) {
+        wait_other(false);
+        signal_other(false);
+    }
+}
+
+// Waits for all of the bits nobody ever sets
+static void bystander_task(void* param) {
+    (void)param;
+    event_group_wait(&group, BYSTANDER_BITS, true, false, RTOS_WAIT_FOREVER, NULL);
+}
+
+static void bench_pingpong(signal_kind_t signal_kind, int bystanders) {
+    start_kernel();
+    kind = signal_kind;
+
+    for (int i = 0; i < bystanders; i++) {
+        task_create("BYSTANDER", bystander_task, NULL, 0, 0);
+    }
+    ping_id = task_create("PING", ping_task, NULL, 1, 0);
+    pong_id = task_create("PONG", pong_task, NULL, 1, 0);
+    rtos_start();
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s", signal_names[signal_kind]);
+    if (bystanders > 0) {
+        snprintf(label, sizeof(label), "%s, %d other waiters", signal_names[signal_kind],
+                 bystanders);
+    }
+    printf("  %-36s %8.1f ns/round trip  %7.1f ns/switch\n", label, round_trip_ns,
+           round_trip_ns * PINGPONG_ROUNDS / get_scheduler_stats()->total_context_switches);
+}
+
+int main(void) {
+    printf("🧪 RTOS NOTIFICATION AND EVENT GROUP BENCHMARK\n");
+    printf("==============================================\n\n");
+
+    bench_fast_paths();
+
+    printf("Ping-pong, %d round trips\n", PINGPONG_ROUNDS);
+    bench_pingpong(SIGNAL_SEMAPHORE, 0);
+    bench_pingpong(SIGNAL_NOTIFY, 0);
+    bench_pingpong(SIGNAL_EVENT_GROUP, 0);
+    bench_pingpong(SIGNAL_EVENT_GROUP, BYSTANDER_TASKS);
+
+    return 0;
+}
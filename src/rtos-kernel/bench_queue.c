@@ -0,0 +1,301 @@
+/*
+ * Semaphore and Message Queue Benchmark
+ *
+ * 1. Semaphore fast path: wait/signal on an available semaphore
+ * 2. Blocking ping-pong between two tasks over a pair of SPSC queues
+ * 3. Streaming throughput of SPSC and MPMC queues between two tasks
+ * 4. Large payloads: copying 64 KiB messages vs passing pointers
+ * 5. MPMC correctness under real concurrency: OS threads hammer the
+ *    lock-free ring and the checksum of everything received must match
+ *
+ * Build and run:  make bench_queue && ./bench_queue
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SEMAPHORE_ITERATIONS 10000000
+#define PINGPONG_ROUNDS 200000
+#define STREAM_MESSAGES 2000000
+#define STREAM_MESSAGE_SIZE 64
+#define LARGE_MESSAGES 20000
+#define LARGE_MESSAGE_SIZE (64 * 1024)
+#define LARGE_QUEUE_CAPACITY 16
+#define LARGE_POOL 32                // Payload buffers; more than can be in flight
+#define THREAD_MESSAGES 500000       // Per producer thread
+#define THREAD_PAIRS 2
+
+static msg_queue_t queue_a;
+static msg_queue_t queue_b;
+static double phase_start;
+static const char* phase_label;
+static uint32_t phase_messages;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char* label, uint32_t operations, double seconds) {
+    printf("%-32s %12.0f ops/s  %8.1f ns/op\n",
+           label, operations / seconds, seconds * 1e9 / operations);
+}
+
+static void start_kernel(void) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 || rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+}
+
+/*
+ * BENCHMARK 1: Semaphore fast path
+ */
+static void semaphore_task(void* param) {
+    (void)param;
+    semaphore_t sem;
+    semaphore_init(&sem, 1);
+
+    double start = now_seconds();
+    for (int i = 0; i < SEMAPHORE_ITERATIONS; i++) {
+        semaphore_wait(&sem);
+        semaphore_signal(&sem);
+    }
+    report("semaphore wait+signal", SEMAPHORE_ITERATIONS, now_seconds() - start);
+
+    rtos_stop();
+}
+
+/*
+ * BENCHMARK 2: Ping-pong
+ *
+ * Every message wakes the other task, which is blocked on an empty queue.
+ */
+static void ping_task(void* param) {
+    (void)param;
+
+    double start = now_seconds();
+    for (uint32_t i = 0; i < PINGPONG_ROUNDS; i++) {
+        uint32_t reply;
+        queue_send(&queue_a, &i);
+        queue_receive(&queue_b, &reply);
+        if (reply != i) {
+            printf("❌ Ping-pong mismatch: %u != %u\n", reply, i);
+            exit(1);
+        }
+    }
+    report("ping-pong round trip", PINGPONG_ROUNDS, now_seconds() - start);
+
+    rtos_stop();
+}
+
+static void pong_task(void* param) {
+    (void)param;
+
+    while (1) {
+        uint32_t value;
+        queue_receive(&queue_a, &value);
+        queue_send(&queue_b, &value);
+    }
+}
+
+/*
+ * BENCHMARK 3 AND 4: Streaming
+ *
+ * The producer fills the queue until it blocks, then the consumer drains
+ * it until it blocks, so messages move in batches of the queue capacity.
+ */
+static void stream_producer(void* param) {
+    msg_queue_t* queue = param;
+    uint8_t message[STREAM_MESSAGE_SIZE] = {0};
+
+    for (uint32_t i = 0; i < phase_messages; i++) {
+        memcpy(message, &i, sizeof(i));
+        queue_send(queue, message);
+    }
+}
+
+static void stream_consumer(void* param) {
+    msg_queue_t* queue = param;
+    uint8_t message[STREAM_MESSAGE_SIZE];
+
+    for (uint32_t i = 0; i < phase_messages; i++) {
+        uint32_t value;
+        queue_receive(queue, message);
+        memcpy(&value, message, sizeof(value));
+        if (value != i) {
+            printf("❌ Stream out of order: %u != %u\n", value, i);
+            exit(1);
+        }
+    }
+
+    report(phase_label, phase_messages, now_seconds() - phase_start);
+    rtos_stop();
+}
+
+static uint8_t* large_buffers[LARGE_POOL];
+
+static void large_copy_producer(void* param) {
+    (void)param;
+    for (uint32_t i = 0; i < LARGE_MESSAGES; i++) {
+        large_buffers[0][0] = (uint8_t)i;
+        queue_send(&queue_a, large_buffers[0]);
+    }
+}
+
+static void large_copy_consumer(void* param) {
+    (void)param;
+    for (uint32_t i = 0; i < LARGE_MESSAGES; i++) {
+        queue_receive(&queue_a, large_buffers[1]);
+    }
+    report("64 KiB messages, copied", LARGE_MESSAGES, now_seconds() - phase_start);
+    rtos_stop();
+}
+
+static void large_ptr_producer(void* param) {
+    (void)param;
+    for (uint32_t i = 0; i < LARGE_MESSAGES; i++) {
+        uint8_t* payload = large_buffers[i % LARGE_POOL];
+        payload[0] = (uint8_t)i;
+        queue_send_ptr(&queue_a, payload);
+    }
+}
+
+static void large_ptr_consumer(void* param) {
+    (void)param;
+    for (uint32_t i = 0; i < LARGE_MESSAGES; i++) {
+        void* payload;
+        queue_receive_ptr(&queue_a, &payload);
+        if (((uint8_t*)payload)[0] != (uint8_t)i) {
+            printf("❌ Pointer payload mismatch\n");
+            exit(1);
+        }
+    }
+    report("64 KiB messages, zero-copy", LARGE_MESSAGES, now_seconds() - phase_start);
+    rtos_stop();
+}
+
+static void run_stream(const char* label, queue_kind_t kind) {
+    start_kernel();
+    queue_create(&queue_a, kind, 256, STREAM_MESSAGE_SIZE);
+    phase_label = label;
+    phase_messages = STREAM_MESSAGES;
+    task_create("PROD", stream_producer, &queue_a, 1, 0);
+    task_create("CONS", stream_consumer, &queue_a, 1, 0);
+    phase_start = now_seconds();
+    rtos_start();
+    queue_destroy(&queue_a);
+}
+
+static void run_large(bool zero_copy) {
+    start_kernel();
+    queue_create(&queue_a, QUEUE_SPSC, LARGE_QUEUE_CAPACITY,
+                 zero_copy ? QUEUE_POINTER_ITEMS : LARGE_MESSAGE_SIZE);
+    task_create("PROD", zero_copy ? large_ptr_producer : large_copy_producer, NULL, 1, 0);
+    task_create("CONS", zero_copy ? large_ptr_consumer : large_copy_consumer, NULL, 1, 0);
+    phase_start = now_seconds();
+    rtos_start();
+    queue_destroy(&queue_a);
+}
+
+/*
+ * BENCHMARK 5: MPMC under real concurrency
+ *
+ * Uses only the non-blocking calls, since OS threads are not RTOS tasks.
+ */
+static uint64_t consumed_sum[THREAD_PAIRS];
+
+static void* thread_producer(void* param) {
+    uint64_t base = (uintptr_t)param * THREAD_MESSAGES;
+    for (uint64_t i = 1; i <= THREAD_MESSAGES; i++) {
+        uint64_t value = base + i;
+        while (queue_try_send(&queue_a, &value) != 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void* thread_consumer(void* param) {
+    uintptr_t index = (uintptr_t)param;
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < THREAD_MESSAGES; i++) {
+        uint64_t value;
+        while (queue_try_receive(&queue_a, &value) != 0) {
+            sched_yield();
+        }
+        sum += value;
+    }
+    consumed_sum[index] = sum;
+    return NULL;
+}
+
+static void run_threads(void) {
+    pthread_t threads[THREAD_PAIRS * 2];
+    uint64_t expected = 0;
+    uint64_t received = 0;
+
+    queue_create(&queue_a, QUEUE_MPMC, 1024, sizeof(uint64_t));
+
+    double start = now_seconds();
+    for (uintptr_t i = 0; i < THREAD_PAIRS; i++) {
+        pthread_create(&threads[i], NULL, thread_producer, (void*)i);
+        pthread_create(&threads[THREAD_PAIRS + i], NULL, thread_consumer, (void*)i);
+    }
+    for (int i = 0; i < THREAD_PAIRS * 2; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = now_seconds() - start;
+
+    for (uint64_t p = 0; p < THREAD_PAIRS; p++) {
+        uint64_t base = p * THREAD_MESSAGES;
+        expected += base * THREAD_MESSAGES + (uint64_t)THREAD_MESSAGES * (THREAD_MESSAGES + 1) / 2;
+        received += consumed_sum[p];
+    }
+
+    report("MPMC, 2 producer + 2 consumer threads", THREAD_PAIRS * THREAD_MESSAGES, elapsed);
+    printf("%-32s %s\n", "MPMC checksum", received == expected ? "✅ match" : "❌ MISMATCH");
+
+    queue_destroy(&queue_a);
+}
+
+int main(void) {
+    printf("🧪 RTOS SEMAPHORE AND QUEUE BENCHMARK\n");
+    printf("=====================================\n");
+
+    start_kernel();
+    task_create("SEM", semaphore_task, NULL, 1, 0);
+    rtos_start();
+
+    start_kernel();
+    queue_create(&queue_a, QUEUE_SPSC, 4, sizeof(uint32_t));
+    queue_create(&queue_b, QUEUE_SPSC, 4, sizeof(uint32_t));
+    task_create("PING", ping_task, NULL, 1, 0);
+    task_create("PONG", pong_task, NULL, 1, 0);
+    rtos_start();
+    queue_destroy(&queue_a);
+    queue_destroy(&queue_b);
+
+    run_stream("SPSC stream, 64 B messages", QUEUE_SPSC);
+    run_stream("MPMC stream, 64 B messages", QUEUE_MPMC);
+
+    for (int i = 0; i < LARGE_POOL; i++) {
+        large_buffers[i] = calloc(1, LARGE_MESSAGE_SIZE);
+    }
+    run_large(false);
+    run_large(true);
+    for (int i = 0; i < LARGE_POOL; i++) {
+        free(large_buffers[i]);
+    }
+
+    run_threads();
+
+    return 0;
+}
@@ -0,0 +1,211 @@
+/*
+ * Virtual-Time Simulation Benchmark
+ *
+ * 1. Speed: one simulated day of a mixed workload (sensors, control loops,
+ *    a logger and a CPU-bound background task), timed on the host.
+ * 2. Reproducibility: the same simulated hour run twice with one seed must
+ *    produce the identical schedule; another seed must not.
+ * 3. Policy comparison: one periodic task set whose bursts sometimes
+ *    overrun their WCET, replayed for a simulated day under RM and under
+ *    EDF, showing who misses deadlines under each.
+ *
+ * Build and run:  make bench_sim && ./bench_sim
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define TICKS_PER_HOUR (60u * 60u * 1000u)
+#define TICKS_PER_DAY (24u * TICKS_PER_HOUR)
+#define MAX_SIM_TASKS 16
+
+static uint32_t task_ids[MAX_SIM_TASKS];
+static const char* task_names[MAX_SIM_TASKS];
+static int task_count;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void start_kernel(sched_policy_t policy, uint32_t seed) {
+    if (rtos_set_mode(RTOS_MODE_VIRTUAL_TIME) != 0 ||
+        rtos_set_policy(policy) != 0 || rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+    rtos_sim_seed(seed);
+    task_count = 0;
+}
+
+static void add_task(const char* name, uint8_t priority, const script_step_t* script) {
+    uint32_t id = task_create(name, NULL, NULL, priority, 0);
+    if (id == 0 || (script != NULL && task_set_script(id, script) != 0)) {
+        printf("❌ Could not create %s\n", name);
+        exit(1);
+    }
+    task_ids[task_count] = id;
+    task_names[task_count++] = name;
+}
+
+static void add_periodic(const char* name, uint32_t period, uint32_t wcet,
+                         const script_step_t* script) {
+    uint32_t id = task_create_periodic(name, NULL, NULL, period, wcet, 0, 0);
+    if (id == 0 || task_set_script(id, script) != 0) {
+        printf("❌ %s not admitted\n", name);
+        exit(1);
+    }
+    task_ids[task_count] = id;
+    task_names[task_count++] = name;
+}
+
+/*
+ * WORKLOADS
+ */
+static const script_step_t sensor_script[] = {
+    {SCRIPT_BURST, 1, 1}, {SCRIPT_SLEEP, 10, 0}, {SCRIPT_REPEAT, 0, 0},
+};
+static const script_step_t control_script[] = {
+    {SCRIPT_BURST, 3, 2}, {SCRIPT_SLEEP, 20, 0}, {SCRIPT_REPEAT, 0, 0},
+};
+static const script_step_t logger_script[] = {
+    {SCRIPT_BURST, 5, 10}, {SCRIPT_SLEEP, 100, 50}, {SCRIPT_REPEAT, 0, 0},
+};
+
+static void build_mixed_workload(void) {
+    add_task("SENSOR_A", 0, sensor_script);
+    add_task("SENSOR_B", 0, sensor_script);
+    add_task("CONTROL", 1, control_script);
+    add_task("LOGGER", 2, logger_script);
+    add_task("CRUNCH", 3, NULL);                // No script: always busy
+}
+
+// Periodic jobs: nominal burst == WCET, but jitter makes some overrun it
+static const script_step_t fast_job[] = {
+    {SCRIPT_BURST, 2, 2}, {SCRIPT_WAIT_PERIOD, 0, 0}, {SCRIPT_REPEAT, 0, 0},
+};
+static const script_step_t mid_job[] = {
+    {SCRIPT_BURST, 5, 4}, {SCRIPT_WAIT_PERIOD, 0, 0}, {SCRIPT_REPEAT, 0, 0},
+};
+static const script_step_t slow_job[] = {
+    {SCRIPT_BURST, 12, 8}, {SCRIPT_WAIT_PERIOD, 0, 0}, {SCRIPT_REPEAT, 0, 0},
+};
+
+static void build_periodic_workload(void) {
+    add_periodic("FAST", 10, 2, fast_job);
+    add_periodic("MID", 25, 5, mid_job);
+    add_periodic("SLOW", 50, 12, slow_job);
+    add_task("BG", 0, NULL);
+}
+
+// FNV-1a over everything the schedule decided
+static uint64_t schedule_fingerprint(void) {
+    scheduler_stats_t* stats = get_scheduler_stats();
+    uint32_t values[4 + 3 * MAX_SIM_TASKS];
+    int n = 0;
+
+    values[n++] = stats->total_context_switches;
+    values[n++] = stats->idle_time;
+    values[n++] = stats->deadline_misses;
+    values[n++] = get_system_uptime();
+    for (int i = 0; i < task_count; i++) {
+        tcb_t* task = task_get_info(task_ids[i]);
+        values[n++] = task->total_runtime;
+        values[n++] = task->jobs_completed;
+        values[n++] = task->script_pc;
+    }
+
+    uint64_t hash = 1469598103934665603ull;
+    for (int i = 0; i < n; i++) {
+        hash = (hash ^ values[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/*
+ * BENCHMARK 1: Speed
+ */
+static void run_speed(void) {
+    start_kernel(SCHED_FIXED_PRIORITY, 1);
+    build_mixed_workload();
+
+    double start = now_seconds();
+    uint64_t events = rtos_sim_run(TICKS_PER_DAY);
+    double elapsed = now_seconds() - start;
+
+    printf("Simulated 1 day in %.2f s: %.0fx real time, %llu events (%.1f M/s), %u switches\n",
+           elapsed, TICKS_PER_DAY / 1000.0 / elapsed, (unsigned long long)events,
+           events / elapsed / 1e6, get_scheduler_stats()->total_context_switches);
+    printf("  CPU shares:");
+    for (int i = 0; i < task_count; i++) {
+        printf(" %s %.1f%%", task_names[i],
+               100.0 * task_get_info(task_ids[i])->total_runtime / TICKS_PER_DAY);
+    }
+    printf("\n\n");
+}
+
+/*
+ * BENCHMARK 2: Reproducibility
+ */
+static uint64_t run_hour(uint32_t seed) {
+    start_kernel(SCHED_FIXED_PRIORITY, seed);
+    build_mixed_workload();
+    rtos_sim_run(TICKS_PER_HOUR);
+    return schedule_fingerprint();
+}
+
+static void run_reproducibility(void) {
+    uint64_t first = run_hour(42);
+    uint64_t again = run_hour(42);
+    uint64_t other = run_hour(43);
+
+    printf("%-36s %016llx\n", "seed 42", (unsigned long long)first);
+    printf("%-36s %016llx %s\n", "seed 42 again", (unsigned long long)again,
+           again == first ? "✅ identical" : "❌ DIFFERS");
+    printf("%-36s %016llx %s\n\n", "seed 43", (unsigned long long)other,
+           other != first ? "✅ different" : "❌ SAME");
+}
+
+/*
+ * BENCHMARK 3: Policy comparison
+ */
+static void run_policy(const char* label, sched_policy_t policy) {
+    start_kernel(policy, 7);
+    build_periodic_workload();
+
+    double start = now_seconds();
+    rtos_sim_run(TICKS_PER_DAY);
+    double elapsed = now_seconds() - start;
+
+    printf("%s (simulated day in %.2f s)\n", label, elapsed);
+    for (int i = 0; i < task_count; i++) {
+        tcb_t* task = task_get_info(task_ids[i]);
+        if (task->period == 0) {
+            printf("  %-5s background got %.1f%% of the CPU\n", task_names[i],
+                   100.0 * task->total_runtime / TICKS_PER_DAY);
+            continue;
+        }
+        printf("  %-5s T=%-3u %9u jobs %8u misses (%.3f%%)\n", task_names[i],
+               task->period, task->jobs_completed, task->deadline_misses,
+               100.0 * task->deadline_misses / (task->jobs_completed ? task->jobs_completed : 1));
+    }
+    printf("\n");
+}
+
+int main(void) {
+    printf("🧪 RTOS VIRTUAL-TIME SIMULATION BENCHMARK\n");
+    printf("=========================================\n\n");
+
+    run_speed();
+    run_reproducibility();
+
+    printf("Periodic set, nominal load 64%%, bursts overrun WCET by up to 100%%\n");
+    run_policy("Rate monotonic", SCHED_RATE_MONOTONIC);
+    run_policy("EDF", SCHED_EDF);
+
+    return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * Time Slice Benchmark
+ *
+ * A mixed workload in context-switch mode on one core: CPU-bound tasks
+ * crunching work units, with a preemption point after each, and
+ * interactive tasks that wait for a request, handle it in a short burst
+ * and wait again. A driver task at the top priority sends the
+ * interactive tasks a request every few ticks, in turn. The CPU-bound and
+ * interactive tasks share one priority level unless the configuration
+ * says otherwise.
+ *
+ * Run under fixed slices of several lengths, with the levels tuned by
+ * hand, and with adaptive slicing. Reported are the work units done per
+ * second (throughput), requests served per second (a handler still busy
+ * with its last request gets no new one), context switches per second,
+ * and the response time of the interactive tasks: from the request
+ * being sent to the handler starting on it.
+ *
+ * Build and run:  make bench_slice && ./bench_slice
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CPU_TASKS 3
+#define INTERACTIVE_TASKS 2
+#define RUN_MS 2000                  // Length of each run
+#define REQUEST_TICKS 2              // Ticks between requests (to the handlers in turn)
+#define WORK_UNIT_US 50              // Compute between preemption points
+#define HANDLER_BURST_US 100         // Compute per request
+#define MAX_SAMPLES (RUN_MS / REQUEST_TICKS + 16)
+
+typedef struct {
+    const char* label;
+    bool adaptive;
+    uint32_t slices[PRIORITY_LEVELS];    // 0 = TIME_SLICE_MS
+    uint8_t interactive_priority;
+} config_t;
+
+static const config_t configs[] = {
+    { "fixed 10 ms", false, { 0, 0, 0, 0 }, 2 },
+    { "fixed 1 ms", false, { 1, 1, 1, 1 }, 2 },
+    { "fixed 40 ms", false, { 40, 40, 40, 40 }, 2 },
+    { "by hand: 2 ms up, 40 ms", false, { 0, 2, 40, 0 }, 1 },
+    { "adaptive, 10 ms", true, { 0, 0, 0, 0 }, 2 },
+};
+
+static uint32_t handler_ids[INTERACTIVE_TASKS];
+static uint32_t cpu_ids[CPU_TASKS];
+static uint64_t sent_ns[INTERACTIVE_TASKS];
+static bool pending[INTERACTIVE_TASKS];
+static uint64_t samples[MAX_SAMPLES];
+static uint32_t sample_count;
+static uint64_t work_units;
+static bool stopping;
+static double run_seconds;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void spin_us(uint32_t us) {
+    uint64_t end = now_ns() + us * 1000ull;
+    while (now_ns() < end) {
+    }
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * THE WORKLOAD
+ */
+static void cpu_task(void* param) {
+    (void)param;
+    while (!stopping) {
+        spin_us(WORK_UNIT_US);
+        work_units++;
+        task_preemption_point();
+    }
+    while (1) {
+        task_sleep(1000);
+    }
+}
+
+static void handler_task(void* param) {
+    uint32_t index = (uint32_t)(uintptr_t)param;
+
+    while (1) {
+        task_notify_take(true, RTOS_WAIT_FOREVER);
+        if (sample_count < MAX_SAMPLES) {
+            samples[sample_count++] = now_ns() - sent_ns[index];
+        }
+        spin_us(HANDLER_BURST_US);
+        pending[index] = false;
+    }
+}
+
+// A request every REQUEST_TICKS, to each handler in turn, unless it is
+// still busy with its last one
+static void driver_task(void* param) {
+    (void)param;
+    uint64_t start = now_ns();
+    uint32_t next = 0;
+
+    while (now_ns() - start < RUN_MS * 1000000ull) {
+        task_sleep(REQUEST_TICKS);
+        if (!pending[next]) {
+            pending[next] = true;
+            sent_ns[next] = now_ns();
+            task_notify(handler_ids[next], 0, NOTIFY_INCREMENT);
+        }
+        next = (next + 1) % INTERACTIVE_TASKS;
+    }
+
+    run_seconds = (now_ns() - start) / 1e9;
+    stopping = true;
+    rtos_stop();
+}
+
+static void run(const config_t* config) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 ||
+        rtos_set_adaptive_slicing(config->adaptive) != 0) {
+        printf("❌ Configuration failed\n");
+        exit(1);
+    }
+    for (uint8_t level = 0; level < PRIORITY_LEVELS; level++) {
+        rtos_set_time_slice(level, config->slices[level] != 0 ? config->slices[level] :
+                                                                  TIME_SLICE_MS);
+    }
+    if (rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+
+    sample_count = 0;
+    work_units = 0;
+    stopping = false;
+    for (uint32_t i = 0; i < INTERACTIVE_TASKS; i++) {
+        pending[i] = false;
+        handler_ids[i] = task_create("HANDLER", handler_task, (void*)(uintptr_t)i,
+                                     config->interactive_priority, 0);
+    }
+    for (uint32_t i = 0; i < CPU_TASKS; i++) {
+        cpu_ids[i] = task_create("CRUNCH", cpu_task, NULL, 2, 0);
+    }
+    task_create("DRIVER", driver_task, NULL, 0, 0);
+    rtos_start();
+
+    qsort(samples, sample_count, sizeof(uint64_t), compare_u64);
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < sample_count; i++) {
+        sum += samples[i];
+    }
+
+    tcb_t* cpu = task_get_info(cpu_ids[0]);
+    tcb_t* handler = task_get_info(handler_ids[0]);
+    printf("  %-24s %9.0f %7.0f %9.0f %8.0f %8.0f %8.0f %6u/%-5u\n", config->label,
+           work_units / run_seconds, sample_count / run_seconds,
+           get_scheduler_stats()->total_context_switches / run_seconds,
+           sample_count ? sum / 1000.0 / sample_count : 0.0,
+           sample_count ? samples[sample_count * 99 / 100] / 1000.0 : 0.0,
+           sample_count ? samples[sample_count - 1] / 1000.0 : 0.0,
+           handler->time_slice, cpu->time_slice);
+}
+
+int main(void) {
+    printf("🧪 RTOS TIME SLICE BENCHMARK\n");
+    printf("============================\n\n");
+
+    printf("%d CPU-bound tasks (%d us units), %d handlers (%d us per request, a request every %d ticks)\n",
+           CPU_TASKS, WORK_UNIT_US, INTERACTIVE_TASKS, HANDLER_BURST_US, REQUEST_TICKS);
+    printf("  %-24s %9s %7s %9s %8s %8s %8s %12s\n", "slices", "units/s", "req/s", "switch/s", "avg us",
+           "p99 us", "max us", "slice ms h/c");
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        run(&configs[i]);
+    }
+    printf("  (response: request sent to handler running; slice: last granted to a handler / a CPU task)\n");
+
+    return 0;
+}
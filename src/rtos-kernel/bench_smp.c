@@ -0,0 +1,260 @@
+/*
+ * SMP Scheduler Benchmark
+ *
+ * 1. Scaling: a fixed amount of CPU-bound work split across many tasks,
+ *    run on 1, 2, 4, ... cores. Reports throughput, speedup over one core,
+ *    and how often tasks were stolen and migrated.
+ * 2. Affinity: tasks pinned to one core must never run anywhere else,
+ *    even while the other cores are idle and stealing.
+ * 3. Cross-core stress: tasks on all cores hammer one mutex, a semaphore
+ *    pair and an MPMC queue; every count and checksum must come out exact.
+ *
+ * Speedup needs that many host CPUs; with fewer, the core threads share
+ * CPUs and the numbers only show the overhead of the SMP machinery.
+ *
+ * Build and run:  make bench_smp && ./bench_smp
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SCALING_TASKS 64
+#define SCALING_UNITS 400            // Work units per task
+#define WORK_UNIT_SPINS 20000        // Busy loop per work unit
+#define AFFINITY_TASKS 8
+#define AFFINITY_UNITS 200
+#define STRESS_CORES 4
+#define STRESS_TASKS 8
+#define STRESS_ITERATIONS 10000
+#define STRESS_MESSAGES 20000
+
+static uint32_t tasks_done;
+static uint32_t tasks_expected;
+static double phase_start;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void start_kernel(uint32_t cores) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 ||
+        rtos_set_core_count(cores) != 0 || rtos_init() != 0) {
+        printf("❌ rtos_init failed with %u cores\n", cores);
+        exit(1);
+    }
+    tasks_done = 0;
+}
+
+// The last task to finish stops the kernel
+static void task_finished(void) {
+    if (__atomic_add_fetch(&tasks_done, 1, __ATOMIC_ACQ_REL) == tasks_expected) {
+        rtos_stop();
+    }
+}
+
+// One unit of CPU work followed by a preemption point
+static void work_unit(void) {
+    for (volatile int i = 0; i < WORK_UNIT_SPINS; i++) {
+    }
+    task_yield();
+}
+
+/*
+ * BENCHMARK 1: Scaling
+ */
+static void scaling_task(void* param) {
+    (void)param;
+    for (int i = 0; i < SCALING_UNITS; i++) {
+        work_unit();
+    }
+    task_finished();
+}
+
+static double run_scaling(uint32_t cores) {
+    start_kernel(cores);
+    tasks_expected = SCALING_TASKS;
+    for (int i = 0; i < SCALING_TASKS; i++) {
+        task_create("WORK", scaling_task, NULL, 1, 0);
+    }
+
+    phase_start = now_seconds();
+    rtos_start();
+    double elapsed = now_seconds() - phase_start;
+
+    scheduler_stats_t* stats = get_scheduler_stats();
+    double units = (double)SCALING_TASKS * SCALING_UNITS;
+    printf("%5u cores  %10.0f units/s  %8.3f s  %6u steals  %6u migrations (%4.1f%%)",
+           cores, units / elapsed, elapsed, stats->task_steals, stats->task_migrations,
+           stats->total_context_switches ?
+           100.0 * stats->task_migrations / stats->total_context_switches : 0.0);
+    return elapsed;
+}
+
+/*
+ * BENCHMARK 2: Affinity
+ */
+static uint32_t affinity_violations;
+
+static void pinned_task(void* param) {
+    uint32_t core = (uint32_t)(uintptr_t)param;
+    for (int i = 0; i < AFFINITY_UNITS; i++) {
+        if (task_get_current_core() != core) {
+            __atomic_add_fetch(&affinity_violations, 1, __ATOMIC_RELAXED);
+        }
+        work_unit();
+    }
+    task_finished();
+}
+
+static void run_affinity(void) {
+    start_kernel(4);
+    tasks_expected = AFFINITY_TASKS;
+    affinity_violations = 0;
+
+    for (int i = 0; i < AFFINITY_TASKS; i++) {
+        uint32_t id = task_create("PIN", pinned_task, (void*)(uintptr_t)1, 1, 0);
+        task_set_affinity(id, 1u << 1);
+    }
+    rtos_start();
+
+    printf("%-36s %s (%u tasks pinned to core 1, %u steals elsewhere)\n",
+           "affinity respected",
+           affinity_violations == 0 ? "✅" : "❌ VIOLATED",
+           AFFINITY_TASKS, get_scheduler_stats()->task_steals);
+}
+
+/*
+ * BENCHMARK 3: Cross-core stress
+ */
+static mutex_t stress_mutex;
+static semaphore_t ping_sem;
+static semaphore_t pong_sem;
+static msg_queue_t stress_queue;
+static uint64_t shared_counter;
+static uint64_t received_sum;
+
+static void counter_task(void* param) {
+    (void)param;
+    for (int i = 0; i < STRESS_ITERATIONS; i++) {
+        mutex_lock(&stress_mutex);
+        shared_counter++;                // Plain increment: only the mutex protects it
+        if ((i & 63) == 0) {
+            task_yield();                // Hold the lock across a switch now and then
+        }
+        mutex_unlock(&stress_mutex);
+    }
+    task_finished();
+}
+
+static void ping_task(void* param) {
+    (void)param;
+    for (int i = 0; i < STRESS_ITERATIONS; i++) {
+        semaphore_signal(&ping_sem);
+        semaphore_wait(&pong_sem);
+    }
+    task_finished();
+}
+
+static void pong_task(void* param) {
+    (void)param;
+    for (int i = 0; i < STRESS_ITERATIONS; i++) {
+        semaphore_wait(&ping_sem);
+        semaphore_signal(&pong_sem);
+    }
+    task_finished();
+}
+
+static void producer_task(void* param) {
+    (void)param;
+    for (uint64_t i = 1; i <= STRESS_MESSAGES; i++) {
+        queue_send(&stress_queue, &i);
+    }
+    task_finished();
+}
+
+static void consumer_task(void* param) {
+    (void)param;
+    uint64_t sum = 0;
+    for (int i = 0; i < STRESS_MESSAGES; i++) {
+        uint64_t value;
+        queue_receive(&stress_queue, &value);
+        sum += value;
+    }
+    __atomic_add_fetch(&received_sum, sum, __ATOMIC_RELAXED);
+    task_finished();
+}
+
+static void run_stress(void) {
+    start_kernel(STRESS_CORES);
+    mutex_init(&stress_mutex);
+    semaphore_init(&ping_sem, 0);
+    semaphore_init(&pong_sem, 0);
+    queue_create(&stress_queue, QUEUE_MPMC, 64, sizeof(uint64_t));
+    shared_counter = 0;
+    received_sum = 0;
+
+    tasks_expected = STRESS_TASKS + 2 + 4;
+    for (int i = 0; i < STRESS_TASKS; i++) {
+        task_create("CNT", counter_task, NULL, 1, 0);
+    }
+    task_create("PING", ping_task, NULL, 1, 0);
+    task_create("PONG", pong_task, NULL, 1, 0);
+    task_create("PROD", producer_task, NULL, 2, 0);
+    task_create("PROD", producer_task, NULL, 2, 0);
+    task_create("CONS", consumer_task, NULL, 2, 0);
+    task_create("CONS", consumer_task, NULL, 2, 0);
+
+    double start = now_seconds();
+    rtos_start();
+    double elapsed = now_seconds() - start;
+
+    uint64_t expected_counter = (uint64_t)STRESS_TASKS * STRESS_ITERATIONS;
+    uint64_t expected_sum = 2 * (uint64_t)STRESS_MESSAGES * (STRESS_MESSAGES + 1) / 2;
+    bool ok = shared_counter == expected_counter && received_sum == expected_sum;
+
+    printf("%-36s %s (%.3f s, %u contentions, %u steals, %u migrations)\n",
+           "cross-core mutex/semaphore/queue", ok ? "✅" : "❌ MISMATCH", elapsed,
+           get_scheduler_stats()->mutex_contentions,
+           get_scheduler_stats()->task_steals, get_scheduler_stats()->task_migrations);
+    if (!ok) {
+        printf("   counter %llu/%llu, queue sum %llu/%llu\n",
+               (unsigned long long)shared_counter, (unsigned long long)expected_counter,
+               (unsigned long long)received_sum, (unsigned long long)expected_sum);
+    }
+
+    queue_destroy(&stress_queue);
+}
+
+int main(void) {
+    long host_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    printf("🧪 RTOS SMP BENCHMARK\n");
+    printf("=====================\n");
+    printf("Host CPUs: %ld\n\n", host_cpus);
+
+    printf("Scaling: %d tasks x %d work units\n", SCALING_TASKS, SCALING_UNITS);
+    double base = 0;
+    uint32_t max_cores = host_cpus > 4 ? (uint32_t)host_cpus : 4;
+    if (max_cores > RTOS_MAX_CORES) {
+        max_cores = RTOS_MAX_CORES;
+    }
+    for (uint32_t cores = 1; cores <= max_cores; cores *= 2) {
+        double elapsed = run_scaling(cores);
+        if (cores == 1) {
+            base = elapsed;
+        }
+        printf("  speedup %.2fx\n", base / elapsed);
+    }
+    printf("\n");
+
+    run_affinity();
+    run_stress();
+
+    return 0;
+}
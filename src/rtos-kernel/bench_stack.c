@@ -0,0 +1,214 @@
+/*
+ * Stack High-Water Mark Benchmark
+ *
+ * Runs in context-switch mode, the mode in which stacks are painted.
+ *
+ * 1. Accuracy: worker tasks each touch a known number of bytes of their
+ *    stack, then block. The idle task's incremental scan must find each
+ *    high-water mark on its own; reported are how many ticks that took
+ *    and how far above the touched depth the mark lies (the frames of
+ *    the task entry code and of the kernel calls the task makes).
+ * 2. Cost: creating and deleting a task, which now paints its whole
+ *    stack, and a full scan through task_get_stack_usage, for small and
+ *    large stacks. Painting also makes every stack page resident.
+ * 3. The stack report for the accuracy run's tasks.
+ *
+ * Build and run:  make bench_stack && ./bench_stack
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WORKERS 5
+#define CHURN_TASKS 2000
+#define SCAN_CALLS 2000
+#define CONVERGE_LIMIT_TICKS 1000
+
+typedef struct {
+    const char* name;
+    uint32_t stack_size;                 // Given to task_create
+    uint32_t touch;                      // Bytes the worker touches
+    uint32_t task_id;
+} worker_t;
+
+static worker_t workers[WORKERS] = {
+    { "TOUCH_1K", 16 * 1024, 1 * 1024, 0 },
+    { "TOUCH_4K", 16 * 1024, 4 * 1024, 0 },
+    { "TOUCH_8K", 16 * 1024, 8 * 1024, 0 },
+    { "TOUCH_12K", 16 * 1024, 12 * 1024, 0 },
+    { "TOUCH_48K", 64 * 1024, 48 * 1024, 0 },
+};
+
+static semaphore_t never_sem;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t read_rss(void) {
+    unsigned long vm_pages = 0;
+    unsigned long rss_pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+
+    if (statm != NULL) {
+        if (fscanf(statm, "%lu %lu", &vm_pages, &rss_pages) != 2) {
+            rss_pages = 0;
+        }
+        fclose(statm);
+    }
+    return rss_pages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void start_kernel(void) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 || rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+}
+
+/*
+ * BENCHMARK 1 AND 3: Accuracy and the report
+ */
+// Not inlined, so the buffer is a frame of its own below the task entry
+__attribute__((noinline))
+static void touch_stack(uint32_t bytes) {
+    volatile uint8_t buffer[bytes];
+
+    // Byte by byte through volatile, so none of it can be optimized away
+    for (uint32_t i = 0; i < bytes; i++) {
+        buffer[i] = 0x11;
+    }
+    (void)buffer;
+}
+
+static void worker_task(void* param) {
+    worker_t* worker = param;
+
+    touch_stack(worker->touch);
+    semaphore_wait(&never_sem);
+}
+
+// Lower priority than the workers; while it sleeps only idle tasks run
+static void control_task(void* param) {
+    (void)param;
+    uint32_t start = get_system_uptime();
+    uint32_t found = 0;
+
+    // Watch the marks the idle task maintains, without scanning ourselves
+    while (found < WORKERS && get_system_uptime() - start < CONVERGE_LIMIT_TICKS) {
+        task_sleep(1);
+        found = 0;
+        for (int i = 0; i < WORKERS; i++) {
+            found += task_get_info(workers[i].task_id)->stack_high_water >= workers[i].touch;
+        }
+    }
+    uint32_t ticks = get_system_uptime() - start;
+
+    printf("Idle scan found %d of %d marks in %u ticks (%d words per idle pass)\n", found,
+           WORKERS, ticks, STACK_SCAN_WORDS);
+    printf("  %-10s %7s %8s %10s %10s %9s %8s\n", "task", "stack", "touched", "idle mark",
+           "full scan", "overhead", "advice");
+
+    bool all_match = true;
+    for (int i = 0; i < WORKERS; i++) {
+        uint32_t idle_mark = task_get_info(workers[i].task_id)->stack_high_water;
+        stack_usage_t usage;
+
+        task_get_stack_usage(workers[i].task_id, &usage);
+        all_match &= usage.used == idle_mark;
+        printf("  %-10s %7u %8u %10u %10u %9d %8u\n", workers[i].name, usage.size,
+               workers[i].touch, idle_mark, usage.used,
+               (int)usage.used - (int)workers[i].touch, usage.recommended);
+    }
+    printf("  %s\n", all_match ? "idle marks match full scans" : "IDLE MARKS DIFFER");
+
+    print_stack_report();
+    rtos_stop();
+}
+
+static void bench_accuracy(void) {
+    start_kernel();
+    semaphore_init(&never_sem, 0);
+
+    for (int i = 0; i < WORKERS; i++) {
+        workers[i].task_id = task_create(workers[i].name, worker_task, &workers[i], 1,
+                                         workers[i].stack_size);
+    }
+    task_create("CONTROL", control_task, NULL, 2, 0);
+    rtos_start();
+    printf("\n");
+}
+
+/*
+ * BENCHMARK 2: Cost of painting and scanning
+ */
+// Created at a lower priority than the cost task, so never runs
+static void idle_worker(void* param) {
+    (void)param;
+    semaphore_wait(&never_sem);
+}
+
+static void cost_task(void* param) {
+    (void)param;
+    static const uint32_t sizes[] = { 16 * 1024, 64 * 1024, 256 * 1024 };
+
+    printf("Painting and scanning\n");
+    printf("  %-7s %16s %13s %16s\n", "stack", "create+delete ns", "full scan ns",
+           "RSS per task KiB");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        double start = now_seconds();
+        for (int i = 0; i < CHURN_TASKS; i++) {
+            task_delete(task_create("CHURN", idle_worker, NULL, 2, sizes[s]));
+        }
+        double churn_ns = (now_seconds() - start) * 1e9 / CHURN_TASKS;
+
+        // A task that has barely used its stack is the longest scan
+        uint32_t id = task_create("SCANNED", idle_worker, NULL, 2, sizes[s]);
+        stack_usage_t usage;
+        start = now_seconds();
+        for (int i = 0; i < SCAN_CALLS; i++) {
+            task_get_stack_usage(id, &usage);
+        }
+        double scan_ns = (now_seconds() - start) * 1e9 / SCAN_CALLS;
+        task_delete(id);
+
+        // Fresh stacks: the pool cannot hand back pages already resident
+        size_t rss_before = read_rss();
+        uint32_t ids[64];
+        for (int i = 0; i < 64; i++) {
+            ids[i] = task_create("RESIDENT", idle_worker, NULL, 2, sizes[s]);
+        }
+        double rss_kib = (double)(read_rss() - rss_before) / 64 / 1024;
+        for (int i = 0; i < 64; i++) {
+            task_delete(ids[i]);
+        }
+
+        printf("  %4u KiB %16.0f %13.0f %16.1f\n", sizes[s] / 1024, churn_ns, scan_ns, rss_kib);
+    }
+
+    rtos_stop();
+}
+
+static void bench_cost(void) {
+    start_kernel();
+    semaphore_init(&never_sem, 0);
+    task_create("COST", cost_task, NULL, 1, 0);
+    rtos_start();
+}
+
+int main(void) {
+    printf("🧪 RTOS STACK HIGH-WATER MARK BENCHMARK\n");
+    printf("=======================================\n\n");
+
+    bench_accuracy();
+    bench_cost();
+
+    return 0;
+}
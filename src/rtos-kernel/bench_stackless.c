@@ -0,0 +1,336 @@
+/*
+ * Stackless Task Benchmark
+ *
+ * Compares stackless tasks (protothreads) with ordinary tasks that each
+ * own a stack. Runs in context-switch mode.
+ *
+ * 1. Memory: many sensor handlers, each blocked waiting for a
+ *    notification. Reports resident memory and address space per task,
+ *    the cost of creating one, and the cost of waking each handler once
+ *    from a control task.
+ * 2. Switch cost: two tasks notifying each other in turn, both with a
+ *    stack, both stackless, and one of each. Between two stackless tasks
+ *    the switch is a function return and a call on the core's runner;
+ *    any switch involving a stack saves and restores registers.
+ * 3. Queues: a stackless producer and consumer over a two-slot queue.
+ *    The producer runs at the higher priority, so it blocks on the full
+ *    queue and the consumer on the empty one. Every item must arrive.
+ *
+ * Build and run:  make bench_stackless && ./bench_stackless
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STACKLESS_HANDLERS 200000
+#define STACKFUL_HANDLERS 10000
+#define PINGPONG_ROUNDS 200000
+#define PIPE_ITEMS 200000
+#define PIPE_CAPACITY 2
+
+typedef struct {
+    uint32_t samples;                    // Notifications handled
+    uint32_t value;                      // Last notification count
+} handler_frame_t;
+
+typedef struct {
+    uint32_t other;                      // Task to notify
+    uint32_t round;                      // Rounds done (ping only)
+    uint32_t value;                      // Last notification count
+} pingpong_frame_t;
+
+typedef struct {
+    uint32_t count;                      // Items sent or received
+    uint32_t item;                       // Item being sent or received
+    uint32_t waits;                      // Times the queue was full (or empty)
+    int result;                          // Last blocking queue call
+    uint64_t sum;                        // Items received, added up
+} pipe_frame_t;
+
+static handler_frame_t* frames;
+static uint32_t* handler_ids;
+static uint32_t handler_count;
+static uint64_t samples_handled;
+static size_t rss_before;
+static size_t vm_before;
+static size_t rss_after;
+static size_t vm_after;
+static double wake_ns;
+static double pingpong_start;
+static double round_trip_ns;
+static msg_queue_t pipe_queue;
+static bool pipe_failed;
+static double pipe_start;
+static double item_ns;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Address space and resident memory of the process, in bytes
+static void read_memory(size_t* vm, size_t* rss) {
+    unsigned long vm_pages = 0;
+    unsigned long rss_pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+
+    if (statm != NULL) {
+        if (fscanf(statm, "%lu %lu", &vm_pages, &rss_pages) != 2) {
+            vm_pages = rss_pages = 0;
+        }
+        fclose(statm);
+    }
+    *vm = vm_pages * (size_t)sysconf(_SC_PAGESIZE);
+    *rss = rss_pages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void start_kernel(void) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 || rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+}
+
+/*
+ * BENCHMARK 1: Memory per handler
+ */
+static pt_status_t stackless_handler(pt_t* pt, void* param) {
+    handler_frame_t* frame = param;
+
+    PT_BEGIN(pt);
+    while (1) {
+        PT_NOTIFY_TAKE(pt, true, frame->value);
+        frame->samples += frame->value;
+    }
+    PT_END(pt);
+}
+
+static void stackful_handler(void* param) {
+    handler_frame_t* frame = param;
+
+    while (1) {
+        frame->samples += task_notify_take(true, RTOS_WAIT_FOREVER);
+    }
+}
+
+// Lower priority than the handlers: runs once they all wait
+static void control_task(void* param) {
+    (void)param;
+
+    read_memory(&vm_after, &rss_after);
+
+    double start = now_seconds();
+    for (uint32_t i = 0; i < handler_count; i++) {
+        task_notify(handler_ids[i], 0, NOTIFY_INCREMENT);
+    }
+    wake_ns = (now_seconds() - start) * 1e9 / handler_count;
+
+    samples_handled = 0;
+    for (uint32_t i = 0; i < handler_count; i++) {
+        samples_handled += frames[i].samples;
+    }
+
+    rtos_stop();
+}
+
+static void bench_memory(bool stackless, uint32_t count) {
+    start_kernel();
+    handler_count = count;
+    frames = calloc(count, sizeof(handler_frame_t));
+    handler_ids = calloc(count, sizeof(uint32_t));
+    read_memory(&vm_before, &rss_before);
+
+    double start = now_seconds();
+    for (uint32_t i = 0; i < count; i++) {
+        handler_ids[i] = stackless ?
+            task_create_stackless("SENSOR", stackless_handler, &frames[i], 1) :
+            task_create("SENSOR", stackful_handler, &frames[i], 1, 0);
+        if (handler_ids[i] == 0) {
+            printf("❌ Creating handler %u failed\n", i);
+            exit(1);
+        }
+    }
+    double create_ns = (now_seconds() - start) * 1e9 / count;
+
+    task_create("CONTROL", control_task, NULL, 2, 0);
+    rtos_start();
+
+    printf("  %-10s %8u %9.0f %11.0f %10.0f %9.0f   %s\n",
+           stackless ? "stackless" : "stackful", count,
+           (double)(rss_after - rss_before) / count, (double)(vm_after - vm_before) / count,
+           create_ns, wake_ns, samples_handled == count ? "all handled" : "LOST SAMPLES");
+
+    free(frames);
+    free(handler_ids);
+}
+
+/*
+ * BENCHMARK 2: Switch cost
+ */
+static pt_status_t stackless_ping(pt_t* pt, void* param) {
+    pingpong_frame_t* frame = param;
+
+    PT_BEGIN(pt);
+    pingpong_start = now_seconds();
+    for (frame->round = 0; frame->round < PINGPONG_ROUNDS; frame->round++) {
+        task_notify(frame->other, 0, NOTIFY_INCREMENT);
+        PT_NOTIFY_TAKE(pt, true, frame->value);
+    }
+    round_trip_ns = (now_seconds() - pingpong_start) * 1e9 / PINGPONG_ROUNDS;
+    rtos_stop();
+    PT_END(pt);
+}
+
+static pt_status_t stackless_pong(pt_t* pt, void* param) {
+    pingpong_frame_t* frame = param;
+
+    PT_BEGIN(pt);
+    while (1) {
+        PT_NOTIFY_TAKE(pt, true, frame->value);
+        task_notify(frame->other, 0, NOTIFY_INCREMENT);
+    }
+    PT_END(pt);
+}
+
+static void stackful_ping(void* param) {
+    pingpong_frame_t* frame = param;
+
+    pingpong_start = now_seconds();
+    for (frame->round = 0; frame->round < PINGPONG_ROUNDS; frame->round++) {
+        task_notify(frame->other, 0, NOTIFY_INCREMENT);
+        task_notify_take(true, RTOS_WAIT_FOREVER);
+    }
+    round_trip_ns = (now_seconds() - pingpong_start) * 1e9 / PINGPONG_ROUNDS;
+    rtos_stop();
+}
+
+static void stackful_pong(void* param) {
+    pingpong_frame_t* frame = param;
+
+    while (1) {
+        task_notify_take(true, RTOS_WAIT_FOREVER);
+        task_notify(frame->other, 0, NOTIFY_INCREMENT);
+    }
+}
+
+static void bench_pingpong(const char* label, bool ping_stackless, bool pong_stackless) {
+    static pingpong_frame_t ping;
+    static pingpong_frame_t pong;
+
+    start_kernel();
+    ping = (pingpong_frame_t){0};
+    pong = (pingpong_frame_t){0};
+
+    uint32_t ping_id = ping_stackless ?
+        task_create_stackless("PING", stackless_ping, &ping, 1) :
+        task_create("PING", stackful_ping, &ping, 1, 0);
+    uint32_t pong_id = pong_stackless ?
+        task_create_stackless("PONG", stackless_pong, &pong, 1) :
+        task_create("PONG", stackful_pong, &pong, 1, 0);
+    ping.other = pong_id;
+    pong.other = ping_id;
+
+    rtos_start();
+
+    printf("  %-24s %9.1f ns/round trip  %7.1f ns/switch\n", label, round_trip_ns,
+           round_trip_ns * PINGPONG_ROUNDS / get_scheduler_stats()->total_context_switches);
+}
+
+/*
+ * BENCHMARK 3: Queues
+ */
+static pt_status_t stackless_producer(pt_t* pt, void* param) {
+    pipe_frame_t* frame = param;
+
+    PT_BEGIN(pt);
+    pipe_start = now_seconds();
+    for (frame->count = 0; frame->count < PIPE_ITEMS; frame->count++) {
+        frame->item = frame->count + 1;
+        if (queue_try_send(&pipe_queue, &frame->item) == 0) {
+            continue;
+        }
+        frame->waits++;
+        PT_QUEUE_SEND(pt, &pipe_queue, &frame->item, frame->result);
+        if (frame->result != 0) {
+            pipe_failed = true;
+            rtos_stop();
+            PT_EXIT(pt);
+        }
+    }
+    PT_END(pt);
+}
+
+static pt_status_t stackless_consumer(pt_t* pt, void* param) {
+    pipe_frame_t* frame = param;
+
+    PT_BEGIN(pt);
+    for (frame->count = 0; frame->count < PIPE_ITEMS; frame->count++) {
+        if (queue_try_receive(&pipe_queue, &frame->item) != 0) {
+            frame->waits++;
+            PT_QUEUE_RECEIVE(pt, &pipe_queue, &frame->item, frame->result);
+            if (frame->result != 0) {
+                pipe_failed = true;
+                break;
+            }
+        }
+        frame->sum += frame->item;
+    }
+    item_ns = (now_seconds() - pipe_start) * 1e9 / PIPE_ITEMS;
+    rtos_stop();
+    PT_END(pt);
+}
+
+static void bench_pipe(void) {
+    static pipe_frame_t producer;
+    static pipe_frame_t consumer;
+
+    start_kernel();
+    producer = (pipe_frame_t){0};
+    consumer = (pipe_frame_t){0};
+    pipe_failed = false;
+    if (queue_create(&pipe_queue, QUEUE_SPSC, PIPE_CAPACITY, sizeof(uint32_t)) != 0) {
+        printf("❌ queue_create failed\n");
+        exit(1);
+    }
+
+    task_create_stackless("PRODUCER", stackless_producer, &producer, 2);
+    task_create_stackless("CONSUMER", stackless_consumer, &consumer, 1);
+    rtos_start();
+    queue_destroy(&pipe_queue);
+
+    uint64_t expected = (uint64_t)PIPE_ITEMS * (PIPE_ITEMS + 1) / 2;
+    const char* verdict = pipe_failed || consumer.sum != expected ? "❌ LOST ITEMS" :
+                          producer.waits == 0 || consumer.waits == 0 ? "❌ NEVER BLOCKED" :
+                          "✅ all received";
+    printf("  stackless -> stackless   %9.1f ns/item   full %u times, empty %u times   %s\n",
+           item_ns, producer.waits, consumer.waits, verdict);
+}
+
+int main(void) {
+    printf("🧪 RTOS STACKLESS TASK BENCHMARK\n");
+    printf("================================\n\n");
+
+    printf("Handlers blocked on a notification (TCB: %zu bytes, pt_t: %zu bytes, frame: %zu bytes)\n",
+           sizeof(tcb_t), sizeof(pt_t), sizeof(handler_frame_t));
+    printf("  %-10s %8s %9s %11s %10s %9s\n", "kind", "tasks", "RSS B", "address B",
+           "create ns", "wake ns");
+    bench_memory(true, STACKLESS_HANDLERS);
+    bench_memory(false, STACKFUL_HANDLERS);
+    printf("\n");
+
+    printf("Ping-pong over notifications, %d round trips\n", PINGPONG_ROUNDS);
+    bench_pingpong("stackful <-> stackful", false, false);
+    bench_pingpong("stackless <-> stackless", true, true);
+    bench_pingpong("stackful <-> stackless", false, true);
+    printf("\n");
+
+    printf("Producer -> consumer over a %d-slot queue, %d items\n", PIPE_CAPACITY, PIPE_ITEMS);
+    bench_pipe();
+
+    return 0;
+}
@@ -0,0 +1,256 @@
+/*
+ * Task Churn Benchmark
+ *
+ * Measures how fast the kernel can create and destroy tasks. With the
+ * pooled task table and stack pool both operations are O(1) and never
+ * touch the system allocator or mmap once the pools are warm.
+ *
+ * 1-2. Create and delete, one task at a time and in a large batch
+ *      (simulated mode: no task ever runs).
+ * 3.   Moving ready tasks between priority queues with task_set_priority,
+ *      and suspending and resuming them, all O(1) however many are queued.
+ *      Every task must still be found on its queue when it is deleted.
+ * 4.   Deleting tasks that are running on another core (context-switch
+ *      mode, two cores), and the idle tasks draining the reclaim list.
+ *
+ * Build and run:  make bench_task_churn && ./bench_task_churn
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CHURN_ITERATIONS 1000000   // create+delete pairs in the steady-state test
+#define BATCH_TASKS 20000          // tasks alive at once in the batch test
+#define LOOKUPS 1000000            // task_get_info calls in the lookup test
+#define QUEUED_TASKS 10000         // ready tasks in the priority change test
+#define PRIORITY_CHANGES 1000000   // task_set_priority calls
+#define SUSPEND_PAIRS 1000000      // task_suspend+task_resume pairs
+#define SPINNER_TASKS 200          // tasks deleted while running elsewhere
+
+static void worker(void* param) {
+    (void)param;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char* label, uint32_t operations, double seconds) {
+    printf("%-28s %10u ops  %8.3f s  %12.0f ops/s  %7.1f ns/op\n",
+           label, operations, seconds, operations / seconds,
+           seconds * 1e9 / operations);
+}
+
+/*
+ * BENCHMARK 1: Steady-state churn
+ *
+ * One task is created and immediately deleted, so the same slot and stack
+ * are recycled every iteration. This is the best case for the free lists.
+ */
+static void bench_steady_churn(void) {
+    double start = now_seconds();
+
+    for (uint32_t i = 0; i < CHURN_ITERATIONS; i++) {
+        uint32_t id = task_create("churn", worker, NULL, 1, STACK_SIZE);
+        if (id == 0 || task_delete(id) != 0) {
+            printf("❌ Churn failed at iteration %u\n", i);
+            exit(1);
+        }
+    }
+
+    report("create+delete (steady)", CHURN_ITERATIONS, now_seconds() - start);
+}
+
+/*
+ * BENCHMARK 2: Batch create, then batch delete
+ *
+ * Grows the task table, ID index and stack arenas, then tears everything
+ * down in a different order than it was built to exercise the hash index.
+ */
+static void bench_batch(void) {
+    uint32_t* ids = malloc(BATCH_TASKS * sizeof(uint32_t));
+    if (ids == NULL) {
+        exit(1);
+    }
+
+    double start = now_seconds();
+    for (uint32_t i = 0; i < BATCH_TASKS; i++) {
+        ids[i] = task_create("batch", worker, NULL, (uint8_t)(i % (PRIORITY_LEVELS - 1)),
+                             STACK_SIZE);
+        if (ids[i] == 0) {
+            printf("❌ Batch create failed at task %u\n", i);
+            exit(1);
+        }
+    }
+    report("create (batch)", BATCH_TASKS, now_seconds() - start);
+
+    start = now_seconds();
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+        if (task_get_info(ids[(i * 7919u) % BATCH_TASKS]) == NULL) {
+            printf("❌ Lookup failed\n");
+            exit(1);
+        }
+    }
+    report("task_get_info", LOOKUPS, now_seconds() - start);
+
+    // Delete even slots first, then odd ones
+    start = now_seconds();
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        for (uint32_t i = pass; i < BATCH_TASKS; i += 2) {
+            if (task_delete(ids[i]) != 0) {
+                printf("❌ Batch delete failed at task %u\n", i);
+                exit(1);
+            }
+        }
+    }
+    report("delete (batch)", BATCH_TASKS, now_seconds() - start);
+
+    free(ids);
+}
+
+/*
+ * BENCHMARK 3: Priority changes, suspend and resume
+ *
+ * Simulated mode with nothing running, so every task stays ready and each
+ * call moves one task between queues.
+ */
+static void bench_requeue(void) {
+    uint32_t* ids = malloc(QUEUED_TASKS * sizeof(uint32_t));
+    if (ids == NULL) {
+        exit(1);
+    }
+
+    for (uint32_t i = 0; i < QUEUED_TASKS; i++) {
+        ids[i] = task_create("queued", worker, NULL, (uint8_t)(i % (PRIORITY_LEVELS - 1)),
+                             STACK_SIZE);
+        if (ids[i] == 0) {
+            printf("❌ Create failed at task %u\n", i);
+            exit(1);
+        }
+    }
+
+    double start = now_seconds();
+    for (uint32_t i = 0; i < PRIORITY_CHANGES; i++) {
+        uint8_t priority = (uint8_t)((i / QUEUED_TASKS + i) % (PRIORITY_LEVELS - 1));
+        if (task_set_priority(ids[(i * 7919u) % QUEUED_TASKS], priority) != 0) {
+            printf("❌ Priority change failed\n");
+            exit(1);
+        }
+    }
+    report("task_set_priority", PRIORITY_CHANGES, now_seconds() - start);
+
+    start = now_seconds();
+    for (uint32_t i = 0; i < SUSPEND_PAIRS; i++) {
+        uint32_t id = ids[(i * 7919u) % QUEUED_TASKS];
+        if (task_suspend(id) != 0 || task_resume(id) != 0) {
+            printf("❌ Suspend/resume failed\n");
+            exit(1);
+        }
+    }
+    report("suspend+resume", SUSPEND_PAIRS, now_seconds() - start);
+
+    // Deleting a ready task takes it off the queue it is on now
+    for (uint32_t i = 0; i < QUEUED_TASKS; i++) {
+        if (task_delete(ids[i]) != 0) {
+            printf("❌ Task %u was not on its ready queue\n", ids[i]);
+            exit(1);
+        }
+    }
+
+    free(ids);
+}
+
+/*
+ * BENCHMARK 4: Deleting running tasks, and reclaim by the idle tasks
+ */
+static uint32_t spinner_ids[SPINNER_TASKS];
+static double delete_seconds;
+static uint32_t reclaimed_at_delete;
+static uint32_t reclaimed_after_sleep;
+
+// Never blocks; each yield is a kernel call at which a delete can land
+static void spinner(void* param) {
+    (void)param;
+    while (1) {
+        task_yield();
+    }
+}
+
+static void deleter_task(void* param) {
+    (void)param;
+    scheduler_stats_t* s = get_scheduler_stats();
+    uint32_t deleted_before = s->tasks_deleted;
+
+    // Let the spinners spread over both cores first
+    task_sleep(20);
+
+    double start = now_seconds();
+    for (uint32_t i = 0; i < SPINNER_TASKS; i++) {
+        if (task_delete(spinner_ids[i]) != 0) {
+            printf("❌ Deleting spinner %u failed\n", i);
+            exit(1);
+        }
+    }
+    while (__atomic_load_n(&s->tasks_deleted, __ATOMIC_ACQUIRE) - deleted_before <
+           SPINNER_TASKS) {
+        task_yield();
+    }
+    delete_seconds = now_seconds() - start;
+    reclaimed_at_delete = __atomic_load_n(&s->tasks_reclaimed, __ATOMIC_ACQUIRE);
+
+    // Nothing else to run: the idle tasks drain the list
+    task_sleep(20);
+    reclaimed_after_sleep = __atomic_load_n(&s->tasks_reclaimed, __ATOMIC_ACQUIRE);
+    rtos_stop();
+}
+
+static void bench_delete_running(void) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 || rtos_set_core_count(2) != 0 ||
+        rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+
+    for (uint32_t i = 0; i < SPINNER_TASKS; i++) {
+        spinner_ids[i] = task_create("spinner", spinner, NULL, 1, 0);
+    }
+    task_create("deleter", deleter_task, NULL, 0, 0);
+    rtos_start();
+
+    scheduler_stats_t* s = get_scheduler_stats();
+    report("delete (running, 2 cores)", SPINNER_TASKS, delete_seconds);
+    printf("Reclaimed by idle: %u when the last delete landed, %u of %u after 20 ticks idle\n",
+           reclaimed_at_delete, reclaimed_after_sleep, s->tasks_deleted);
+    if (reclaimed_after_sleep != s->tasks_deleted) {
+        printf("❌ Reclaim list not drained\n");
+        exit(1);
+    }
+}
+
+int main(void) {
+    printf("🧪 RTOS TASK CHURN BENCHMARK\n");
+    printf("============================\n");
+
+    if (rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        return 1;
+    }
+
+    bench_steady_churn();
+    bench_batch();
+    bench_requeue();
+
+    scheduler_stats_t* s = get_scheduler_stats();
+    printf("\nTasks created: %u, deleted: %u\n", s->tasks_created, s->tasks_deleted);
+    print_scheduler_stats();
+
+    printf("\n");
+    bench_delete_running();
+
+    return 0;
+}
@@ -0,0 +1,259 @@
+/*
+ * Software Timer Benchmark
+ *
+ * 1. Idle cost: thousands of armed timers that do not expire during the
+ *    run. The timer task sleeps until the earliest one, so the kernel's
+ *    host thread should stay asleep too (tickless idle). Also the memory
+ *    a timer takes compared to a task.
+ * 2. API cost: reset and stop/start with all those timers armed (heap
+ *    operations, O(log n)).
+ * 3. Dispatch: periodic timers expiring in groups on the same ticks, with
+ *    a lower priority load task hogging the CPU between kernel calls.
+ *    Each callback measures how late it runs after its expiry tick was
+ *    due. The same periodic work done by tasks in task_sleep loops needs
+ *    a context switch pair per expiry instead of per batch.
+ *
+ * Build and run:  make bench_timers && ./bench_timers
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#define IDLE_TIMERS 10000
+#define IDLE_RUN_MS 2000
+#define API_ROUNDS 10
+#define DISPATCH_TIMERS 1000
+#define DISPATCH_PERIOD_MS 10
+#define DISPATCH_GROUPS 10                   // Distinct expiry ticks per period
+#define DISPATCH_RUN_MS 3000
+#define SLEEPER_TASKS 1000
+#define LOAD_BUSY_US 200
+
+typedef struct {
+    uint64_t samples;
+    uint64_t sum_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+} latency_stats_t;
+
+static soft_timer_t* timers;
+static latency_stats_t all_latency;
+static latency_stats_t first_latency;        // First callback of each batch
+static uint32_t last_due_tick;
+static uint32_t sleeper_wakeups;
+static double api_reset_ns;
+static double api_stop_start_ns;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint64_t thread_cpu_ns(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return ((uint64_t)usage.ru_utime.tv_sec + (uint64_t)usage.ru_stime.tv_sec) * 1000000000u +
+           ((uint64_t)usage.ru_utime.tv_usec + (uint64_t)usage.ru_stime.tv_usec) * 1000u;
+}
+
+static void stats_add(latency_stats_t* stats, uint64_t ns) {
+    if (stats->samples == 0 || ns < stats->min_ns) {
+        stats->min_ns = ns;
+    }
+    if (ns > stats->max_ns) {
+        stats->max_ns = ns;
+    }
+    stats->sum_ns += ns;
+    stats->samples++;
+}
+
+static void print_row(const char* label, const latency_stats_t* stats) {
+    printf("  %-22s %8llu %9.1f %9.1f %9.1f\n", label, (unsigned long long)stats->samples,
+           stats->min_ns / 1000.0, stats->samples ? stats->sum_ns / 1000.0 / stats->samples : 0.0,
+           stats->max_ns / 1000.0);
+}
+
+static void start_kernel(void) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 || rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+}
+
+static void create_timer(soft_timer_t* timer, uint32_t period_ms, soft_timer_callback_t callback) {
+    if (soft_timer_create(timer, "T", period_ms, true, callback, NULL) != 0) {
+        printf("❌ soft_timer_create failed\n");
+        exit(1);
+    }
+}
+
+/*
+ * BENCHMARK 1 AND 2: Idle cost, API cost
+ */
+static void never_called(soft_timer_t* timer) {
+    (void)timer;
+}
+
+static void api_task(void* param) {
+    (void)param;
+
+    uint64_t start = now_ns();
+    for (int round = 0; round < API_ROUNDS; round++) {
+        for (int i = 0; i < IDLE_TIMERS; i++) {
+            soft_timer_reset(&timers[i]);
+        }
+    }
+    api_reset_ns = (double)(now_ns() - start) / (API_ROUNDS * IDLE_TIMERS);
+
+    start = now_ns();
+    for (int round = 0; round < API_ROUNDS; round++) {
+        for (int i = 0; i < IDLE_TIMERS; i++) {
+            soft_timer_stop(&timers[i]);
+            soft_timer_start(&timers[i]);
+        }
+    }
+    api_stop_start_ns = (double)(now_ns() - start) / (API_ROUNDS * IDLE_TIMERS);
+
+    // Now do nothing, with every timer armed
+    task_sleep(IDLE_RUN_MS);
+    rtos_stop();
+}
+
+static void run_idle(void) {
+    start_kernel();
+    timers = calloc(IDLE_TIMERS, sizeof(soft_timer_t));
+    for (int i = 0; i < IDLE_TIMERS; i++) {
+        create_timer(&timers[i], 20000 + (uint32_t)rand() % 40000, never_called);
+        soft_timer_start(&timers[i]);
+    }
+    task_create("API", api_task, NULL, 1, 0);
+
+    uint64_t cpu_start = thread_cpu_ns();
+    uint64_t wall_start = now_ns();
+    rtos_start();
+    double cpu_use = (double)(thread_cpu_ns() - cpu_start) / (now_ns() - wall_start);
+
+    core_stats_t core;
+    get_core_stats(0, &core);
+    printf("%d armed timers, %d ms run\n", IDLE_TIMERS, IDLE_RUN_MS);
+    printf("  %-34s %8.1f %%  (includes the API rounds below)\n", "host CPU used by the kernel", 100.0 * cpu_use);
+    printf("  %-34s %8u\n", "idle sleeps of the host thread", core.idle_sleeps);
+    printf("  %-34s %8u\n", "timer task wake-ups", get_scheduler_stats()->timer_batches);
+    printf("  %-34s %8zu bytes (+ %zu heap slot)\n", "memory per timer", sizeof(soft_timer_t),
+           sizeof(soft_timer_t*));
+    printf("  %-34s %8zu bytes (+ %d KiB stack)\n", "memory per task", sizeof(tcb_t),
+           CONTEXT_STACK_MIN / 1024);
+    printf("  %-34s %8.1f ns\n", "soft_timer_reset", api_reset_ns);
+    printf("  %-34s %8.1f ns\n\n", "soft_timer_stop + start", api_stop_start_ns);
+    free(timers);
+}
+
+/*
+ * BENCHMARK 3: Dispatch latency and batching
+ */
+static void record_dispatch(soft_timer_t* timer) {
+    uint64_t late = now_ns() - rtos_tick_time_ns(timer->due_tick);
+    stats_add(&all_latency, late);
+    if (timer->due_tick != last_due_tick) {
+        last_due_tick = timer->due_tick;
+        stats_add(&first_latency, late);
+    }
+}
+
+static void load_task(void* param) {
+    (void)param;
+    while (1) {
+        uint64_t start = now_ns();
+        while (now_ns() - start < LOAD_BUSY_US * 1000ull) {
+        }
+        if (get_system_uptime() >= DISPATCH_RUN_MS) {
+            rtos_stop();
+        }
+        task_yield();
+    }
+}
+
+// Arms the timers in DISPATCH_GROUPS groups, one tick apart
+static void starter_task(void* param) {
+    (void)param;
+    for (int group = 0; group < DISPATCH_GROUPS; group++) {
+        for (int i = group; i < DISPATCH_TIMERS; i += DISPATCH_GROUPS) {
+            soft_timer_start(&timers[i]);
+        }
+        task_sleep(1);
+    }
+}
+
+// The same periodic work without timers: one task per period
+static void sleeper_task(void* param) {
+    task_sleep((uint32_t)(uintptr_t)param); // Stagger like the timer groups
+
+    while (1) {
+        uint32_t due_tick = get_system_uptime() + DISPATCH_PERIOD_MS;
+        task_sleep(DISPATCH_PERIOD_MS);
+        stats_add(&all_latency, now_ns() - rtos_tick_time_ns(due_tick));
+        sleeper_wakeups++;
+    }
+}
+
+static void run_dispatch(bool use_timers) {
+    start_kernel();
+    all_latency = (latency_stats_t){0};
+    first_latency = (latency_stats_t){0};
+    last_due_tick = 0;
+    sleeper_wakeups = 0;
+
+    if (use_timers) {
+        timers = calloc(DISPATCH_TIMERS, sizeof(soft_timer_t));
+        for (int i = 0; i < DISPATCH_TIMERS; i++) {
+            create_timer(&timers[i], DISPATCH_PERIOD_MS, record_dispatch);
+        }
+        task_create("STARTER", starter_task, NULL, 0, 0);
+    } else {
+        for (int i = 0; i < SLEEPER_TASKS; i++) {
+            task_create("SLEEPER", sleeper_task, (void*)(uintptr_t)(1 + i % DISPATCH_GROUPS),
+                        TIMER_TASK_PRIORITY, 0);
+        }
+    }
+    task_create("LOAD", load_task, NULL, PRIORITY_LEVELS - 2, 0);
+
+    rtos_start();
+
+    scheduler_stats_t* stats = get_scheduler_stats();
+    uint32_t expiries = use_timers ? stats->timer_callbacks : sleeper_wakeups;
+    if (use_timers) {
+        printf("%d periodic timers every %d ms in %d groups, load task %d us between yields\n",
+               DISPATCH_TIMERS, DISPATCH_PERIOD_MS, DISPATCH_GROUPS, LOAD_BUSY_US);
+        printf("  %-22s %8s %9s %9s %9s\n", "latency", "samples", "min us", "avg us", "max us");
+        print_row("first callback", &first_latency);
+        print_row("all callbacks", &all_latency);
+        printf("  %u callbacks in %u batches (%.1f per wake-up), %u overruns\n",
+               stats->timer_callbacks, stats->timer_batches,
+               stats->timer_batches ? (double)stats->timer_callbacks / stats->timer_batches : 0.0,
+               stats->timer_overruns);
+        free(timers);
+    } else {
+        printf("The same with %d tasks in task_sleep(%d) loops instead of timers\n",
+               SLEEPER_TASKS, DISPATCH_PERIOD_MS);
+        printf("  %-22s %8s %9s %9s %9s\n", "latency", "samples", "min us", "avg us", "max us");
+        print_row("all wake-ups", &all_latency);
+    }
+    printf("  %.2f context switches per expiry\n\n",
+           (double)stats->total_context_switches / (expiries ? expiries : 1));
+}
+
+int main(void) {
+    printf("🧪 RTOS SOFTWARE TIMER BENCHMARK\n");
+    printf("================================\n\n");
+
+    run_idle();
+    run_dispatch(true);
+    run_dispatch(false);
+
+    return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * Scheduler Trace Benchmark
+ *
+ * 1. Cost: a semaphore ping-pong (two context switches per round) with
+ *    tracing off and on, next to what the old printf log line cost per
+ *    switch: one line-buffered write, even when it goes to /dev/null.
+ * 2. Export: a mixed workload on two cores (periodic sleepers, CPU-bound
+ *    yielders and a producer/consumer pair) is traced and written out as
+ *    Chrome/Perfetto JSON. Open the file in https://ui.perfetto.dev or
+ *    chrome://tracing to see every core's timeline.
+ *
+ * Build and run:  make bench_trace && ./bench_trace [trace.json]
+ */
+
+#define _GNU_SOURCE
+#include "rtos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PINGPONG_ROUNDS 200000
+#define PRINTF_LINES 1000000
+#define TRACE_EVENTS_PER_CORE (1u << 16)
+#define EXPORT_CORES 2
+#define EXPORT_RUN_MS 200
+
+static semaphore_t ping_sem;
+static semaphore_t pong_sem;
+static double round_ns;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void start_kernel(uint32_t cores) {
+    if (rtos_set_mode(RTOS_MODE_CONTEXT_SWITCH) != 0 ||
+        rtos_set_core_count(cores) != 0 || rtos_init() != 0) {
+        printf("❌ rtos_init failed\n");
+        exit(1);
+    }
+}
+
+/*
+ * BENCHMARK 1: Cost
+ */
+static void ping_task(void* param) {
+    (void)param;
+    double start = now_seconds();
+    for (int i = 0; i < PINGPONG_ROUNDS; i++) {
+        semaphore_signal(&ping_sem);
+        semaphore_wait(&pong_sem);
+    }
+    round_ns = (now_seconds() - start) * 1e9 / PINGPONG_ROUNDS;
+    rtos_stop();
+}
+
+static void pong_task(void* param) {
+    (void)param;
+    while (1) {
+        semaphore_wait(&ping_sem);
+        semaphore_signal(&pong_sem);
+    }
+}
+
+static double run_pingpong(bool traced) {
+    start_kernel(1);
+    semaphore_init(&ping_sem, 0);
+    semaphore_init(&pong_sem, 0);
+    task_create("PING", ping_task, NULL, 1, 0);
+    task_create("PONG", pong_task, NULL, 1, 0);
+    if (traced) {
+        rtos_trace_start(TRACE_EVENTS_PER_CORE);
+    }
+    rtos_start();
+    rtos_trace_stop();
+    return round_ns;
+}
+
+static void run_cost(void) {
+    double off = run_pingpong(false);
+    double on = run_pingpong(true);
+
+    // stdout on a terminal is line buffered: one write() per log line
+    FILE* sink = fopen("/dev/null", "w");
+    setvbuf(sink, NULL, _IOLBF, 0);
+    double start = now_seconds();
+    for (int i = 0; i < PRINTF_LINES; i++) {
+        fprintf(sink, "🔄 Context switch: %s -> %s\n", "PING", "PONG");
+    }
+    double printf_ns = (now_seconds() - start) * 1e9 / PRINTF_LINES;
+    fclose(sink);
+
+    // A round is two switches, each with its wake, block and switch events
+    printf("%-36s %8.1f ns\n", "ping-pong round, tracing off", off);
+    printf("%-36s %8.1f ns  (+%.1f ns per switch)\n", "ping-pong round, tracing on",
+           on, (on - off) / 2);
+    printf("%-36s %8.1f ns  (line-buffered printf to /dev/null)\n",
+           "old log line per switch", printf_ns);
+    printf("\n");
+}
+
+/*
+ * BENCHMARK 2: Export
+ */
+static msg_queue_t work_queue;
+
+static void sleeper_task(void* param) {
+    uint32_t period = (uint32_t)(uintptr_t)param;
+    while (1) {
+        for (volatile int i = 0; i < 20000; i++) {
+        }
+        task_sleep(period);
+    }
+}
+
+static void cruncher_task(void* param) {
+    (void)param;
+    while (1) {
+        for (volatile int i = 0; i < 50000; i++) {
+        }
+        if (get_system_uptime() >= EXPORT_RUN_MS) {
+            rtos_stop();
+        }
+        task_yield();
+    }
+}
+
+static void producer_task(void* param) {
+    (void)param;
+    for (uint32_t i = 0; ; i++) {
+        queue_send(&work_queue, &i);
+        if ((i & 15) == 0) {
+            task_sleep(1);
+        }
+    }
+}
+
+static void consumer_task(void* param) {
+    (void)param;
+    while (1) {
+        uint32_t item;
+        queue_receive(&work_queue, &item);
+    }
+}
+
+static void run_export(const char* path) {
+    start_kernel(EXPORT_CORES);
+    queue_create(&work_queue, QUEUE_MPMC, 8, sizeof(uint32_t));
+
+    task_create("SENSOR", sleeper_task, (void*)(uintptr_t)2, 0, 0);
+    task_create("CONTROL", sleeper_task, (void*)(uintptr_t)5, 0, 0);
+    task_create("CRUNCH1", cruncher_task, NULL, 2, 0);
+    task_create("CRUNCH2", cruncher_task, NULL, 2, 0);
+    task_create("PRODUCER", producer_task, NULL, 1, 0);
+    task_create("CONSUMER", consumer_task, NULL, 1, 0);
+
+    rtos_trace_start(TRACE_EVENTS_PER_CORE);
+    double start = now_seconds();
+    rtos_start();
+    double elapsed = now_seconds() - start;
+    rtos_trace_stop();
+
+    double export_start = now_seconds();
+    int events = rtos_trace_export_chrome(path);
+    double export_time = now_seconds() - export_start;
+
+    queue_destroy(&work_queue);
+
+    if (events < 0) {
+        printf("❌ Could not write %s\n", path);
+        exit(1);
+    }
+
+    printf("Traced %.0f ms on %d cores: %d events (%llu overwritten), %u switches\n",
+           elapsed * 1000, EXPORT_CORES, events,
+           (unsigned long long)rtos_trace_overwritten(),
+           get_scheduler_stats()->total_context_switches);
+    printf("Exported to %s in %.1f ms ✅  (open in https://ui.perfetto.dev)\n",
+           path, export_time * 1000);
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "rtos_trace.json";
+
+    printf("🧪 RTOS SCHEDULER TRACE BENCHMARK\n");
+    printf("=================================\n");
+
+    run_cost();
+    run_export(path);
+
+    return 0;
+}
@@ -0,0 +1,462 @@
+/*
+ * RTOS Heap - Two-Level Segregated Fit (TLSF)
+ *
+ * A real-time task may only allocate memory if it knows how long that can
+ * take. A first-fit or best-fit allocator walks a free list whose length
+ * depends on the heap's history; TLSF finds a fitting block in a constant
+ * number of steps, however fragmented the heap is.
+ *
+ * FREE LISTS:
+ * Free blocks are kept on segregated lists, indexed in two levels. The
+ * first level is the power of two of the size (log2), the second splits
+ * each power of two into SL_COUNT equal ranges:
+ *
+ *   size 1000 = 0b1111101000 -> first level 9 (512..1023),
+ *                               second level (1000 - 512) / 32 = 15
+ *
+ * A bitmap per level says which lists are non-empty. malloc rounds the
+ * request up to the start of the next range, so that any block on the
+ * list it picks is big enough, and finds that list with two find-first-
+ * set instructions. free merges the block with its physical neighbours
+ * (each block knows both) and pushes it on its list. Both are O(1).
+ *
+ * OWNERSHIP:
+ * Every allocated block records the task that allocated it and is linked
+ * into that task's list of blocks, so deleting a task gives all of its
+ * memory back in one go (heap_release_task) and each TCB knows how many
+ * bytes it holds. Allocations made outside any task belong to the kernel.
+ * The links reuse the free-list pointers, which a used block does not
+ * need.
+ *
+ * PARTITION POOLS:
+ * Messages of a few hot sizes are allocated and freed constantly. A pool
+ * carves one heap allocation into equal blocks and keeps the free ones on
+ * a lock-free stack, which is cheaper still than TLSF and never fragments.
+ *
+ * The heap is guarded by the kernel lock, like the other shared kernel
+ * objects; its operations are a few dozen instructions long.
+ */
+
+#define _GNU_SOURCE
+#include "rtos_internal.h"
+#include <string.h>
+#include <sys/mman.h>
+
+/*
+ * HEAP LAYOUT
+ */
+#define HEAP_ALIGN_SHIFT 4
+#define HEAP_ALIGN (1u << HEAP_ALIGN_SHIFT)         // Payload alignment (bytes)
+#define SL_SHIFT 4
+#define SL_COUNT (1u << SL_SHIFT)                   // Second-level lists per power of two
+#define FL_SHIFT (SL_SHIFT + HEAP_ALIGN_SHIFT)
+#define SMALL_BLOCK (1u << FL_SHIFT)                // Below this, lists are HEAP_ALIGN apart
+#define FL_COUNT (32 - FL_SHIFT + 1)                // First-level lists (blocks below 4 GiB)
+#define BLOCK_FREE 1u                               // Flag in heap_block_t.size
+#define MIN_PAYLOAD HEAP_ALIGN                      // Smallest block worth splitting off
+
+typedef struct heap_block {
+    struct heap_block* prev_phys;             // Block just below this one in memory
+    uint32_t size;                            // Payload bytes, BLOCK_FREE in bit 0
+    uint32_t owner;                           // Allocating task ID (0 = kernel)
+    struct heap_block* next;                  // Free: next on its list. Used: next owned block
+    struct heap_block* prev;                  // Free: previous on its list. Used: previous owned
+} heap_block_t;
+
+// Payloads start right after the header, on a HEAP_ALIGN boundary
+#define HEADER_SIZE ((sizeof(heap_block_t) + HEAP_ALIGN - 1) & ~(size_t)(HEAP_ALIGN - 1))
+#define MAX_ALLOC (RTOS_HEAP_SIZE - 2 * HEADER_SIZE)
+
+static uint8_t* heap_base = NULL;             // The heap's mapping
+static uint32_t fl_bitmap;                    // Bit per non-empty first level
+static uint32_t sl_bitmap[FL_COUNT];          // Bit per non-empty list in each level
+static heap_block_t* free_lists[FL_COUNT][SL_COUNT];
+static heap_block_t* kernel_blocks;           // Blocks allocated outside any task
+static size_t heap_free_bytes;                // Payload bytes in free blocks
+
+/*
+ * BLOCK HELPERS
+ */
+static inline uint32_t block_size(const heap_block_t* block) {
+    return block->size & ~BLOCK_FREE;
+}
+
+static inline bool block_is_free(const heap_block_t* block) {
+    return (block->size & BLOCK_FREE) != 0;
+}
+
+static inline void* block_payload(heap_block_t* block) {
+    return (uint8_t*)block + HEADER_SIZE;
+}
+
+static inline heap_block_t* payload_block(void* ptr) {
+    return (heap_block_t*)((uint8_t*)ptr - HEADER_SIZE);
+}
+
+static inline heap_block_t* block_next_phys(heap_block_t* block) {
+    return (heap_block_t*)((uint8_t*)block_payload(block) + block_size(block));
+}
+
+static inline uint32_t fls32(uint32_t x) {
+    return 31u - (uint32_t)__builtin_clz(x);
+}
+
+/*
+ * SIZE TO LIST MAPPING
+ */
+static inline void mapping_insert(uint32_t size, uint32_t* fl, uint32_t* sl) {
+    if (size < SMALL_BLOCK) {
+        *fl = 0;
+        *sl = size >> HEAP_ALIGN_SHIFT;
+    } else {
+        uint32_t log2 = fls32(size);
+        *sl = (size >> (log2 - SL_SHIFT)) ^ SL_COUNT;
+        *fl = log2 - FL_SHIFT + 1;
+    }
+}
+
+// Round up to the next list boundary: every block on that list fits
+static inline void mapping_search(uint32_t size, uint32_t* fl, uint32_t* sl) {
+    if (size >= SMALL_BLOCK) {
+        size += (1u << (fls32(size) - SL_SHIFT)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+/*
+ * FREE LISTS
+ */
+static void free_list_insert(heap_block_t* block) {
+    uint32_t fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    block->size |= BLOCK_FREE;
+    block->prev = NULL;
+    block->next = free_lists[fl][sl];
+    if (block->next != NULL) {
+        block->next->prev = block;
+    }
+    free_lists[fl][sl] = block;
+    fl_bitmap |= 1u << fl;
+    sl_bitmap[fl] |= 1u << sl;
+    heap_free_bytes += block_size(block);
+}
+
+static void free_list_remove(heap_block_t* block) {
+    uint32_t fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        free_lists[fl][sl] = block->next;
+        if (block->next == NULL) {
+            sl_bitmap[fl] &= ~(1u << sl);
+            if (sl_bitmap[fl] == 0) {
+                fl_bitmap &= ~(1u << fl);
+            }
+        }
+    }
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+    block->size &= ~BLOCK_FREE;
+    heap_free_bytes -= block_size(block);
+}
+
+// First non-empty list at or above (fl, sl): two find-first-set lookups
+static heap_block_t* free_list_find(uint32_t fl, uint32_t sl) {
+    if (fl >= FL_COUNT) {
+        return NULL;
+    }
+
+    uint32_t sl_map = sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        uint32_t fl_map = fl + 1 < 32 ? fl_bitmap & (~0u << (fl + 1)) : 0;
+        if (fl_map == 0) {
+            return NULL;
+        }
+        fl = (uint32_t)__builtin_ctz(fl_map);
+        sl_map = sl_bitmap[fl];
+    }
+
+    return free_lists[fl][__builtin_ctz(sl_map)];
+}
+
+/*
+ * SPLIT AND MERGE
+ */
+static void block_split(heap_block_t* block, uint32_t size) {
+    uint32_t total = block_size(block);
+
+    if (total < size + HEADER_SIZE + MIN_PAYLOAD) {
+        return; // The rest would be too small to be useful
+    }
+
+    heap_block_t* rest = (heap_block_t*)((uint8_t*)block_payload(block) + size);
+    rest->prev_phys = block;
+    rest->size = total - size - (uint32_t)HEADER_SIZE;
+    block_next_phys(rest)->prev_phys = rest;
+    block->size = size;
+
+    free_list_insert(rest);
+}
+
+// Free a block, absorbing free neighbours so no two free blocks touch
+static void block_release(heap_block_t* block) {
+    heap_block_t* next = block_next_phys(block);
+
+    if (block_is_free(next)) {
+        free_list_remove(next);
+        block->size += (uint32_t)HEADER_SIZE + block_size(next);
+    }
+
+    heap_block_t* prev = block->prev_phys;
+    if (prev != NULL && block_is_free(prev)) {
+        free_list_remove(prev);
+        prev->size += (uint32_t)HEADER_SIZE + block_size(block);
+        block = prev;
+    }
+
+    block_next_phys(block)->prev_phys = block;
+    free_list_insert(block);
+}
+
+/*
+ * OWNERSHIP LISTS
+ */
+static heap_block_t** owner_list(uint32_t owner) {
+    tcb_t* task = owner != 0 ? task_lookup(owner) : NULL;
+    return task != NULL ? &task->heap_blocks : &kernel_blocks;
+}
+
+static void owner_unlink(heap_block_t* block) {
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        *owner_list(block->owner) = block->next;
+    }
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+}
+
+/*
+ * HEAP INITIALIZATION
+ *
+ * The whole heap starts out as one free block, followed by a zero-size
+ * used block that stops merging at the end. rtos_init calls this again
+ * for every run, which discards all earlier allocations.
+ */
+int heap_init(void) {
+    // Populated up front: a page fault in the middle of an allocation
+    // would cost more than the allocation itself
+    if (heap_base == NULL) {
+        void* mapping = mmap(NULL, RTOS_HEAP_SIZE, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (mapping == MAP_FAILED) {
+            return -1;
+        }
+        heap_base = mapping;
+    }
+
+    fl_bitmap = 0;
+    memset(sl_bitmap, 0, sizeof(sl_bitmap));
+    memset(free_lists, 0, sizeof(free_lists));
+    kernel_blocks = NULL;
+    heap_free_bytes = 0;
+
+    heap_block_t* block = (heap_block_t*)heap_base;
+    block->prev_phys = NULL;
+    block->size = (uint32_t)MAX_ALLOC;
+
+    heap_block_t* sentinel = block_next_phys(block);
+    sentinel->prev_phys = block;
+    sentinel->size = 0;
+
+    free_list_insert(block);
+    return 0;
+}
+
+/*
+ * ALLOCATION
+ */
+void* rtos_malloc(size_t size) {
+    if (size == 0 || size > MAX_ALLOC) {
+        return NULL;
+    }
+
+    uint32_t aligned = ((uint32_t)size + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+    uint32_t fl, sl;
+    mapping_search(aligned, &fl, &sl);
+
+    kernel_lock();
+    heap_block_t* block = free_list_find(fl, sl);
+    if (block == NULL) {
+        kernel_unlock();
+        RTOS_LOG("❌ Heap exhausted: no free block of %zu bytes\n", size);
+        return NULL;
+    }
+    free_list_remove(block);
+    block_split(block, aligned);
+
+    // Tag the block with its owner and link it into the owner's list
+    tcb_t* owner = scheduler_running && current_task != NULL &&
+                   !current_task->is_idle ? current_task : NULL;
+    heap_block_t** list = owner != NULL ? &owner->heap_blocks : &kernel_blocks;
+    block->owner = owner != NULL ? owner->task_id : 0;
+    block->prev = NULL;
+    block->next = *list;
+    if (block->next != NULL) {
+        block->next->prev = block;
+    }
+    *list = block;
+    if (owner != NULL) {
+        owner->heap_used += block_size(block);
+    }
+    kernel_unlock();
+
+    return block_payload(block);
+}
+
+void rtos_free(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    heap_block_t* block = payload_block(ptr);
+    if ((uint8_t*)block < heap_base || (uint8_t*)block >= heap_base + RTOS_HEAP_SIZE) {
+        RTOS_LOG("❌ rtos_free: %p is not on the RTOS heap\n", ptr);
+        return;
+    }
+
+    kernel_lock();
+    if (block_is_free(block)) {
+        kernel_unlock();
+        RTOS_LOG("❌ rtos_free: %p freed twice\n", ptr);
+        return;
+    }
+
+    owner_unlink(block);
+    tcb_t* owner = block->owner != 0 ? task_lookup(block->owner) : NULL;
+    if (owner != NULL) {
+        owner->heap_used -= block_size(block);
+    }
+    block_release(block);
+    kernel_unlock();
+}
+
+/*
+ * TASK RECLAIM
+ *
+ * Called by task_delete with the kernel lock held: every block the task
+ * still owns goes back to the heap.
+ */
+void heap_release_task(tcb_t* task) {
+    heap_block_t* block = task->heap_blocks;
+
+    while (block != NULL) {
+        heap_block_t* next = block->next;
+        block_release(block);
+        block = next;
+    }
+
+    task->heap_blocks = NULL;
+    task->heap_used = 0;
+}
+
+size_t get_free_heap_size(void) {
+    return heap_free_bytes;
+}
+
+/*
+ * PARTITION POOLS
+ *
+ * The free blocks form a stack: each one holds the index of the next in
+ * its first four bytes. The head packs the index of the top block (plus
+ * one, so zero means empty) with a counter that changes on every update.
+ * Without the counter a pop could succeed on a stale view (ABA): another
+ * core pops the top block and its successor and pushes the first one
+ * back, so the head looks unchanged but its successor is in use.
+ */
+#define POOL_EMPTY 0u
+
+static inline uint64_t pool_head(uint64_t tag, uint32_t index) {
+    return (tag << 32) | index;
+}
+
+int pool_create(mem_pool_t* pool, uint32_t block_size, uint32_t block_count) {
+    if (pool == NULL || block_count == 0) {
+        return -1;
+    }
+
+    // Every block must hold the next index and stay aligned
+    uint32_t size = block_size < sizeof(uint32_t) ? (uint32_t)sizeof(uint32_t) : block_size;
+    size = (size + sizeof(void*) - 1) & ~(uint32_t)(sizeof(void*) - 1);
+
+    uint8_t* storage = rtos_malloc((size_t)size * block_count);
+    if (storage == NULL) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < block_count; i++) {
+        *(uint32_t*)(storage + (size_t)i * size) = i + 1 < block_count ? i + 2 : POOL_EMPTY;
+    }
+
+    pool->storage = storage;
+    pool->block_size = size;
+    pool->block_count = block_count;
+    pool->head = pool_head(0, 1);
+    pool->available = block_count;
+    return 0;
+}
+
+void pool_destroy(mem_pool_t* pool) {
+    rtos_free(pool->storage);
+    pool->storage = NULL;
+    pool->head = POOL_EMPTY;
+    pool->available = 0;
+}
+
+void* pool_alloc(mem_pool_t* pool) {
+    uint64_t head = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+
+    while (1) {
+        uint32_t index = (uint32_t)head;
+        if (index == POOL_EMPTY) {
+            return NULL;
+        }
+
+        uint8_t* block = pool->storage + (size_t)(index - 1) * pool->block_size;
+        uint32_t next = __atomic_load_n((uint32_t*)block, __ATOMIC_RELAXED);
+
+        if (__atomic_compare_exchange_n(&pool->head, &head, pool_head((head >> 32) + 1, next),
+                                        true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            __atomic_fetch_sub(&pool->available, 1, __ATOMIC_RELAXED);
+            return block;
+        }
+    }
+}
+
+int pool_free(mem_pool_t* pool, void* ptr) {
+    uint8_t* block = ptr;
+    if (block < pool->storage) {
+        return -1;
+    }
+
+    size_t offset = (size_t)(block - pool->storage);
+    if (offset % pool->block_size != 0 || offset / pool->block_size >= pool->block_count) {
+        return -1;
+    }
+
+    uint32_t index = (uint32_t)(offset / pool->block_size) + 1;
+    uint64_t head = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+
+    do {
+        __atomic_store_n((uint32_t*)block, (uint32_t)head, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&pool->head, &head, pool_head((head >> 32) + 1, index),
+                                          true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    __atomic_fetch_add(&pool->available, 1, __ATOMIC_RELAXED);
+    return 0;
+}
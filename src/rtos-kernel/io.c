@@ -0,0 +1,194 @@
+/*
+ * RTOS Asynchronous I/O
+ *
+ * A task that calls read() on an empty socket blocks its core's host
+ * thread, and with it every other task on that core. task_wait_fd lets
+ * the task block in the kernel instead, like a task waiting on a
+ * semaphore, until the descriptor is ready; the task then does the I/O
+ * without blocking. One host thread can so serve thousands of
+ * connections, each handled by straight-line code in its own task.
+ *
+ * THE MULTIPLEXER:
+ * All waits share one epoll instance (port.c). Each registration carries
+ * the waiting task's ID and reports once, so a ready descriptor readies
+ * exactly one task. Nothing is looked at while no task waits for I/O.
+ *
+ * WHO POLLS:
+ * - An idle core sleeps in the multiplexer instead of on its futex word,
+ *   with the same deadline: it wakes for a timeout, for a task readied by
+ *   another core (io_idle_wake), or for I/O, whichever comes first. One
+ *   core at a time sleeps there; the others sleep as usual.
+ * - A busy core looks at the multiplexer without waiting once per tick,
+ *   on the tick path, so I/O is noticed within a tick while tasks keep
+ *   the cores busy and the system call is not paid on every kernel entry.
+ * Either way all events found at once are handed out under one kernel
+ * lock acquisition.
+ */
+
+#define _GNU_SOURCE
+#include "rtos_internal.h"
+#include <poll.h>
+
+#define IO_WAKE_BATCH 64                      // Events handed out per look
+
+static uint32_t io_waiters = 0;               // Tasks blocked in task_wait_fd
+static uint32_t io_polled_tick = 0;           // Tick of the last look from the tick path
+static rtos_core_t* io_sleeper = NULL;        // Idle core sleeping in the multiplexer
+
+/*
+ * WAKING WAITERS
+ */
+static void io_ready_tasks(const port_io_event_t* events, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    kernel_lock();
+    stats.io_polls++;
+    for (uint32_t i = 0; i < count; i++) {
+        tcb_t* task = task_lookup((uint32_t)events[i].token);
+
+        // The wait may have timed out, and the task moved on or gone,
+        // since the descriptor was armed for it
+        if (task == NULL || !task->io_waiting || task->io_ready != 0) {
+            continue;
+        }
+
+        task->io_ready = events[i].events;
+        task_set_wake_time(task, 0);
+        if (task->state == TASK_BLOCKED) {
+            add_task_to_ready_queue(task);
+        }
+        stats.io_wakeups++;
+    }
+    kernel_unlock();
+}
+
+void io_poll(void) {
+    port_io_event_t events[IO_WAKE_BATCH];
+    uint32_t tick = __atomic_load_n(&system_tick_count, __ATOMIC_RELAXED);
+    uint32_t polled = __atomic_load_n(&io_polled_tick, __ATOMIC_RELAXED);
+
+    if (__atomic_load_n(&io_waiters, __ATOMIC_RELAXED) == 0 || polled == tick) {
+        return;
+    }
+
+    // One core per tick
+    if (!__atomic_compare_exchange_n(&io_polled_tick, &polled, tick, false,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    io_ready_tasks(events, port_io_poll(events, IO_WAKE_BATCH, false, 0));
+}
+
+/*
+ * IDLE SLEEP
+ *
+ * The sleeper publishes itself in io_sleeper before its last look at its
+ * wake-up counter; a waker bumps the counter before looking at
+ * io_sleeper. With full barriers on both sides, either the sleeper sees
+ * the new count or the waker sees the sleeper and ends its poll.
+ */
+bool io_idle_wait(rtos_core_t* core, uint32_t seen, uint64_t deadline_ns) {
+    port_io_event_t events[IO_WAKE_BATCH];
+    rtos_core_t* none = NULL;
+
+    if (__atomic_load_n(&io_waiters, __ATOMIC_RELAXED) == 0 ||
+        !__atomic_compare_exchange_n(&io_sleeper, &none, core, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return false;
+    }
+
+    uint32_t count = 0;
+    if (__atomic_load_n(&core->idle_wakeups, __ATOMIC_SEQ_CST) == seen) {
+        count = port_io_poll(events, IO_WAKE_BATCH, true, deadline_ns);
+    }
+    __atomic_store_n(&io_sleeper, NULL, __ATOMIC_RELEASE);
+
+    io_ready_tasks(events, count);
+    return true;
+}
+
+void io_idle_wake(rtos_core_t* core) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&io_sleeper, __ATOMIC_RELAXED) == core) {
+        port_io_wake();
+    }
+}
+
+/*
+ * API
+ */
+int task_wait_fd(int fd, uint32_t events, uint32_t timeout_ms) {
+    tcb_t* self = current_task;
+
+    if (self == NULL || fd < 0 || (events & (IO_READABLE | IO_WRITABLE)) == 0) {
+        return -1;
+    }
+    if (rtos_mode != RTOS_MODE_CONTEXT_SWITCH || this_core()->in_stackless) {
+        RTOS_LOG("❌ task_wait_fd needs a task with a stack in context-switch mode\n");
+        return -1;
+    }
+
+    // Polling needs neither the kernel nor the multiplexer
+    if (timeout_ms == 0) {
+        struct pollfd pfd = { fd, (short)(((events & IO_READABLE) ? POLLIN : 0) |
+                                          ((events & IO_WRITABLE) ? POLLOUT : 0)), 0 };
+        if (poll(&pfd, 1, 0) < 0) {
+            return -1;
+        }
+        return ((pfd.revents & POLLIN) ? IO_READABLE : 0) |
+               ((pfd.revents & POLLOUT) ? IO_WRITABLE : 0) |
+               ((pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) ? IO_ERROR : 0);
+    }
+
+    uint32_t deadline = 0;
+    if (timeout_ms != RTOS_WAIT_FOREVER) {
+        poll_host_clock();
+        deadline = system_tick_count + timeout_ms;
+        deadline = deadline != 0 ? deadline : 1; // 0 would mean "forever"
+    }
+
+    // Armed under the kernel lock: an event found before we are blocked
+    // waits for the lock, then sees io_waiting and readies us
+    kernel_lock();
+    if (port_io_arm(fd, events, self->task_id) != 0) {
+        kernel_unlock();
+        RTOS_LOG("❌ Cannot wait for descriptor %d\n", fd);
+        return -1;
+    }
+    self->io_waiting = true;
+    self->io_fd = fd;
+    self->io_ready = 0;
+    __atomic_fetch_add(&io_waiters, 1, __ATOMIC_RELAXED);
+    task_block_until(deadline);
+
+    kernel_lock();
+    uint32_t ready = self->io_ready;
+    self->io_waiting = false;
+    __atomic_fetch_sub(&io_waiters, 1, __ATOMIC_RELAXED);
+    kernel_unlock();
+
+    // Timed out: the registration is still armed, for nobody
+    if (ready == 0) {
+        port_io_disarm(fd);
+    }
+
+    return (int)ready;
+}
+
+void io_cancel_wait(tcb_t* task) {
+    task->io_waiting = false;
+    __atomic_fetch_sub(&io_waiters, 1, __ATOMIC_RELAXED);
+    port_io_disarm(task->io_fd);
+}
+
+/*
+ * RESET
+ */
+void io_reset(void) {
+    io_waiters = 0;
+    io_polled_tick = 0;
+    io_sleeper = NULL;
+}
@@ -0,0 +1,270 @@
+/*
+ * RTOS Interrupts and Deferred Work
+ *
+ * The host has no device interrupts, so a simulated device (any host
+ * thread) raises IRQ line n by sending the real-time signal SIGRTMIN + n
+ * to the thread running core 0. The handler then interrupts whatever that
+ * thread was doing, just like a hardware interrupt: a task in the middle
+ * of its work, the kernel inside a critical section, or the idle core
+ * asleep.
+ *
+ * TOP HALF AND BOTTOM HALF:
+ * Because the interrupted code may hold the kernel lock or be halfway
+ * through updating a run queue, the handler (the top half) must not take
+ * locks or touch scheduler state. It only records that something happened
+ * by queueing a deferred_work_t. The work item's function (the bottom
+ * half) runs later in the IRQ worker task, a high-priority task that may
+ * block, allocate and call any kernel function.
+ *
+ * DEFERRED-WORK QUEUE:
+ * Work items link through their own next field onto a lock-free stack:
+ * queueing is one compare-and-swap, which stays correct even when a
+ * handler interrupts another queueing on the same thread. The worker takes
+ * the whole stack with one exchange and reverses it into arrival order.
+ * Nothing is allocated; the items belong to the caller, like timers.
+ *
+ * COALESCING:
+ * A work item that is already queued is not queued twice. The event is
+ * only counted, and the bottom half is told how many events it covers, so
+ * a burst of the same interrupt costs one run: a network driver would
+ * drain its receive ring once, however many packets arrived meanwhile.
+ *
+ * WAKING THE WORKER:
+ * Only the kernel may ready a task, so queued work is noticed at the next
+ * kernel entry (poll_host_clock, which every kernel call runs), and a
+ * core asleep in tickless idle is woken to get there at once. Scheduling
+ * is cooperative: a task computing without kernel calls holds the worker
+ * off the way code running with interrupts masked would. bench_irq
+ * measures how long events wait for their bottom half.
+ */
+
+#define _GNU_SOURCE
+#include "rtos_internal.h"
+
+typedef struct {
+    rtos_irq_handler_t handler;               // Top half, NULL if not attached
+    void* param;                              // Passed to the handler
+} irq_line_t;
+
+static irq_line_t irq_lines[RTOS_IRQ_LINES];
+static deferred_work_t* deferred_head = NULL; // Queued work, most recent first
+static tcb_t* irq_worker = NULL;              // Runs the bottom halves
+static bool irq_worker_started = false;       // Set by whoever creates the worker
+static bool irq_worker_idle = false;          // Worker blocked until work is queued
+
+/*
+ * TOP HALF (signal context: atomics only, no locks, no logging)
+ */
+void irq_dispatch(uint32_t irq) {
+    __atomic_fetch_add(&stats.interrupts, 1, __ATOMIC_RELAXED);
+
+    rtos_irq_handler_t handler = __atomic_load_n(&irq_lines[irq].handler, __ATOMIC_ACQUIRE);
+    if (handler != NULL) {
+        handler(irq, irq_lines[irq].param);
+    }
+}
+
+int deferred_work_queue(deferred_work_t* work) {
+    if (work == NULL || work->function == NULL) {
+        return -1;
+    }
+
+    // Count the event, then queue the item unless it is queued already;
+    // the worker clears queued before taking the count, so an event either
+    // queues the item again or is included in the run that follows
+    __atomic_fetch_add(&work->events, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&work->queued, 1, __ATOMIC_SEQ_CST) != 0) {
+        __atomic_fetch_add(&work->coalesced, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats.deferred_coalesced, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    work->raised_ns = port_time_ns();
+    work->next = __atomic_load_n(&deferred_head, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&deferred_head, &work->next, work, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+    }
+
+    idle_kick_interrupt();
+    return 0;
+}
+
+/*
+ * BOTTOM HALVES
+ */
+static void deferred_run(deferred_work_t* work) {
+    uint64_t raised_ns = work->raised_ns;
+
+    // From here on a new event queues the item again
+    __atomic_store_n(&work->queued, 0, __ATOMIC_SEQ_CST);
+    uint32_t events = __atomic_exchange_n(&work->events, 0, __ATOMIC_SEQ_CST);
+    if (events == 0) {
+        return; // Already handled by the run before
+    }
+
+    uint64_t latency_ns = port_time_ns() - raised_ns;
+    work->last_latency_ns = latency_ns;
+    if (latency_ns > work->max_latency_ns) {
+        work->max_latency_ns = latency_ns;
+    }
+    work->runs++;
+    stats.deferred_runs++;
+
+    work->function(work, events);
+}
+
+static void irq_worker_function(void* param) {
+    (void)param;
+
+    while (1) {
+        deferred_work_t* list = __atomic_exchange_n(&deferred_head, NULL, __ATOMIC_ACQUIRE);
+
+        if (list == NULL) {
+            // Announce that we sleep, then look once more: work queued
+            // after that look is seen by deferred_work_poll
+            kernel_lock();
+            __atomic_store_n(&irq_worker_idle, true, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&deferred_head, __ATOMIC_SEQ_CST) != NULL) {
+                irq_worker_idle = false;
+                kernel_unlock();
+                continue;
+            }
+            task_block_until(0);
+            continue;
+        }
+
+        // Most recent first: reverse into arrival order
+        deferred_work_t* fifo = NULL;
+        while (list != NULL) {
+            deferred_work_t* next = list->next;
+            list->next = fifo;
+            fifo = list;
+            list = next;
+        }
+
+        while (fifo != NULL) {
+            // Read next first: once run, the item may be queued again
+            deferred_work_t* next = fifo->next;
+            deferred_run(fifo);
+            fifo = next;
+        }
+    }
+}
+
+/*
+ * KERNEL ENTRY
+ */
+bool deferred_work_pending(void) {
+    return __atomic_load_n(&irq_worker_idle, __ATOMIC_SEQ_CST) &&
+           __atomic_load_n(&deferred_head, __ATOMIC_SEQ_CST) != NULL;
+}
+
+void deferred_work_poll(void) {
+    if (!deferred_work_pending()) {
+        return;
+    }
+
+    kernel_lock();
+    if (irq_worker_idle && irq_worker->state == TASK_BLOCKED) {
+        irq_worker_idle = false;
+        add_task_to_ready_queue(irq_worker);
+    }
+    kernel_unlock();
+}
+
+/*
+ * API
+ */
+int rtos_irq_attach(uint32_t irq, rtos_irq_handler_t handler, void* param) {
+    if (irq >= RTOS_IRQ_LINES || handler == NULL) {
+        return -1;
+    }
+    if (rtos_mode != RTOS_MODE_CONTEXT_SWITCH) {
+        RTOS_LOG("❌ Interrupts need context-switch mode to run bottom halves\n");
+        return -1;
+    }
+
+    irq_lines[irq].param = param;
+    __atomic_store_n(&irq_lines[irq].handler, handler, __ATOMIC_RELEASE);
+    if (port_irq_install(irq) != 0) {
+        __atomic_store_n(&irq_lines[irq].handler, NULL, __ATOMIC_RELEASE);
+        return -1;
+    }
+
+    RTOS_LOG("⚡ IRQ %u attached\n", irq);
+    return 0;
+}
+
+int rtos_irq_detach(uint32_t irq) {
+    if (irq >= RTOS_IRQ_LINES) {
+        return -1;
+    }
+
+    // The signal stays installed; with no handler it is only counted
+    __atomic_store_n(&irq_lines[irq].handler, NULL, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int rtos_irq_raise(uint32_t irq) {
+    if (irq >= RTOS_IRQ_LINES) {
+        return -1;
+    }
+
+    return port_irq_raise(irq);
+}
+
+int deferred_work_init(deferred_work_t* work, deferred_work_fn_t function, void* param) {
+    if (work == NULL || function == NULL) {
+        return -1;
+    }
+    if (rtos_mode != RTOS_MODE_CONTEXT_SWITCH) {
+        RTOS_LOG("❌ Deferred work needs context-switch mode to run\n");
+        return -1;
+    }
+
+    work->next = NULL;
+    work->function = function;
+    work->param = param;
+    work->queued = 0;
+    work->events = 0;
+    work->raised_ns = 0;
+    work->runs = 0;
+    work->coalesced = 0;
+    work->last_latency_ns = 0;
+    work->max_latency_ns = 0;
+
+    kernel_lock();
+    bool need_task = !irq_worker_started;
+    irq_worker_started = true;
+    kernel_unlock();
+
+    if (need_task) {
+        uint32_t task_id = task_create("IRQ", irq_worker_function, NULL,
+                                       IRQ_WORKER_PRIORITY, 0);
+        kernel_lock();
+        if (task_id == 0) {
+            irq_worker_started = false;
+            kernel_unlock();
+            work->function = NULL;
+            return -1;
+        }
+        irq_worker = task_lookup(task_id);
+        kernel_unlock();
+    }
+
+    return 0;
+}
+
+/*
+ * RESET (called by rtos_init, which deletes the worker with every other task)
+ */
+void irq_reset(void) {
+    for (uint32_t irq = 0; irq < RTOS_IRQ_LINES; irq++) {
+        __atomic_store_n(&irq_lines[irq].handler, NULL, __ATOMIC_RELEASE);
+        irq_lines[irq].param = NULL;
+    }
+    __atomic_store_n(&deferred_head, NULL, __ATOMIC_RELEASE);
+    irq_worker = NULL;
+    irq_worker_started = false;
+    irq_worker_idle = false;
+}
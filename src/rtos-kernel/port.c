@@ -0,0 +1,535 @@
+/*
+ * RTOS Host Port - Real Context Switching
+ *
+ * In RTOS_MODE_CONTEXT_SWITCH every task really runs on its own stack.
+ * On an ARM Cortex-M the PendSV handler pushes R4-R11 onto the outgoing
+ * task's stack and pops the incoming task's registers from its stack; on
+ * the host we get the same effect with ucontext. Each task's saved context
+ * lives at the top of its own stack (just like a hardware exception frame)
+ * and swapcontext() saves one context and restores the other.
+ *
+ * Scheduling stays cooperative: a task can only be switched out inside a
+ * kernel call (yield, sleep, blocking on a mutex, ...). Those calls are
+ * the preemption points, and they also advance the tick count from the
+ * host's monotonic clock.
+ *
+ * SMP:
+ * Each core is a host thread pinned to one CPU, and a thread-local
+ * pointer says which core the thread runs. Tasks move freely between
+ * threads, because a ucontext can be resumed on any of them. The one
+ * hazard is resuming a task whose registers another core is still saving:
+ * on_cpu stays set from the moment a task is switched in until the core
+ * that switches it out has left its stack. A preempted task is only put
+ * back on a run queue after that point, and a blocked one is only woken
+ * after it, so any task a core finds on a run queue can be switched to
+ * at once and two cores can never end up waiting for each other.
+ *
+ * STACKLESS TASKS:
+ * Each core has one runner context with its own stack, a loop that calls
+ * the current stackless task's function and switches when it returns.
+ * Going from one stackless task to another needs no register switch at
+ * all: the runner simply calls the next function. Only switches between
+ * a stackless task and one with a stack go through swapcontext, saving
+ * or resuming the runner. A stackless function never switches from
+ * inside (stackless_run), so the runner is always parked between calls.
+ */
+
+#define _GNU_SOURCE
+#include "rtos_internal.h"
+#include <errno.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+static ucontext_t kernel_contexts[RTOS_MAX_CORES]; // Per-core context of the host thread
+static __thread rtos_core_t* bound_core = NULL;    // Core run by this host thread
+static rtos_core_t foreign_core;                   // Seen by threads outside the kernel
+static pid_t main_thread_tid = 0;                  // Thread that called rtos_init
+static pid_t irq_thread_tid = 0;                   // Thread taking interrupts (core 0's)
+
+#define RUNNER_STACK_SIZE (64 * 1024)             // Stack stackless tasks run on, per core
+
+static ucontext_t runner_contexts[RTOS_MAX_CORES]; // Per-core runner of stackless tasks
+static uint8_t* runner_stacks[RTOS_MAX_CORES];     // Their stacks, kept across runs
+static bool runner_ready[RTOS_MAX_CORES];          // Context made for this run
+
+#define IO_POLL_BATCH 64                          // Events taken per epoll call
+
+static int io_epoll_fd = -1;                      // Watches the descriptors tasks wait on
+static int io_wake_fd = -1;                       // eventfd that ends a sleeping poll
+
+/*
+ * CORE LOOKUP
+ */
+__attribute__((noinline)) rtos_core_t* this_core(void) {
+    rtos_core_t* core = bound_core;
+
+    // Keep the compiler from treating this as a pure function whose
+    // result may be reused across a context switch
+    __asm__ __volatile__("" ::: "memory");
+
+    return core != NULL ? core : &foreign_core;
+}
+
+void port_relax(uint32_t* spins) {
+    if (++*spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        sched_yield();
+    }
+}
+
+/*
+ * TASK ENTRY
+ *
+ * First code a task runs on its new stack. Returning from the task
+ * function deletes the task, which switches away for good.
+ */
+static void port_task_entry(void) {
+    port_finish_switch();
+
+    tcb_t* self = current_task;
+    self->task_function(self->task_parameter);
+
+    task_delete(self->task_id);
+}
+
+int port_init_task(tcb_t* task) {
+    // Carve the saved context out of the top of the stack, 64-byte aligned
+    // for the FPU save area, and give the rest to the task
+    uintptr_t top = (uintptr_t)(task->stack_base + task->stack_size);
+    ucontext_t* context = (ucontext_t*)((top - sizeof(ucontext_t)) & ~(uintptr_t)63);
+
+    if (getcontext(context) != 0) {
+        return -1;
+    }
+
+    context->uc_stack.ss_sp = task->stack_base;
+    context->uc_stack.ss_size = (size_t)((uint8_t*)context - task->stack_base);
+    context->uc_link = NULL;
+    makecontext(context, port_task_entry, 0);
+
+    task->host_context = context;
+    task->stack_pointer = (uint32_t*)context;
+
+    return 0;
+}
+
+/*
+ * STACKLESS RUNNER
+ */
+static void port_runner_entry(void) {
+    while (1) {
+        port_finish_switch();
+        stackless_run();
+    }
+}
+
+int port_init_stackless(void) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+    for (uint32_t i = 0; i < core_count; i++) {
+        if (runner_stacks[i] == NULL) {
+            // Guard page below, like task stacks
+            void* region = mmap(NULL, RUNNER_STACK_SIZE + page, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (region == MAP_FAILED) {
+                return -1;
+            }
+            mprotect(region, page, PROT_NONE);
+            runner_stacks[i] = (uint8_t*)region + page;
+        }
+
+        if (!runner_ready[i]) {
+            if (getcontext(&runner_contexts[i]) != 0) {
+                return -1;
+            }
+            runner_contexts[i].uc_stack.ss_sp = runner_stacks[i];
+            runner_contexts[i].uc_stack.ss_size = RUNNER_STACK_SIZE;
+            runner_contexts[i].uc_link = NULL;
+            makecontext(&runner_contexts[i], port_runner_entry, 0);
+            runner_ready[i] = true;
+        }
+    }
+
+    return 0;
+}
+
+// Where a task's registers live: its own stack, or its core's runner
+static ucontext_t* task_context(rtos_core_t* core, tcb_t* task) {
+    return task->pt_function != NULL ? &runner_contexts[core->id] : task->host_context;
+}
+
+void port_switch(tcb_t* from, tcb_t* to) {
+    rtos_core_t* core = this_core();
+
+    to->on_cpu = true;
+
+    if (from == NULL) {
+        // Starting the scheduler: park the host thread running this core
+        swapcontext(&kernel_contexts[core->id], task_context(core, to));
+    } else if (from->pt_function != NULL) {
+        // Leaving a stackless task: we are on the runner, between calls
+        if (from->state == TASK_TERMINATED) {
+            core->exited_task = from;
+        } else {
+            core->switch_prev = from;
+        }
+        if (to->pt_function == NULL) {
+            swapcontext(&runner_contexts[core->id], to->host_context);
+        }
+    } else if (from->state == TASK_TERMINATED) {
+        // A deleted task never resumes; free it once we are off its stack
+        core->exited_task = from;
+        setcontext(task_context(core, to));
+    } else {
+        core->switch_prev = from;
+        swapcontext(from->host_context, task_context(core, to));
+    }
+
+    // We may be back on a different core than the one we left
+    port_finish_switch();
+}
+
+void port_finish_switch(void) {
+    rtos_core_t* core = this_core();
+    tcb_t* prev = core->switch_prev;
+
+    // The outgoing task's registers are saved: other cores may resume it,
+    // and if it was preempted rather than blocked it can be queued again
+    if (prev != NULL) {
+        bool requeue = prev->state == TASK_READY;
+        core->switch_prev = NULL;
+        __atomic_store_n(&prev->on_cpu, false, __ATOMIC_RELEASE);
+        if (requeue) {
+            add_task_to_ready_queue(prev);
+        }
+        if (__atomic_load_n(&prev->delete_requested, __ATOMIC_ACQUIRE)) {
+            task_delete_switched_out(prev); // Deleted while it ran here
+        }
+    }
+
+    if (core->exited_task != NULL && core->exited_task != core->current) {
+        tcb_t* exited = core->exited_task;
+        core->exited_task = NULL;
+        task_reclaim(exited);
+    }
+}
+
+void port_exit_to_kernel(tcb_t* from) {
+    rtos_core_t* core = this_core();
+    swapcontext(task_context(core, from), &kernel_contexts[core->id]);
+}
+
+/*
+ * Linux lets a sleeping thread's timer fire up to 50 us late by default,
+ * so it can be batched with other wake-ups. A kernel thread that sleeps
+ * until the next tick or wake-up is due must not be that sloppy.
+ */
+static void port_tighten_timers(void) {
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+}
+
+void port_reset(void) {
+    // Registrations belong to tasks of the previous run
+    if (io_epoll_fd >= 0) {
+        close(io_epoll_fd);
+        close(io_wake_fd);
+        io_epoll_fd = io_wake_fd = -1;
+    }
+
+    bound_core = &cores[0];
+    port_tighten_timers();
+    memset(runner_ready, 0, sizeof(runner_ready));
+    main_thread_tid = (pid_t)syscall(SYS_gettid);
+    __atomic_store_n(&irq_thread_tid, main_thread_tid, __ATOMIC_RELEASE);
+}
+
+void port_idle(void) {
+    sched_yield();
+}
+
+/*
+ * IDLE SLEEP
+ *
+ * A futex is the host's wait-for-interrupt: the idle core sleeps on its
+ * word until the timeout or until someone changes the word and wakes it.
+ * If the word already moved on since the caller read it, the wake-up came
+ * first and the wait returns at once, so none can be lost.
+ */
+void port_idle_wait(uint32_t* word, uint32_t seen, uint64_t deadline_ns) {
+    struct timespec ts = {
+        .tv_sec = (time_t)(deadline_ns / 1000000000ull),
+        .tv_nsec = (long)(deadline_ns % 1000000000ull),
+    };
+
+    // FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC timeout
+    syscall(SYS_futex, word, FUTEX_WAIT_BITSET_PRIVATE, seen,
+            deadline_ns != 0 ? &ts : NULL, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+void port_idle_wake(uint32_t* word) {
+    __atomic_fetch_add(word, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/*
+ * HOST I/O MULTIPLEXER
+ *
+ * One epoll instance watches every descriptor a task waits on. Each
+ * registration is one-shot: it reports once, then stays in the set
+ * disarmed until the next wait arms it again, so an event wakes at most
+ * one wait and waiting on the same descriptor again costs one epoll_ctl.
+ * An eventfd in the set (token 0) ends a sleeping poll the way changing
+ * the futex word ends port_idle_wait.
+ */
+static int port_io_open(void) {
+    if (io_epoll_fd >= 0) {
+        return 0;
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event wake = { .events = EPOLLIN, .data.u64 = 0 };
+
+    if (epoll_fd < 0 || wake_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &wake) != 0) {
+        if (epoll_fd >= 0) {
+            close(epoll_fd);
+        }
+        if (wake_fd >= 0) {
+            close(wake_fd);
+        }
+        return -1;
+    }
+
+    io_wake_fd = wake_fd;
+    __atomic_store_n(&io_epoll_fd, epoll_fd, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int port_io_arm(int fd, uint32_t events, uint64_t token) {
+    if (port_io_open() != 0) {
+        return -1;
+    }
+
+    struct epoll_event event = {
+        .events = EPOLLONESHOT | ((events & IO_READABLE) ? EPOLLIN : 0) |
+                  ((events & IO_WRITABLE) ? EPOLLOUT : 0),
+        .data.u64 = token,
+    };
+
+    // Most waits are on a descriptor that was waited on before
+    if (epoll_ctl(io_epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0) {
+        return 0;
+    }
+    if (errno == ENOENT && epoll_ctl(io_epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0) {
+        return 0;
+    }
+    return -1;
+}
+
+void port_io_disarm(int fd) {
+    if (io_epoll_fd >= 0) {
+        epoll_ctl(io_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    }
+}
+
+uint32_t port_io_poll(port_io_event_t* out, uint32_t max, bool block, uint64_t deadline_ns) {
+    int epoll_fd = __atomic_load_n(&io_epoll_fd, __ATOMIC_ACQUIRE);
+    struct epoll_event events[IO_POLL_BATCH];
+    struct timespec timeout = { 0, 0 };
+    int count;
+
+    if (epoll_fd < 0) {
+        return 0;
+    }
+    if (max > IO_POLL_BATCH) {
+        max = IO_POLL_BATCH;
+    }
+
+    if (block && deadline_ns != 0) {
+        uint64_t now_ns = port_time_ns();
+        uint64_t left_ns = deadline_ns > now_ns ? deadline_ns - now_ns : 0;
+        timeout.tv_sec = (time_t)(left_ns / 1000000000ull);
+        timeout.tv_nsec = (long)(left_ns % 1000000000ull);
+    }
+
+    // epoll_pwait2 takes the timeout in nanoseconds, epoll_wait only in
+    // whole milliseconds (rounded down: early is better than late)
+    count = epoll_pwait2(epoll_fd, events, (int)max,
+                         block && deadline_ns == 0 ? NULL : &timeout, NULL);
+    if (count < 0 && errno == ENOSYS) {
+        int timeout_ms = block && deadline_ns == 0 ? -1 :
+                         (int)(timeout.tv_sec * 1000 + timeout.tv_nsec / 1000000);
+        count = epoll_wait(epoll_fd, events, (int)max, timeout_ms);
+    }
+
+    uint32_t stored = 0;
+    for (int i = 0; i < count; i++) {
+        if (events[i].data.u64 == 0) {
+            uint64_t value;
+            if (read(io_wake_fd, &value, sizeof(value)) < 0) {
+                // Already drained by the poll before
+            }
+            continue;
+        }
+
+        uint32_t ready = 0;
+        if (events[i].events & EPOLLIN) {
+            ready |= IO_READABLE;
+        }
+        if (events[i].events & EPOLLOUT) {
+            ready |= IO_WRITABLE;
+        }
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            ready |= IO_ERROR;
+        }
+        out[stored].token = events[i].data.u64;
+        out[stored].events = ready;
+        stored++;
+    }
+
+    return stored;
+}
+
+void port_io_wake(void) {
+    int wake_fd = __atomic_load_n(&io_wake_fd, __ATOMIC_ACQUIRE);
+    uint64_t one = 1;
+
+    if (wake_fd >= 0 && write(wake_fd, &one, sizeof(one)) < 0) {
+        // The counter is already non-zero: the poll will end anyway
+    }
+}
+
+/*
+ * SIMULATED INTERRUPTS
+ *
+ * IRQ line n is the real-time signal SIGRTMIN + n, sent to one thread with
+ * tgkill. Real-time signals queue instead of merging, so every raise runs
+ * the handler once. SA_RESTART keeps interrupted system calls going, and
+ * an idle core's futex sleep ends because the handler's wake-up changes
+ * the futex word.
+ */
+static void port_irq_entry(int signo) {
+    int saved_errno = errno;
+    irq_dispatch((uint32_t)(signo - SIGRTMIN));
+    errno = saved_errno;
+}
+
+int port_irq_install(uint32_t irq) {
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = port_irq_entry;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    return sigaction(SIGRTMIN + (int)irq, &action, NULL) == 0 ? 0 : -1;
+}
+
+int port_irq_raise(uint32_t irq) {
+    pid_t tid = __atomic_load_n(&irq_thread_tid, __ATOMIC_ACQUIRE);
+
+    return syscall(SYS_tgkill, getpid(), tid, SIGRTMIN + (int)irq) == 0 ? 0 : -1;
+}
+
+/*
+ * CORE THREADS
+ *
+ * One host thread per core, pinned to a host CPU (wrapping around when
+ * there are more cores than CPUs). rtos_start waits for all of them.
+ */
+static void* port_core_thread(void* param) {
+    bound_core = param;
+    port_tighten_timers();
+    
+    // Interrupts go to core 0 while it runs, to the main thread otherwise
+    bool takes_irqs = bound_core->id == 0;
+    if (takes_irqs) {
+        __atomic_store_n(&irq_thread_tid, (pid_t)syscall(SYS_gettid), __ATOMIC_RELEASE);
+    }
+    scheduler_run_core();
+    if (takes_irqs) {
+        __atomic_store_n(&irq_thread_tid, main_thread_tid, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+void port_run_cores(uint32_t count) {
+    pthread_t threads[RTOS_MAX_CORES];
+    long host_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (host_cpus < 1) {
+        host_cpus = 1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        pthread_attr_t attr;
+        cpu_set_t cpus;
+
+        pthread_attr_init(&attr);
+        CPU_ZERO(&cpus);
+        CPU_SET(i % host_cpus, &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+
+        if (pthread_create(&threads[i], &attr, port_core_thread, &cores[i]) != 0) {
+            RTOS_LOG("❌ Failed to start core %u\n", i);
+            count = i;
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+uint64_t port_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void port_sleep_until(uint64_t deadline_ns) {
+    struct timespec ts = {
+        .tv_sec = (time_t)(deadline_ns / 1000000000ull),
+        .tv_nsec = (long)(deadline_ns % 1000000000ull),
+    };
+
+    // Absolute: oversleeping one tick does not push back the next
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+uint64_t port_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return port_time_ns();
+#endif
+}
+
+double port_ns_per_cycle(void) {
+    static double ns_per_cycle = 0;
+
+    if (ns_per_cycle == 0) {
+        uint64_t start_ns = port_time_ns();
+        uint64_t start_cycles = port_cycles();
+        port_sleep_until(start_ns + 2000000u);
+        ns_per_cycle = (double)(port_time_ns() - start_ns) /
+                       (double)(port_cycles() - start_cycles);
+    }
+
+    return ns_per_cycle;
+}
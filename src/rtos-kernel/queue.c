@@ -0,0 +1,304 @@
+/*
+ * RTOS Message Queues
+ *
+ * Fixed-capacity ring buffers with free-running 32-bit indices: a slot is
+ * index & (capacity - 1), and the queue holds tail - head messages. Both
+ * flavours are lock-free, so tasks on different cores (or interrupt-style
+ * code) can use them without entering the kernel.
+ *
+ * SPSC:
+ * The sender is the only writer of tail and the receiver the only writer
+ * of head, so plain loads and stores with acquire/release ordering are
+ * enough. Each side also caches the other side's index and only re-reads
+ * it when the queue looks full (or empty), which keeps the two cache
+ * lines from bouncing on every message.
+ *
+ * MPMC (Dmitry Vyukov's bounded queue):
+ * Every cell has a sequence number saying whose turn it is. A sender may
+ * fill cell i when sequence == tail and claims it by advancing tail with
+ * a compare-and-swap; it then publishes the cell by setting sequence to
+ * tail + 1. A receiver may drain it when sequence == head + 1 and then
+ * recycles it for the next lap by setting sequence to head + capacity.
+ *
+ * BLOCKING:
+ * queue_send/queue_receive only fall back to the scheduler when the ring
+ * is full or empty. The opposite side checks for waiters after every
+ * successful operation and wakes the best one directly.
+ *
+ * On SMP the two sides can race: a receiver finds the ring empty, and
+ * before it is queued as a waiter a sender on another core fills the
+ * ring and sees nobody to wake. So a blocking task first queues itself,
+ * then looks at the ring once more, while the other side first updates
+ * the ring, then looks for waiters. With a full fence between the two
+ * steps on each side, at least one of them sees the other.
+ */
+
+#include "rtos_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+static inline uint8_t* queue_slot(msg_queue_t* queue, uint32_t index) {
+    return queue->items + (size_t)(index & (queue->capacity - 1)) * queue->item_size;
+}
+
+// Wake the best task waiting on the other side of the queue, if any
+static void queue_wake_one(tcb_t** waiters) {
+    if (core_count > 1) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+    if (__atomic_load_n(waiters, __ATOMIC_RELAXED) == NULL) {
+        return;
+    }
+
+    kernel_lock();
+    tcb_t* waiter = *waiters;
+    if (waiter != NULL) {
+        task_unblock(waiter);
+    }
+    kernel_unlock();
+
+    if (waiter != NULL) {
+        scheduler_reschedule();
+    }
+}
+
+// Would an operation on this side of the queue succeed now?
+static bool queue_can_proceed(msg_queue_t* queue, bool sending) {
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+    return sending ? tail - head < queue->capacity : tail != head;
+}
+
+// Block the current task until the other side makes progress. Returns
+// false if it is a stackless task, which is only marked blocked: it must
+// return to its runner and call again once woken (PT_QUEUE_*).
+static bool queue_wait(msg_queue_t* queue, tcb_t** waiters, bool sending) {
+    tcb_t* self = current_task;
+    bool stackless = this_core()->in_stackless;
+
+    kernel_lock();
+    wait_queue_insert(waiters, self);
+    self->state = TASK_BLOCKED;
+
+    if (core_count > 1) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (queue_can_proceed(queue, sending)) {
+            // The other side got there first: retry instead of sleeping
+            wait_queue_remove(self);
+            self->state = TASK_RUNNING;
+            kernel_unlock();
+            return true;
+        }
+    }
+
+    task_block_current();
+    return !stackless;
+}
+
+/*
+ * QUEUE CREATION
+ */
+int queue_create(msg_queue_t* queue, queue_kind_t kind,
+                 uint32_t capacity, uint32_t item_size) {
+    if (capacity == 0 || capacity > (1u << 30)) {
+        return -1;
+    }
+
+    memset(queue, 0, sizeof(*queue));
+
+    // Round up to a power of two so slots are found with a mask
+    uint32_t rounded = 2;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+
+    queue->kind = kind;
+    queue->capacity = rounded;
+    queue->item_size = item_size == QUEUE_POINTER_ITEMS ? sizeof(void*) : item_size;
+
+    queue->items = malloc((size_t)queue->capacity * queue->item_size);
+    if (queue->items == NULL) {
+        return -1;
+    }
+
+    if (kind == QUEUE_MPMC) {
+        queue->sequence = malloc(queue->capacity * sizeof(uint32_t));
+        if (queue->sequence == NULL) {
+            free(queue->items);
+            queue->items = NULL;
+            return -1;
+        }
+        for (uint32_t i = 0; i < queue->capacity; i++) {
+            queue->sequence[i] = i;
+        }
+    }
+
+    return 0;
+}
+
+void queue_destroy(msg_queue_t* queue) {
+    free(queue->items);
+    free(queue->sequence);
+    queue->items = NULL;
+    queue->sequence = NULL;
+}
+
+/*
+ * SPSC RING
+ */
+static int spsc_send(msg_queue_t* queue, const void* item) {
+    uint32_t tail = queue->tail;
+
+    if (tail - queue->cached_head == queue->capacity) {
+        queue->cached_head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+        if (tail - queue->cached_head == queue->capacity) {
+            return -1;
+        }
+    }
+
+    memcpy(queue_slot(queue, tail), item, queue->item_size);
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+static int spsc_receive(msg_queue_t* queue, void* item) {
+    uint32_t head = queue->head;
+
+    if (head == queue->cached_tail) {
+        queue->cached_tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+        if (head == queue->cached_tail) {
+            return -1;
+        }
+    }
+
+    memcpy(item, queue_slot(queue, head), queue->item_size);
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/*
+ * MPMC RING
+ */
+static int mpmc_send(msg_queue_t* queue, const void* item) {
+    uint32_t mask = queue->capacity - 1;
+    uint32_t pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+
+    while (1) {
+        uint32_t seq = __atomic_load_n(&queue->sequence[pos & mask], __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(seq - pos);
+
+        if (diff == 0) {
+            // Cell is free for this lap: try to claim it
+            if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return -1;  // Cell still holds last lap's message: full
+        } else {
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(queue_slot(queue, pos), item, queue->item_size);
+    __atomic_store_n(&queue->sequence[pos & mask], pos + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+static int mpmc_receive(msg_queue_t* queue, void* item) {
+    uint32_t mask = queue->capacity - 1;
+    uint32_t pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+
+    while (1) {
+        uint32_t seq = __atomic_load_n(&queue->sequence[pos & mask], __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(seq - (pos + 1));
+
+        if (diff == 0) {
+            // Cell holds a published message: try to claim it
+            if (__atomic_compare_exchange_n(&queue->head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return -1;  // Nothing published yet: empty
+        } else {
+            pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(item, queue_slot(queue, pos), queue->item_size);
+    __atomic_store_n(&queue->sequence[pos & mask], pos + mask + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/*
+ * NON-BLOCKING API
+ */
+int queue_try_send(msg_queue_t* queue, const void* item) {
+    int result = queue->kind == QUEUE_SPSC ? spsc_send(queue, item)
+                                           : mpmc_send(queue, item);
+    if (result == 0) {
+        queue_wake_one(&queue->waiting_receivers);
+    }
+    return result;
+}
+
+int queue_try_receive(msg_queue_t* queue, void* item) {
+    int result = queue->kind == QUEUE_SPSC ? spsc_receive(queue, item)
+                                           : mpmc_receive(queue, item);
+    if (result == 0) {
+        queue_wake_one(&queue->waiting_senders);
+    }
+    return result;
+}
+
+/*
+ * BLOCKING API
+ *
+ * Blocking needs a task that can really be suspended, so in simulated
+ * mode a full or empty queue fails instead of waiting. A stackless task
+ * is left blocked and gets QUEUE_WOULD_BLOCK, and PT_QUEUE_SEND/RECEIVE
+ * try again once the other side wakes it.
+ */
+int queue_send(msg_queue_t* queue, const void* item) {
+    while (queue_try_send(queue, item) != 0) {
+        if (current_task == NULL || rtos_mode != RTOS_MODE_CONTEXT_SWITCH) {
+            return -1;
+        }
+        if (!queue_wait(queue, &queue->waiting_senders, true)) {
+            return QUEUE_WOULD_BLOCK;
+        }
+    }
+    return 0;
+}
+
+int queue_receive(msg_queue_t* queue, void* item) {
+    while (queue_try_receive(queue, item) != 0) {
+        if (current_task == NULL || rtos_mode != RTOS_MODE_CONTEXT_SWITCH) {
+            return -1;
+        }
+        if (!queue_wait(queue, &queue->waiting_receivers, false)) {
+            return QUEUE_WOULD_BLOCK;
+        }
+    }
+    return 0;
+}
+
+int queue_send_ptr(msg_queue_t* queue, void* payload) {
+    if (queue->item_size != sizeof(void*)) {
+        return -1;
+    }
+    return queue_send(queue, &payload);
+}
+
+int queue_receive_ptr(msg_queue_t* queue, void** payload) {
+    if (queue->item_size != sizeof(void*)) {
+        return -1;
+    }
+    return queue_receive(queue, payload);
+}
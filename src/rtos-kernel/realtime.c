@@ -0,0 +1,323 @@
+/*
+ * RTOS Periodic Tasks
+ *
+ * Control loops do not just want to run often; each activation (a "job")
+ * must finish before a deadline. A periodic task is described by:
+ *
+ *   period   - a new job is released every period ticks
+ *   WCET     - the longest one job can take (worst-case execution time)
+ *   deadline - how long after its release a job must be finished
+ *
+ * ADMISSION CONTROL:
+ * A task set is only schedulable if the CPU is not promised more time than
+ * it has. Each task needs WCET/deadline of a core (its density), so a new
+ * task is only admitted if the core's total density stays under the bound
+ * of the active policy:
+ *
+ *   EDF: total <= 1. Earliest-deadline-first is optimal on one core: if any
+ *        schedule meets every deadline, EDF does too.
+ *   RM:  total <= n * (2^(1/n) - 1) for n tasks (Liu & Layland, 1973).
+ *        With fixed priorities some CPU time can be stranded, so the bound
+ *        falls from 100% for one task to ln 2 (about 69%) for many.
+ *
+ * Both tests trust the declared WCET: a job that runs longer than it said
+ * it would can still make other jobs late. That is what the deadline-miss
+ * counters are for.
+ *
+ * SMP:
+ * Periodic tasks are partitioned: each is admitted to the first core with
+ * room for it (first fit) and pinned there, so every core runs the
+ * single-core test on its own task set and is never disturbed by stealing.
+ *
+ * DEADLINE MONITOR:
+ * Jobs that are still unfinished at their deadline are found from a
+ * min-heap of the periodic tasks ordered by absolute deadline, whatever
+ * state they are in, so the tick only ever looks at its root. The run
+ * queues' deadline heaps cannot serve: they only hold ready jobs, and
+ * under RM they are ordered by relative deadline.
+ */
+
+#define _GNU_SOURCE
+#include "rtos_internal.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define PPM 1000000u                          // Utilisation fixed point: 1.0
+
+static tcb_t** monitor_heap = NULL;           // Unflagged jobs, earliest deadline first
+static uint32_t monitor_size = 0;             // Tasks in monitor_heap
+static uint32_t monitor_capacity = 0;         // Slots in monitor_heap
+
+/*
+ * UTILISATION HELPERS
+ */
+static uint32_t task_density(uint32_t wcet, uint32_t deadline) {
+    return (uint32_t)(((uint64_t)wcet * PPM + deadline - 1) / deadline);
+}
+
+static uint32_t rm_bound(uint32_t tasks) {
+    return (uint32_t)(tasks * (pow(2.0, 1.0 / tasks) - 1.0) * PPM);
+}
+
+static bool core_admits(const rtos_core_t* core, uint32_t density) {
+    uint64_t total = (uint64_t)core->rt_utilization + density;
+
+    if (sched_policy == SCHED_EDF) {
+        return total <= PPM;
+    }
+    return total <= rm_bound(core->rt_tasks + 1);
+}
+
+/*
+ * DEADLINE MONITOR HEAP
+ *
+ * The same binary min-heap as the timer and run-queue heaps. A task
+ * leaves it once its job has been counted as a miss, and returns with
+ * its next job.
+ */
+static inline bool monitor_before(const tcb_t* a, const tcb_t* b) {
+    return (int32_t)(a->absolute_deadline - b->absolute_deadline) < 0;
+}
+
+static inline void monitor_place(uint32_t index, tcb_t* task) {
+    monitor_heap[index] = task;
+    task->monitor_index = index;
+}
+
+static void monitor_sift_up(uint32_t index) {
+    tcb_t* task = monitor_heap[index];
+
+    while (index > 0) {
+        uint32_t parent = (index - 1) / 2;
+        if (!monitor_before(task, monitor_heap[parent])) {
+            break;
+        }
+        monitor_place(index, monitor_heap[parent]);
+        index = parent;
+    }
+    monitor_place(index, task);
+}
+
+static void monitor_sift_down(uint32_t index) {
+    tcb_t* task = monitor_heap[index];
+
+    while (1) {
+        uint32_t child = 2 * index + 1;
+        if (child >= monitor_size) {
+            break;
+        }
+        if (child + 1 < monitor_size && monitor_before(monitor_heap[child + 1], monitor_heap[child])) {
+            child++;
+        }
+        if (!monitor_before(monitor_heap[child], task)) {
+            break;
+        }
+        monitor_place(index, monitor_heap[child]);
+        index = child;
+    }
+    monitor_place(index, task);
+}
+
+static void monitor_push(tcb_t* task) {
+    // Capacity was reserved when the task was admitted
+    monitor_heap[monitor_size++] = task;
+    monitor_sift_up(monitor_size - 1);
+}
+
+static void monitor_remove(tcb_t* task) {
+    uint32_t index = task->monitor_index;
+    tcb_t* last = monitor_heap[--monitor_size];
+
+    task->monitor_index = REALTIME_UNMONITORED;
+    if (last == task) {
+        return;
+    }
+
+    monitor_place(index, last);
+    monitor_sift_up(index);
+    if (monitor_heap[index] == last) {
+        monitor_sift_down(index);
+    }
+}
+
+static int monitor_reserve(uint32_t tasks) {
+    if (tasks <= monitor_capacity) {
+        return 0;
+    }
+
+    uint32_t capacity = monitor_capacity ? monitor_capacity * 2 : 8;
+    while (capacity < tasks) {
+        capacity *= 2;
+    }
+
+    tcb_t** grown = realloc(monitor_heap, capacity * sizeof(tcb_t*));
+    if (grown == NULL) {
+        return -1;
+    }
+    monitor_heap = grown;
+    monitor_capacity = capacity;
+    return 0;
+}
+
+static void count_deadline_miss(tcb_t* task) {
+    task->deadline_misses++;
+    task->job_missed = true;
+    stats.deadline_misses++;
+    RTOS_LOG("⏱️  Task %s missed its deadline (tick %u)\n",
+             task->name, task->absolute_deadline);
+}
+
+/*
+ * PERIODIC TASK CREATION
+ *
+ * The task is created like any other, then moved from the priority lists
+ * into the deadline heap of the core that admitted it. Its priority (0)
+ * only matters while it waits on a mutex or queue.
+ */
+uint32_t task_create_periodic(const char* name,
+                              void (*task_func)(void* param),
+                              void* param,
+                              uint32_t period_ms,
+                              uint32_t wcet_ms,
+                              uint32_t deadline_ms,
+                              uint32_t stack_size) {
+    if (deadline_ms == 0) {
+        deadline_ms = period_ms;
+    }
+
+    if (sched_policy == SCHED_FIXED_PRIORITY) {
+        RTOS_LOG("❌ Periodic task '%s' needs the EDF or RM policy\n", name);
+        return 0;
+    }
+
+    if (period_ms == 0 || wcet_ms == 0 || wcet_ms > deadline_ms || deadline_ms > period_ms) {
+        RTOS_LOG("❌ Invalid timing for '%s': need 0 < WCET <= deadline <= period\n", name);
+        return 0;
+    }
+
+    uint32_t density = task_density(wcet_ms, deadline_ms);
+
+    kernel_lock();
+
+    // First fit over the cores
+    rtos_core_t* core = NULL;
+    for (uint32_t i = 0; i < core_count && core == NULL; i++) {
+        if (core_admits(&cores[i], density)) {
+            core = &cores[i];
+        }
+    }
+
+    if (core == NULL) {
+        stats.admission_rejections++;
+        kernel_unlock();
+        RTOS_LOG("🚫 Admission refused for '%s': %u.%02u%% more would overload every core\n",
+                 name, density / 10000, density / 100 % 100);
+        return 0;
+    }
+
+    uint32_t periodic_tasks = 0;
+    for (uint32_t i = 0; i < core_count; i++) {
+        periodic_tasks += cores[i].rt_tasks;
+    }
+
+    uint32_t task_id = 0;
+    if (monitor_reserve(periodic_tasks + 1) == 0 &&
+        run_queue_reserve_realtime(core, core->rt_tasks + 1) == 0) {
+        task_id = task_create_locked(name, task_func, param, 0, stack_size);
+    }
+    if (task_id == 0) {
+        kernel_unlock();
+        return 0;
+    }
+
+    tcb_t* task = task_lookup(task_id);
+    remove_task_from_ready_queue(task);
+
+    task->period = period_ms;
+    task->wcet = wcet_ms;
+    task->relative_deadline = deadline_ms;
+    task->release_time = system_tick_count;
+    task->absolute_deadline = system_tick_count + deadline_ms;
+    task->affinity_mask = 1u << core->id;
+    task->core = (uint8_t)core->id;
+
+    core->rt_tasks++;
+    core->rt_utilization += density;
+
+    monitor_push(task);
+    add_task_to_ready_queue(task);
+    kernel_unlock();
+
+    RTOS_LOG("⏲️  Periodic task '%s' admitted to core %u: T=%u C=%u D=%u (core at %u.%02u%%)\n",
+             name, core->id, period_ms, wcet_ms, deadline_ms,
+             core->rt_utilization / 10000, core->rt_utilization / 100 % 100);
+
+    return task_id;
+}
+
+/*
+ * JOB COMPLETION
+ *
+ * Releases stay on the original grid (release + k * period) even when a
+ * job runs late, so one overrun does not shift every later deadline.
+ * Returns whether the next release is still in the future.
+ */
+bool realtime_finish_job(tcb_t* task) {
+    uint32_t now = system_tick_count;
+
+    task->jobs_completed++;
+    stats.jobs_completed++;
+
+    if (!task->job_missed && (int32_t)(now - task->absolute_deadline) > 0) {
+        count_deadline_miss(task);
+    }
+
+    if (task->monitor_index != REALTIME_UNMONITORED) {
+        monitor_remove(task);
+    }
+    task->release_time += task->period;
+    task->absolute_deadline = task->release_time + task->relative_deadline;
+    task->job_missed = false;
+    monitor_push(task);
+
+    return (int32_t)(task->release_time - now) > 0;
+}
+
+/*
+ * DEADLINE MONITOR
+ *
+ * A job that never finishes would never be counted at completion, so the
+ * tick also flags jobs still running past their deadline, once per job:
+ * every job at the root of the monitor heap whose deadline has passed.
+ * While a task waits for its next release its deadline already belongs to
+ * that future job, so it cannot be flagged by mistake.
+ */
+void realtime_check_deadlines(void) {
+    while (monitor_size > 0 &&
+           (int32_t)(system_tick_count - monitor_heap[0]->absolute_deadline) > 0) {
+        tcb_t* task = monitor_heap[0];
+
+        monitor_remove(task);
+        if (task_is_realtime(task)) {
+            count_deadline_miss(task);
+        }
+    }
+}
+
+void realtime_release(tcb_t* task) {
+    rtos_core_t* core = &cores[task->core];
+
+    if (task->monitor_index != REALTIME_UNMONITORED) {
+        monitor_remove(task);
+    }
+
+    core->rt_tasks--;
+    core->rt_utilization -= task_density(task->wcet, task->relative_deadline);
+}
+
+void realtime_reset(void) {
+    free(monitor_heap);
+    monitor_heap = NULL;
+    monitor_size = 0;
+    monitor_capacity = 0;
+}
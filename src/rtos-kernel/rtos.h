@@ -11,6 +11,7 @@
  * CONCEPTS COVERED:
  * - Task Control Blocks (TCB)
  * - Round-robin scheduling with priorities
+ * - Earliest-deadline-first and rate-monotonic scheduling
  * - Context switching (simulated)
  * - Task states and state transitions
  * - Stack management
@@ -30,10 +31,26 @@
 /*
  * RTOS CONFIGURATION
  */
-#define MAX_TASKS 8              // Maximum number of tasks
-#define STACK_SIZE 1024          // Stack size per task (bytes)
-#define TIME_SLICE_MS 10         // Time slice in milliseconds
+#define MAX_TASKS (1u << 20)     // Maximum number of tasks (table grows on demand)
+#define STACK_SIZE 1024          // Default stack size per task (bytes)
+#define MAX_STACK_SIZE (256 * 1024) // Largest stack a task may request (bytes)
+#define CONTEXT_STACK_MIN (16 * 1024) // Smallest stack in context-switch mode (bytes)
+#define TIME_SLICE_MS 10         // Default time slice of every priority level (ms)
+#define ADAPTIVE_SLICE_SCALE 2   // Adaptive slicing: interactive tasks get 1/N of their level's slice, CPU-bound ones N times
 #define PRIORITY_LEVELS 4        // Number of priority levels (0-3)
+#define RTOS_MAX_CORES 32        // Most scheduler cores in SMP mode
+#define TASK_AFFINITY_ANY 0xFFFFFFFFu // Affinity mask allowing every core
+#define RTOS_HEAP_SIZE (4u * 1024 * 1024) // Bytes managed by rtos_malloc
+#define RUNTIME_BUCKETS 16       // Log2 histogram buckets: <1 us, <2 us, <4 us, ...
+#define STACK_SAFETY_PERCENT 25  // Headroom above the high-water mark in stack advice
+#define STACK_SCAN_WORDS 2048    // Stack words the idle task checks per pass
+#define TIMER_TASK_PRIORITY 0    // Priority software timer callbacks run at
+#define RTOS_IRQ_LINES 8         // Simulated interrupt lines
+#define IRQ_WORKER_PRIORITY 0    // Priority interrupt bottom halves run at
+
+#ifndef RTOS_VERBOSE
+#define RTOS_VERBOSE 1           // Print kernel events (build with 0 for benchmarks)
+#endif
 
 /*
  * TASK STATES
@@ -53,6 +70,106 @@ typedef enum {
     TASK_TERMINATED
 } task_state_t;
 
+/*
+ * EXECUTION MODES
+ *
+ * - SIMULATED: rtos_start drives the scheduler from a 1 ms tick loop and
+ *   only models task switches; task functions never actually run, but
+ *   tasks with a script follow it in real time.
+ * - CONTEXT_SWITCH: every task runs on its own stack and the kernel really
+ *   switches between them. Kernel calls (yield, sleep, blocking on a
+ *   mutex, ...) are the preemption points.
+ * - VIRTUAL_TIME: a discrete-event simulation. Tasks follow scripts of CPU
+ *   bursts and sleeps instead of running code, and the tick count jumps
+ *   straight to the next event (a burst finishing, a sleeper waking, a
+ *   time slice running out), so days of scheduling replay in seconds and
+ *   every run with the same seed is identical.
+ */
+typedef enum {
+    RTOS_MODE_SIMULATED = 0,
+    RTOS_MODE_CONTEXT_SWITCH,
+    RTOS_MODE_VIRTUAL_TIME
+} rtos_mode_t;
+
+/*
+ * TASK SCRIPTS (simulated and virtual-time modes)
+ *
+ * A script is an array of steps ending in SCRIPT_REPEAT (start over) or
+ * SCRIPT_END (the task exits). Step lengths are in ticks; a step with
+ * jitter lasts ticks + a seeded random 0..jitter, so workloads can vary
+ * while staying reproducible.
+ */
+typedef enum {
+    SCRIPT_BURST = 0,                    // Use the CPU for ticks
+    SCRIPT_SLEEP,                        // Sleep for ticks (task_sleep)
+    SCRIPT_WAIT_PERIOD,                  // End the job (task_wait_next_period)
+    SCRIPT_REPEAT,                       // Jump back to the first step
+    SCRIPT_END                           // Delete the task
+} script_op_t;
+
+typedef struct {
+    script_op_t op;                      // What to do
+    uint32_t ticks;                      // Length of a burst or sleep
+    uint32_t jitter;                     // Extra random length, 0..jitter
+} script_step_t;
+
+/*
+ * SCHEDULING POLICIES
+ *
+ * - FIXED_PRIORITY: round-robin within fixed priority levels (default).
+ * - EDF: periodic tasks run earliest absolute deadline first. EDF can use
+ *   the whole CPU: a task set is admitted while sum(WCET / deadline) <= 1.
+ * - RATE_MONOTONIC: periodic tasks run shortest relative deadline first
+ *   (shortest period when deadline == period, the classic RM ordering).
+ *   Fixed priorities cannot use the whole CPU, so n tasks are admitted
+ *   only under the Liu & Layland bound n * (2^(1/n) - 1), about 69% for
+ *   large n.
+ *
+ * Under EDF and RM, periodic tasks always outrank ordinary (aperiodic)
+ * tasks, which share the leftover time by priority as before. On SMP each
+ * periodic task is admitted to, and pinned on, the first core it fits.
+ */
+typedef enum {
+    SCHED_FIXED_PRIORITY = 0,
+    SCHED_EDF,
+    SCHED_RATE_MONOTONIC
+} sched_policy_t;
+
+/*
+ * SMP
+ *
+ * In context-switch mode the kernel can run several schedulers at once,
+ * one per core. Each core is a worker OS thread pinned to a host CPU with
+ * its own run queues, current task and idle task. New tasks go to the
+ * least loaded core, woken tasks return to the core they last ran on
+ * (their cache is still warm there), and a core with nothing to do steals
+ * ready tasks from the others. A task's affinity mask limits which cores
+ * may run or steal it.
+ */
+struct rtos_mutex;
+struct rtos_core;
+struct rtos_event_waiter;
+
+/*
+ * STACKLESS TASKS (protothreads)
+ *
+ * A stackless task has no stack of its own. Its function is called from
+ * the top every time the task is switched in and jumps to the line it
+ * left off at, which is all the state the kernel keeps for it (see the
+ * PT_ macros at the end of this file).
+ */
+typedef enum {
+    PT_WAITING = 0,                      // Blocked in a kernel call
+    PT_YIELDED,                          // Willing to let others run first
+    PT_EXITED                            // Finished: the task is deleted
+} pt_status_t;
+
+typedef struct {
+    uint32_t resume;                     // Line to continue at, 0 = the top
+} pt_t;
+
+typedef pt_status_t (*pt_function_t)(pt_t* pt, void* param);
+
 /*
  * TASK CONTROL BLOCK (TCB)
  * 
@@ -63,32 +180,108 @@ typedef struct task_control_block {
     // Task identification
     uint32_t task_id;                    // Unique task identifier
     char name[16];                       // Task name for debugging
+    uint32_t slot;                       // Index in the task table
     
     // CPU context (registers)
     uint32_t* stack_pointer;             // Current stack pointer
     uint32_t registers[16];              // Saved CPU registers (R0-R15)
     
+    void* host_context;                  // Saved host context (context-switch mode)
+    
     // Task properties
-    uint8_t priority;                    // Task priority (0 = highest)
+    uint8_t priority;                    // Effective priority (0 = highest)
+    uint8_t base_priority;               // Assigned priority, before inheritance
     task_state_t state;                  // Current task state
     uint32_t time_slice_remaining;       // Remaining time slice
+    uint32_t time_slice;                 // Slice granted when last switched in
+    bool slice_kept;                     // Preempted mid-slice: resumes it, first in its level
+    uint16_t slice_usage;                // Adaptive slicing: average share of its slices used (of 256)
+    bool interactive;                    // Adaptive slicing: blocks early, runs one level up
+    uint8_t ready_priority;              // Ready queue the task was put on
+    bool suspended;                      // Kept off the run queues until task_resume
+    bool delete_requested;               // Delete once switched out (running elsewhere)
     
     // Stack management
     uint8_t* stack_base;                 // Base of task stack
     uint32_t stack_size;                 // Size of task stack
     
     // Timing and statistics
-    uint32_t total_runtime;              // Total CPU time used
+    uint32_t total_runtime;              // Ticks spent running
     uint32_t last_run_time;              // When task last ran
     uint32_t wake_time;                  // When to wake up (if sleeping)
+    uint32_t sleep_index;                // Position in the sleep queue (scheduler.c)
     
     // Linked list pointers
     struct task_control_block* next;     // Next task in list
     struct task_control_block* prev;     // Previous task in list
     
+    // Blocking and priority inheritance
+    struct task_control_block** wait_list; // Wait queue this task is blocked on
+    struct rtos_mutex* waiting_for_mutex;  // Mutex this task is blocked on
+    struct rtos_mutex* contended_mutexes;  // Held mutexes that have waiters
+    struct rtos_event_waiter* event_wait;  // Event group wait in progress (on the task's stack)
+    
+    // Direct-to-task notification
+    uint32_t notify_value;               // Bits, count or message (see task_notify)
+    bool notify_pending;                 // Notified since the last wait took it
+    bool notify_waiting;                 // Blocked in task_notify_wait/take
+    
+    // Asynchronous I/O
+    bool io_waiting;                     // Blocked in task_wait_fd
+    int io_fd;                           // Descriptor waited on
+    uint32_t io_ready;                   // IO_* events that ended the wait
+    
+    // SMP placement
+    uint32_t affinity_mask;              // Cores allowed to run the task (bit per core)
+    uint8_t core;                        // Core the task last ran on
+    bool is_idle;                        // A core's idle task (never migrates)
+    bool on_cpu;                         // Registers still live on some core
+    struct rtos_core* run_queue;         // Core whose run queue holds the task
+    
+    // Periodic real-time parameters (period == 0 for ordinary tasks)
+    uint32_t period;                     // Ticks between job releases
+    uint32_t wcet;                       // Worst-case execution time per job (ticks)
+    uint32_t relative_deadline;          // Deadline after each release (ticks)
+    uint32_t release_time;               // Tick the current job was released
+    uint32_t absolute_deadline;          // Tick the current job must finish by
+    uint32_t heap_index;                 // Position in its core's deadline heap
+    uint32_t monitor_index;              // Position in the deadline monitor (realtime.c)
+    uint32_t jobs_completed;             // Jobs finished
+    uint32_t deadline_misses;            // Jobs that finished late or not at all
+    bool job_missed;                     // Current job already counted as a miss
+    
+    // CPU accounting, in port cycles, updated at every switch in and out
+    // (not in virtual time). Read them with task_get_runtime.
+    uint32_t account_seq;                // Odd while the counters below change
+    uint32_t runs;                       // Times switched in
+    uint64_t switched_in_at;             // Cycle count at the last switch in
+    uint64_t ready_since;                // Cycle count when made ready (0 = not ready)
+    uint64_t cpu_cycles;                 // Time spent running (finished runs)
+    uint64_t ready_cycles;               // Time spent ready, waiting for a CPU
+    uint64_t max_ready_cycles;           // Longest wait from ready to running
+    uint32_t run_histogram[RUNTIME_BUCKETS];   // Lengths of finished runs
+    uint32_t ready_histogram[RUNTIME_BUCKETS]; // Ready-to-run waits
+    
+    // Stack use, measured on painted stacks (context-switch mode)
+    uint32_t stack_high_water;           // Most bytes of stack ever found in use
+    uint32_t stack_scan_word;            // Where the idle task's scan continues
+    
+    // Heap ownership
+    struct heap_block* heap_blocks;      // Blocks allocated by this task
+    uint32_t heap_used;                  // Bytes in those blocks
+    
+    // Virtual-time workload
+    const script_step_t* script;         // Steps the task follows (NULL = always busy)
+    uint32_t script_pc;                  // Next step to execute
+    uint32_t burst_remaining;            // Ticks left in the current CPU burst
+    
     // Task function
     void (*task_function)(void* param);  // Task entry point
     void* task_parameter;                // Parameter for task function
+    
+    // Stackless task (task_create_stackless)
+    pt_function_t pt_function;           // Body, NULL for tasks with a stack
+    pt_t pt;                             // Where the body continues
 } tcb_t;
 
 /*
@@ -97,11 +290,66 @@ typedef struct task_control_block {
 typedef struct {
     uint32_t total_context_switches;     // Total context switches
     uint32_t total_ticks;                // Total system ticks
-    uint32_t idle_time;                  // Time spent in idle task
+    uint32_t idle_time;                  // Ticks spent in the idle tasks
     uint32_t tasks_created;              // Number of tasks created
     uint32_t tasks_deleted;              // Number of tasks deleted
+    uint32_t tasks_reclaimed;            // Deleted tasks whose slot and stack are free again
+    uint32_t mutex_contentions;          // Mutex locks that had to block
+    uint32_t priority_boosts;            // Priority inheritance boosts applied
+    uint32_t task_steals;                // Ready tasks taken from another core
+    uint32_t task_migrations;            // Switches to a task that last ran elsewhere
+    uint32_t jobs_completed;             // Periodic jobs finished
+    uint32_t deadline_misses;            // Periodic jobs that missed their deadline
+    uint32_t admission_rejections;       // Periodic tasks refused by the admission test
+    uint32_t timer_callbacks;            // Software timer callbacks run
+    uint32_t timer_batches;              // Timer daemon wake-ups that ran callbacks
+    uint32_t timer_overruns;             // Periodic timer expiries skipped by a late daemon
+    uint32_t interrupts;                 // Simulated interrupts taken (top halves)
+    uint32_t deferred_runs;              // Bottom halves run by the IRQ worker
+    uint32_t deferred_coalesced;         // Events merged into already queued work
+    uint32_t io_polls;                   // Looks at the I/O multiplexer that found events
+    uint32_t io_wakeups;                 // Tasks readied because a descriptor was ready
 } scheduler_stats_t;
 
+/*
+ * PER-CORE STATISTICS (SMP)
+ */
+typedef struct {
+    uint32_t context_switches;           // Switches performed by this core
+    uint32_t steals;                     // Tasks this core stole from others
+    uint32_t migrations;                 // Tasks that arrived from another core
+    uint32_t idle_time;                  // Ticks this core spent idle
+    uint32_t idle_sleeps;                // Times the idle core slept the host thread
+} core_stats_t;
+
+/*
+ * TASK RUNTIME SNAPSHOT
+ *
+ * Histogram bucket 0 counts times below 1 us, bucket i (i > 0) times of
+ * 2^(i-1) up to 2^i us, and the last bucket everything longer.
+ */
+typedef struct {
+    uint64_t cpu_ns;                     // Time on a CPU, including a run in progress
+    uint64_t ready_ns;                   // Time spent ready but not running
+    uint64_t max_ready_ns;               // Longest wait from ready to running
+    uint64_t elapsed_ns;                 // Time since rtos_start, for load figures
+    uint32_t runs;                       // Times switched in
+    uint32_t run_histogram[RUNTIME_BUCKETS];   // How long each run lasted
+    uint32_t ready_histogram[RUNTIME_BUCKETS]; // How long each wake waited for the CPU
+} task_runtime_t;
+
+/*
+ * TASK STACK USAGE
+ *
+ * Only known in context-switch mode, the one mode where task code runs on
+ * the stacks; elsewhere, and for stackless tasks, everything is 0.
+ */
+typedef struct {
+    uint32_t size;                       // Stack size in bytes
+    uint32_t used;                       // High-water mark: most bytes ever in use
+    uint32_t recommended;                // Suggested stack_size for task_create
+} stack_usage_t;
+
 /*
  * RTOS KERNEL FUNCTIONS
  */
@@ -112,19 +360,108 @@ typedef struct {
  */
 int rtos_init(void);
 
+/**
+ * Select how tasks are executed (call before rtos_init)
+ * @param mode: RTOS_MODE_SIMULATED (default) or RTOS_MODE_CONTEXT_SWITCH
+ * @return: 0 on success, -1 if the scheduler is running
+ */
+int rtos_set_mode(rtos_mode_t mode);
+
+/**
+ * Select how many scheduler cores to run (call before rtos_init)
+ * @param count: 1 (default) to RTOS_MAX_CORES; more than one core
+ *               requires RTOS_MODE_CONTEXT_SWITCH
+ * @return: 0 on success, -1 if out of range or the scheduler is running
+ */
+int rtos_set_core_count(uint32_t count);
+
+/**
+ * Get the number of scheduler cores
+ * @return: Core count
+ */
+uint32_t rtos_get_core_count(void);
+
+/**
+ * Select the scheduling policy (call before rtos_init)
+ * @param policy: SCHED_FIXED_PRIORITY (default), SCHED_EDF or
+ *                SCHED_RATE_MONOTONIC
+ * @return: 0 on success, -1 if the scheduler is running
+ */
+int rtos_set_policy(sched_policy_t policy);
+
+/**
+ * Get the scheduling policy
+ * @return: Current policy
+ */
+sched_policy_t rtos_get_policy(void);
+
+/**
+ * Set the time slice of one priority level: how long a task of that
+ * level may run while another task of the same level is ready. Takes
+ * effect at each task's next slice.
+ * @param priority: Priority level (0 = highest)
+ * @param slice_ms: Slice in ticks (ms), at least 1
+ * @return: 0 on success, -1 if either is out of range
+ */
+int rtos_set_time_slice(uint8_t priority, uint32_t slice_ms);
+
+/**
+ * Get the time slice of a priority level
+ * @param priority: Priority level
+ * @return: Slice in ticks (ms), 0 if the priority is out of range
+ */
+uint32_t rtos_get_time_slice(uint8_t priority);
+
+/**
+ * Turn adaptive time slicing on or off (call before rtos_start). The
+ * kernel keeps a running average of how much of its slice each task uses
+ * before it blocks or the slice runs out. Tasks that mostly block within
+ * the first quarter count as interactive: they are scheduled one priority
+ * level higher, with 1/ADAPTIVE_SLICE_SCALE of their level's slice.
+ * Tasks that use three quarters or more are CPU-bound and get
+ * ADAPTIVE_SLICE_SCALE times the slice, so they are switched less often.
+ * Periodic and idle tasks are left alone.
+ * @param enabled: true to adapt, false for the fixed per-level slices
+ * @return: 0 on success, -1 if the scheduler is running
+ */
+int rtos_set_adaptive_slicing(bool enabled);
+
 /**
  * Start the RTOS scheduler
- * This function never returns
+ * Does not return until a task calls rtos_stop()
  */
 void rtos_start(void);
 
+/**
+ * Seed the random step jitter of virtual-time scripts (call after
+ * rtos_init; the same seed replays the same schedule)
+ * @param seed: Any value
+ */
+void rtos_sim_seed(uint32_t seed);
+
+/**
+ * Advance a virtual-time simulation (RTOS_MODE_VIRTUAL_TIME only).
+ * Can be called repeatedly to continue where the last call stopped.
+ * rtos_start instead runs until no task has anything left to do.
+ * @param ticks: Virtual ticks to simulate (below 2^31)
+ * @return: Number of scheduling events processed
+ */
+uint64_t rtos_sim_run(uint32_t ticks);
+
+/**
+ * Stop the scheduler and return from rtos_start()
+ * Called from a task; the kernel must be re-initialized before restarting.
+ */
+void rtos_stop(void);
+
 /**
  * Create a new task
  * @param name: Task name (for debugging)
  * @param task_func: Task function pointer
  * @param param: Parameter to pass to task
  * @param priority: Task priority (0 = highest)
- * @param stack_size: Stack size in bytes
+ * @param stack_size: Stack size in bytes (0 = STACK_SIZE). Rounded up to
+ *                    whole pages; each stack gets its own guard page.
  * @return: Task ID on success, 0 on failure
  */
 uint32_t task_create(const char* name, 
@@ -134,34 +471,107 @@ uint32_t task_create(const char* name,
                      uint32_t stack_size);
 
 /**
- * Delete a task
+ * Create a stackless task (a protothread)
+ *
+ * The task shares the scheduler, priorities and synchronization
+ * primitives with ordinary tasks but has no stack: its function runs on
+ * its core's runner stack and returns whenever it waits, so the only
+ * memory it needs is its TCB and whatever param points to. Local
+ * variables do not survive a wait; keep them behind param. Write the
+ * function with the PT_ macros below.
+ * @param name: Task name (for debugging)
+ * @param function: Task body, PT_BEGIN ... PT_END
+ * @param param: Passed to every call of function (the task's frame)
+ * @param priority: Task priority (0 = highest)
+ * @return: Task ID on success, 0 on failure
+ */
+uint32_t task_create_stackless(const char* name,
+                               pt_function_t function,
+                               void* param,
+                               uint8_t priority);
+
+/**
+ * Give a task a workload script (simulated or virtual-time mode)
+ * @param task_id: Task ID
+ * @param script: Steps ending in SCRIPT_REPEAT or SCRIPT_END; must stay
+ *                valid while the task exists
+ * @return: 0 on success, -1 if the task is unknown or the script is
+ *          malformed (no terminator, or a loop that never takes time)
+ */
+int task_set_script(uint32_t task_id, const script_step_t* script);
+
+/**
+ * Create a periodic task (EDF and RM policies only)
+ *
+ * The task function runs one job, calls task_wait_next_period(), and loops.
+ * The first job is released at creation. The task is admitted only if the
+ * policy's utilisation test still passes with it added.
+ * @param name: Task name (for debugging)
+ * @param task_func: Task function pointer
+ * @param param: Parameter to pass to task
+ * @param period_ms: Time between job releases
+ * @param wcet_ms: Worst-case execution time of one job
+ * @param deadline_ms: Deadline relative to each release (0 = period_ms);
+ *                     wcet_ms <= deadline_ms <= period_ms
+ * @param stack_size: Stack size in bytes (0 = STACK_SIZE)
+ * @return: Task ID on success, 0 if invalid or rejected by admission
+ */
+uint32_t task_create_periodic(const char* name,
+                              void (*task_func)(void* param),
+                              void* param,
+                              uint32_t period_ms,
+                              uint32_t wcet_ms,
+                              uint32_t deadline_ms,
+                              uint32_t stack_size);
+
+/**
+ * Delete a task. A task running on another core is deleted the next
+ * time that core switches it out (at its next kernel call). The slot and
+ * stack are reclaimed later, in batches, by the idle task.
  * @param task_id: Task ID to delete
- * @return: 0 on success, -1 on failure
+ * @return: 0 on success (or once requested), -1 if the task does not
+ *          exist or is an idle task
  */
 int task_delete(uint32_t task_id);
 
 /**
- * Suspend a task
- * @param task_id: Task ID to suspend
- * @return: 0 on success, -1 on failure
+ * Suspend a task until task_resume. A ready task leaves its run queue at
+ * once. A blocked task finishes its wait first (it still receives what
+ * it waits for), then is suspended instead of readied. A task running on
+ * another core is suspended when that core next switches it out.
+ * @param task_id: Task ID to suspend (may be the caller)
+ * @return: 0 on success, -1 if the task does not exist, is an idle task
+ *          or is already suspended
  */
 int task_suspend(uint32_t task_id);
 
 /**
  * Resume a suspended task
  * @param task_id: Task ID to resume
- * @return: 0 on success, -1 on failure
+ * @return: 0 on success, -1 if the task does not exist or is not suspended
  */
 int task_resume(uint32_t task_id);
 
 /**
- * Change task priority
+ * Change a task's base priority. A ready task moves to its new
+ * priority's queue and a waiting task to its new place in the wait
+ * queue; priority inherited through mutexes still applies on top. The
+ * caller is preempted if the change puts another task ahead of it.
  * @param task_id: Task ID
- * @param new_priority: New priority level
- * @return: 0 on success, -1 on failure
+ * @param new_priority: Priority below PRIORITY_LEVELS (0 = highest)
+ * @return: 0 on success, -1 if the task does not exist, is an idle or
+ *          periodic task, or the priority is out of range
  */
 int task_set_priority(uint32_t task_id, uint8_t new_priority);
 
+/**
+ * Restrict the cores a task may run on
+ * @param task_id: Task ID
+ * @param mask: Bit n allows core n (TASK_AFFINITY_ANY = all cores)
+ * @return: 0 on success, -1 if the task is unknown or the mask allows no core
+ */
+int task_set_affinity(uint32_t task_id, uint32_t mask);
+
 /*
  * TASK CONTROL FUNCTIONS
  */
@@ -171,18 +581,50 @@ int task_set_priority(uint32_t task_id, uint8_t new_priority);
  */
 void task_yield(void);
 
+/**
+ * Preemption point: switch away only if the caller's time slice has run
+ * out with another task of its level ready, or a higher priority task is
+ * ready. In context-switch mode a long computation calls this now and
+ * then, so it is time-sliced without giving up the rest of its slice the
+ * way task_yield does.
+ */
+void task_preemption_point(void);
+
 /**
  * Put current task to sleep for specified milliseconds
  * @param ms: Sleep duration in milliseconds
  */
 void task_sleep(uint32_t ms);
 
+/**
+ * Did the calling task's last kernel call leave it blocked? Only a
+ * stackless task can see true: its blocking calls return at once, and
+ * the task is switched out when its function returns (the PT_ macros
+ * check this for you).
+ * @return: true if the task must return PT_WAITING now
+ */
+bool task_will_block(void);
+
+/**
+ * Finish the current periodic job and sleep until the next release.
+ * A job finishing after its deadline is counted as a deadline miss; if the
+ * next release has already passed, the next job starts immediately.
+ * @return: 0 on success, -1 if the caller is not a periodic task
+ */
+int task_wait_next_period(void);
+
 /**
  * Get current task ID
  * @return: Current task ID
  */
 uint32_t task_get_current_id(void);
 
+/**
+ * Get the core the calling task is running on
+ * @return: Core index (0 when not called from a task)
+ */
+uint32_t task_get_current_core(void);
+
 /**
  * Get task information
  * @param task_id: Task ID
@@ -218,19 +660,36 @@ void context_switch(tcb_t* current_task, tcb_t* next_task);
 
 /**
  * Mutex structure
+ *
+ * The whole lock is one word: the owner's TCB address, with the low bit
+ * set once a task is waiting. Locking a free mutex and unlocking one
+ * nobody waits for are each a single compare-and-swap on that word and
+ * never enter the scheduler. Only contention takes the slow path, where
+ * waiters queue in priority order and the owner inherits the priority of
+ * the highest waiter until it unlocks.
  */
-typedef struct {
-    bool locked;                         // Mutex state
+typedef struct rtos_mutex {
+    uintptr_t state;                    // Owner TCB | MUTEX_HAS_WAITERS, 0 = unlocked
     uint32_t owner_task_id;             // Task that owns the mutex
-    tcb_t* waiting_tasks;               // Queue of waiting tasks
+    tcb_t* waiting_tasks;               // Waiting tasks, highest priority first
+    struct rtos_mutex* next_contended;  // Next contended mutex of the same owner
+    bool priority_inheritance;          // Boost owner to highest waiter (default on)
 } mutex_t;
 
+#define MUTEX_HAS_WAITERS ((uintptr_t)1)
+
 /**
  * Semaphore structure
+ *
+ * While the count is positive, wait is a single compare-and-swap and
+ * signal with no waiters is a single atomic increment. Only an empty
+ * semaphore blocks: the waiter drives the count negative, so the signal
+ * that brings it back towards zero knows somebody is waiting and hands
+ * the unit straight to the highest-priority waiter.
  */
 typedef struct {
-    int32_t count;                      // Semaphore count
-    tcb_t* waiting_tasks;               // Queue of waiting tasks
+    int32_t count;                      // Available units; negative = waiters
+    tcb_t* waiting_tasks;               // Waiting tasks, highest priority first
 } semaphore_t;
 
 /**
@@ -240,16 +699,17 @@ typedef struct {
 void mutex_init(mutex_t* mutex);
 
 /**
- * Lock a mutex
+ * Lock a mutex, blocking while another task owns it
  * @param mutex: Mutex to lock
- * @return: 0 on success, -1 on failure
+ * @return: 0 on success, -1 on failure (no current task, or already owned
+ *          by the caller)
  */
 int mutex_lock(mutex_t* mutex);
 
 /**
- * Unlock a mutex
+ * Unlock a mutex, handing it directly to the highest-priority waiter
  * @param mutex: Mutex to unlock
- * @return: 0 on success, -1 on failure
+ * @return: 0 on success, -1 if the caller is not the owner
  */
 int mutex_unlock(mutex_t* mutex);
 
@@ -274,6 +734,229 @@ int semaphore_wait(semaphore_t* sem);
  */
 int semaphore_signal(semaphore_t* sem);
 
+/*
+ * TASK NOTIFICATIONS
+ *
+ * Every task has one 32-bit notification value that others can update
+ * directly, so signalling a single task needs no semaphore, no wait queue
+ * and no object shared with the sender: the sender looks the task up by
+ * ID, updates the value and, if the task is waiting for it, readies that
+ * one task. Depending on the action the value serves as a set of event
+ * bits, a counting semaphore, or a one-word mailbox.
+ */
+typedef enum {
+    NOTIFY_SET_BITS = 0,                 // value |= bits (lightweight event bits)
+    NOTIFY_INCREMENT,                    // value++, ignoring the argument (counting semaphore)
+    NOTIFY_OVERWRITE                     // value = argument (mailbox, latest wins)
+} notify_action_t;
+
+#define RTOS_WAIT_FOREVER 0xFFFFFFFFu    // Timeout that never expires
+
+/**
+ * Notify a task, waking it if it waits for a notification
+ * @param task_id: Task to notify
+ * @param value: Bits to set or value to write (ignored by NOTIFY_INCREMENT)
+ * @param action: How to update the task's notification value
+ * @return: 0 on success, -1 if the task does not exist
+ */
+int task_notify(uint32_t task_id, uint32_t value, notify_action_t action);
+
+/**
+ * Wait until the current task is notified (a notification that arrived
+ * since the last wait counts at once)
+ * @param clear_on_exit: Bits to clear in the value once received
+ * @param value: Receives the value before clearing (may be NULL)
+ * @param timeout_ms: 0 to poll, RTOS_WAIT_FOREVER to wait without limit
+ * @return: 0 if notified, -1 on timeout or outside a task
+ */
+int task_notify_wait(uint32_t clear_on_exit, uint32_t* value, uint32_t timeout_ms);
+
+/**
+ * Use the notification value as a counting semaphore: wait until it is
+ * non-zero, then decrement it (or zero it)
+ * @param clear_on_exit: true to zero the value, false to decrement it
+ * @param timeout_ms: 0 to poll, RTOS_WAIT_FOREVER to wait without limit
+ * @return: The value before it was decremented or cleared, 0 on timeout
+ */
+uint32_t task_notify_take(bool clear_on_exit, uint32_t timeout_ms);
+
+/*
+ * EVENT GROUPS
+ *
+ * A word of event bits that tasks wait on, for any of a set of bits or
+ * for all of them. Setting bits that nobody waits for is one atomic OR.
+ * Waiters are kept per bit, linked through records on their own stacks,
+ * so nothing is allocated and setting bits only visits tasks waiting for
+ * one of those bits: a task waiting for any bit is linked on each of
+ * them, a task waiting for all bits only on one bit it still misses.
+ */
+#define EVENT_GROUP_BITS 32
+
+typedef struct {
+    uint32_t bits;                       // Current event bits
+    uint32_t waited_bits;                // Bits with at least one waiter linked
+    struct event_link* waiters[EVENT_GROUP_BITS]; // Waiters linked on each bit
+} event_group_t;
+
+/**
+ * Initialize an event group with all bits clear
+ * @param group: Event group to initialize
+ */
+void event_group_init(event_group_t* group);
+
+/**
+ * Set bits and wake every task whose wait they complete
+ * @param group: Event group
+ * @param bits: Bits to set
+ * @return: The group's bits just after setting (before woken waiters
+ *          clear theirs)
+ */
+uint32_t event_group_set_bits(event_group_t* group, uint32_t bits);
+
+/**
+ * Clear bits (never wakes anybody)
+ * @param group: Event group
+ * @param bits: Bits to clear
+ * @return: The group's bits before clearing
+ */
+uint32_t event_group_clear_bits(event_group_t* group, uint32_t bits);
+
+/**
+ * Read the current bits
+ * @param group: Event group
+ * @return: Current bits
+ */
+uint32_t event_group_get_bits(event_group_t* group);
+
+/**
+ * Wait for any or all of a set of bits
+ * @param group: Event group
+ * @param bits: Bits to wait for (not 0)
+ * @param wait_all: true to wait for all of them, false for any one
+ * @param clear_on_exit: Clear the waited-for bits when the wait succeeds
+ * @param timeout_ms: 0 to poll, RTOS_WAIT_FOREVER to wait without limit
+ * @param result: Receives the group's bits when the wait ended (may be NULL)
+ * @return: 0 if the condition was met, -1 on timeout or bad arguments
+ */
+int event_group_wait(event_group_t* group, uint32_t bits, bool wait_all,
+                     bool clear_on_exit, uint32_t timeout_ms, uint32_t* result);
+
+/*
+ * MESSAGE QUEUES
+ *
+ * Fixed-capacity ring buffers for passing data between tasks. Sending and
+ * receiving are lock-free; the scheduler is only entered to block on a
+ * full or empty queue, and the other side wakes its waiter directly.
+ *
+ * - QUEUE_SPSC: one sending task, one receiving task. Each index has a
+ *   single writer, so no read-modify-write atomics are needed at all.
+ * - QUEUE_MPMC: any number of senders and receivers. Every cell carries a
+ *   sequence number, and a slot is claimed with one compare-and-swap.
+ *
+ * Created with item_size == QUEUE_POINTER_ITEMS, a queue carries pointers
+ * (queue_send_ptr/queue_receive_ptr): a large payload moves from sender to
+ * receiver by handing over its address, without copying a single byte.
+ */
+typedef enum {
+    QUEUE_SPSC = 0,
+    QUEUE_MPMC
+} queue_kind_t;
+
+#define QUEUE_POINTER_ITEMS 0            // item_size for zero-copy pointer queues
+#define QUEUE_WOULD_BLOCK 1              // A stackless task must return and wait
+#define QUEUE_CACHE_LINE 64              // Keeps producer and consumer state apart
+
+typedef struct {
+    // Read-only after creation
+    queue_kind_t kind;                   // SPSC or MPMC
+    uint32_t capacity;                   // Number of slots (power of two)
+    uint32_t item_size;                  // Bytes per message
+    uint8_t* items;                      // capacity * item_size bytes
+    uint32_t* sequence;                  // Per-cell sequence numbers (MPMC only)
+    tcb_t* waiting_senders;              // Tasks blocked on a full queue
+    tcb_t* waiting_receivers;            // Tasks blocked on an empty queue
+    char pad0[QUEUE_CACHE_LINE];
+    
+    // Written by senders
+    uint32_t tail;                       // Next slot to fill
+    uint32_t cached_head;                // SPSC: sender's last view of head
+    char pad1[QUEUE_CACHE_LINE];
+    
+    // Written by receivers
+    uint32_t head;                       // Next slot to drain
+    uint32_t cached_tail;                // SPSC: receiver's last view of tail
+    char pad2[QUEUE_CACHE_LINE];
+} msg_queue_t;
+
+/**
+ * Create a message queue
+ * @param queue: Queue to initialize
+ * @param kind: QUEUE_SPSC or QUEUE_MPMC
+ * @param capacity: Number of messages (rounded up to a power of two)
+ * @param item_size: Bytes per message, or QUEUE_POINTER_ITEMS
+ * @return: 0 on success, -1 on failure
+ */
+int queue_create(msg_queue_t* queue, queue_kind_t kind,
+                 uint32_t capacity, uint32_t item_size);
+
+/**
+ * Free a queue's buffers (no task may be blocked on it)
+ * @param queue: Queue to destroy
+ */
+void queue_destroy(msg_queue_t* queue);
+
+/**
+ * Send without blocking
+ * @param queue: Queue to send to
+ * @param item: Message (item_size bytes are copied)
+ * @return: 0 on success, -1 if the queue is full
+ */
+int queue_try_send(msg_queue_t* queue, const void* item);
+
+/**
+ * Receive without blocking
+ * @param queue: Queue to receive from
+ * @param item: Buffer for the message (item_size bytes)
+ * @return: 0 on success, -1 if the queue is empty
+ */
+int queue_try_receive(msg_queue_t* queue, void* item);
+
+/**
+ * Send, blocking the current task while the queue is full. A stackless
+ * task must use PT_QUEUE_SEND instead.
+ * @param queue: Queue to send to
+ * @param item: Message (item_size bytes are copied)
+ * @return: 0 on success, -1 on failure (no task to block, or simulated
+ *          mode), QUEUE_WOULD_BLOCK if a stackless task must wait
+ */
+int queue_send(msg_queue_t* queue, const void* item);
+
+/**
+ * Receive, blocking the current task while the queue is empty. A
+ * stackless task must use PT_QUEUE_RECEIVE instead.
+ * @param queue: Queue to receive from
+ * @param item: Buffer for the message (item_size bytes)
+ * @return: 0 on success, -1 on failure (no task to block, or simulated
+ *          mode), QUEUE_WOULD_BLOCK if a stackless task must wait
+ */
+int queue_receive(msg_queue_t* queue, void* item);
+
+/**
+ * Zero-copy send on a pointer queue; ownership of payload passes on
+ * @param queue: Queue created with QUEUE_POINTER_ITEMS
+ * @param payload: Pointer to hand over
+ * @return: 0 on success, -1 on failure, QUEUE_WOULD_BLOCK as queue_send
+ */
+int queue_send_ptr(msg_queue_t* queue, void* payload);
+
+/**
+ * Zero-copy receive on a pointer queue
+ * @param queue: Queue created with QUEUE_POINTER_ITEMS
+ * @param payload: Receives the pointer that was sent
+ * @return: 0 on success, -1 on failure, QUEUE_WOULD_BLOCK as queue_receive
+ */
+int queue_receive_ptr(msg_queue_t* queue, void** payload);
+
 /*
  * UTILITY AND DEBUG FUNCTIONS
  */
@@ -284,6 +967,73 @@ int semaphore_signal(semaphore_t* sem);
  */
 scheduler_stats_t* get_scheduler_stats(void);
 
+/**
+ * Get one core's statistics
+ * @param core: Core index below rtos_get_core_count()
+ * @param out: Receives a copy of the counters
+ * @return: 0 on success, -1 if the core does not exist
+ */
+int get_core_stats(uint32_t core, core_stats_t* out);
+
+/**
+ * Take a consistent snapshot of a task's CPU accounting. Lock-free with
+ * respect to the task's core, so it is cheap enough to poll; in
+ * virtual-time mode only cpu_ns and elapsed_ns are filled (from ticks).
+ * @param task_id: Task ID
+ * @param out: Receives the snapshot
+ * @return: 0 on success, -1 if the task does not exist
+ */
+int task_get_runtime(uint32_t task_id, task_runtime_t* out);
+
+/**
+ * Measure how much of its stack a task has used so far. Scans the
+ * task's whole painted stack, so the figure is exact and current, and
+ * recommends a size: the high-water mark plus STACK_SAFETY_PERCENT,
+ * rounded up to whole pages.
+ * @param task_id: Task ID
+ * @param out: Receives the usage
+ * @return: 0 on success, -1 if the task does not exist
+ */
+int task_get_stack_usage(uint32_t task_id, stack_usage_t* out);
+
+/*
+ * SCHEDULER TRACING
+ *
+ * The kernel can record every context switch, wake-up, block, preemption
+ * and tick into per-core ring buffers, stamped with the CPU cycle counter.
+ * Recording is cheap enough to leave on while measuring; the trace is
+ * turned into Chrome/Perfetto JSON afterwards and opened in
+ * chrome://tracing or https://ui.perfetto.dev.
+ */
+
+/**
+ * Start recording (call after rtos_init and while the scheduler is not
+ * running; restarting discards old events)
+ * @param events_per_core: Ring size per core (rounded up to a power of
+ *                         two); older events are overwritten when full
+ * @return: 0 on success, -1 if out of memory or if tracing or the
+ *          scheduler is still running
+ */
+int rtos_trace_start(uint32_t events_per_core);
+
+/**
+ * Stop recording, keeping the recorded events for export
+ */
+void rtos_trace_stop(void);
+
+/**
+ * Number of events lost because a ring wrapped around
+ * @return: Overwritten event count
+ */
+uint64_t rtos_trace_overwritten(void);
+
+/**
+ * Write the recorded events as Chrome trace event JSON
+ * @param path: Output file
+ * @return: Number of events written, -1 on failure
+ */
+int rtos_trace_export_chrome(const char* path);
+
 /**
  * Print all task information (for debugging)
  */
@@ -294,6 +1044,13 @@ void print_task_list(void);
  */
 void print_scheduler_stats(void);
 
+/**
+ * Print every task's stack size, high-water mark and recommended size,
+ * flag stacks close to overflowing, and total the memory right-sizing
+ * would save (context-switch mode)
+ */
+void print_stack_report(void);
+
 /**
  * Get system uptime in milliseconds
  * @return: System uptime
@@ -301,25 +1058,74 @@ void print_scheduler_stats(void);
 uint32_t get_system_uptime(void);
 
 /**
- * Get CPU utilization percentage
+ * Get CPU utilization percentage: the time the cores spent outside
+ * their idle tasks since rtos_start, measured with the cycle counter
+ * (from ticks in virtual-time mode)
  * @return: CPU utilization (0-100%)
  */
 uint8_t get_cpu_utilization(void);
 
+/*
+ * LATENCY MEASUREMENT
+ *
+ * Ticks are due at fixed points on the host's monotonic clock, so how
+ * late a woken task really runs is the host time it gets the CPU minus
+ * the time its wake-up tick was due. A switch hook sees every context
+ * switch the moment it happens, which is the only place to measure that
+ * in simulated mode, where task functions never run.
+ */
+
+/**
+ * Called on every context switch, on the switching core, after the
+ * incoming task is marked running. Runs inside the kernel: it must be
+ * short and must not call kernel functions.
+ * @param from: Outgoing task (NULL when a core starts)
+ * @param to: Incoming task
+ */
+typedef void (*rtos_switch_hook_t)(tcb_t* from, tcb_t* to);
+
+/**
+ * Install a switch hook (call after rtos_init, which removes it)
+ * @param hook: Function to call, or NULL for none
+ */
+void rtos_set_switch_hook(rtos_switch_hook_t hook);
+
+/**
+ * Host time at which a tick is due (simulated and context-switch modes)
+ * @param tick: Tick number, as in get_system_uptime() or wake_time
+ * @return: CLOCK_MONOTONIC nanoseconds; only valid after rtos_start
+ */
+uint64_t rtos_tick_time_ns(uint32_t tick);
+
 /*
  * MEMORY MANAGEMENT
+ *
+ * rtos_malloc and rtos_free run in bounded, constant time whatever the
+ * state of the heap (TLSF, see heap.c), so real-time tasks may use them.
+ * Each block belongs to the task that allocated it; deleting a task frees
+ * everything it still owns. rtos_init starts a fresh heap.
+ *
+ * Partition pools hand out blocks of one fixed size, lock-free, for
+ * messages that are allocated and freed at a high rate.
  */
+typedef struct {
+    uint8_t* storage;                    // block_count blocks, block_size apart
+    uint32_t block_size;                 // Bytes per block (rounded up to pointer size)
+    uint32_t block_count;                // Blocks in the pool
+    uint64_t head;                       // Free stack: update tag << 32 | top index + 1
+    uint32_t available;                  // Free blocks
+} mem_pool_t;
 
 /**
  * Allocate memory from RTOS heap
  * @param size: Size in bytes
- * @return: Pointer to allocated memory, NULL on failure
+ * @return: Pointer to allocated memory (16-byte aligned), NULL on failure
  */
 void* rtos_malloc(size_t size);
 
 /**
- * Free memory allocated by rtos_malloc
- * @param ptr: Pointer to memory to free
+ * Free memory allocated by rtos_malloc (by any task)
+ * @param ptr: Pointer to memory to free (NULL is ignored)
  */
 void rtos_free(void* ptr);
 
@@ -329,4 +1135,300 @@ void rtos_free(void* ptr);
  */
 size_t get_free_heap_size(void);
 
-#endif // RTOS_H
\ No newline at end of file
+/**
+ * Create a partition pool; its storage is one rtos_malloc block owned by
+ * the calling task
+ * @param pool: Pool to initialize
+ * @param block_size: Bytes per block
+ * @param block_count: Number of blocks
+ * @return: 0 on success, -1 if the heap has no room
+ */
+int pool_create(mem_pool_t* pool, uint32_t block_size, uint32_t block_count);
+
+/**
+ * Release a pool's storage (its blocks must no longer be in use)
+ * @param pool: Pool to destroy
+ */
+void pool_destroy(mem_pool_t* pool);
+
+/**
+ * Take a block from a pool (lock-free, safe from any core)
+ * @param pool: Pool
+ * @return: Block, or NULL if all blocks are in use
+ */
+void* pool_alloc(mem_pool_t* pool);
+
+/**
+ * Return a block to its pool
+ * @param pool: Pool the block came from
+ * @param block: Block from pool_alloc
+ * @return: 0 on success, -1 if the block is not from this pool
+ */
+int pool_free(mem_pool_t* pool, void* block);
+
+/*
+ * SOFTWARE TIMERS
+ *
+ * One-shot and periodic callbacks without a task each: every timer's
+ * callback runs in a shared timer task at TIMER_TASK_PRIORITY, which is
+ * created with the first timer and sleeps until the earliest expiry (see
+ * timers.c). Timers are owned by the caller, like semaphores, and need
+ * context-switch mode, the only mode that runs task code. rtos_init
+ * forgets all timers.
+ */
+#define SOFT_TIMER_STOPPED 0xFFFFFFFFu       // heap_index of a timer that is not armed
+
+typedef struct soft_timer soft_timer_t;
+
+/**
+ * Timer callback. Runs in the timer task: it may call kernel functions,
+ * but should not block, or every other timer waits too.
+ * @param timer: The expired timer (timer->param is the caller's)
+ */
+typedef void (*soft_timer_callback_t)(soft_timer_t* timer);
+
+struct soft_timer {
+    const char* name;                    // For debugging
+    soft_timer_callback_t callback;      // Called at expiry (NULL once destroyed)
+    void* param;                         // For the callback's use
+    uint32_t period;                     // Ticks from start to expiry, and between expiries
+    bool auto_reload;                    // Periodic rather than one-shot
+    uint32_t expiry;                     // Tick of the next expiry while armed
+    uint32_t heap_index;                 // Position in the timer heap, or SOFT_TIMER_STOPPED
+    uint32_t due_tick;                   // Tick the latest callback was due at
+    uint32_t overruns;                   // Expiries skipped because the timer task ran late
+};
+
+/**
+ * Set up a timer, stopped. The first timer also creates the timer task.
+ * @param timer: Timer to initialize
+ * @param name: Timer name (kept by reference)
+ * @param period_ms: Time to expiry and, if periodic, between expiries
+ * @param auto_reload: true for a periodic timer, false for one-shot
+ * @param callback: Function to call at expiry
+ * @param param: Stored in timer->param for the callback
+ * @return: 0 on success, -1 on bad arguments, out of memory, or outside
+ *          context-switch mode
+ */
+int soft_timer_create(soft_timer_t* timer, const char* name, uint32_t period_ms,
+                      bool auto_reload, soft_timer_callback_t callback, void* param);
+
+/**
+ * Stop a timer for good and release its slot
+ * @param timer: Timer from soft_timer_create
+ */
+void soft_timer_destroy(soft_timer_t* timer);
+
+/**
+ * Arm a stopped timer to expire one period from now (an armed timer is
+ * left alone)
+ * @param timer: Timer to start
+ * @return: 0 on success, -1 if the timer was not created
+ */
+int soft_timer_start(soft_timer_t* timer);
+
+/**
+ * Disarm a timer; a callback already running finishes
+ * @param timer: Timer to stop
+ * @return: 0 on success, -1 if the timer was not created
+ */
+int soft_timer_stop(soft_timer_t* timer);
+
+/**
+ * Re-arm a timer to expire one period from now, whether it was armed or
+ * not (a watchdog that is fed by resetting it)
+ * @param timer: Timer to reset
+ * @return: 0 on success, -1 if the timer was not created
+ */
+int soft_timer_reset(soft_timer_t* timer);
+
+/**
+ * Check whether a timer is armed
+ * @param timer: Timer to check
+ * @return: true if it will expire unless stopped
+ */
+bool soft_timer_is_active(const soft_timer_t* timer);
+
+
+/*
+ * SIMULATED INTERRUPTS AND DEFERRED WORK
+ *
+ * A simulated device (any host thread) raises an IRQ line with
+ * rtos_irq_raise, and the line's handler runs at once on core 0's host
+ * thread, interrupting whatever runs there (see irq.c). Like a real
+ * interrupt handler it may not block, take locks or call kernel
+ * functions; it should only queue deferred work, whose function then
+ * runs in the IRQ worker task at IRQ_WORKER_PRIORITY. Work items are
+ * owned by the caller; one that is queued again before it ran runs once,
+ * told how many events it covers. Context-switch mode only; rtos_init
+ * detaches all handlers.
+ */
+typedef struct deferred_work deferred_work_t;
+
+/**
+ * Top half. Runs in interrupt context: only deferred_work_queue may be
+ * called from it.
+ * @param irq: Line that was raised
+ * @param param: Value given to rtos_irq_attach
+ */
+typedef void (*rtos_irq_handler_t)(uint32_t irq, void* param);
+
+/**
+ * Bottom half. Runs in the IRQ worker task and may call any kernel
+ * function, though blocking delays every other bottom half.
+ * @param work: The work item (work->param is the caller's)
+ * @param events: Times the item was queued since it last ran (> 1 when
+ *                a burst was coalesced)
+ */
+typedef void (*deferred_work_fn_t)(deferred_work_t* work, uint32_t events);
+
+struct deferred_work {
+    deferred_work_t* next;               // Link in the deferred-work queue
+    deferred_work_fn_t function;         // Bottom half (NULL if not initialized)
+    void* param;                         // For the function's use
+    uint32_t queued;                     // Set while queued: further events coalesce
+    uint32_t events;                     // Events not yet handed to the function
+    uint64_t raised_ns;                  // Host time the oldest of those events was queued
+    uint32_t runs;                       // Times the function ran
+    uint32_t coalesced;                  // Events merged into an already queued item
+    uint64_t last_latency_ns;            // Queued to function start, latest run
+    uint64_t max_latency_ns;             // Queued to function start, worst run
+};
+
+/**
+ * Attach a top-half handler to an IRQ line
+ * @param irq: Line below RTOS_IRQ_LINES
+ * @param handler: Function to run when the line is raised
+ * @param param: Passed to the handler
+ * @return: 0 on success, -1 on bad arguments or outside context-switch mode
+ */
+int rtos_irq_attach(uint32_t irq, rtos_irq_handler_t handler, void* param);
+
+/**
+ * Detach a line's handler; later interrupts on it are only counted
+ * @param irq: Line below RTOS_IRQ_LINES
+ * @return: 0 on success, -1 if the line does not exist
+ */
+int rtos_irq_detach(uint32_t irq);
+
+/**
+ * Raise an IRQ line, as a device would (from any host thread or task)
+ * @param irq: Line below RTOS_IRQ_LINES
+ * @return: 0 on success, -1 if the line does not exist or the signal
+ *          could not be sent
+ */
+int rtos_irq_raise(uint32_t irq);
+
+/**
+ * Set up a work item. The first one also creates the IRQ worker task.
+ * @param work: Work item to initialize
+ * @param function: Bottom half to run
+ * @param param: Stored in work->param for the function
+ * @return: 0 on success, -1 on bad arguments or outside context-switch mode
+ */
+int deferred_work_init(deferred_work_t* work, deferred_work_fn_t function, void* param);
+
+/**
+ * Have a work item's function run in the IRQ worker task. Lock-free and
+ * safe in a top half; queueing an item that has not run yet only adds
+ * to its event count.
+ * @param work: Work item from deferred_work_init
+ * @return: 0 on success, -1 if the item was not initialized
+ */
+int deferred_work_queue(deferred_work_t* work);
+
+/*
+ * ASYNCHRONOUS I/O
+ *
+ * A task waiting for a host file descriptor (socket, pipe, ...) blocks
+ * like any other waiting task instead of blocking the core's host thread,
+ * so thousands of tasks can each wait on a connection while one thread
+ * runs them all. One epoll instance watches every waited-on descriptor;
+ * an idle core sleeps in it, and a busy core looks at it once per tick
+ * (see io.c). Set descriptors to non-blocking and read or write them
+ * once task_wait_fd says they are ready. Context-switch mode only.
+ */
+#define IO_READABLE 0x1u                 // Data (or end of stream) to read
+#define IO_WRITABLE 0x2u                 // Room to write
+#define IO_ERROR 0x4u                    // Error or hang-up (always reported)
+
+/**
+ * Block the current task until a descriptor is ready. Only one task may
+ * wait on a descriptor at a time. Not for stackless tasks.
+ * @param fd: Host file descriptor
+ * @param events: IO_READABLE and/or IO_WRITABLE
+ * @param timeout_ms: 0 to poll, RTOS_WAIT_FOREVER to wait without limit
+ * @return: The IO_* events that are ready, 0 on timeout, -1 on error
+ */
+int task_wait_fd(int fd, uint32_t events, uint32_t timeout_ms);
+
+/*
+ * PROTOTHREAD MACROS (stackless task bodies)
+ *
+ * The body is one switch statement on pt->resume, and every wait is a
+ * case label inside it, so a waiting task returns from its function and
+ * continues at the same line the next time it is switched in:
+ *
+ *   static pt_status_t sensor(pt_t* pt, void* param) {
+ *       sensor_t* s = param;
+ *       PT_BEGIN(pt);
+ *       while (1) {
+ *           PT_NOTIFY_TAKE(pt, true, s->samples);
+ *           s->total += s->samples;
+ *       }
+ *       PT_END(pt);
+ *   }
+ *
+ * Inside a body, kernel calls that may block must go through a macro
+ * (semaphores, mutexes, sleeps, notifications and queues are covered;
+ * event group waits need a stack and fail). A switch statement of your own may
+ * not span a wait. Other tasks get the CPU only when the body waits,
+ * yields or ends: preemption, like blocking, happens on return.
+ */
+#define PT_BEGIN(pt) switch ((pt)->resume) { case 0:
+
+#define PT_END(pt) } (pt)->resume = 0; return PT_EXITED
+
+// Resume point: reached only by the switch, never by falling into it
+#define PT_LABEL_ if (0) { case __LINE__:; }
+
+// Make a kernel call that finishes the job when it wakes the task (a
+// semaphore unit or mutex handed over, a sleep over)
+#define PT_WAIT_CALL(pt, call) \
+    do { (pt)->resume = __LINE__; call; \
+         if (task_will_block()) { return PT_WAITING; } PT_LABEL_ } while (0)
+
+// Make a kernel call that has to be repeated after the wake-up
+#define PT_RETRY_CALL(pt, call) \
+    do { (pt)->resume = __LINE__; PT_LABEL_ call; \
+         if (task_will_block()) { return PT_WAITING; } } while (0)
+
+#define PT_YIELD(pt) \
+    do { (pt)->resume = __LINE__; return PT_YIELDED; PT_LABEL_ } while (0)
+
+#define PT_EXIT(pt) do { (pt)->resume = 0; return PT_EXITED; } while (0)
+
+// Polls: yields until the condition holds. Prefer a kernel wait.
+#define PT_WAIT_UNTIL(pt, condition) \
+    do { while (!(condition)) { PT_YIELD(pt); } } while (0)
+
+#define PT_SLEEP(pt, ms) PT_WAIT_CALL(pt, task_sleep(ms))
+#define PT_SEM_WAIT(pt, sem) PT_WAIT_CALL(pt, semaphore_wait(sem))
+#define PT_MUTEX_LOCK(pt, mutex) PT_WAIT_CALL(pt, mutex_lock(mutex))
+
+// value receives the notification count (see task_notify_take)
+#define PT_NOTIFY_TAKE(pt, clear_on_exit, value) \
+    PT_RETRY_CALL(pt, (value) = task_notify_take(clear_on_exit, RTOS_WAIT_FOREVER))
+
+// value (a uint32_t*, or NULL) receives the notification value
+#define PT_NOTIFY_WAIT(pt, clear_on_exit, value) \
+    PT_RETRY_CALL(pt, task_notify_wait(clear_on_exit, value, RTOS_WAIT_FOREVER))
+
+// item must not live in the body's locals (see task_create_stackless);
+// result receives 0, or -1 if the queue could not wait (see queue_send)
+#define PT_QUEUE_SEND(pt, queue, item, result) \
+    PT_RETRY_CALL(pt, (result) = queue_send(queue, item))
+#define PT_QUEUE_RECEIVE(pt, queue, item, result) \
+    PT_RETRY_CALL(pt, (result) = queue_receive(queue, item))
+
+#endif // RTOS_H
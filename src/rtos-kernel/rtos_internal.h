@@ -0,0 +1,739 @@
+/*
+ * RTOS Kernel - Internal Header
+ *
+ * Declarations shared between the kernel's source files but not part of
+ * the public API in rtos.h. Application code should never include this.
+ *
+ * The kernel is split by subsystem:
+ * - scheduler.c: per-core run queues, work stealing, wait queues, time
+ *                slicing, context switching
+ * - tasks.c:     task creation/deletion, task table, stack pool
+ * - port.c:      host port layer that really switches task stacks and
+ *                runs each SMP core on its own thread
+ * - sync.c:      mutexes, semaphores, task notifications, event groups
+ * - queue.c:     lock-free message queues
+ * - realtime.c:  periodic tasks, EDF/RM admission and deadline tracking
+ * - trace.c:     per-core binary event trace and Chrome/Perfetto export
+ * - sim.c:       virtual-time discrete-event simulation of task scripts
+ * - heap.c:      TLSF heap with per-task ownership, partition pools
+ * - timers.c:    software timers and the timer task
+ * - irq.c:       simulated interrupts, deferred-work queue and IRQ worker
+ */
+
+#ifndef RTOS_INTERNAL_H
+#define RTOS_INTERNAL_H
+
+#include "rtos.h"
+#include <stdio.h>
+
+/*
+ * KERNEL LOGGING
+ *
+ * Every kernel event used to be printed unconditionally. That is great for
+ * following the scheduler step by step, but far too slow once thousands of
+ * tasks are created per second, so benchmarks build with RTOS_VERBOSE=0.
+ */
+#define RTOS_LOG(...) do { if (RTOS_VERBOSE) printf(__VA_ARGS__); } while (0)
+
+/*
+ * SPINLOCKS
+ *
+ * Kernel critical sections are a handful of pointer updates, far shorter
+ * than putting a host thread to sleep, so cores simply spin. Both locks
+ * compile down to nothing when only one core runs.
+ */
+typedef struct {
+    int locked;
+} spinlock_t;
+
+/**
+ * Back off inside a spin loop
+ * @param spins: Caller's spin counter (start at 0); after a while the
+ *               host thread yields so a preempted lock holder can run
+ */
+void port_relax(uint32_t* spins);
+
+static inline void spin_lock(spinlock_t* lock) {
+    uint32_t spins = 0;
+    while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)) {
+            port_relax(&spins);
+        }
+    }
+}
+
+static inline bool spin_trylock(spinlock_t* lock) {
+    return !__atomic_load_n(&lock->locked, __ATOMIC_RELAXED) &&
+           !__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE);
+}
+
+static inline void spin_unlock(spinlock_t* lock) {
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * PER-CORE SCHEDULER STATE (owned by scheduler.c)
+ *
+ * The lock only protects the run queues: other cores take it to place a
+ * woken task here or to steal one. Everything else is touched only by the
+ * core itself, except the admission totals, which the kernel lock guards.
+ *
+ * Under EDF and RM, ready periodic tasks sit in a binary min-heap ordered
+ * by deadline instead of the priority lists, and always run first.
+ */
+typedef struct rtos_core {
+    uint32_t id;                             // Index in cores[]
+    spinlock_t lock;                         // Protects ready_queues/ready_count
+    tcb_t* ready_queues[PRIORITY_LEVELS];    // Ready queues per priority
+    uint32_t ready_count;                    // Queued tasks, not counting idle
+    tcb_t** rt_heap;                         // Ready periodic tasks, earliest deadline first
+    uint32_t rt_heap_size;                   // Tasks in rt_heap
+    uint32_t rt_heap_capacity;               // Slots in rt_heap
+    uint32_t rt_tasks;                       // Periodic tasks admitted to this core
+    uint32_t rt_utilization;                 // Their summed density (parts per million)
+    tcb_t* current;                          // Task running on this core
+    tcb_t* idle;                             // Runs when nothing else is ready
+    uint32_t last_tick;                      // Tick up to which slices were charged
+    uint32_t steal_cursor;                   // Next core to try stealing from
+    uint32_t idle_wakeups;                   // Bumped to wake the core from idle sleep
+    uint32_t idle_exit_ns;                   // Average lateness of timed idle sleeps
+    uint64_t idle_until_ns;                  // Wake-up the idle core sleeps for (0 awake, UINT64_MAX none)
+    tcb_t* switch_prev;                      // Task being switched out (port.c)
+    tcb_t* exited_task;                      // Deleted task we may still be on (port.c)
+    bool in_stackless;                       // Running a stackless task's function
+    core_stats_t stats;                      // Per-core counters
+    char pad[64];                            // Keep cores off each other's cache lines
+} rtos_core_t;
+
+#define TASK_NO_CORE 0xFF                     // tcb core before the first run
+#define TASK_NOT_SLEEPING 0xFFFFFFFFu         // tcb sleep_index outside the sleep queue
+#define REALTIME_UNMONITORED 0xFFFFFFFFu      // tcb monitor_index outside the deadline monitor
+
+extern rtos_core_t cores[RTOS_MAX_CORES];     // Scheduler cores
+extern uint32_t core_count;                   // Cores in use
+
+/**
+ * The core the calling host thread runs (port.c). Never inlined: a task
+ * can resume on a different thread after any switch, so the thread-local
+ * lookup must be redone on every use rather than cached by the compiler.
+ * @return: Core bound to this thread, or a core with no current task for
+ *          threads outside the kernel
+ */
+rtos_core_t* this_core(void);
+
+#define current_task (this_core()->current)      // Task running on this core
+#define idle_task (this_core()->idle)            // This core's idle task
+
+/*
+ * KERNEL LOCK
+ *
+ * Serializes the slow paths that touch shared kernel objects: the task
+ * table, wait queues, mutex ownership and the tick count. Order is always
+ * kernel lock first, then at most one core lock, and it is never held
+ * across a context switch.
+ */
+extern spinlock_t kernel_spinlock;
+
+static inline void kernel_lock(void) {
+    if (core_count > 1) {
+        spin_lock(&kernel_spinlock);
+    }
+}
+
+static inline void kernel_unlock(void) {
+    if (core_count > 1) {
+        spin_unlock(&kernel_spinlock);
+    }
+}
+
+/*
+ * SHARED SCHEDULER STATE (owned by scheduler.c)
+ */
+extern uint32_t system_tick_count;            // System tick counter
+extern scheduler_stats_t stats;               // Scheduler statistics
+extern bool scheduler_running;                // Scheduler state
+extern rtos_mode_t rtos_mode;                 // How tasks are executed
+extern sched_policy_t sched_policy;           // How ready tasks are ordered
+
+/**
+ * Is a task scheduled by deadline rather than by priority?
+ * @param task: Task to check
+ * @return: true for periodic tasks under EDF or RM
+ */
+static inline bool task_is_realtime(const tcb_t* task) {
+    return task->period != 0 && sched_policy != SCHED_FIXED_PRIORITY;
+}
+
+/*
+ * READY QUEUE MANAGEMENT (scheduler.c)
+ */
+
+/**
+ * Make a task ready on the run queue of a core it may run on
+ * @param task: Task to queue
+ */
+void add_task_to_ready_queue(tcb_t* task);
+
+/**
+ * Take a task off whichever core's run queue holds it
+ * @param task: Task to remove
+ * @return: true if it was queued, false if it is running or being switched in
+ */
+bool remove_task_from_ready_queue(tcb_t* task);
+
+tcb_t* get_highest_priority_ready_task(void);
+void wake_sleeping_tasks(void);
+
+/**
+ * Find the earliest tick at which a blocked task wakes (a timeout, a
+ * sleep or a periodic release)
+ * @param wake: Receives the tick
+ * @return: true if some task is waiting on a timeout
+ */
+bool next_wake_tick(uint32_t* wake);
+
+/**
+ * Catch the tick count up with the host clock (context-switch mode),
+ * waking tasks that became due and the IRQ worker if work was queued
+ */
+void poll_host_clock(void);
+
+/**
+ * Wake a core from idle sleep after deferred work was queued. Safe in
+ * interrupt context: only atomics and a futex wake.
+ */
+void idle_kick_interrupt(void);
+
+/**
+ * Block the current task until a tick. Called with the kernel lock held,
+ * which it releases.
+ * @param tick: Tick to wake at, 0 to wait for task_wake_at or task_unblock
+ */
+void task_block_until(uint32_t tick);
+
+/**
+ * Set the tick a blocked task wakes at, or cancel its wake-up with 0,
+ * keeping the sleep queue in order (kernel lock held)
+ * @param task: Blocked task
+ * @param tick: Tick to wake at, 0 for none
+ */
+void task_set_wake_time(tcb_t* task, uint32_t tick);
+
+/**
+ * Make sure the sleep queue can hold every task, so blocking with a
+ * timeout never allocates
+ * @param tasks: Task table slots
+ * @return: 0 on success, -1 if out of memory
+ */
+int sleep_queue_reserve(uint32_t tasks);
+
+/**
+ * Bring forward the wake-up of a task blocked in task_block_until (kernel
+ * lock held); a later tick than the current one is ignored
+ * @param task: Blocked task
+ * @param tick: Tick to wake at
+ */
+void task_wake_at(tcb_t* task, uint32_t tick);
+
+/**
+ * Make sure a core's deadline heap can hold all its periodic tasks, so
+ * queueing one never allocates
+ * @param core: Core a periodic task was admitted to
+ * @param tasks: Periodic tasks admitted to it
+ * @return: 0 on success, -1 if out of memory
+ */
+int run_queue_reserve_realtime(rtos_core_t* core, uint32_t tasks);
+
+/**
+ * Enter the scheduler on the calling core and run tasks until rtos_stop
+ */
+void scheduler_run_core(void);
+
+/**
+ * Switch to a higher priority ready task, or to a same-priority one if
+ * the current task's time slice is used up
+ */
+void scheduler_reschedule(void);
+
+/**
+ * Call the current stackless task's function once, then switch away if
+ * it blocked, yielded or ended (the loop of each core's runner, port.c)
+ */
+void stackless_run(void);
+
+/**
+ * Give a task a fresh time slice, sized for its priority level (and, with
+ * adaptive slicing, for how it has used its slices so far)
+ * @param task: Task about to run or be queued
+ */
+void task_grant_time_slice(tcb_t* task);
+
+#define SLICE_USAGE_START 128                 // slice_usage of a new task: neither kind yet
+
+/**
+ * Change the priority a task is scheduled at (used by priority
+ * inheritance), re-queuing it on its ready queue or wait queue
+ * @param task: Task to change
+ * @param priority: New effective priority
+ */
+void task_set_effective_priority(tcb_t* task, uint8_t priority);
+
+/*
+ * WAIT QUEUES (scheduler.c)
+ *
+ * Priority-ordered lists of blocked tasks, threaded through tcb next/prev.
+ */
+void wait_queue_insert(tcb_t** queue, tcb_t* task);
+void wait_queue_remove(tcb_t* task);
+
+/**
+ * Block the current task on a wait queue and switch to the next task.
+ * Called with the kernel lock held; releases it before switching.
+ * @param queue: Wait queue to sleep on
+ */
+void task_block_on(tcb_t** queue);
+
+/**
+ * Switch away from a current task that is no longer RUNNING (already on
+ * a wait queue or sleeping). Called with the kernel lock held.
+ */
+void task_block_current(void);
+
+/**
+ * Remove a task from its wait queue and make it ready (kernel lock held)
+ * @param task: Blocked task
+ */
+void task_unblock(tcb_t* task);
+
+/*
+ * TASK TABLE (tasks.c)
+ */
+
+/**
+ * Reset the task table and stack pool to an empty state
+ * @return: 0 on success, -1 on failure
+ */
+int task_table_init(void);
+
+/**
+ * Number of slots ever handed out (upper bound for iteration)
+ * @return: Slot high-water mark
+ */
+uint32_t task_table_slot_count(void);
+
+/**
+ * Get the task occupying a slot
+ * @param slot: Slot index below task_table_slot_count()
+ * @return: Pointer to the TCB, NULL if the slot is free
+ */
+tcb_t* task_table_slot(uint32_t slot);
+
+/**
+ * Look for high-water marks in a bounded number of stack words, carrying
+ * on where the previous call stopped (idle task; takes the kernel lock)
+ */
+void stack_scan_step(void);
+
+/**
+ * Queue a deleted task's slot and stack for reclaim (takes the kernel lock)
+ * @param task: Task already removed from the scheduler and ID index
+ */
+void task_reclaim(tcb_t* task);
+
+/**
+ * Return up to RECLAIM_BATCH queued slots and stacks to the pools (idle
+ * task; takes the kernel lock)
+ * @return: true if more are left for the next pass
+ */
+bool task_reclaim_drain(void);
+
+/**
+ * Finish deleting a task that task_delete found running on another core,
+ * now that this core has switched it out (port_finish_switch)
+ * @param task: Task with delete_requested set and its registers saved
+ */
+void task_delete_switched_out(tcb_t* task);
+
+/**
+ * Find a task by ID without taking the kernel lock
+ * @param task_id: Task ID
+ * @return: Pointer to the TCB, NULL if not found
+ */
+tcb_t* task_lookup(uint32_t task_id);
+
+/**
+ * Create a task with the kernel lock already held
+ * @return: Task ID on success, 0 on failure (see task_create)
+ */
+uint32_t task_create_locked(const char* name, void (*task_func)(void* param),
+                            void* param, uint8_t priority, uint32_t stack_size);
+
+/**
+ * Bytes of address space currently mapped for task stacks
+ * @return: Mapped stack memory including guard pages
+ */
+size_t stack_pool_mapped_bytes(void);
+
+/*
+ * PERIODIC TASKS (realtime.c)
+ */
+
+/**
+ * Account for a finished periodic job and advance to the next release
+ * (kernel lock held)
+ * @param task: Periodic task finishing its job
+ * @return: true if the next release is in the future and the task should
+ *          sleep until release_time, false if the next job is already due
+ */
+bool realtime_finish_job(tcb_t* task);
+
+/**
+ * Count a miss for every periodic job still unfinished past its deadline
+ * (called on each tick, kernel lock held)
+ */
+void realtime_check_deadlines(void);
+
+/**
+ * Give a deleted periodic task's utilisation back to its core
+ * (kernel lock held)
+ * @param task: Periodic task being deleted
+ */
+void realtime_release(tcb_t* task);
+
+/**
+ * Forget all periodic tasks (called by rtos_init, which deletes them)
+ */
+void realtime_reset(void);
+
+/*
+ * SCHEDULER TRACE (trace.c)
+ *
+ * Scheduling events are recorded as fixed-size binary records into a ring
+ * per core instead of being printed. Recording costs a cycle-counter read
+ * and a few stores, and nothing at all beyond one branch while tracing is
+ * off, so it can stay enabled while measuring.
+ */
+typedef enum {
+    TRACE_SWITCH = 1,                         // task switched in, arg = task switched out
+    TRACE_WAKE,                               // task made ready, arg = core it was queued on
+    TRACE_BLOCK,                              // task blocked, arg = wake tick (0 = no timeout)
+    TRACE_PREEMPT,                            // task switched out while ready, arg = successor
+    TRACE_TICK                                // system tick, arg = tick number
+} trace_type_t;
+
+typedef struct {
+    uint64_t timestamp;                       // port_cycles() when recorded
+    uint32_t seq;                             // Ring position + 1, 0 while being written
+    uint32_t task_id;                         // Task the event is about (0 = none)
+    uint32_t arg;                             // Meaning depends on type
+    uint16_t depth;                           // Recording core's run queue length
+    uint8_t type;                             // trace_type_t
+    uint8_t core;                             // Recording core
+} trace_event_t;
+
+extern bool trace_enabled;                    // Set by rtos_trace_start
+
+/**
+ * Append an event to the calling core's ring (use trace_record)
+ * @param type: Event type
+ * @param task_id: Task the event is about
+ * @param arg: Event argument
+ */
+void trace_write(trace_type_t type, uint32_t task_id, uint32_t arg);
+
+static inline void trace_record(trace_type_t type, const tcb_t* task, uint32_t arg) {
+    if (__builtin_expect(trace_enabled, 0)) {
+        trace_write(type, task != NULL ? task->task_id : 0, arg);
+    }
+}
+
+/*
+ * VIRTUAL TIME (sim.c)
+ */
+
+/**
+ * Run the virtual-time simulation until no task will ever run again
+ * (rtos_start in RTOS_MODE_VIRTUAL_TIME)
+ */
+void sim_run_to_completion(void);
+
+/**
+ * Carry scripted tasks one tick further (each tick of rtos_start's loop
+ * in RTOS_MODE_SIMULATED)
+ * @param ran: Task that was running before the tick
+ */
+void sim_tick_scripts(tcb_t* ran);
+
+/*
+ * HEAP (heap.c)
+ */
+
+/**
+ * Start a fresh, empty heap (called by rtos_init)
+ * @return: 0 on success, -1 if the heap could not be mapped
+ */
+int heap_init(void);
+
+/**
+ * Free every block a task still owns (called by task_delete with the
+ * kernel lock held)
+ * @param task: Task being deleted
+ */
+void heap_release_task(tcb_t* task);
+
+/*
+ * SOFTWARE TIMERS (timers.c)
+ */
+
+/**
+ * Forget all timers (called by rtos_init, which deletes the timer task)
+ */
+void timers_reset(void);
+
+/*
+ * INTERRUPTS AND DEFERRED WORK (irq.c)
+ */
+
+/**
+ * Run the top half of an IRQ line (port.c's signal handler)
+ * @param irq: Line that was raised
+ */
+void irq_dispatch(uint32_t irq);
+
+/**
+ * Is work queued while the IRQ worker sleeps? (lock-free; a core must
+ * not go to sleep while it is)
+ * @return: true if the worker has to be readied
+ */
+bool deferred_work_pending(void);
+
+/**
+ * Ready the IRQ worker if work is queued for it (every kernel entry)
+ */
+void deferred_work_poll(void);
+
+/**
+ * Detach all handlers and forget queued work (called by rtos_init, which
+ * deletes the IRQ worker)
+ */
+void irq_reset(void);
+
+/*
+ * ASYNCHRONOUS I/O (io.c)
+ */
+
+/**
+ * Look at the I/O multiplexer without waiting and ready the tasks whose
+ * descriptors are ready (once per tick, from the tick path)
+ */
+void io_poll(void);
+
+/**
+ * Sleep an idle core in the I/O multiplexer instead of port_idle_wait,
+ * if tasks wait for I/O and no other core sleeps there already. Ends at
+ * the deadline, on I/O, or on io_idle_wake.
+ * @param core: The idle core
+ * @param seen: Value of core->idle_wakeups read before deciding to sleep
+ * @param deadline_ns: port_time_ns() value to wake at, 0 for none
+ * @return: true if the core slept (or had been woken meanwhile), false
+ *          if the caller should sleep on its futex word instead
+ */
+bool io_idle_wait(rtos_core_t* core, uint32_t seen, uint64_t deadline_ns);
+
+/**
+ * Wake a core sleeping in io_idle_wait (after its wake-up counter moved;
+ * safe in a signal handler)
+ * @param core: Core being woken
+ */
+void io_idle_wake(rtos_core_t* core);
+
+/**
+ * Stop a deleted task's wait for I/O (kernel lock held)
+ * @param task: Task blocked in task_wait_fd
+ */
+void io_cancel_wait(tcb_t* task);
+
+/**
+ * Forget all waits (called by rtos_init, whose port_reset closes the
+ * multiplexer)
+ */
+void io_reset(void);
+
+/*
+ * HOST PORT (port.c)
+ */
+
+typedef struct {
+    uint64_t token;                          // Given to port_io_arm
+    uint32_t events;                         // IO_* events that are ready
+} port_io_event_t;
+
+/**
+ * Prepare a task's stack so the first switch to it enters its function
+ * @param task: New task with stack_base and stack_size set
+ * @return: 0 on success, -1 on failure
+ */
+int port_init_task(tcb_t* task);
+
+/**
+ * Make sure every core has a runner to call stackless tasks on
+ * (kernel lock held)
+ * @return: 0 on success, -1 if a runner stack could not be mapped
+ */
+int port_init_stackless(void);
+
+/**
+ * Save the CPU context of one task and restore another's
+ * @param from: Outgoing task (NULL when starting the scheduler)
+ * @param to: Incoming task
+ */
+void port_switch(tcb_t* from, tcb_t* to);
+
+/**
+ * Housekeeping after a switch: releases the outgoing task to other cores,
+ * re-queues it if it was preempted, and frees a deleted task once off its
+ * stack
+ */
+void port_finish_switch(void);
+
+/**
+ * Let the host CPU go while a core has nothing to run (the host's
+ * equivalent of the WFI instruction), so core threads sharing a CPU do
+ * not burn each other's time slices
+ */
+void port_idle(void);
+
+/**
+ * Sleep the host thread until a deadline or until port_idle_wake, unless
+ * the wake-up already happened (the host's equivalent of entering a
+ * low-power state until the next timer or device interrupt)
+ * @param word: The sleeping core's wake-up counter
+ * @param seen: Value of *word read before deciding to sleep
+ * @param deadline_ns: port_time_ns() value to wake at, 0 for none
+ */
+void port_idle_wait(uint32_t* word, uint32_t seen, uint64_t deadline_ns);
+
+/**
+ * Wake a host thread sleeping in port_idle_wait (or make its next wait
+ * return at once)
+ * @param word: The sleeping core's wake-up counter
+ */
+void port_idle_wake(uint32_t* word);
+
+/**
+ * Run every core on its own pinned host thread until rtos_stop
+ * @param count: Number of cores
+ */
+void port_run_cores(uint32_t count);
+
+/**
+ * Leave the running tasks and resume the caller of rtos_start
+ * @param from: Task calling rtos_stop
+ */
+void port_exit_to_kernel(tcb_t* from);
+
+/**
+ * Install the signal handler for an IRQ line
+ * @param irq: Line below RTOS_IRQ_LINES
+ * @return: 0 on success, -1 on failure
+ */
+int port_irq_install(uint32_t irq);
+
+/**
+ * Interrupt core 0's host thread with an IRQ line's signal
+ * @param irq: Line below RTOS_IRQ_LINES
+ * @return: 0 on success, -1 if the signal could not be sent
+ */
+int port_irq_raise(uint32_t irq);
+
+/**
+ * Watch a descriptor for one report of the given events (creates the
+ * I/O multiplexer on first use)
+ * @param fd: Host file descriptor
+ * @param events: IO_READABLE and/or IO_WRITABLE
+ * @param token: Returned with the events (never 0)
+ * @return: 0 on success, -1 if the descriptor cannot be watched
+ */
+int port_io_arm(int fd, uint32_t events, uint64_t token);
+
+/**
+ * Stop watching a descriptor
+ * @param fd: Host file descriptor
+ */
+void port_io_disarm(int fd);
+
+/**
+ * Collect ready descriptors, optionally waiting for the first one
+ * @param out: Receives up to max events
+ * @param max: Capacity of out
+ * @param block: Wait until something is ready, the deadline passes or
+ *               port_io_wake is called
+ * @param deadline_ns: port_time_ns() value to stop waiting at, 0 for none
+ * @return: Number of events stored (0 if none or woken)
+ */
+uint32_t port_io_poll(port_io_event_t* out, uint32_t max, bool block, uint64_t deadline_ns);
+
+/**
+ * End a blocking port_io_poll (or make the next one return at once);
+ * safe in a signal handler
+ */
+void port_io_wake(void);
+
+/**
+ * Forget per-run port state and bind the calling thread to core 0
+ * (called by rtos_init)
+ */
+void port_reset(void);
+
+/**
+ * Host monotonic clock
+ * @return: Nanoseconds since an arbitrary epoch
+ */
+uint64_t port_time_ns(void);
+
+/**
+ * Sleep the host thread until an absolute time on the monotonic clock
+ * @param deadline_ns: port_time_ns() value to wake at
+ */
+void port_sleep_until(uint64_t deadline_ns);
+
+/**
+ * Cheapest high-resolution timestamp the host offers: the CPU's cycle
+ * counter (TSC) on x86, the monotonic clock elsewhere
+ * @return: Counter value; only differences are meaningful
+ */
+uint64_t port_cycles(void);
+
+/**
+ * Length of one port_cycles() unit, measured once against the monotonic
+ * clock (the first call takes about 2 ms)
+ * @return: Nanoseconds per cycle
+ */
+double port_ns_per_cycle(void);
+
+/*
+ * SYNCHRONIZATION (sync.c)
+ */
+
+/**
+ * Recompute a task's effective priority after its base priority changed,
+ * keeping what its mutexes' waiters lend it, and pass a raise on to the
+ * owner of the mutex it waits on (kernel lock held)
+ * @param task: Task whose base_priority was set
+ */
+void mutex_priority_changed(tcb_t* task);
+
+/**
+ * Remove a task that is being deleted from the mutex it waits on,
+ * undoing any priority it lent the owner
+ * @param task: Task blocked in mutex_lock
+ */
+void mutex_cancel_wait(tcb_t* task);
+
+/**
+ * Unlink a task that is being deleted from the event group it waits on
+ * @param task: Task blocked in event_group_wait
+ */
+void event_group_cancel_wait(tcb_t* task);
+
+#endif // RTOS_INTERNAL_H
@@ -9,9 +9,36 @@
  * 2. Within each priority level, tasks are scheduled round-robin
  * 3. Higher priority tasks preempt lower priority tasks
  * 4. Time slicing prevents task starvation within same priority
+ * 
+ * Each priority level has its own time slice. A task preempted by a
+ * higher priority one keeps the rest of its slice and its turn: it goes
+ * back to the head of its level, not the tail, as under POSIX SCHED_RR.
+ * Otherwise frequent high priority activity would rotate a level at its
+ * own pace and the slice length would not matter. With adaptive slicing on,
+ * the kernel also watches how much of its slice each task uses: tasks
+ * that block early (interactive) are scheduled one level up with a
+ * short slice, tasks that run their slices out (CPU-bound) get long
+ * slices and so fewer switches.
+ * 
+ * Under the EDF and RM policies, periodic tasks come before all of that:
+ * they are ordered by deadline in a heap and run to the end of each job
+ * without time slicing (see realtime.c for admission and deadlines).
+ * 
+ * EXECUTION MODES:
+ * In RTOS_MODE_SIMULATED, rtos_start ticks the scheduler every 1 ms and
+ * task switches are only bookkeeping. In RTOS_MODE_CONTEXT_SWITCH the port
+ * layer (port.c) really switches stacks, and ticks follow the host clock.
+ * 
+ * SMP:
+ * Every core runs this same scheduler on its own run queues. current_task
+ * and idle_task resolve to the calling core's. Cores only share the task
+ * table and synchronization objects, which are guarded by the kernel lock,
+ * and they touch each other's run queues only to place a woken task or to
+ * steal one.
  */
 
-#include "rtos.h"
+#define _GNU_SOURCE
+#include "rtos_internal.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,417 +46,1582 @@
 /*
  * GLOBAL SCHEDULER STATE
  */
-static tcb_t* ready_queues[PRIORITY_LEVELS];  // Ready queues per priority
-static tcb_t* current_task = NULL;            // Currently running task
-static tcb_t* idle_task = NULL;               // Idle task (always ready)
-static uint32_t next_task_id = 1;             // Next available task ID
-static bool scheduler_running = false;         // Scheduler state
-static uint32_t system_tick_count = 0;        // System tick counter
-static scheduler_stats_t stats = {0};         // Scheduler statistics
+rtos_core_t cores[RTOS_MAX_CORES];            // Run queues and current task per core
+uint32_t core_count = 1;                      // Cores in use
+spinlock_t kernel_spinlock;                   // Serializes kernel slow paths
+bool scheduler_running = false;               // Scheduler state
+uint32_t system_tick_count = 0;               // System tick counter
+scheduler_stats_t stats = {0};                // Scheduler statistics
+rtos_mode_t rtos_mode = RTOS_MODE_SIMULATED;  // How tasks are executed
+sched_policy_t sched_policy = SCHED_FIXED_PRIORITY; // How ready tasks are ordered
+static uint64_t start_time_ns = 0;            // Host time at rtos_start
+static rtos_switch_hook_t switch_hook = NULL; // Latency probe, see rtos_set_switch_hook
+static uint64_t start_cycles = 0;             // port_cycles() at rtos_start
+static uint64_t stop_cycles = 0;              // port_cycles() when rtos_start returned
+static uint64_t cycles_to_us_q32 = 0;         // Microseconds per cycle, 32.32 fixed point
+static uint32_t sleeping_cores = 0;           // Bit per core whose host thread is in idle sleep
+static uint32_t time_slices[PRIORITY_LEVELS]; // Slice per level, 0 = TIME_SLICE_MS
+static bool adaptive_slicing = false;         // See rtos_set_adaptive_slicing
+static tcb_t** sleep_heap = NULL;             // Blocked tasks with a wake-up, earliest first
+static uint32_t sleep_heap_size = 0;          // Tasks in sleep_heap
+static uint32_t sleep_heap_capacity = 0;      // Slots in sleep_heap
 
 /*
  * TASK STORAGE
- * In a real RTOS, this would be dynamically allocated
+ * TCBs and stacks are allocated on demand by the task table in tasks.c
+ */
+
+/*
+ * TICKLESS IDLE
+ * 
+ * A periodic tick wakes an idle CPU a thousand times a second just to
+ * find there is still nothing to do. When only the idle task is left, the
+ * next thing that can happen is either the earliest timed wake-up or a
+ * task being readied from outside (another core, or a host thread). So
+ * the idle core sleeps its host thread until that wake-up is due, and
+ * whoever readies a task for it wakes it early. The ticks that passed are
+ * accounted for in one go when it wakes.
+ * 
+ * The sleeper announces itself in sleeping_cores before its last look at
+ * the run queues, and a waker queues its task before looking at
+ * sleeping_cores. Both steps are full barriers, so at least one side
+ * sees the other and no wake-up is lost.
+ */
+
+/*
+ * The host takes a while to get a sleeping thread going again (much
+ * longer under a hypervisor than on bare metal). Each core keeps a
+ * running average of how late its timed sleeps end, and wakes twice that
+ * early, then polls the clock; the woken task is not made to wait for the
+ * host, at the price of a short spin per wake-up.
+ */
+#define IDLE_EXIT_INITIAL_NS 50000u           // Estimate before the first sleep
+#define IDLE_EXIT_MAX_NS 500000u              // Never spin more than half a tick
+
+// Wake an idle core, wherever it sleeps
+static void idle_wake(rtos_core_t* core) {
+    port_idle_wake(&core->idle_wakeups);
+    io_idle_wake(core);
+}
+
+static bool work_queued(void) {
+    for (uint32_t i = 0; i < core_count; i++) {
+        if (__atomic_load_n(&cores[i].ready_count, __ATOMIC_RELAXED) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Sleep unless work is queued somewhere. seen is the core's wake-up count
+ * from before the caller chose the deadline, so a kick that came since
+ * ends the sleep at once.
+ */
+static bool idle_sleep(rtos_core_t* core, uint32_t seen, uint64_t deadline_ns) {
+    uint32_t bit = 1u << core->id;
+    bool slept = false;
+    
+    __atomic_fetch_or(&sleeping_cores, bit, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&scheduler_running, __ATOMIC_ACQUIRE) && !work_queued() &&
+        !deferred_work_pending()) {
+        core->stats.idle_sleeps++;
+        if (!io_idle_wait(core, seen, deadline_ns)) {
+            port_idle_wait(&core->idle_wakeups, seen, deadline_ns);
+        }
+        slept = true;
+    }
+    __atomic_fetch_and(&sleeping_cores, ~bit, __ATOMIC_RELAXED);
+    
+    return slept;
+}
+
+/*
+ * Called after a task was queued on target. A sleeping target is woken;
+ * if target is busy running something else, a sleeping core is woken to
+ * steal the task instead.
+ */
+static void idle_kick(rtos_core_t* target) {
+    if (rtos_mode == RTOS_MODE_VIRTUAL_TIME) {
+        return;
+    }
+    
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint32_t sleepers = __atomic_load_n(&sleeping_cores, __ATOMIC_RELAXED);
+    if (sleepers == 0) {
+        return;
+    }
+    
+    if (sleepers & (1u << target->id)) {
+        idle_wake(target);
+        return;
+    }
+    
+    tcb_t* running = __atomic_load_n(&target->current, __ATOMIC_RELAXED);
+    if (running != NULL && !running->is_idle) {
+        idle_wake(&cores[__builtin_ctz(sleepers)]);
+    }
+}
+
+/*
+ * Called from interrupt context once deferred work is queued: core 0,
+ * which takes the interrupts, if it sleeps, else any sleeping core. The
+ * woken core readies the IRQ worker at its next kernel entry.
+ */
+void idle_kick_interrupt(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint32_t sleepers = __atomic_load_n(&sleeping_cores, __ATOMIC_RELAXED);
+    if (sleepers != 0) {
+        idle_wake(&cores[__builtin_ctz(sleepers)]);
+    }
+}
+
+/*
+ * Called with the kernel lock held when the running task sets a wake-up
+ * tick. On SMP an idle core may be asleep until a later one; waking it
+ * lets it choose a new deadline. (Idle cores publish their deadline under
+ * the kernel lock, so none can miss the new tick.)
  */
-static tcb_t task_pool[MAX_TASKS];            // Pre-allocated task pool
-static uint8_t task_stacks[MAX_TASKS][STACK_SIZE]; // Pre-allocated stacks
-static bool task_pool_used[MAX_TASKS] = {false}; // Track used slots
+static void idle_kick_timer(uint32_t wake) {
+    if (rtos_mode != RTOS_MODE_CONTEXT_SWITCH || core_count == 1) {
+        return;
+    }
+    
+    uint64_t due_ns = rtos_tick_time_ns(wake);
+    for (uint32_t i = 0; i < core_count; i++) {
+        uint64_t until_ns = __atomic_load_n(&cores[i].idle_until_ns, __ATOMIC_RELAXED);
+        if (until_ns != 0 && until_ns > due_ns) {
+            idle_wake(&cores[i]);
+            return;
+        }
+    }
+}
+
+/*
+ * Context-switch mode: sleep until the earliest wake-up is about due, or
+ * for good if no task is waiting on a timeout
+ */
+static void idle_wait(void) {
+    rtos_core_t* core = this_core();
+    uint32_t seen = __atomic_load_n(&core->idle_wakeups, __ATOMIC_ACQUIRE);
+    uint32_t wake;
+    
+    kernel_lock();
+    bool timed = next_wake_tick(&wake);
+    
+    uint64_t early_ns = 2ull * core->idle_exit_ns;
+    uint64_t due_ns = timed ? rtos_tick_time_ns(wake) : 0;
+    
+    // A wake-up due any moment is better caught by polling the clock
+    bool due_soon = timed && due_ns <= port_time_ns() + early_ns;
+    uint64_t deadline_ns = timed ? due_ns - early_ns : 0;
+    if (!due_soon) {
+        __atomic_store_n(&core->idle_until_ns, timed ? due_ns : UINT64_MAX,
+                         __ATOMIC_RELAXED);
+    }
+    kernel_unlock();
+    
+    bool slept = !due_soon && idle_sleep(core, seen, deadline_ns);
+    __atomic_store_n(&core->idle_until_ns, 0, __ATOMIC_RELAXED);
+    
+    if (!slept) {
+        // On SMP, give the host CPU to the other cores' threads
+        if (core_count > 1) {
+            port_idle();
+        }
+        return;
+    }
+    
+    // Learn from sleeps that ran to their deadline (not cut short by a kick)
+    uint64_t now_ns = port_time_ns();
+    if (timed && now_ns >= deadline_ns) {
+        uint64_t late_ns = now_ns - deadline_ns;
+        if (late_ns > IDLE_EXIT_MAX_NS / 2) {
+            late_ns = IDLE_EXIT_MAX_NS / 2;
+        }
+        core->idle_exit_ns = (uint32_t)((7ull * core->idle_exit_ns + late_ns) / 8);
+    }
+}
 
 /*
  * IDLE TASK
  * 
  * The idle task runs when no other tasks are ready.
  * It's the lowest priority task and helps measure CPU utilization.
+ * Every core has its own, pinned to that core.
  */
 static void idle_task_function(void* param) {
     (void)param; // Unused parameter
     
     while (1) {
-        // In a real system, this might:
-        // - Put CPU in low-power mode
-        // - Perform background garbage collection
-        // - Update system statistics
+        // Give deleted tasks' slots and stacks back, a batch per pass.
+        // While some are left, only yield between batches.
+        bool reclaim_pending = task_reclaim_drain();
         
-        stats.idle_time++;
-        
-        // Simulate some idle work
-        for (volatile int i = 0; i < 1000; i++) {
-            // Busy wait to simulate idle processing
+        // In a real system, this might put the CPU in low-power mode
+        // until the next interrupt. Here the host thread sleeps until the
+        // next wake-up is due or a task is readied (tickless idle), after
+        // spending a moment looking for the stacks' high-water marks.
+        if (rtos_mode == RTOS_MODE_CONTEXT_SWITCH) {
+            stack_scan_step();
+            if (!reclaim_pending) {
+                idle_wait();
+            }
         }
         
-        // Yield to allow other tasks to run
+        // Yield to allow other tasks to run (or steal one on SMP)
         task_yield();
     }
 }
 
+static uint32_t all_cores_mask(void) {
+    return core_count == 32 ? 0xFFFFFFFFu : (1u << core_count) - 1;
+}
+
 /*
  * SCHEDULER INITIALIZATION
  */
 int rtos_init(void) {
-    printf("🚀 Initializing RTOS kernel\n");
+    RTOS_LOG("🚀 Initializing RTOS kernel\n");
+    
+    if (core_count > 1 && rtos_mode != RTOS_MODE_CONTEXT_SWITCH) {
+        RTOS_LOG("❌ SMP needs context-switch mode\n");
+        return -1;
+    }
+    
+    // Initialize per-core run queues
+    for (uint32_t i = 0; i < RTOS_MAX_CORES; i++) {
+        free(cores[i].rt_heap);
+    }
+    free(sleep_heap);
+    sleep_heap = NULL;
+    sleep_heap_size = 0;
+    sleep_heap_capacity = 0;
+    memset(cores, 0, sizeof(cores));
+    sleeping_cores = 0;
+    for (uint32_t i = 0; i < RTOS_MAX_CORES; i++) {
+        cores[i].id = i;
+        cores[i].idle_exit_ns = IDLE_EXIT_INITIAL_NS;
+    }
+    kernel_spinlock.locked = 0;
+    system_tick_count = 0;
+    scheduler_running = false;
+    switch_hook = NULL;
+    start_cycles = 0;
+    stop_cycles = 0;
+    if (cycles_to_us_q32 == 0) {
+        cycles_to_us_q32 = (uint64_t)(port_ns_per_cycle() / 1000.0 * 4294967296.0);
+    }
+    port_reset();
     
-    // Initialize ready queues
-    for (int i = 0; i < PRIORITY_LEVELS; i++) {
-        ready_queues[i] = NULL;
+    if (heap_init() != 0) {
+        RTOS_LOG("❌ Failed to map the heap\n");
+        return -1;
     }
+    timers_reset();
+    realtime_reset();
+    irq_reset();
+    io_reset();
     
-    // Initialize task pool
-    memset(task_pool, 0, sizeof(task_pool));
-    memset(task_pool_used, false, sizeof(task_pool_used));
+    // Initialize task table and stack pool
+    if (task_table_init() != 0) {
+        RTOS_LOG("❌ Failed to initialize task table\n");
+        return -1;
+    }
     
     // Initialize statistics
     memset(&stats, 0, sizeof(stats));
     
-    // Create idle task (lowest priority)
-    uint32_t idle_id = task_create("IDLE", idle_task_function, NULL, 
-                                   PRIORITY_LEVELS - 1, STACK_SIZE);
-    if (idle_id == 0) {
-        printf("❌ Failed to create idle task\n");
+    // Create one idle task (lowest priority) per core
+    for (uint32_t i = 0; i < core_count; i++) {
+        char name[16];
+        if (core_count == 1) {
+            snprintf(name, sizeof(name), "IDLE");
+        } else {
+            snprintf(name, sizeof(name), "IDLE%u", i);
+        }
+        
+        uint32_t idle_id = task_create(name, idle_task_function, NULL, 
+                                       PRIORITY_LEVELS - 1, STACK_SIZE);
+        if (idle_id == 0) {
+            RTOS_LOG("❌ Failed to create idle task\n");
+            return -1;
+        }
+        
+        // Re-queue it on its own core, which it never leaves
+        tcb_t* idle = task_get_info(idle_id);
+        remove_task_from_ready_queue(idle);
+        idle->is_idle = true;
+        idle->affinity_mask = 1u << i;
+        idle->core = (uint8_t)i;
+        add_task_to_ready_queue(idle);
+        cores[i].idle = idle;
+    }
+    
+    RTOS_LOG("✅ RTOS kernel initialized\n");
+    RTOS_LOG("   Max tasks: %u (allocated on demand)\n", MAX_TASKS);
+    RTOS_LOG("   Priority levels: %d\n", PRIORITY_LEVELS);
+    RTOS_LOG("   Time slice: %u ms (level 0) to %u ms (level %d)%s\n", rtos_get_time_slice(0),
+             rtos_get_time_slice(PRIORITY_LEVELS - 1), PRIORITY_LEVELS - 1,
+             adaptive_slicing ? ", adaptive" : "");
+    RTOS_LOG("   Mode: %s\n", rtos_mode == RTOS_MODE_CONTEXT_SWITCH ? "context switch" :
+             rtos_mode == RTOS_MODE_VIRTUAL_TIME ? "virtual time" : "simulated");
+    RTOS_LOG("   Cores: %u\n", core_count);
+    RTOS_LOG("   Policy: %s\n", sched_policy == SCHED_EDF ? "EDF" :
+             sched_policy == SCHED_RATE_MONOTONIC ? "rate monotonic" : "fixed priority");
+    
+    return 0;
+}
+
+int rtos_set_mode(rtos_mode_t mode) {
+    if (scheduler_running) {
         return -1;
     }
     
-    idle_task = task_get_info(idle_id);
+    rtos_mode = mode;
+    return 0;
+}
+
+int rtos_set_core_count(uint32_t count) {
+    if (scheduler_running || count == 0 || count > RTOS_MAX_CORES) {
+        return -1;
+    }
     
-    printf("✅ RTOS kernel initialized\n");
-    printf("   Max tasks: %d\n", MAX_TASKS);
-    printf("   Priority levels: %d\n", PRIORITY_LEVELS);
-    printf("   Time slice: %d ms\n", TIME_SLICE_MS);
+    core_count = count;
+    return 0;
+}
+
+uint32_t rtos_get_core_count(void) {
+    return core_count;
+}
+
+int rtos_set_policy(sched_policy_t policy) {
+    if (scheduler_running || policy > SCHED_RATE_MONOTONIC) {
+        return -1;
+    }
     
+    sched_policy = policy;
     return 0;
 }
 
+sched_policy_t rtos_get_policy(void) {
+    return sched_policy;
+}
+
 /*
- * TASK CREATION
+ * TIME SLICES
  * 
- * Creates a new task and adds it to the appropriate ready queue.
+ * Adaptive slicing keeps, per task, a running average of the share of
+ * its slice it used each time it gave up the CPU by itself: by blocking
+ * (little used) or by running the slice out (all used). Being preempted
+ * by a higher priority task says nothing about the task and is not
+ * counted. Two thresholds with a gap between them keep a task whose
+ * average hovers near one from flipping between kinds every slice.
  */
-uint32_t task_create(const char* name, 
-                     void (*task_func)(void* param),
-                     void* param,
-                     uint8_t priority,
-                     uint32_t stack_size) {
-    
-    printf("📋 Creating task '%s' (priority %d)\n", name, priority);
+#define SLICE_USAGE_HISTORY 4                 // Weight of the past in the average
+#define SLICE_INTERACTIVE_BELOW 64            // Becomes interactive under 1/4 used...
+#define SLICE_INTERACTIVE_UNTIL 128           // ...and stays so until 1/2
+#define SLICE_CPU_BOUND_FROM 192              // CPU-bound from 3/4 used
+
+int rtos_set_time_slice(uint8_t priority, uint32_t slice_ms) {
+    if (priority >= PRIORITY_LEVELS || slice_ms == 0) {
+        return -1;
+    }
     
-    // Validate parameters
+    time_slices[priority] = slice_ms;
+    return 0;
+}
+
+uint32_t rtos_get_time_slice(uint8_t priority) {
     if (priority >= PRIORITY_LEVELS) {
-        printf("❌ Invalid priority: %d (max: %d)\n", priority, PRIORITY_LEVELS - 1);
         return 0;
     }
-    
-    if (stack_size > STACK_SIZE) {
-        printf("❌ Stack size too large: %u (max: %d)\n", stack_size, STACK_SIZE);
-        return 0;
+    return time_slices[priority] != 0 ? time_slices[priority] : TIME_SLICE_MS;
+}
+
+int rtos_set_adaptive_slicing(bool enabled) {
+    if (scheduler_running) {
+        return -1;
     }
     
-    // Find free slot in task pool
-    int slot = -1;
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (!task_pool_used[i]) {
-            slot = i;
-            break;
+    adaptive_slicing = enabled;
+    return 0;
+}
+
+static inline bool task_adapts(const tcb_t* task) {
+    return adaptive_slicing && !task->is_idle && !task_is_realtime(task);
+}
+
+/**
+ * Level a task is queued and compared at: its priority, lifted one level
+ * if adaptive slicing found it interactive
+ */
+static inline uint8_t sched_level(const tcb_t* task) {
+    return adaptive_slicing && task->interactive && task->priority > 0 ?
+           task->priority - 1 : task->priority;
+}
+
+void task_grant_time_slice(tcb_t* task) {
+    uint32_t slice = rtos_get_time_slice(task->base_priority);
+    
+    if (task_adapts(task)) {
+        if (task->interactive) {
+            slice = slice > ADAPTIVE_SLICE_SCALE ? slice / ADAPTIVE_SLICE_SCALE : 1;
+        } else if (task->slice_usage >= SLICE_CPU_BOUND_FROM) {
+            slice *= ADAPTIVE_SLICE_SCALE;
         }
     }
     
-    if (slot == -1) {
-        printf("❌ No free task slots available\n");
-        return 0;
+    task->time_slice = slice;
+    task->time_slice_remaining = slice;
+    task->slice_kept = false;
+}
+
+// Fold the slice the task is giving up into its average. Only the task's
+// own core calls this, while the task is not queued anywhere.
+static void slice_account(tcb_t* task) {
+    if (!task_adapts(task) || task->time_slice == 0) {
+        return;
     }
     
-    // Initialize TCB
-    tcb_t* tcb = &task_pool[slot];
-    task_pool_used[slot] = true;
+    uint32_t left = task->time_slice_remaining < task->time_slice ?
+                    task->time_slice_remaining : task->time_slice;
+    uint32_t share = (task->time_slice - left) * 256 / task->time_slice;
     
-    tcb->task_id = next_task_id++;
-    strncpy(tcb->name, name, sizeof(tcb->name) - 1);
-    tcb->name[sizeof(tcb->name) - 1] = '\0';
+    task->slice_usage = (uint16_t)((task->slice_usage * (SLICE_USAGE_HISTORY - 1) + share) /
+                                   SLICE_USAGE_HISTORY);
+    if (task->slice_usage < SLICE_INTERACTIVE_BELOW) {
+        task->interactive = true;
+    } else if (task->slice_usage >= SLICE_INTERACTIVE_UNTIL) {
+        task->interactive = false;
+    }
+}
+
+/*
+ * PER-CORE RUN QUEUES
+ * 
+ * Each core has its own circular list per priority, protected by that
+ * core's lock. The idle task sits in its core's lowest queue but is left
+ * out of ready_count, which measures real work for placement and stealing.
+ * Periodic tasks under EDF/RM go into the core's deadline heap instead.
+ */
+static inline void core_lock(rtos_core_t* core) {
+    if (core_count > 1) {
+        spin_lock(&core->lock);
+    }
+}
+
+static inline void core_unlock(rtos_core_t* core) {
+    if (core_count > 1) {
+        spin_unlock(&core->lock);
+    }
+}
+
+/*
+ * DEADLINE ORDER
+ * 
+ * EDF compares the deadlines of the current jobs, which move with every
+ * release; RM compares relative deadlines, which never change (shorter
+ * period first when deadline == period). Tick counts wrap, so deadlines are
+ * compared by signed distance. Equal keys fall back to the task ID so the
+ * order is deterministic.
+ */
+static bool deadline_before(const tcb_t* a, const tcb_t* b) {
+    int32_t diff;
     
-    tcb->priority = priority;
-    tcb->state = TASK_READY;
-    tcb->time_slice_remaining = TIME_SLICE_MS;
+    if (sched_policy == SCHED_EDF) {
+        diff = (int32_t)(a->absolute_deadline - b->absolute_deadline);
+    } else {
+        diff = (int32_t)(a->relative_deadline - b->relative_deadline);
+    }
     
-    // Initialize stack
-    tcb->stack_base = task_stacks[slot];
-    tcb->stack_size = stack_size;
-    tcb->stack_pointer = (uint32_t*)(tcb->stack_base + stack_size - 4);
+    return diff != 0 ? diff < 0 : a->task_id < b->task_id;
+}
+
+/**
+ * Should task a get the CPU ahead of task b?
+ * Periodic tasks beat ordinary ones; otherwise compare deadline or priority.
+ */
+static bool task_outranks(const tcb_t* a, const tcb_t* b) {
+    bool a_rt = task_is_realtime(a);
+    bool b_rt = task_is_realtime(b);
     
-    // Initialize registers (simulated ARM Cortex-M context)
-    memset(tcb->registers, 0, sizeof(tcb->registers));
-    tcb->registers[15] = (uint32_t)task_func;  // PC (Program Counter)
-    tcb->registers[14] = 0xFFFFFFFD;           // LR (Link Register - return to thread mode)
-    tcb->registers[13] = (uint32_t)tcb->stack_pointer; // SP (Stack Pointer)
-    tcb->registers[0] = (uint32_t)param;       // R0 (first parameter)
+    if (a_rt != b_rt) {
+        return a_rt;
+    }
+    return a_rt ? deadline_before(a, b) : sched_level(a) < sched_level(b);
+}
+
+/**
+ * Do two tasks share the CPU round-robin? Only ordinary tasks of the same
+ * priority do; a periodic job keeps the CPU until it finishes or a job
+ * with an earlier deadline arrives.
+ */
+static bool task_shares_slice(const tcb_t* a, const tcb_t* b) {
+    return !task_is_realtime(a) && !task_is_realtime(b) && sched_level(a) == sched_level(b);
+}
+
+/*
+ * DEADLINE HEAP
+ * 
+ * A binary min-heap in an array: the earliest deadline is always at index
+ * 0, and insert and remove are O(log n) sift operations. Every task records
+ * its index so it can be removed from the middle, when it is deleted or
+ * its priority changes.
+ */
+static inline void rt_heap_place(rtos_core_t* core, uint32_t index, tcb_t* task) {
+    core->rt_heap[index] = task;
+    task->heap_index = index;
+}
+
+static void rt_heap_sift_up(rtos_core_t* core, uint32_t index) {
+    tcb_t* task = core->rt_heap[index];
     
-    // Initialize timing
-    tcb->total_runtime = 0;
-    tcb->last_run_time = system_tick_count;
-    tcb->wake_time = 0;
+    while (index > 0) {
+        uint32_t parent = (index - 1) / 2;
+        if (!deadline_before(task, core->rt_heap[parent])) {
+            break;
+        }
+        rt_heap_place(core, index, core->rt_heap[parent]);
+        index = parent;
+    }
+    rt_heap_place(core, index, task);
+}
+
+static void rt_heap_sift_down(rtos_core_t* core, uint32_t index) {
+    tcb_t* task = core->rt_heap[index];
+    uint32_t size = core->rt_heap_size;
     
-    // Initialize linked list pointers
-    tcb->next = NULL;
-    tcb->prev = NULL;
+    while (1) {
+        uint32_t child = 2 * index + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && deadline_before(core->rt_heap[child + 1], core->rt_heap[child])) {
+            child++;
+        }
+        if (!deadline_before(core->rt_heap[child], task)) {
+            break;
+        }
+        rt_heap_place(core, index, core->rt_heap[child]);
+        index = child;
+    }
+    rt_heap_place(core, index, task);
+}
+
+static void rt_heap_push(rtos_core_t* core, tcb_t* task) {
+    // Capacity was reserved when the task was admitted to this core
+    core->rt_heap[core->rt_heap_size++] = task;
+    rt_heap_sift_up(core, core->rt_heap_size - 1);
+}
+
+static void rt_heap_remove(rtos_core_t* core, tcb_t* task) {
+    uint32_t index = task->heap_index;
+    tcb_t* last = core->rt_heap[--core->rt_heap_size];
     
-    // Store task function and parameter
-    tcb->task_function = task_func;
-    tcb->task_parameter = param;
+    if (last == task) {
+        return;
+    }
     
-    // Add to ready queue
-    add_task_to_ready_queue(tcb);
+    // Move the last task into the hole, then restore heap order in
+    // whichever direction it is out of place
+    rt_heap_place(core, index, last);
+    rt_heap_sift_up(core, index);
+    if (core->rt_heap[index] == last) {
+        rt_heap_sift_down(core, index);
+    }
+}
+
+int run_queue_reserve_realtime(rtos_core_t* core, uint32_t tasks) {
+    if (tasks <= core->rt_heap_capacity) {
+        return 0;
+    }
     
-    stats.tasks_created++;
+    uint32_t capacity = core->rt_heap_capacity ? core->rt_heap_capacity * 2 : 8;
+    while (capacity < tasks) {
+        capacity *= 2;
+    }
     
-    printf("✅ Task '%s' created (ID: %u, slot: %d)\n", name, tcb->task_id, slot);
+    core_lock(core);
+    tcb_t** grown = realloc(core->rt_heap, capacity * sizeof(tcb_t*));
+    if (grown != NULL) {
+        core->rt_heap = grown;
+        core->rt_heap_capacity = capacity;
+    }
+    core_unlock(core);
     
-    return tcb->task_id;
+    return grown != NULL ? 0 : -1;
 }
 
-/*
- * ADD TASK TO READY QUEUE
- * 
- * Adds a task to the appropriate priority ready queue.
- */
-void add_task_to_ready_queue(tcb_t* task) {
-    if (task->state != TASK_READY) {
-        task->state = TASK_READY;
+static void run_queue_insert(rtos_core_t* core, tcb_t* task) {
+    if (task_is_realtime(task)) {
+        rt_heap_push(core, task);
+        task->run_queue = core;
+        core->ready_count++;
+        return;
     }
     
-    uint8_t priority = task->priority;
+    // Remembered for removal: the priority may change while queued
+    uint8_t priority = sched_level(task);
+    tcb_t** queue = &core->ready_queues[priority];
+    task->ready_priority = priority;
     
-    // Add to end of priority queue (round-robin within priority)
-    if (ready_queues[priority] == NULL) {
+    // Add to end of priority queue (round-robin within priority), or to
+    // the front for a task preempted before its slice ran out
+    if (*queue == NULL) {
         // First task in this priority queue
-        ready_queues[priority] = task;
+        *queue = task;
         task->next = task;
         task->prev = task;
     } else {
         // Insert at end of circular list
-        tcb_t* last = ready_queues[priority]->prev;
+        tcb_t* last = (*queue)->prev;
         
-        task->next = ready_queues[priority];
+        task->next = *queue;
         task->prev = last;
         last->next = task;
-        ready_queues[priority]->prev = task;
+        (*queue)->prev = task;
+        if (task->slice_kept) {
+            *queue = task;
+        }
+    }
+    
+    task->run_queue = core;
+    if (!task->is_idle) {
+        core->ready_count++;
     }
 }
 
-/*
- * REMOVE TASK FROM READY QUEUE
- */
-void remove_task_from_ready_queue(tcb_t* task) {
-    uint8_t priority = task->priority;
-    
-    if (ready_queues[priority] == NULL) {
-        return; // Task not in queue
+static void run_queue_remove(rtos_core_t* core, tcb_t* task) {
+    if (task_is_realtime(task)) {
+        rt_heap_remove(core, task);
+        task->run_queue = NULL;
+        core->ready_count--;
+        return;
     }
     
+    tcb_t** queue = &core->ready_queues[task->ready_priority];
+    
     if (task->next == task) {
         // Only task in queue
-        ready_queues[priority] = NULL;
+        *queue = NULL;
     } else {
         // Remove from circular list
         task->prev->next = task->next;
         task->next->prev = task->prev;
         
         // Update queue head if necessary
-        if (ready_queues[priority] == task) {
-            ready_queues[priority] = task->next;
+        if (*queue == task) {
+            *queue = task->next;
         }
     }
     
     task->next = NULL;
     task->prev = NULL;
+    task->run_queue = NULL;
+    if (!task->is_idle) {
+        core->ready_count--;
+    }
+}
+
+static tcb_t* run_queue_first(rtos_core_t* core) {
+    if (core->rt_heap_size > 0) {
+        return core->rt_heap[0];
+    }
+    for (int priority = 0; priority < PRIORITY_LEVELS; priority++) {
+        if (core->ready_queues[priority] != NULL) {
+            return core->ready_queues[priority];
+        }
+    }
+    return NULL;
 }
 
 /*
- * SCHEDULER - GET NEXT TASK
+ * TASK PLACEMENT
  * 
- * Implements priority-based scheduling with round-robin within priorities.
+ * A task goes back to the core it last ran on while its affinity allows,
+ * since its working set is most likely still in that core's cache. New
+ * tasks, and tasks whose core is no longer allowed, go to the allowed
+ * core with the fewest queued tasks.
  */
-tcb_t* scheduler_get_next_task(void) {
-    // Find highest priority queue with ready tasks
-    for (int priority = 0; priority < PRIORITY_LEVELS; priority++) {
-        if (ready_queues[priority] != NULL) {
-            tcb_t* next_task = ready_queues[priority];
-            
-            // Move to next task in round-robin fashion
-            ready_queues[priority] = next_task->next;
-            
-            return next_task;
+static rtos_core_t* select_core(tcb_t* task) {
+    if (core_count == 1) {
+        return &cores[0];
+    }
+    
+    uint32_t allowed = task->affinity_mask & all_cores_mask();
+    if (allowed == 0) {
+        allowed = all_cores_mask();
+    }
+    
+    if (task->core < core_count && (allowed & (1u << task->core))) {
+        return &cores[task->core];
+    }
+    
+    rtos_core_t* best = NULL;
+    for (uint32_t i = 0; i < core_count; i++) {
+        if ((allowed & (1u << i)) &&
+            (best == NULL || cores[i].ready_count < best->ready_count)) {
+            best = &cores[i];
         }
     }
+    return best;
+}
+
+/*
+ * ADD TASK TO READY QUEUE
+ * 
+ * Adds a task to the appropriate priority ready queue.
+ */
+void add_task_to_ready_queue(tcb_t* task) {
+    // A task that blocked on another core a moment ago may still be saving
+    // its registers there. Waiting here, with no core lock held, keeps the
+    // rule that a queued task is never live on a CPU, so a core that picks
+    // a task can always switch to it straight away.
+    uint32_t spins = 0;
+    while (__atomic_load_n(&task->on_cpu, __ATOMIC_ACQUIRE) && scheduler_running) {
+        port_relax(&spins);
+    }
+    
+    // Readied early (or just due): its timeout is over
+    if (task->sleep_index != TASK_NOT_SLEEPING) {
+        task_set_wake_time(task, 0);
+    }
+    
+    // A suspended task waits off the run queues for task_resume
+    if (task->suspended) {
+        task->state = TASK_SUSPENDED;
+        return;
+    }
+    
+    rtos_core_t* core = select_core(task);
+    
+    if (task->state == TASK_BLOCKED) {
+        trace_record(TRACE_WAKE, task, core->id);
+    }
+    if (task->state != TASK_READY) {
+        task->state = TASK_READY;
+    }
+    if (rtos_mode != RTOS_MODE_VIRTUAL_TIME) {
+        task->ready_since = port_cycles();
+    }
+    
+    core_lock(core);
+    run_queue_insert(core, task);
+    core_unlock(core);
+    
+    idle_kick(core);
+}
+
+/*
+ * REMOVE TASK FROM READY QUEUE
+ * 
+ * The task may be stolen by another core between reading run_queue and
+ * taking that core's lock, so check again under the lock.
+ */
+bool remove_task_from_ready_queue(tcb_t* task) {
+    while (1) {
+        rtos_core_t* core = __atomic_load_n(&task->run_queue, __ATOMIC_ACQUIRE);
+        if (core == NULL) {
+            return false; // Task not in queue
+        }
+        
+        core_lock(core);
+        if (task->run_queue == core) {
+            run_queue_remove(core, task);
+            core_unlock(core);
+            return true;
+        }
+        core_unlock(core);
+    }
+}
+
+/*
+ * WORK STEALING
+ * 
+ * A core with nothing but its idle task to run walks the other cores,
+ * starting where its last search left off so thieves spread out, and
+ * takes the highest priority task it is allowed to run. A core whose lock
+ * is busy is skipped rather than waited for: somebody is already working
+ * on its queue, and stealing is only an optimization. Periodic tasks are
+ * pinned to the core that admitted them, so deadline heaps are never
+ * searched.
+ */
+static tcb_t* steal_task(rtos_core_t* thief) {
+    if (core_count == 1) {
+        return NULL;
+    }
+    
+    uint32_t thief_bit = 1u << thief->id;
+    
+    for (uint32_t i = 1; i < core_count; i++) {
+        uint32_t victim_id = (thief->id + thief->steal_cursor + i) % core_count;
+        rtos_core_t* victim = &cores[victim_id];
+        
+        if (victim_id == thief->id ||
+            __atomic_load_n(&victim->ready_count, __ATOMIC_RELAXED) == 0 ||
+            !spin_trylock(&victim->lock)) {
+            continue;
+        }
+        
+        for (int priority = 0; priority < PRIORITY_LEVELS; priority++) {
+            tcb_t* head = victim->ready_queues[priority];
+            tcb_t* task = head;
+            
+            while (task != NULL) {
+                if (!task->is_idle && (task->affinity_mask & thief_bit)) {
+                    run_queue_remove(victim, task);
+                    spin_unlock(&victim->lock);
+                    
+                    thief->steal_cursor = victim_id + core_count - thief->id;
+                    thief->stats.steals++;
+                    RTOS_LOG("🥷 Core %u steals task %s from core %u\n",
+                             thief->id, task->name, victim_id);
+                    return task;
+                }
+                task = task->next == head ? NULL : task->next;
+            }
+        }
+        
+        spin_unlock(&victim->lock);
+    }
+    
+    return NULL;
+}
+
+/*
+ * SCHEDULER - GET NEXT TASK
+ * 
+ * Implements priority-based scheduling with round-robin within priorities.
+ * The chosen task is taken off its run queue, so no other core can pick it
+ * as well; the current task goes back to the tail when it is switched out.
+ */
+tcb_t* scheduler_get_next_task(void) {
+    rtos_core_t* core = this_core();
+    
+    // Find highest priority queue with ready tasks on this core
+    core_lock(core);
+    tcb_t* next_task = run_queue_first(core);
+    if (next_task != NULL && !next_task->is_idle) {
+        run_queue_remove(core, next_task);
+        core_unlock(core);
+        return next_task;
+    }
+    core_unlock(core);
+    
+    // Nothing but idle here: look for work on the other cores
+    tcb_t* stolen = steal_task(core);
+    if (stolen != NULL) {
+        return stolen;
+    }
+    
+    core_lock(core);
+    next_task = run_queue_first(core);
+    if (next_task != NULL) {
+        run_queue_remove(core, next_task);
+    }
+    core_unlock(core);
+    
+    // The idle task is only missing from the queue while it is running
+    return next_task != NULL ? next_task : core->idle;
+}
+
+/*
+ * CPU ACCOUNTING
+ * 
+ * Every switch reads the cycle counter once. The outgoing task is charged
+ * for the run that just ended and the incoming one for the time it waited
+ * since it became ready, so load and latency figures are exact instead of
+ * counting switches or ticks. The counters change under a sequence count:
+ * task_get_runtime on another core retries its copy if the count was odd
+ * or moved, and never takes a lock the switching core needs.
+ */
+static inline uint32_t runtime_bucket(uint64_t cycles) {
+    if (cycles >= (1ull << 40)) {
+        return RUNTIME_BUCKETS - 1; // Minutes; also keeps the product below in range
+    }
+    
+    uint64_t us = (cycles * cycles_to_us_q32) >> 32;
+    if (us == 0) {
+        return 0;
+    }
+    
+    uint32_t bucket = 64 - (uint32_t)__builtin_clzll(us); // us in [2^(b-1), 2^b)
+    return bucket < RUNTIME_BUCKETS ? bucket : RUNTIME_BUCKETS - 1;
+}
+
+static inline void account_begin(tcb_t* task) {
+    __atomic_store_n(&task->account_seq, task->account_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void account_end(tcb_t* task) {
+    __atomic_store_n(&task->account_seq, task->account_seq + 1, __ATOMIC_RELEASE);
+}
+
+static void account_switch(tcb_t* current, tcb_t* next, uint64_t now) {
+    if (current != NULL && current->switched_in_at != 0) {
+        uint64_t ran = now - current->switched_in_at;
+        
+        account_begin(current);
+        current->cpu_cycles += ran;
+        current->run_histogram[runtime_bucket(ran)]++;
+        current->switched_in_at = 0;
+        account_end(current);
+    }
+    
+    if (next != NULL) {
+        account_begin(next);
+        if (next->ready_since != 0) {
+            uint64_t waited = now - next->ready_since;
+            next->ready_cycles += waited;
+            if (waited > next->max_ready_cycles) {
+                next->max_ready_cycles = waited;
+            }
+            next->ready_histogram[runtime_bucket(waited)]++;
+            next->ready_since = 0;
+        }
+        next->runs++;
+        next->switched_in_at = now;
+        account_end(next);
+    }
+}
+
+/*
+ * CONTEXT SWITCH
+ * 
+ * Switches from current task to next task.
+ * In a real system, this would save/restore CPU registers.
+ * Every switch is recorded in the scheduler trace (trace.c) rather than
+ * printed, so watching the scheduler does not slow it down.
+ */
+void context_switch(tcb_t* current, tcb_t* next) {
+    rtos_core_t* core = this_core();
+    
+    if (rtos_mode == RTOS_MODE_CONTEXT_SWITCH && !scheduler_running && current != NULL) {
+        port_exit_to_kernel(current); // rtos_stop was called on another core
+        return;
+    }
+    
+    if (current == next) {
+        // Idle stays idle
+        if (next != NULL) {
+            next->state = TASK_RUNNING;
+        }
+        return;
+    }
+    
+    // Record why the current task leaves the CPU, and who takes over
+    if (current != NULL && current->state == TASK_RUNNING) {
+        trace_record(TRACE_PREEMPT, current, next ? next->task_id : 0);
+    } else if (current != NULL && current->state == TASK_BLOCKED) {
+        trace_record(TRACE_BLOCK, current, current->wake_time);
+    }
+    trace_record(TRACE_SWITCH, next, current ? current->task_id : 0);
+    
+    bool real_switch = rtos_mode == RTOS_MODE_CONTEXT_SWITCH && scheduler_running;
+    
+    // Update statistics (virtual time has no CPU time to measure)
+    core->stats.context_switches++;
+    if (rtos_mode != RTOS_MODE_VIRTUAL_TIME) {
+        account_switch(current, next, port_cycles());
+    }
+    
+    // A task leaving by itself (it blocked, or its slice ran out) shows
+    // the adaptive slicer what kind of task it is
+    if (current != NULL && (current->state != TASK_RUNNING || current->time_slice_remaining == 0)) {
+        slice_account(current);
+    }
+    
+    // Save current task context (simulated)
+    if (current != NULL) {
+        // In real ARM Cortex-M, this would be done by hardware/PendSV
+        // We simulate by storing the "current" register state
+        current->last_run_time = system_tick_count;
+        
+        // If task is still ready, put it back in queue. After a real
+        // switch that waits until its registers are saved (see
+        // port_finish_switch), so no other core can pick it up too early.
+        if (current->state == TASK_RUNNING) {
+            current->state = TASK_READY;
+            current->slice_kept = current->time_slice_remaining > 0 && !current->is_idle;
+            if (!real_switch) {
+                add_task_to_ready_queue(current);
+            }
+        }
+    }
+    
+    // Load next task context
+    if (next != NULL) {
+        // Remove from ready queue (already done if it came from
+        // scheduler_get_next_task)
+        remove_task_from_ready_queue(next);
+        
+        core->current = next;
+        core->last_tick = system_tick_count;
+        next->state = TASK_RUNNING;
+        if (!next->slice_kept) {
+            task_grant_time_slice(next);
+        }
+        next->slice_kept = false;
+        
+        if (next->core != core->id) {
+            if (next->core != TASK_NO_CORE) {
+                core->stats.migrations++;
+            }
+            next->core = (uint8_t)core->id;
+        }
+        
+        if (switch_hook != NULL) {
+            switch_hook(current, next);
+        }
+        
+        // Restore the next task's registers and stack. Only the port layer
+        // can do that; in simulated mode the switch is pure bookkeeping.
+        if (real_switch) {
+            port_switch(current, next);
+        }
+    }
+}
+
+/*
+ * SCHEDULER TICK
+ * 
+ * Called by system timer interrupt (simulated).
+ * Handles time slicing and task switching.
+ */
+static void tick_update(void) {
+    system_tick_count++;
+    stats.total_ticks++;
+    trace_record(TRACE_TICK, NULL, system_tick_count);
+    
+    if (!scheduler_running || current_task == NULL) {
+        return;
+    }
+    
+    // Charge the tick to the task that held the CPU through it
+    current_task->total_runtime++;
+    if (current_task->is_idle) {
+        this_core()->stats.idle_time++;
+    }
+    
+    // Update current task's time slice
+    if (current_task->time_slice_remaining > 0) {
+        current_task->time_slice_remaining--;
+    }
+    
+    // Check for sleeping tasks to wake up
+    wake_sleeping_tasks();
+}
+
+void scheduler_tick(void) {
+    tick_update();
+    scheduler_reschedule();
+}
+
+/*
+ * HOST CLOCK
+ * 
+ * In context-switch mode there is no timer interrupt. Instead every kernel
+ * entry point catches the tick count up with the host's monotonic clock,
+ * waking whoever became due during the missed ticks.
+ * Whichever core notices first processes the ticks; each core then charges
+ * its own running task for the ticks that passed since it last looked.
+ * Kernel entry is also where work queued by interrupt handlers is noticed
+ * and the IRQ worker readied (irq.c).
+ */
+static uint32_t host_clock_ticks(void) {
+    return (uint32_t)((port_time_ns() - start_time_ns) / 1000000u);
+}
+
+void poll_host_clock(void) {
+    // Before rtos_start the clock has no start time to count from
+    if (rtos_mode != RTOS_MODE_CONTEXT_SWITCH || !scheduler_running) {
+        return;
+    }
+    
+    deferred_work_poll();
+    
+    uint32_t elapsed_ticks = host_clock_ticks();
+    if (__atomic_load_n(&system_tick_count, __ATOMIC_RELAXED) < elapsed_ticks) {
+        kernel_lock();
+        if (system_tick_count < elapsed_ticks) {
+            // One wake-up pass covers every missed tick: nothing ran in
+            // between that could have noticed the difference
+            stats.total_ticks += elapsed_ticks - system_tick_count;
+            system_tick_count = elapsed_ticks;
+            trace_record(TRACE_TICK, NULL, system_tick_count);
+            wake_sleeping_tasks();
+        }
+        kernel_unlock();
+        
+        io_poll();
+    }
+    
+    rtos_core_t* core = this_core();
+    uint32_t now = __atomic_load_n(&system_tick_count, __ATOMIC_RELAXED);
+    uint32_t charged = now - core->last_tick;
+    core->last_tick = now;
+    
+    tcb_t* task = core->current;
+    if (task != NULL) {
+        task->total_runtime += charged;
+        if (task->is_idle) {
+            core->stats.idle_time += charged;
+        }
+        task->time_slice_remaining = task->time_slice_remaining > charged ?
+                                     task->time_slice_remaining - charged : 0;
+    }
+}
+
+/*
+ * Simulated mode's tickless idle: with only the idle task to run, no tick
+ * before the next wake-up can change anything. Sleep until that wake-up
+ * (or until a task is readied from outside) and charge the skipped ticks
+ * to idle in one go; the tick that is due then runs as usual.
+ */
+static void idle_skip_ticks(void) {
+    rtos_core_t* core = this_core();
+    uint32_t seen = __atomic_load_n(&core->idle_wakeups, __ATOMIC_ACQUIRE);
+    uint32_t wake;
+    bool timed = next_wake_tick(&wake);
+    if (timed && wake <= system_tick_count + 1) {
+        return;
+    }
+    
+    idle_sleep(core, seen, timed ? rtos_tick_time_ns(wake) : 0);
+    
+    uint32_t due = host_clock_ticks();
+    if (due > system_tick_count + 1) {
+        uint32_t skipped = due - 1 - system_tick_count;
+        system_tick_count += skipped;
+        stats.total_ticks += skipped;
+        idle_task->total_runtime += skipped;
+        core->stats.idle_time += skipped;
+    }
+}
+
+/*
+ * RESCHEDULE
+ * 
+ * Switches away from the current task if a higher priority task is ready,
+ * or if its time slice expired and another task of the same priority is
+ * waiting. An expired slice never hands the CPU to a lower priority task;
+ * the current task just gets a fresh slice. A core running its idle task
+ * also tries to steal work from the other cores.
+ */
+void scheduler_reschedule(void) {
+    rtos_core_t* core = this_core();
+    tcb_t* current = core->current;
+    
+    if (current == NULL) {
+        return;
+    }
+    if (!scheduler_running) {
+        if (rtos_mode == RTOS_MODE_CONTEXT_SWITCH) {
+            port_exit_to_kernel(current); // rtos_stop was called on another core
+        }
+        return;
+    }
+    
+    // Preempting a stackless task waits until its function returns
+    if (core->in_stackless) {
+        return;
+    }
+    
+    // Deleted or suspended from another core while running here. Nothing
+    // may switch it out for a long time, so it carries that out itself.
+    if (__atomic_load_n(&current->delete_requested, __ATOMIC_ACQUIRE)) {
+        task_delete(current->task_id);
+        return;
+    }
+    if (__atomic_load_n(&current->suspended, __ATOMIC_ACQUIRE)) {
+        kernel_lock();
+        if (current->suspended) {
+            current->state = TASK_SUSPENDED;
+            task_block_current(); // Releases the kernel lock
+            return;
+        }
+        kernel_unlock();
+    }
+    
+    tcb_t* highest_ready = get_highest_priority_ready_task();
+    bool need_reschedule = false;
+    
+    // Higher priority (or earlier deadline) task became ready
+    if (highest_ready && task_outranks(highest_ready, current)) {
+        need_reschedule = true;
+    }
+    
+    // Time slice expiration
+    if (!need_reschedule && current->time_slice_remaining == 0) {
+        if (highest_ready && task_shares_slice(highest_ready, current)) {
+            need_reschedule = true;
+        } else {
+            slice_account(current);
+            task_grant_time_slice(current);
+        }
+    }
+    
+    // An idle core pulls work from busy ones
+    if (!need_reschedule && current->is_idle && core_count > 1) {
+        tcb_t* stolen = steal_task(core);
+        if (stolen != NULL) {
+            context_switch(current, stolen);
+        }
+        return;
+    }
+    
+    // Perform context switch if needed
+    if (need_reschedule) {
+        tcb_t* next_task = scheduler_get_next_task();
+        
+        // Another core stole the task we meant to run and only worse
+        // ones are left: keep running the current task
+        if (!current->is_idle && task_outranks(current, next_task)) {
+            add_task_to_ready_queue(next_task);
+            return;
+        }
+        
+        context_switch(current, next_task);
+    }
+}
+
+/*
+ * GET HIGHEST PRIORITY READY TASK
+ */
+tcb_t* get_highest_priority_ready_task(void) {
+    rtos_core_t* core = this_core();
+    
+    core_lock(core);
+    tcb_t* task = run_queue_first(core);
+    core_unlock(core);
+    
+    return task;
+}
+
+/*
+ * SLEEP QUEUE
+ * 
+ * Blocked tasks with a wake-up tick (sleeps, timeouts and periodic
+ * releases) sit in a binary min-heap ordered by that tick, like the
+ * timer heap, so the tick and the idle loop only ever look at its root
+ * however many tasks are blocked. A task is in it exactly while its
+ * wake_time is not 0; being made ready takes it out. Wake ticks are
+ * compared as signed differences, so the order survives the tick counter
+ * wrapping around. Called with the kernel lock held.
+ */
+static inline bool wakes_before(const tcb_t* a, const tcb_t* b) {
+    return (int32_t)(a->wake_time - b->wake_time) < 0;
+}
+
+static inline void sleep_heap_place(uint32_t index, tcb_t* task) {
+    sleep_heap[index] = task;
+    task->sleep_index = index;
+}
+
+static void sleep_heap_sift_up(uint32_t index) {
+    tcb_t* task = sleep_heap[index];
+    
+    while (index > 0) {
+        uint32_t parent = (index - 1) / 2;
+        if (!wakes_before(task, sleep_heap[parent])) {
+            break;
+        }
+        sleep_heap_place(index, sleep_heap[parent]);
+        index = parent;
+    }
+    sleep_heap_place(index, task);
+}
+
+static void sleep_heap_sift_down(uint32_t index) {
+    tcb_t* task = sleep_heap[index];
+    
+    while (1) {
+        uint32_t child = 2 * index + 1;
+        if (child >= sleep_heap_size) {
+            break;
+        }
+        if (child + 1 < sleep_heap_size && wakes_before(sleep_heap[child + 1], sleep_heap[child])) {
+            child++;
+        }
+        if (!wakes_before(sleep_heap[child], task)) {
+            break;
+        }
+        sleep_heap_place(index, sleep_heap[child]);
+        index = child;
+    }
+    sleep_heap_place(index, task);
+}
+
+static void sleep_heap_remove(tcb_t* task) {
+    uint32_t index = task->sleep_index;
+    tcb_t* last = sleep_heap[--sleep_heap_size];
+    
+    task->sleep_index = TASK_NOT_SLEEPING;
+    if (last == task) {
+        return;
+    }
+    
+    sleep_heap_place(index, last);
+    sleep_heap_sift_up(index);
+    if (sleep_heap[index] == last) {
+        sleep_heap_sift_down(index);
+    }
+}
+
+int sleep_queue_reserve(uint32_t tasks) {
+    if (tasks <= sleep_heap_capacity) {
+        return 0;
+    }
+    
+    uint32_t capacity = sleep_heap_capacity ? sleep_heap_capacity * 2 : 8;
+    while (capacity < tasks) {
+        capacity *= 2;
+    }
+    
+    tcb_t** grown = realloc(sleep_heap, capacity * sizeof(tcb_t*));
+    if (grown == NULL) {
+        return -1;
+    }
+    sleep_heap = grown;
+    sleep_heap_capacity = capacity;
+    return 0;
+}
+
+void task_set_wake_time(tcb_t* task, uint32_t tick) {
+    if (task->sleep_index != TASK_NOT_SLEEPING) {
+        sleep_heap_remove(task);
+    }
+    
+    task->wake_time = tick;
+    if (tick == 0) {
+        return;
+    }
+    
+    // Capacity was reserved for every task table slot
+    sleep_heap[sleep_heap_size++] = task;
+    sleep_heap_sift_up(sleep_heap_size - 1);
+    idle_kick_timer(tick);
+}
+
+/*
+ * WAKE SLEEPING TASKS
+ * 
+ * Wakes the tasks whose wake-up is due, which includes periodic tasks
+ * waiting for their next release, and catches periodic jobs that ran
+ * past their deadline. Called with the kernel lock held.
+ */
+void wake_sleeping_tasks(void) {
+    realtime_check_deadlines();
+    
+    while (sleep_heap_size > 0 &&
+           (int32_t)(system_tick_count - sleep_heap[0]->wake_time) >= 0) {
+        add_task_to_ready_queue(sleep_heap[0]); // Takes it off the sleep queue
+    }
+}
+
+bool next_wake_tick(uint32_t* wake) {
+    if (sleep_heap_size == 0) {
+        return false;
+    }
     
-    // Should never happen if idle task exists
-    return idle_task;
+    *wake = sleep_heap[0]->wake_time;
+    return true;
 }
 
 /*
- * CONTEXT SWITCH
+ * WAIT QUEUES
  * 
- * Switches from current task to next task.
- * In a real system, this would save/restore CPU registers.
+ * Tasks blocked on a synchronization object wait on a NULL-terminated list
+ * ordered by priority (FIFO among equal priorities), so the task to wake
+ * is always the head. A blocked task is never on a ready queue, so the
+ * same next/prev pointers are reused.
  */
-void context_switch(tcb_t* current, tcb_t* next) {
-    if (current == next) {
-        return; // No switch needed
-    }
-    
-    printf("🔄 Context switch: %s -> %s\n", 
-           current ? current->name : "NULL", 
-           next ? next->name : "NULL");
+void wait_queue_insert(tcb_t** queue, tcb_t* task) {
+    tcb_t* prev = NULL;
+    tcb_t* cur = *queue;
     
-    // Update statistics
-    stats.total_context_switches++;
-    
-    // Save current task context (simulated)
-    if (current != NULL) {
-        // In real ARM Cortex-M, this would be done by hardware/PendSV
-        // We simulate by storing the "current" register state
-        current->last_run_time = system_tick_count;
-        
-        // Update runtime statistics
-        if (current->state == TASK_RUNNING) {
-            current->total_runtime++;
-        }
-        
-        // If task is still ready, put it back in queue
-        if (current->state == TASK_RUNNING) {
-            current->state = TASK_READY;
-            add_task_to_ready_queue(current);
-        }
+    while (cur != NULL && cur->priority <= task->priority) {
+        prev = cur;
+        cur = cur->next;
     }
     
-    // Load next task context
-    if (next != NULL) {
-        current_task = next;
-        next->state = TASK_RUNNING;
-        next->time_slice_remaining = TIME_SLICE_MS;
-        
-        // Remove from ready queue
-        remove_task_from_ready_queue(next);
-        
-        // In real system, restore CPU registers from next->registers[]
-        // and set stack pointer to next->stack_pointer
+    task->prev = prev;
+    task->next = cur;
+    if (cur != NULL) {
+        cur->prev = task;
+    }
+    if (prev != NULL) {
+        prev->next = task;
+    } else {
+        *queue = task;
     }
+    
+    task->wait_list = queue;
 }
 
-/*
- * SCHEDULER TICK
- * 
- * Called by system timer interrupt (simulated).
- * Handles time slicing and task switching.
- */
-void scheduler_tick(void) {
-    system_tick_count++;
-    stats.total_ticks++;
-    
-    if (!scheduler_running || current_task == NULL) {
+void wait_queue_remove(tcb_t* task) {
+    tcb_t** queue = task->wait_list;
+    if (queue == NULL) {
         return;
     }
     
-    // Update current task's time slice
-    if (current_task->time_slice_remaining > 0) {
-        current_task->time_slice_remaining--;
+    if (task->prev != NULL) {
+        task->prev->next = task->next;
+    } else {
+        *queue = task->next;
+    }
+    if (task->next != NULL) {
+        task->next->prev = task->prev;
     }
     
-    // Check for sleeping tasks to wake up
-    wake_sleeping_tasks();
+    task->next = NULL;
+    task->prev = NULL;
+    task->wait_list = NULL;
+}
+
+void task_block_on(tcb_t** queue) {
+    tcb_t* self = current_task;
     
-    // Check if current task's time slice expired or higher priority task ready
-    bool need_reschedule = false;
+    wait_queue_insert(queue, self);
+    self->state = TASK_BLOCKED;
     
-    // Time slice expiration
-    if (current_task->time_slice_remaining == 0) {
-        printf("⏰ Time slice expired for task %s\n", current_task->name);
-        need_reschedule = true;
-    }
+    task_block_current();
+}
+
+void task_block_current(void) {
+    tcb_t* self = current_task;
     
-    // Higher priority task became ready
-    tcb_t* highest_ready = get_highest_priority_ready_task();
-    if (highest_ready && highest_ready->priority < current_task->priority) {
-        printf("⚡ Higher priority task %s preempting %s\n", 
-               highest_ready->name, current_task->name);
-        need_reschedule = true;
-    }
+    // Once the lock is dropped another core may try to wake us before we
+    // are off the CPU; add_task_to_ready_queue makes it wait until we are.
+    kernel_unlock();
     
-    // Perform context switch if needed
-    if (need_reschedule) {
-        tcb_t* next_task = scheduler_get_next_task();
-        context_switch(current_task, next_task);
+    // A stackless task is switched out once its function has returned
+    if (this_core()->in_stackless) {
+        return;
     }
+    
+    context_switch(self, scheduler_get_next_task());
 }
 
-/*
- * GET HIGHEST PRIORITY READY TASK
- */
-tcb_t* get_highest_priority_ready_task(void) {
-    for (int priority = 0; priority < PRIORITY_LEVELS; priority++) {
-        if (ready_queues[priority] != NULL) {
-            return ready_queues[priority];
-        }
-    }
-    return NULL;
+void task_unblock(tcb_t* task) {
+    wait_queue_remove(task);
+    add_task_to_ready_queue(task);
 }
 
 /*
- * WAKE SLEEPING TASKS
+ * EFFECTIVE PRIORITY
  * 
- * Checks for tasks that should wake up from sleep.
+ * Changes the priority a task is scheduled at while keeping whichever
+ * queue it sits on (ready queue or wait queue) correctly ordered. Called
+ * with the kernel lock held.
  */
-void wake_sleeping_tasks(void) {
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (task_pool_used[i]) {
-            tcb_t* task = &task_pool[i];
-            
-            if (task->state == TASK_BLOCKED && 
-                task->wake_time > 0 && 
-                system_tick_count >= task->wake_time) {
-                
-                printf("😴 Waking up task %s\n", task->name);
-                task->wake_time = 0;
-                task->state = TASK_READY;
-                add_task_to_ready_queue(task);
-            }
-        }
+void task_set_effective_priority(tcb_t* task, uint8_t priority) {
+    if (task->priority == priority) {
+        return;
+    }
+    
+    if (task->state == TASK_READY && remove_task_from_ready_queue(task)) {
+        task->priority = priority;
+        add_task_to_ready_queue(task);
+    } else if (task->wait_list != NULL) {
+        tcb_t** queue = task->wait_list;
+        wait_queue_remove(task);
+        task->priority = priority;
+        wait_queue_insert(queue, task);
+    } else {
+        task->priority = priority;
     }
 }
 
 /*
  * START SCHEDULER
  * 
- * Begins task execution. This function never returns.
+ * Begins task execution. Returns only after a task calls rtos_stop().
  */
 void rtos_start(void) {
-    printf("🎯 Starting RTOS scheduler\n");
+    RTOS_LOG("🎯 Starting RTOS scheduler\n");
     
     scheduler_running = true;
+    start_time_ns = port_time_ns();
+    start_cycles = port_cycles();
+    
+    // In context-switch mode the first switch runs the tasks for real,
+    // and we only get back here once a task calls rtos_stop()
+    if (rtos_mode == RTOS_MODE_CONTEXT_SWITCH) {
+        if (core_count > 1) {
+            port_run_cores(core_count);
+        } else {
+            scheduler_run_core();
+        }
+        stop_cycles = port_cycles();
+        RTOS_LOG("🛑 RTOS scheduler stopped\n");
+        return;
+    }
+    
+    // Virtual time runs until every script has finished or only sleeps
+    // forever; see sim.c
+    if (rtos_mode == RTOS_MODE_VIRTUAL_TIME) {
+        sim_run_to_completion();
+        return;
+    }
     
     // Get first task to run
     tcb_t* first_task = scheduler_get_next_task();
     if (first_task == NULL) {
-        printf("❌ No tasks to run!\n");
+        RTOS_LOG("❌ No tasks to run!\n");
         return;
     }
     
-    printf("🏃 Starting with task: %s\n", first_task->name);
+    RTOS_LOG("🏃 Starting with task: %s\n", first_task->name);
     
     // Start first task
     context_switch(NULL, first_task);
     
     // Simulate scheduler main loop
-    // In a real system, this would be handled by timer interrupts
+    // In a real system, this would be handled by timer interrupts. Tick N
+    // is due N ms after the start; sleeping to that absolute time rather
+    // than for 1 ms keeps late ticks from pushing back all later ones.
     while (scheduler_running) {
-        // Simulate timer tick every 1ms
+        if (current_task->is_idle && get_highest_priority_ready_task() == NULL) {
+            idle_skip_ticks();
+        }
+        port_sleep_until(rtos_tick_time_ns(system_tick_count + 1));
+        tcb_t* ran = current_task;
         scheduler_tick();
         
-        // Simulate task execution
-        if (current_task && current_task->task_function) {
-            // In real system, task would run until preempted
-            // Here we simulate by calling task function briefly
-            printf("🔄 Running task %s\n", current_task->name);
+        // Simulate task execution: scripted tasks follow their script,
+        // the others just hold the CPU
+        sim_tick_scripts(ran);
+    }
+    stop_cycles = port_cycles();
+}
+
+void scheduler_run_core(void) {
+    rtos_core_t* core = this_core();
+    
+    core->last_tick = system_tick_count;
+    
+    tcb_t* first_task = scheduler_get_next_task();
+    RTOS_LOG("🏃 Core %u starting with task: %s\n", core->id, first_task->name);
+    
+    context_switch(NULL, first_task);
+}
+
+void rtos_stop(void) {
+    __atomic_store_n(&scheduler_running, false, __ATOMIC_SEQ_CST);
+    
+    // Sleeping cores are woken; the others notice at their next kernel entry
+    uint32_t sleepers = __atomic_load_n(&sleeping_cores, __ATOMIC_SEQ_CST);
+    for (uint32_t i = 0; i < core_count; i++) {
+        if (sleepers & (1u << i)) {
+            idle_wake(&cores[i]);
         }
-        
-        // Small delay to make output readable
-        usleep(1000); // 1ms delay
+    }
+    
+    if (rtos_mode == RTOS_MODE_CONTEXT_SWITCH && current_task != NULL) {
+        port_exit_to_kernel(current_task);
     }
 }
 
@@ -438,103 +1630,440 @@ void rtos_start(void) {
  */
 
 void task_yield(void) {
-    if (!scheduler_running || current_task == NULL) {
+    if (current_task == NULL) {
+        return;
+    }
+    if (!scheduler_running) {
+        scheduler_reschedule(); // Leaves for the kernel once stopped
         return;
     }
-    
-    printf("🤝 Task %s yielding CPU\n", current_task->name);
     
     // Force time slice to expire
     current_task->time_slice_remaining = 0;
     
-    // Trigger reschedule
-    scheduler_tick();
+    // Trigger reschedule. The simulated scheduler treats a yield as a tick;
+    // in virtual time only the simulation moves the clock.
+    if (rtos_mode == RTOS_MODE_SIMULATED) {
+        scheduler_tick();
+    } else {
+        poll_host_clock();
+        scheduler_reschedule();
+    }
+}
+
+void task_preemption_point(void) {
+    if (current_task == NULL) {
+        return;
+    }
+    
+    poll_host_clock();
+    scheduler_reschedule();
 }
 
 void task_sleep(uint32_t ms) {
-    if (!scheduler_running || current_task == NULL) {
+    if (current_task == NULL) {
+        return;
+    }
+    
+    // Once stopped, a task must not spin through its sleeps: yielding
+    // leaves for the kernel
+    if (ms == 0 || !scheduler_running) {
+        task_yield();
         return;
     }
     
-    printf("😴 Task %s sleeping for %u ms\n", current_task->name, ms);
+    poll_host_clock();
     
-    // Set wake time
-    current_task->wake_time = system_tick_count + ms;
+    kernel_lock();
+    uint32_t wake = system_tick_count + ms;
+    task_block_until(wake != 0 ? wake : 1); // 0 would mean "forever"
+}
+
+void task_block_until(uint32_t tick) {
     current_task->state = TASK_BLOCKED;
+    task_set_wake_time(current_task, tick);
+    
+    // Switch to next task
+    task_block_current();
+}
+
+void task_wake_at(tcb_t* task, uint32_t tick) {
+    if (task->state != TASK_BLOCKED ||
+        (task->wake_time != 0 && (int32_t)(tick - task->wake_time) >= 0)) {
+        return;
+    }
+    
+    if ((int32_t)(tick - system_tick_count) <= 0) {
+        add_task_to_ready_queue(task);
+    } else {
+        task_set_wake_time(task, tick);
+    }
+}
+
+int task_wait_next_period(void) {
+    tcb_t* self = current_task;
+    
+    if (self == NULL || !task_is_realtime(self)) {
+        return -1;
+    }
+    if (!scheduler_running) {
+        task_yield(); // Leaves for the kernel once stopped
+        return 0;
+    }
+    
+    poll_host_clock();
+    
+    kernel_lock();
+    if (!realtime_finish_job(self)) {
+        // Running late: the next job starts now, but its deadline may be
+        // later than another ready job's, so give the scheduler a look
+        kernel_unlock();
+        task_yield();
+        return 0;
+    }
+    
+    // Sleep until the next release like task_sleep
+    task_block_until(self->release_time);
+    return 0;
+}
+
+/*
+ * STACKLESS TASKS
+ * 
+ * A stackless task's function runs on its core's runner (port.c) and is
+ * called afresh each time, so the kernel must never switch away from
+ * inside it: the frames below would be lost. Kernel calls made from it
+ * therefore only mark the task blocked (or deleted) and return, and
+ * preemption is held off. Once the function has returned, this does the
+ * switch the call would have done.
+ */
+void stackless_run(void) {
+    rtos_core_t* core = this_core();
+    tcb_t* self = core->current;
+    
+    core->in_stackless = true;
+    pt_status_t status = self->pt_function(&self->pt, self->task_parameter);
+    if (status == PT_EXITED && self->state != TASK_TERMINATED) {
+        task_delete(self->task_id);
+    }
+    core->in_stackless = false;
+    
+    if (self->state == TASK_BLOCKED || self->state == TASK_SUSPENDED ||
+        self->state == TASK_TERMINATED) {
+        context_switch(self, scheduler_get_next_task());
+    } else if (status == PT_YIELDED) {
+        task_yield();
+    } else {
+        scheduler_reschedule();
+    }
+    
+    // After a switch self may run on another core or be gone: the runner
+    // just calls whichever stackless task is current next
+}
+
+bool task_will_block(void) {
+    rtos_core_t* core = this_core();
+    tcb_t* self = core->current;
     
-    // Remove from ready queue and switch to next task
-    tcb_t* next_task = scheduler_get_next_task();
-    context_switch(current_task, next_task);
+    return self != NULL && core->in_stackless &&
+           (self->state == TASK_BLOCKED || self->state == TASK_SUSPENDED ||
+            self->state == TASK_TERMINATED);
 }
 
 uint32_t task_get_current_id(void) {
     return current_task ? current_task->task_id : 0;
 }
 
-tcb_t* task_get_info(uint32_t task_id) {
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (task_pool_used[i] && task_pool[i].task_id == task_id) {
-            return &task_pool[i];
-        }
+uint32_t task_get_current_core(void) {
+    rtos_core_t* core = this_core();
+    return core->current ? core->id : 0;
+}
+
+int task_set_affinity(uint32_t task_id, uint32_t mask) {
+    if ((mask & all_cores_mask()) == 0) {
+        return -1;
     }
-    return NULL;
+    
+    kernel_lock();
+    tcb_t* task = task_lookup(task_id);
+    // Idle tasks and admitted periodic tasks stay on their core
+    if (task == NULL || task->is_idle || task_is_realtime(task)) {
+        kernel_unlock();
+        return -1;
+    }
+    
+    task->affinity_mask = mask;
+    
+    // A queued task moves now; a running one moves when it is switched out
+    rtos_core_t* queued_on = __atomic_load_n(&task->run_queue, __ATOMIC_ACQUIRE);
+    if (queued_on != NULL && !(mask & (1u << queued_on->id)) &&
+        remove_task_from_ready_queue(task)) {
+        add_task_to_ready_queue(task);
+    }
+    kernel_unlock();
+    
+    return 0;
 }
 
 /*
  * UTILITY FUNCTIONS
  */
 
+int task_get_runtime(uint32_t task_id, task_runtime_t* out) {
+    tcb_t* task = task_get_info(task_id);
+    if (task == NULL) {
+        return -1;
+    }
+    
+    memset(out, 0, sizeof(*out));
+    
+    if (rtos_mode == RTOS_MODE_VIRTUAL_TIME) {
+        out->cpu_ns = (uint64_t)task->total_runtime * 1000000u;
+        out->elapsed_ns = (uint64_t)system_tick_count * 1000000u;
+        return 0;
+    }
+    
+    uint64_t now = __atomic_load_n(&scheduler_running, __ATOMIC_ACQUIRE) ?
+                   port_cycles() : stop_cycles;
+    uint64_t cpu_cycles, ready_cycles, max_ready_cycles, switched_in_at;
+    uint32_t seq;
+    uint32_t spins = 0;
+    
+    while (1) {
+        seq = __atomic_load_n(&task->account_seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            port_relax(&spins); // Its core is updating it right now
+            continue;
+        }
+        
+        cpu_cycles = task->cpu_cycles;
+        ready_cycles = task->ready_cycles;
+        max_ready_cycles = task->max_ready_cycles;
+        switched_in_at = task->switched_in_at;
+        out->runs = task->runs;
+        memcpy(out->run_histogram, task->run_histogram, sizeof(out->run_histogram));
+        memcpy(out->ready_histogram, task->ready_histogram, sizeof(out->ready_histogram));
+        
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&task->account_seq, __ATOMIC_RELAXED) == seq) {
+            break;
+        }
+    }
+    
+    // A run in progress counts up to now
+    if (switched_in_at != 0 && now > switched_in_at) {
+        cpu_cycles += now - switched_in_at;
+    }
+    
+    double ns_per_cycle = port_ns_per_cycle();
+    out->cpu_ns = (uint64_t)(cpu_cycles * ns_per_cycle);
+    out->ready_ns = (uint64_t)(ready_cycles * ns_per_cycle);
+    out->max_ready_ns = (uint64_t)(max_ready_cycles * ns_per_cycle);
+    if (start_cycles != 0 && now > start_cycles) {
+        out->elapsed_ns = (uint64_t)((now - start_cycles) * ns_per_cycle);
+    }
+    
+    return 0;
+}
+
 scheduler_stats_t* get_scheduler_stats(void) {
+    // Hot counters live per core; fold them into the global view
+    stats.total_context_switches = 0;
+    stats.idle_time = 0;
+    stats.task_steals = 0;
+    stats.task_migrations = 0;
+    
+    for (uint32_t i = 0; i < core_count; i++) {
+        stats.total_context_switches += cores[i].stats.context_switches;
+        stats.idle_time += cores[i].stats.idle_time;
+        stats.task_steals += cores[i].stats.steals;
+        stats.task_migrations += cores[i].stats.migrations;
+    }
+    
     return &stats;
 }
 
+int get_core_stats(uint32_t core, core_stats_t* out) {
+    if (core >= core_count) {
+        return -1;
+    }
+    
+    *out = cores[core].stats;
+    return 0;
+}
+
 void print_task_list(void) {
     printf("\n📋 TASK LIST\n");
     printf("============\n");
-    printf("ID   Name         State      Priority  Runtime  Stack\n");
-    printf("---  -----------  ---------  --------  -------  -----\n");
+    printf("ID   Name         State      Priority  Runtime   CPU %%  Wait us  Stack   Used     Heap\n");
+    printf("---  -----------  ---------  --------  -------  ------  -------  -----  -----  -------\n");
+    
+    uint32_t slot_count = task_table_slot_count();
     
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (task_pool_used[i]) {
-            tcb_t* task = &task_pool[i];
+    for (uint32_t i = 0; i < slot_count; i++) {
+        tcb_t* task = task_table_slot(i);
+        
+        if (task != NULL) {
             const char* state_str;
+            task_runtime_t runtime;
             
             switch (task->state) {
                 case TASK_READY: state_str = "READY"; break;
                 case TASK_RUNNING: state_str = "RUNNING"; break;
-                case TASK_BLOCKED: state_str = "BLOCKED"; break;
+                case TASK_BLOCKED: state_str = task->io_waiting ? "IO WAIT" : "BLOCKED"; break;
                 case TASK_SUSPENDED: state_str = "SUSPENDED"; break;
                 case TASK_TERMINATED: state_str = "TERMINATED"; break;
                 default: state_str = "UNKNOWN"; break;
             }
             
-            printf("%3u  %-11s  %-9s  %8u  %7u  %5u\n",
+            // Real load: measured CPU time over the time since rtos_start,
+            // and the average wait between becoming ready and running
+            task_get_runtime(task->task_id, &runtime);
+            double load = runtime.elapsed_ns ? 100.0 * runtime.cpu_ns / runtime.elapsed_ns : 0;
+            double wait = runtime.runs ? runtime.ready_ns / 1000.0 / runtime.runs : 0;
+            
+            // Deepest the stack has been (0 when stacks are not painted)
+            stack_usage_t stack;
+            task_get_stack_usage(task->task_id, &stack);
+            
+            printf("%3u  %-11s  %-9s  %8u  %7u  %6.2f  %7.1f  %5u  %5u  %7u\n",
                    task->task_id, task->name, state_str,
-                   task->priority, task->total_runtime, task->stack_size);
+                   task->priority, task->total_runtime, load, wait,
+                   task->stack_size, stack.used, task->heap_used);
         }
     }
 }
 
 void print_scheduler_stats(void) {
+    get_scheduler_stats();
+    
     printf("\n📊 SCHEDULER STATISTICS\n");
     printf("=======================\n");
     printf("System uptime:      %u ticks\n", system_tick_count);
     printf("Context switches:   %u\n", stats.total_context_switches);
     printf("Tasks created:      %u\n", stats.tasks_created);
-    printf("Tasks deleted:      %u\n", stats.tasks_deleted);
+    printf("Tasks deleted:      %u", stats.tasks_deleted);
+    if (stats.tasks_reclaimed < stats.tasks_deleted) {
+        printf(" (%u awaiting reclaim)", stats.tasks_deleted - stats.tasks_reclaimed);
+    }
+    printf("\n");
     printf("Idle time:          %u ticks\n", stats.idle_time);
+    printf("Stack memory:       %zu KiB mapped\n", stack_pool_mapped_bytes() / 1024);
     printf("CPU utilization:    %u%%\n", get_cpu_utilization());
+    
+    if (sched_policy != SCHED_FIXED_PRIORITY) {
+        printf("Periodic jobs:      %u completed\n", stats.jobs_completed);
+        printf("Deadline misses:    %u\n", stats.deadline_misses);
+        printf("Admissions refused: %u\n", stats.admission_rejections);
+    }
+    
+    if (stats.timer_callbacks > 0) {
+        printf("Timer callbacks:    %u in %u batches, %u overruns\n", stats.timer_callbacks,
+               stats.timer_batches, stats.timer_overruns);
+    }
+    
+    if (stats.interrupts > 0) {
+        printf("Interrupts:         %u, bottom halves run %u times (%u events coalesced)\n",
+               stats.interrupts, stats.deferred_runs, stats.deferred_coalesced);
+    }
+    
+    if (stats.io_wakeups > 0) {
+        printf("I/O wake-ups:       %u from %u looks at the multiplexer\n", stats.io_wakeups,
+               stats.io_polls);
+    }
+    
+    if (core_count > 1) {
+        printf("Task steals:        %u\n", stats.task_steals);
+        printf("Task migrations:    %u (%.1f%% of switches)\n", stats.task_migrations,
+               stats.total_context_switches ?
+               100.0 * stats.task_migrations / stats.total_context_switches : 0.0);
+        
+        for (uint32_t i = 0; i < core_count; i++) {
+            printf("  Core %2u: %u switches, %u steals, %u migrations in, %u idle\n",
+                   i, cores[i].stats.context_switches, cores[i].stats.steals,
+                   cores[i].stats.migrations, cores[i].stats.idle_time);
+        }
+    }
+}
+
+void print_stack_report(void) {
+    uint32_t slot_count = task_table_slot_count();
+    uint64_t allocated = 0;
+    uint64_t recommended = 0;
+    uint32_t tight = 0;
+    
+    printf("\n📏 STACK REPORT\n");
+    printf("===============\n");
+    
+    if (rtos_mode != RTOS_MODE_CONTEXT_SWITCH) {
+        printf("Stacks are only painted and measured in context-switch mode\n");
+        return;
+    }
+    
+    printf("ID   Name          Size   Used  Used %%  Advice\n");
+    printf("---  -----------  -----  -----  ------  ------\n");
+    
+    for (uint32_t i = 0; i < slot_count; i++) {
+        tcb_t* task = task_table_slot(i);
+        stack_usage_t usage;
+        
+        if (task == NULL || task_get_stack_usage(task->task_id, &usage) != 0 || usage.size == 0) {
+            continue; // Free slot or stackless task
+        }
+        
+        double percent = 100.0 * usage.used / usage.size;
+        bool too_small = usage.recommended > usage.size;
+        
+        printf("%3u  %-11s  %5u  %5u  %5.1f%%  %6u%s\n", task->task_id, task->name,
+               usage.size, usage.used, percent, usage.recommended,
+               too_small ? "  ⚠️  too small" : "");
+        
+        allocated += usage.size;
+        recommended += usage.recommended;
+        tight += too_small;
+    }
+    
+    // Stacks come in power-of-two pages and never below CONTEXT_STACK_MIN,
+    // so task_create may round an advised size back up
+    printf("Advice: high-water mark plus %d%%, in whole pages (task_create "
+           "uses at least %d bytes)\n", STACK_SAFETY_PERCENT, CONTEXT_STACK_MIN);
+    printf("Stacks allocated: %llu KiB, advised: %llu KiB", (unsigned long long)allocated / 1024,
+           (unsigned long long)recommended / 1024);
+    if (recommended < allocated) {
+        printf(" (%llu KiB to save)", (unsigned long long)(allocated - recommended) / 1024);
+    }
+    printf("\n");
+    if (tight > 0) {
+        printf("⚠️  %u task(s) should get a bigger stack\n", tight);
+    }
 }
 
 uint32_t get_system_uptime(void) {
     return system_tick_count;
 }
 
+void rtos_set_switch_hook(rtos_switch_hook_t hook) {
+    switch_hook = hook;
+}
+
+uint64_t rtos_tick_time_ns(uint32_t tick) {
+    return start_time_ns + (uint64_t)tick * 1000000u;
+}
+
 uint8_t get_cpu_utilization(void) {
-    if (stats.total_ticks == 0) {
-        return 0;
+    uint64_t elapsed = 0;
+    uint64_t idle = 0;
+    
+    for (uint32_t i = 0; i < core_count; i++) {
+        task_runtime_t runtime;
+        if (cores[i].idle != NULL && task_get_runtime(cores[i].idle->task_id, &runtime) == 0) {
+            elapsed += runtime.elapsed_ns;
+            idle += runtime.cpu_ns < runtime.elapsed_ns ? runtime.cpu_ns : runtime.elapsed_ns;
+        }
     }
     
-    uint32_t busy_time = stats.total_ticks - stats.idle_time;
-    return (uint8_t)((busy_time * 100) / stats.total_ticks);
-}
\ No newline at end of file
+    if (elapsed == 0) {
+        return 0;
+    }
+    return (uint8_t)((elapsed - idle) * 100 / elapsed);
+}
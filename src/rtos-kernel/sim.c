@@ -0,0 +1,251 @@
+/*
+ * RTOS Virtual-Time Simulation
+ *
+ * The simulated mode ticks once per real millisecond, so an hour of
+ * scheduler behaviour takes an hour to watch. But between two interesting
+ * moments nothing happens: the running task keeps running and everyone
+ * else keeps waiting. A discrete-event simulation skips those stretches.
+ * At every step it asks "when is the next thing going to happen?" and
+ * jumps system_tick_count straight there. The candidates are:
+ *
+ *   - the running task's CPU burst finishes
+ *   - a sleeping task (or a periodic task waiting for its release) wakes
+ *   - the running task's time slice runs out
+ *
+ * Tasks do not execute code in this mode. Each follows a script of CPU
+ * bursts and sleeps (see script_step_t), which is exactly the information
+ * the scheduler ever sees of a task anyway. Everything else is the real
+ * kernel: the same run queues, policies, wake-ups and statistics, with
+ * context switches reduced to bookkeeping as in the simulated mode.
+ *
+ * Nothing depends on the host clock, and the random jitter in scripts
+ * comes from a seeded generator, so a run can be replayed exactly and two
+ * policies can be compared on the very same workload.
+ */
+
+#define _GNU_SOURCE
+#include "rtos_internal.h"
+
+#define SCRIPT_MAX_STEPS 4096                 // Longest script task_set_script accepts
+
+static uint32_t sim_rng = 1;                  // xorshift32 state, never 0
+
+/*
+ * DETERMINISTIC JITTER
+ */
+void rtos_sim_seed(uint32_t seed) {
+    sim_rng = seed != 0 ? seed : 1;
+}
+
+static uint32_t sim_random(void) {
+    sim_rng ^= sim_rng << 13;
+    sim_rng ^= sim_rng >> 17;
+    sim_rng ^= sim_rng << 5;
+    return sim_rng;
+}
+
+static uint32_t step_length(const script_step_t* step) {
+    if (step->jitter == 0) {
+        return step->ticks;
+    }
+    return step->ticks + sim_random() % (step->jitter + 1);
+}
+
+/*
+ * SCRIPTS
+ *
+ * A looping script must take time somewhere, or the simulation would
+ * spin forever at one tick.
+ */
+int task_set_script(uint32_t task_id, const script_step_t* script) {
+    if (script == NULL) {
+        return -1;
+    }
+
+    bool takes_time = false;
+    uint32_t i;
+    for (i = 0; i < SCRIPT_MAX_STEPS; i++) {
+        script_op_t op = script[i].op;
+        if (op == SCRIPT_END || op == SCRIPT_REPEAT) {
+            break;
+        }
+        if (op == SCRIPT_WAIT_PERIOD || script[i].ticks > 0) {
+            takes_time = true;
+        } else if (op != SCRIPT_BURST && op != SCRIPT_SLEEP) {
+            return -1;
+        }
+    }
+    if (i == SCRIPT_MAX_STEPS || (script[i].op == SCRIPT_REPEAT && !takes_time)) {
+        RTOS_LOG("❌ Script for task %u has no end or loops without taking time\n", task_id);
+        return -1;
+    }
+
+    kernel_lock();
+    tcb_t* task = task_lookup(task_id);
+    if (task == NULL || task->is_idle) {
+        kernel_unlock();
+        return -1;
+    }
+    task->script = script;
+    task->script_pc = 0;
+    task->burst_remaining = 0;
+    kernel_unlock();
+
+    return 0;
+}
+
+/*
+ * Let the running task carry out its zero-time steps (starting a burst,
+ * going to sleep, ending a job, exiting) until it is in the middle of a
+ * burst. Steps that block switch to another task, which may have steps of
+ * its own to carry out.
+ */
+static void sim_run_steps(void) {
+    while (scheduler_running) {
+        tcb_t* task = current_task;
+        if (task == NULL || task->is_idle || task->script == NULL ||
+            task->burst_remaining > 0) {
+            return;
+        }
+
+        const script_step_t* step = &task->script[task->script_pc++];
+
+        switch (step->op) {
+            case SCRIPT_BURST:
+                task->burst_remaining = step_length(step);
+                break;
+
+            case SCRIPT_SLEEP:
+                task_sleep(step_length(step));
+                break;
+
+            case SCRIPT_WAIT_PERIOD:
+                task_wait_next_period();
+                break;
+
+            case SCRIPT_REPEAT:
+                task->script_pc = 0;
+                break;
+
+            case SCRIPT_END:
+                task_delete(task->task_id);
+                break;
+        }
+    }
+}
+
+/*
+ * Zero-time steps and preemptions until the running task is mid-burst
+ * (or idle) and nothing outranks it
+ */
+static void sim_settle(void) {
+    tcb_t* before;
+    do {
+        sim_run_steps();
+        before = current_task;
+        scheduler_reschedule();
+    } while (current_task != before && scheduler_running);
+}
+
+/*
+ * ADVANCE VIRTUAL TIME
+ *
+ * Charges the elapsed ticks to the running task exactly as that many
+ * timer interrupts would have, then wakes whoever is due.
+ */
+static void sim_advance(uint32_t delta) {
+    tcb_t* task = current_task;
+
+    system_tick_count += delta;
+    stats.total_ticks += delta;
+    if (delta > 0) {
+        trace_record(TRACE_TICK, NULL, system_tick_count);
+    }
+
+    task->total_runtime += delta;
+    if (task->is_idle) {
+        this_core()->stats.idle_time += delta;
+    } else if (task->script != NULL) {
+        task->burst_remaining -= delta;
+    }
+    task->time_slice_remaining = task->time_slice_remaining > delta ?
+                                 task->time_slice_remaining - delta : 0;
+
+    wake_sleeping_tasks();
+}
+
+static uint64_t sim_loop(uint32_t ticks, bool stop_when_quiet) {
+    uint32_t end = system_tick_count + ticks;
+    uint64_t events = 0;
+
+    scheduler_running = true;
+    if (current_task == NULL) {
+        context_switch(NULL, scheduler_get_next_task());
+    }
+
+    while (scheduler_running) {
+        sim_settle();
+
+        int32_t remaining = (int32_t)(end - system_tick_count);
+        if (remaining <= 0) {
+            break;
+        }
+
+        // Jump to whichever event comes first
+        tcb_t* task = current_task;
+        uint32_t delta = (uint32_t)remaining;
+        uint32_t wake = 0;
+        bool wake_pending = next_wake_tick(&wake);
+
+        if (wake_pending) {
+            int32_t until_wake = (int32_t)(wake - system_tick_count);
+            if (until_wake < (int32_t)delta) {
+                delta = until_wake > 0 ? (uint32_t)until_wake : 0;
+            }
+        }
+
+        if (!task->is_idle) {
+            if (task->script != NULL && task->burst_remaining < delta) {
+                delta = task->burst_remaining;
+            }
+            if (task->time_slice_remaining > 0 && task->time_slice_remaining < delta) {
+                delta = task->time_slice_remaining;
+            }
+        } else if (!wake_pending && stop_when_quiet) {
+            break; // Nothing will ever happen again
+        }
+
+        sim_advance(delta);
+        events++;
+    }
+
+    scheduler_running = false;
+    return events;
+}
+
+uint64_t rtos_sim_run(uint32_t ticks) {
+    if (rtos_mode != RTOS_MODE_VIRTUAL_TIME) {
+        return 0;
+    }
+
+    return sim_loop(ticks, false);
+}
+
+void sim_run_to_completion(void) {
+    sim_loop(0x7FFFFFFFu, true);
+}
+
+/*
+ * REAL-TIME SCRIPTS
+ *
+ * The simulated mode's tick loop runs scripts too, one tick at a time
+ * instead of jumping ahead: the task that held the CPU through the tick
+ * has spent one more tick of its burst, and whatever the task running now
+ * does next happens at once.
+ */
+void sim_tick_scripts(tcb_t* ran) {
+    if (ran != NULL && ran->script != NULL && ran->burst_remaining > 0) {
+        ran->burst_remaining--;
+    }
+    sim_settle();
+}
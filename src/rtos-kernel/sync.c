@@ -0,0 +1,720 @@
+/*
+ * RTOS Synchronization Primitives
+ *
+ * MUTEXES:
+ * The lock is a single word holding the owner's TCB address. Because TCBs
+ * are word aligned, the low bit is free to mean "somebody is waiting".
+ *
+ *   unlocked:            0
+ *   locked, no waiters:  owner
+ *   locked, contended:   owner | MUTEX_HAS_WAITERS
+ *
+ * lock:   CAS 0 -> self            (fast path, no scheduler involvement)
+ * unlock: CAS self -> 0            (fast path, fails only if waiters exist)
+ *
+ * Everything else is the slow path: a locker that finds the mutex owned
+ * sets the waiters bit, queues itself by priority and blocks. Unlock then
+ * hands ownership straight to the highest-priority waiter, so the mutex is
+ * never observed free while tasks are queued on it.
+ *
+ * PRIORITY INHERITANCE:
+ * While a task waits, the owner runs at the waiter's priority if that is
+ * higher. Without it a medium-priority task can preempt a low-priority
+ * owner indefinitely while a high-priority task waits on that owner
+ * (the classic Mars Pathfinder priority inversion). Boosts follow chains
+ * of owners that are themselves blocked on other mutexes, and an owner
+ * drops back to the highest priority still owed to it when it unlocks.
+ *
+ * SEMAPHORES:
+ * The count is manipulated with atomics, so taking an available unit or
+ * signalling with nobody waiting never enters the scheduler. A task that
+ * has to wait decrements the count below zero, which tells signal to take
+ * the slow path and pass the unit directly to the best waiter; no other
+ * task can snatch the unit in between.
+ *
+ * TASK NOTIFICATIONS:
+ * A semaphore used to signal one task is an object both sides share, with
+ * a wait queue that has to be searched for the waiter's place. A
+ * notification is addressed to the task itself: the sender finds the TCB
+ * by ID (a hash lookup), updates its notification value and, if the task
+ * is blocked waiting for it, readies exactly that task. There is nothing
+ * to allocate, initialize or queue on.
+ *
+ * EVENT GROUPS:
+ * Each bit has its own list of waiters. The list links are not allocated:
+ * a waiting task keeps an event_waiter_t on its stack with one link per
+ * bit, and the stack stays put while the task is blocked. A task waiting
+ * for any of several bits is linked on all of them. A task waiting for
+ * all of them is linked on just one bit it still lacks; when that bit is
+ * set it either has everything and wakes, or moves on to the next bit it
+ * lacks. So setting bits visits only tasks that wake or move, never a
+ * task waiting for something else, and waited_bits tells the set_bits
+ * fast path in one load that nobody waits for the bits being set.
+ *
+ * SMP:
+ * The fast paths are unchanged. The slow paths run under the kernel lock,
+ * and a waiter always makes itself visible (waiters bit, negative count,
+ * waited_bits) under that lock before it blocks, so a wakeup can never be
+ * lost between a failed fast path and going to sleep.
+ */
+
+#include "rtos_internal.h"
+
+static inline tcb_t* mutex_owner(uintptr_t state) {
+    return (tcb_t*)(state & ~MUTEX_HAS_WAITERS);
+}
+
+/*
+ * PRIORITY INHERITANCE HELPERS
+ */
+
+// Raise the owner of a mutex (and anyone the owner waits on) to priority
+static void mutex_boost_owner(mutex_t* mutex, uint8_t priority) {
+    while (mutex != NULL && mutex->priority_inheritance) {
+        tcb_t* owner = mutex_owner(mutex->state);
+        if (owner == NULL || owner->priority <= priority) {
+            break;
+        }
+
+        RTOS_LOG("⬆️  Task %s inherits priority %u\n", owner->name, priority);
+        task_set_effective_priority(owner, priority);
+        stats.priority_boosts++;
+
+        mutex = owner->waiting_for_mutex;
+    }
+}
+
+// Drop a task back to the highest priority any of its waiters still needs
+static void mutex_restore_priority(tcb_t* task) {
+    uint8_t priority = task->base_priority;
+
+    for (mutex_t* m = task->contended_mutexes; m != NULL; m = m->next_contended) {
+        if (m->priority_inheritance && m->waiting_tasks != NULL &&
+            m->waiting_tasks->priority < priority) {
+            priority = m->waiting_tasks->priority;
+        }
+    }
+
+    if (priority != task->priority) {
+        RTOS_LOG("⬇️  Task %s returns to priority %u\n", task->name, priority);
+        task_set_effective_priority(task, priority);
+    }
+}
+
+void mutex_priority_changed(tcb_t* task) {
+    mutex_restore_priority(task);
+    if (task->waiting_for_mutex != NULL) {
+        mutex_boost_owner(task->waiting_for_mutex, task->priority);
+    }
+}
+
+static void contended_list_remove(tcb_t* owner, mutex_t* mutex) {
+    mutex_t** link = &owner->contended_mutexes;
+
+    while (*link != NULL && *link != mutex) {
+        link = &(*link)->next_contended;
+    }
+    if (*link == mutex) {
+        *link = mutex->next_contended;
+    }
+    mutex->next_contended = NULL;
+}
+
+/*
+ * MUTEX API
+ */
+void mutex_init(mutex_t* mutex) {
+    mutex->state = 0;
+    mutex->owner_task_id = 0;
+    mutex->waiting_tasks = NULL;
+    mutex->next_contended = NULL;
+    mutex->priority_inheritance = true;
+}
+
+int mutex_lock(mutex_t* mutex) {
+    tcb_t* self = current_task;
+    if (self == NULL) {
+        return -1;
+    }
+
+    // Fast path: a free mutex is taken with one atomic operation
+    uintptr_t state = 0;
+    if (__atomic_compare_exchange_n(&mutex->state, &state, (uintptr_t)self, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        mutex->owner_task_id = self->task_id;
+        return 0;
+    }
+
+    // Slow path: mark the mutex contended (or grab it if it just came free)
+    kernel_lock();
+    state = __atomic_load_n(&mutex->state, __ATOMIC_RELAXED);
+    while (1) {
+        if (state == 0) {
+            if (__atomic_compare_exchange_n(&mutex->state, &state, (uintptr_t)self, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                mutex->owner_task_id = self->task_id;
+                kernel_unlock();
+                return 0;
+            }
+            continue;
+        }
+
+        if (mutex_owner(state) == self) {
+            kernel_unlock();
+            RTOS_LOG("❌ Task %s already owns this mutex\n", self->name);
+            return -1;
+        }
+
+        if (state & MUTEX_HAS_WAITERS) {
+            break;
+        }
+
+        if (__atomic_compare_exchange_n(&mutex->state, &state, state | MUTEX_HAS_WAITERS,
+                                        false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    tcb_t* owner = mutex_owner(state);
+    RTOS_LOG("🔒 Task %s blocks on mutex owned by %s\n", self->name, owner->name);
+    stats.mutex_contentions++;
+
+    // The first waiter makes this mutex relevant to the owner's priority
+    if (mutex->waiting_tasks == NULL) {
+        mutex->next_contended = owner->contended_mutexes;
+        owner->contended_mutexes = mutex;
+    }
+
+    self->waiting_for_mutex = mutex;
+    mutex_boost_owner(mutex, self->priority);
+
+    // Sleep until mutex_unlock hands the mutex over to us (the waiters bit
+    // forces the owner into the slow path, which waits for the kernel lock
+    // and so always finds us queued)
+    task_block_on(&mutex->waiting_tasks);
+
+    return 0;
+}
+
+int mutex_unlock(mutex_t* mutex) {
+    tcb_t* self = current_task;
+    if (self == NULL) {
+        return -1;
+    }
+
+    // Fast path: nobody is waiting, release with one atomic operation
+    uintptr_t state = (uintptr_t)self;
+    mutex->owner_task_id = 0;
+    if (__atomic_compare_exchange_n(&mutex->state, &state, 0, false,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    if (mutex_owner(state) != self) {
+        mutex->owner_task_id = mutex_owner(state) ? mutex_owner(state)->task_id : 0;
+        RTOS_LOG("❌ Task %s unlocking a mutex it does not own\n", self->name);
+        return -1;
+    }
+
+    // Slow path: hand the mutex to the highest-priority waiter
+    kernel_lock();
+    tcb_t* next_owner = mutex->waiting_tasks;
+    if (next_owner == NULL) {
+        // The last waiter was deleted while blocked, after the waiters bit
+        // sent us here: release as the fast path would have
+        contended_list_remove(self, mutex);
+        mutex_restore_priority(self);
+        __atomic_store_n(&mutex->state, 0, __ATOMIC_RELEASE);
+        kernel_unlock();
+        return 0;
+    }
+    wait_queue_remove(next_owner);
+    next_owner->waiting_for_mutex = NULL;
+
+    contended_list_remove(self, mutex);
+
+    uintptr_t new_state = (uintptr_t)next_owner;
+    if (mutex->waiting_tasks != NULL) {
+        new_state |= MUTEX_HAS_WAITERS;
+        mutex->next_contended = next_owner->contended_mutexes;
+        next_owner->contended_mutexes = mutex;
+    }
+    mutex->owner_task_id = next_owner->task_id;
+    __atomic_store_n(&mutex->state, new_state, __ATOMIC_RELEASE);
+
+    RTOS_LOG("🔓 Mutex handed from %s to %s\n", self->name, next_owner->name);
+
+    // The new owner inherits from the waiters it now holds up, and we give
+    // back whatever priority this mutex's waiters lent us
+    if (mutex->waiting_tasks != NULL) {
+        mutex_boost_owner(mutex, mutex->waiting_tasks->priority);
+    }
+    mutex_restore_priority(self);
+
+    add_task_to_ready_queue(next_owner);
+    kernel_unlock();
+
+    // Run the new owner right away if it outranks us
+    scheduler_reschedule();
+
+    return 0;
+}
+
+// Called with the kernel lock held
+void mutex_cancel_wait(tcb_t* task) {
+    mutex_t* mutex = task->waiting_for_mutex;
+
+    wait_queue_remove(task);
+    task->waiting_for_mutex = NULL;
+
+    tcb_t* owner = mutex_owner(mutex->state);
+    if (mutex->waiting_tasks == NULL) {
+        __atomic_and_fetch(&mutex->state, ~MUTEX_HAS_WAITERS, __ATOMIC_RELAXED);
+        contended_list_remove(owner, mutex);
+    }
+    mutex_restore_priority(owner);
+}
+
+/*
+ * SEMAPHORE API
+ */
+void semaphore_init(semaphore_t* sem, int32_t initial_count) {
+    sem->count = initial_count;
+    sem->waiting_tasks = NULL;
+}
+
+int semaphore_wait(semaphore_t* sem) {
+    // Fast path: take a unit if one is available
+    int32_t count = __atomic_load_n(&sem->count, __ATOMIC_RELAXED);
+    while (count > 0) {
+        if (__atomic_compare_exchange_n(&sem->count, &count, count - 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return 0;
+        }
+    }
+
+    // Slow path: block until semaphore_signal hands us a unit
+    if (current_task == NULL) {
+        return -1;
+    }
+
+    kernel_lock();
+
+    // Claim a unit or register as a waiter in one step. A signaller that
+    // sees the negative count takes the kernel lock, so it cannot look
+    // for us before we are on the wait queue.
+    if (__atomic_fetch_sub(&sem->count, 1, __ATOMIC_ACQ_REL) > 0) {
+        kernel_unlock();
+        return 0;
+    }
+
+    RTOS_LOG("⏳ Task %s waits on semaphore\n", current_task->name);
+    task_block_on(&sem->waiting_tasks);
+
+    return 0;
+}
+
+int semaphore_signal(semaphore_t* sem) {
+    // Fast path: nobody waiting, just count the unit
+    if (__atomic_fetch_add(&sem->count, 1, __ATOMIC_ACQ_REL) >= 0) {
+        return 0;
+    }
+
+    // Slow path: give the unit to the highest-priority waiter
+    kernel_lock();
+    tcb_t* waiter = sem->waiting_tasks;
+    if (waiter == NULL) {
+        // The waiter was deleted while blocked and never took its unit
+        __atomic_add_fetch(&sem->count, 1, __ATOMIC_RELEASE);
+        kernel_unlock();
+        return 0;
+    }
+
+    RTOS_LOG("🚦 Semaphore wakes task %s\n", waiter->name);
+    task_unblock(waiter);
+    kernel_unlock();
+
+    scheduler_reschedule();
+
+    return 0;
+}
+
+/*
+ * TIMED WAITS
+ */
+
+// Tick at which a timed wait gives up, 0 for none
+static uint32_t wait_deadline(uint32_t timeout_ms) {
+    if (timeout_ms == 0 || timeout_ms == RTOS_WAIT_FOREVER) {
+        return 0;
+    }
+
+    poll_host_clock();
+    uint32_t deadline = system_tick_count + timeout_ms;
+    return deadline != 0 ? deadline : 1; // 0 would mean "forever"
+}
+
+static bool wait_timed_out(uint32_t timeout_ms, uint32_t deadline) {
+    return timeout_ms == 0 ||
+           (deadline != 0 && (int32_t)(deadline - system_tick_count) <= 0);
+}
+
+// Ready a task whose wait is over, cancelling its timeout. A task whose
+// timeout already readied it only has to notice. Kernel lock held.
+static void wait_complete(tcb_t* task) {
+    task_set_wake_time(task, 0);
+    if (task->state == TASK_BLOCKED) {
+        add_task_to_ready_queue(task);
+    }
+}
+
+/*
+ * TASK NOTIFICATION API
+ */
+int task_notify(uint32_t task_id, uint32_t value, notify_action_t action) {
+    kernel_lock();
+    tcb_t* task = task_lookup(task_id);
+    if (task == NULL) {
+        kernel_unlock();
+        return -1;
+    }
+
+    switch (action) {
+        case NOTIFY_SET_BITS:
+            task->notify_value |= value;
+            break;
+        case NOTIFY_INCREMENT:
+            task->notify_value++;
+            break;
+        case NOTIFY_OVERWRITE:
+            task->notify_value = value;
+            break;
+        default:
+            kernel_unlock();
+            return -1;
+    }
+    task->notify_pending = true;
+
+    bool wake = task->notify_waiting;
+    if (wake) {
+        task->notify_waiting = false;
+        wait_complete(task);
+    }
+    kernel_unlock();
+
+    if (wake) {
+        scheduler_reschedule();
+    }
+
+    return 0;
+}
+
+// Block until notified (or, counting, until the value is non-zero).
+// Kernel lock held on entry and on return. A stackless task cannot wait
+// here: it is only marked blocked, and PT_NOTIFY_* call again once woken.
+static bool notify_wait_for(tcb_t* self, bool counting, uint32_t timeout_ms, uint32_t deadline) {
+    while (counting ? self->notify_value == 0 : !self->notify_pending) {
+        if (wait_timed_out(timeout_ms, deadline)) {
+            return false;
+        }
+
+        self->notify_waiting = true;
+        if (this_core()->in_stackless) {
+            self->state = TASK_BLOCKED;
+            task_set_wake_time(self, deadline);
+            return false;
+        }
+        task_block_until(deadline);
+        kernel_lock();
+        self->notify_waiting = false;
+    }
+
+    return true;
+}
+
+int task_notify_wait(uint32_t clear_on_exit, uint32_t* value, uint32_t timeout_ms) {
+    tcb_t* self = current_task;
+    if (self == NULL) {
+        return -1;
+    }
+
+    uint32_t deadline = wait_deadline(timeout_ms);
+    kernel_lock();
+    bool notified = notify_wait_for(self, false, timeout_ms, deadline);
+    if (value != NULL) {
+        *value = self->notify_value;
+    }
+    if (notified) {
+        self->notify_value &= ~clear_on_exit;
+        self->notify_pending = false;
+    }
+    kernel_unlock();
+
+    return notified ? 0 : -1;
+}
+
+uint32_t task_notify_take(bool clear_on_exit, uint32_t timeout_ms) {
+    tcb_t* self = current_task;
+    if (self == NULL) {
+        return 0;
+    }
+
+    uint32_t deadline = wait_deadline(timeout_ms);
+    kernel_lock();
+    uint32_t value = 0;
+    if (notify_wait_for(self, true, timeout_ms, deadline)) {
+        value = self->notify_value;
+        self->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    self->notify_pending = false;
+    kernel_unlock();
+
+    return value;
+}
+
+/*
+ * EVENT GROUP WAITERS
+ *
+ * A waiter's links[i] sits on the group's list for bit i while bit i is
+ * in linked. Lists are only touched under the kernel lock.
+ */
+typedef struct event_link {
+    struct event_link* next;
+    struct event_link* prev;
+} event_link_t;
+
+typedef struct rtos_event_waiter {
+    tcb_t* task;                         // Waiting task
+    event_group_t* group;                // Group waited on
+    uint32_t mask;                       // Bits waited for
+    uint32_t linked;                     // Bits whose list holds one of our links
+    uint32_t result;                     // Group bits when the wait was satisfied
+    bool wait_all;                       // All bits rather than any
+    bool clear_on_exit;                  // Clear mask once satisfied
+    bool satisfied;                      // Set by whoever completed the wait
+    event_link_t links[EVENT_GROUP_BITS];
+} event_waiter_t;
+
+static inline bool event_wait_met(uint32_t bits, uint32_t mask, bool wait_all) {
+    return wait_all ? (bits & mask) == mask : (bits & mask) != 0;
+}
+
+static inline event_waiter_t* event_link_waiter(event_link_t* link, uint32_t bit) {
+    return (event_waiter_t*)((char*)(link - bit) - offsetof(event_waiter_t, links));
+}
+
+static void event_link_add(event_group_t* group, event_waiter_t* waiter, uint32_t bit) {
+    event_link_t* link = &waiter->links[bit];
+
+    link->prev = NULL;
+    link->next = group->waiters[bit];
+    if (link->next != NULL) {
+        link->next->prev = link;
+    }
+    group->waiters[bit] = link;
+
+    waiter->linked |= 1u << bit;
+    __atomic_store_n(&group->waited_bits, group->waited_bits | (1u << bit), __ATOMIC_RELAXED);
+}
+
+static void event_link_remove(event_group_t* group, event_waiter_t* waiter, uint32_t bit) {
+    event_link_t* link = &waiter->links[bit];
+
+    if (link->prev != NULL) {
+        link->prev->next = link->next;
+    } else {
+        group->waiters[bit] = link->next;
+    }
+    if (link->next != NULL) {
+        link->next->prev = link->prev;
+    }
+
+    waiter->linked &= ~(1u << bit);
+    if (group->waiters[bit] == NULL) {
+        __atomic_store_n(&group->waited_bits, group->waited_bits & ~(1u << bit),
+                         __ATOMIC_RELAXED);
+    }
+}
+
+static void event_unlink_all(event_waiter_t* waiter) {
+    while (waiter->linked != 0) {
+        event_link_remove(waiter->group, waiter, (uint32_t)__builtin_ctz(waiter->linked));
+    }
+}
+
+// Link a waiter where the next bit it needs will find it
+static void event_link_waiter_for(event_waiter_t* waiter, uint32_t bits) {
+    if (!waiter->wait_all) {
+        for (uint32_t rest = waiter->mask & ~waiter->linked; rest != 0; rest &= rest - 1) {
+            event_link_add(waiter->group, waiter, (uint32_t)__builtin_ctz(rest));
+        }
+        return;
+    }
+
+    event_unlink_all(waiter);
+    uint32_t missing = waiter->mask & ~bits;
+    event_link_add(waiter->group, waiter, (uint32_t)__builtin_ctz(missing ? missing : waiter->mask));
+}
+
+// Called with the kernel lock held
+void event_group_cancel_wait(tcb_t* task) {
+    event_unlink_all(task->event_wait);
+    task->event_wait = NULL;
+}
+
+/*
+ * EVENT GROUP API
+ */
+void event_group_init(event_group_t* group) {
+    group->bits = 0;
+    group->waited_bits = 0;
+    for (uint32_t bit = 0; bit < EVENT_GROUP_BITS; bit++) {
+        group->waiters[bit] = NULL;
+    }
+}
+
+uint32_t event_group_get_bits(event_group_t* group) {
+    return __atomic_load_n(&group->bits, __ATOMIC_ACQUIRE);
+}
+
+uint32_t event_group_clear_bits(event_group_t* group, uint32_t bits) {
+    return __atomic_fetch_and(&group->bits, ~bits, __ATOMIC_ACQ_REL);
+}
+
+uint32_t event_group_set_bits(event_group_t* group, uint32_t bits) {
+    // Fast path: nobody waits for any of these bits. The full barrier
+    // pairs with the waiter's: either it sees our bits, or we see it.
+    uint32_t now = __atomic_or_fetch(&group->bits, bits, __ATOMIC_SEQ_CST);
+    if ((__atomic_load_n(&group->waited_bits, __ATOMIC_SEQ_CST) & bits) == 0) {
+        return now;
+    }
+
+    // Slow path: visit the waiters on the bits just set
+    kernel_lock();
+    now = __atomic_load_n(&group->bits, __ATOMIC_ACQUIRE);
+    uint32_t clear = 0;
+    bool woke = false;
+
+    for (uint32_t pending = bits & group->waited_bits; pending != 0; pending &= pending - 1) {
+        uint32_t bit = (uint32_t)__builtin_ctz(pending);
+        event_link_t* link = group->waiters[bit];
+
+        while (link != NULL) {
+            event_link_t* next = link->next;
+            event_waiter_t* waiter = event_link_waiter(link, bit);
+
+            if (event_wait_met(now, waiter->mask, waiter->wait_all)) {
+                event_unlink_all(waiter);
+                waiter->result = now;
+                waiter->satisfied = true;
+                waiter->task->event_wait = NULL;
+                if (waiter->clear_on_exit) {
+                    clear |= waiter->mask;
+                }
+                wait_complete(waiter->task);
+                woke = true;
+            } else {
+                // Waiting for all bits: move on to one still missing,
+                // which is not among those being visited
+                event_link_waiter_for(waiter, now);
+            }
+            link = next;
+        }
+    }
+
+    // Every waiter satisfied by these bits saw them before any are cleared
+    if (clear != 0) {
+        __atomic_fetch_and(&group->bits, ~clear, __ATOMIC_ACQ_REL);
+    }
+    kernel_unlock();
+
+    if (woke) {
+        scheduler_reschedule();
+    }
+
+    return now;
+}
+
+int event_group_wait(event_group_t* group, uint32_t bits, bool wait_all,
+                     bool clear_on_exit, uint32_t timeout_ms, uint32_t* result) {
+    if (group == NULL || bits == 0) {
+        return -1;
+    }
+
+    // Fast path: already satisfied (clearing in the same atomic step)
+    uint32_t now = __atomic_load_n(&group->bits, __ATOMIC_ACQUIRE);
+    while (event_wait_met(now, bits, wait_all)) {
+        if (!clear_on_exit ||
+            __atomic_compare_exchange_n(&group->bits, &now, now & ~bits, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            if (result != NULL) {
+                *result = now;
+            }
+            return 0;
+        }
+    }
+
+    // The waiter lives on the caller's stack, which a stackless task lacks
+    tcb_t* self = current_task;
+    if (self == NULL || timeout_ms == 0 || this_core()->in_stackless) {
+        if (result != NULL) {
+            *result = now;
+        }
+        return -1;
+    }
+
+    uint32_t deadline = wait_deadline(timeout_ms);
+    event_waiter_t waiter;
+    waiter.task = self;
+    waiter.group = group;
+    waiter.mask = bits;
+    waiter.linked = 0;
+    waiter.wait_all = wait_all;
+    waiter.clear_on_exit = clear_on_exit;
+    waiter.satisfied = false;
+
+    kernel_lock();
+
+    // Link ourselves, then look at the bits once more. A wait-all waiter
+    // linked on a bit that got set meanwhile moves on and looks again.
+    event_link_waiter_for(&waiter, now);
+    while (1) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        now = __atomic_load_n(&group->bits, __ATOMIC_ACQUIRE);
+        if (event_wait_met(now, bits, wait_all) || !wait_all || !(now & waiter.linked)) {
+            break;
+        }
+        event_link_waiter_for(&waiter, now);
+    }
+
+    if (event_wait_met(now, bits, wait_all)) {
+        event_unlink_all(&waiter);
+        if (clear_on_exit) {
+            now = __atomic_fetch_and(&group->bits, ~bits, __ATOMIC_ACQ_REL);
+        }
+        kernel_unlock();
+        if (result != NULL) {
+            *result = now;
+        }
+        return 0;
+    }
+
+    RTOS_LOG("⏳ Task %s waits for event bits 0x%x\n", self->name, bits);
+    self->event_wait = &waiter;
+    task_block_until(deadline);
+
+    // Woken by set_bits (satisfied) or by the timeout
+    kernel_lock();
+    if (!waiter.satisfied) {
+        event_group_cancel_wait(self);
+        now = __atomic_load_n(&group->bits, __ATOMIC_ACQUIRE);
+    } else {
+        now = waiter.result;
+    }
+    kernel_unlock();
+
+    if (result != NULL) {
+        *result = now;
+    }
+    return waiter.satisfied ? 0 : -1;
+}
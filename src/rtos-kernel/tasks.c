@@ -0,0 +1,981 @@
+/*
+ * RTOS Task Management
+ *
+ * Task creation, deletion and lookup, plus the two data structures that
+ * make them cheap enough to create and destroy tasks at a high rate.
+ *
+ * TASK TABLE:
+ * TCBs live in fixed-size chunks that are allocated on demand, so the table
+ * grows without ever moving a TCB (the ready queues hold raw pointers).
+ * Free slots are kept on a stack of slot indices: creating a task pops one,
+ * deleting a task pushes it back, both in O(1). Task IDs are mapped to
+ * slots through an open-addressing hash table instead of a linear scan.
+ *
+ * STACK POOL:
+ * Stacks are carved out of large mmap'd arenas, with one arena list per
+ * power-of-two size class. Every stack has a PROT_NONE guard page below
+ * it, so an overflow faults immediately instead of silently corrupting the
+ * neighbouring task. Freed stacks go on a per-class free stack and are
+ * handed out again without any system call. The free stack is a separate
+ * array rather than a list threaded through the stacks, so recycling a
+ * stack never dirties one of its pages.
+ *
+ * STACK HIGH-WATER MARKS:
+ * In context-switch mode every stack is painted with a fixed pattern when
+ * its task is created. Stacks grow down, so the lowest word that no
+ * longer holds the pattern marks the deepest the task has ever reached.
+ * Finding it means reading up from the base through the part that was
+ * never used, so the idle task does it a few hundred words at a time:
+ * each task's scan walks up from the base and starts over from the base
+ * once it reaches the known mark or finds a lower one. Use only ever
+ * grows, so the mark only ever moves down.
+ *
+ * DEFERRED RECLAIM:
+ * Deleting a task only unlinks it and pushes it on the reclaim list, in
+ * O(1) whatever the task was doing. Returning the slot and stack to the
+ * pools, and repainting the stack so its next owner starts with a clean
+ * high-water mark, is left to the idle task, RECLAIM_BATCH tasks per
+ * pass. task_create drains a batch itself when it would otherwise have
+ * to grow a pool, so churn without idle time does not leak.
+ */
+
+#define _GNU_SOURCE
+#include "rtos_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+ * TASK TABLE STATE
+ */
+#define TASK_CHUNK_SHIFT 6
+#define TASK_CHUNK_SIZE (1u << TASK_CHUNK_SHIFT)   // TCBs per chunk
+#define TASK_CHUNK_MASK (TASK_CHUNK_SIZE - 1)
+
+static tcb_t** task_chunks = NULL;            // Chunk directory
+static uint32_t task_chunk_count = 0;         // Chunks allocated so far
+static uint32_t task_chunk_capacity = 0;      // Entries in chunk directory
+
+static uint32_t* free_slots = NULL;           // Stack of free slot indices
+static uint32_t free_slot_top = 0;            // Number of entries on the stack
+
+static uint32_t next_task_id = 1;             // Next candidate task ID
+static uint32_t tasks_alive = 0;              // Tasks currently in the table
+
+#define RECLAIM_BATCH 16                      // Deleted tasks reclaimed per idle pass
+
+static tcb_t* reclaim_list = NULL;            // Deleted tasks, linked through next
+
+/*
+ * TASK ID INDEX
+ *
+ * Open addressing with linear probing. Each entry holds (slot + 1) so that
+ * zero can mean "empty"; the key is read from the TCB itself. Deletion
+ * shifts later entries back instead of leaving tombstones, which keeps
+ * probe sequences short under heavy create/delete churn.
+ */
+static uint32_t* id_index = NULL;             // Hash buckets (slot + 1)
+static uint32_t id_index_bits = 0;            // log2(bucket count)
+
+/*
+ * STACK POOL STATE
+ */
+#define STACK_CLASS_COUNT 16                  // Power-of-two size classes (in pages)
+#define STACK_ARENA_STACKS 64                 // Stacks carved from each arena
+
+typedef struct stack_arena {
+    struct stack_arena* next;                 // All arenas, for teardown
+    uint8_t* base;                            // Start of the mapping
+    size_t length;                            // Length of the mapping
+} stack_arena_t;
+
+typedef struct {
+    uint8_t** free_stacks;                    // Recycled stacks (LIFO)
+    uint32_t free_count;                      // Entries on free_stacks
+    uint32_t carved;                          // Stacks ever carved (free_stacks capacity)
+    uint8_t* bump;                            // Next never-used stack in arena
+    uint8_t* bump_end;                        // End of current arena
+} stack_class_t;
+
+#define STACK_PAINT 0xA5A5A5A5A5A5A5A5ull        // Fill of never-used stack words
+
+static stack_class_t stack_classes[STACK_CLASS_COUNT];
+static stack_arena_t* stack_arenas = NULL;
+static size_t stack_mapped_bytes = 0;
+static size_t page_size = 0;
+static uint32_t stack_scan_slot = 0;          // Task the next idle pass looks at
+
+/*
+ * SLOT HELPERS
+ */
+static inline tcb_t* slot_to_tcb(uint32_t slot) {
+    return &task_chunks[slot >> TASK_CHUNK_SHIFT][slot & TASK_CHUNK_MASK];
+}
+
+static inline uint32_t id_hash(uint32_t task_id) {
+    // Fibonacci hashing spreads sequential IDs across the whole table
+    return (uint32_t)(task_id * 2654435769u) >> (32 - id_index_bits);
+}
+
+/*
+ * GROW THE TASK TABLE
+ *
+ * Adds one chunk of TCBs and pushes its slots onto the free-slot stack.
+ * Slots are pushed in reverse so that lower slots are handed out first.
+ */
+static int task_table_grow(void) {
+    uint32_t total_slots = task_chunk_count * TASK_CHUNK_SIZE;
+
+    if (total_slots + TASK_CHUNK_SIZE > MAX_TASKS ||
+        sleep_queue_reserve(total_slots + TASK_CHUNK_SIZE) != 0) {
+        return -1;
+    }
+
+    if (task_chunk_count == task_chunk_capacity) {
+        uint32_t new_capacity = task_chunk_capacity ? task_chunk_capacity * 2 : 8;
+        tcb_t** new_chunks = realloc(task_chunks, new_capacity * sizeof(tcb_t*));
+        uint32_t* new_free = realloc(free_slots,
+                                     new_capacity * TASK_CHUNK_SIZE * sizeof(uint32_t));
+        if (new_chunks) {
+            task_chunks = new_chunks;
+        }
+        if (new_free) {
+            free_slots = new_free;
+        }
+        if (!new_chunks || !new_free) {
+            return -1;
+        }
+        task_chunk_capacity = new_capacity;
+    }
+
+    tcb_t* chunk = calloc(TASK_CHUNK_SIZE, sizeof(tcb_t));
+    if (chunk == NULL) {
+        return -1;
+    }
+
+    task_chunks[task_chunk_count++] = chunk;
+
+    for (uint32_t i = TASK_CHUNK_SIZE; i > 0; i--) {
+        free_slots[free_slot_top++] = total_slots + i - 1;
+    }
+
+    return 0;
+}
+
+/*
+ * TASK ID INDEX OPERATIONS
+ */
+static void id_index_insert_slot(uint32_t slot) {
+    uint32_t mask = (1u << id_index_bits) - 1;
+    uint32_t i = id_hash(slot_to_tcb(slot)->task_id);
+
+    while (id_index[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    id_index[i] = slot + 1;
+}
+
+static int id_index_resize(uint32_t bits) {
+    uint32_t* old_index = id_index;
+    uint32_t old_size = id_index_bits ? (1u << id_index_bits) : 0;
+
+    uint32_t* new_index = calloc((size_t)1 << bits, sizeof(uint32_t));
+    if (new_index == NULL) {
+        return -1;
+    }
+
+    id_index = new_index;
+    id_index_bits = bits;
+
+    for (uint32_t i = 0; i < old_size; i++) {
+        if (old_index[i] != 0) {
+            id_index_insert_slot(old_index[i] - 1);
+        }
+    }
+
+    free(old_index);
+    return 0;
+}
+
+static void id_index_remove(uint32_t task_id) {
+    uint32_t mask = (1u << id_index_bits) - 1;
+    uint32_t i = id_hash(task_id);
+
+    // Find the entry
+    while (id_index[i] != 0 && slot_to_tcb(id_index[i] - 1)->task_id != task_id) {
+        i = (i + 1) & mask;
+    }
+    if (id_index[i] == 0) {
+        return;
+    }
+
+    // Backward-shift deletion: pull later entries of the probe run into
+    // the hole unless their home bucket lies cyclically in (hole, j]
+    uint32_t j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        if (id_index[j] == 0) {
+            break;
+        }
+
+        uint32_t home = id_hash(slot_to_tcb(id_index[j] - 1)->task_id);
+        bool home_between = (i <= j) ? (i < home && home <= j)
+                                     : (i < home || home <= j);
+        if (!home_between) {
+            id_index[i] = id_index[j];
+            i = j;
+        }
+    }
+    id_index[i] = 0;
+}
+
+/*
+ * STACK POOL OPERATIONS
+ */
+static int stack_size_class(uint32_t size) {
+    size_t pages = (size + page_size - 1) / page_size;
+    int size_class = 0;
+
+    while (((size_t)1 << size_class) < pages) {
+        size_class++;
+    }
+
+    return size_class < STACK_CLASS_COUNT ? size_class : -1;
+}
+
+static uint8_t* stack_pool_alloc(uint32_t size, uint32_t* actual_size, bool* recycled) {
+    int size_class = stack_size_class(size);
+    if (size_class < 0) {
+        return NULL;
+    }
+
+    stack_class_t* sc = &stack_classes[size_class];
+    size_t usable = page_size << size_class;
+    size_t stride = usable + page_size;       // Guard page + usable stack
+
+    *actual_size = (uint32_t)usable;
+    *recycled = sc->free_count > 0;
+
+    // Fast path: reuse a stack freed earlier
+    if (sc->free_count > 0) {
+        return sc->free_stacks[--sc->free_count];
+    }
+
+    // Make room to recycle every stack of this class before carving one,
+    // so stack_pool_free can never fail
+    if ((sc->carved & (STACK_ARENA_STACKS - 1)) == 0) {
+        uint8_t** grown = realloc(sc->free_stacks,
+                                  (sc->carved + STACK_ARENA_STACKS) * sizeof(uint8_t*));
+        if (grown == NULL) {
+            return NULL;
+        }
+        sc->free_stacks = grown;
+    }
+
+    // Slow path: map a new arena when the current one is used up
+    if (sc->bump == sc->bump_end) {
+        size_t length = stride * STACK_ARENA_STACKS;
+        void* region = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (region == MAP_FAILED) {
+            return NULL;
+        }
+
+        stack_arena_t* arena = malloc(sizeof(stack_arena_t));
+        if (arena == NULL) {
+            munmap(region, length);
+            return NULL;
+        }
+        arena->base = region;
+        arena->length = length;
+        arena->next = stack_arenas;
+        stack_arenas = arena;
+        stack_mapped_bytes += length;
+
+        sc->bump = region;
+        sc->bump_end = (uint8_t*)region + length;
+    }
+
+    // Guard page sits at the low end because stacks grow downwards.
+    // It is protected once, the first time this stack is carved out.
+    uint8_t* guard = sc->bump;
+    sc->bump += stride;
+    sc->carved++;
+
+    if (mprotect(guard, page_size, PROT_NONE) != 0) {
+        RTOS_LOG("⚠️  Could not protect guard page at %p\n", (void*)guard);
+    }
+
+    return guard + page_size;
+}
+
+static void stack_pool_free(uint8_t* base, uint32_t size) {
+    int size_class = stack_size_class(size);
+    if (base == NULL || size_class < 0) {
+        return;
+    }
+
+    stack_class_t* sc = &stack_classes[size_class];
+    sc->free_stacks[sc->free_count++] = base;
+}
+
+static bool stack_pool_has_free(uint32_t size) {
+    int size_class = stack_size_class(size);
+    return size_class >= 0 && stack_classes[size_class].free_count > 0;
+}
+
+/*
+ * STACK PAINTING AND SCANNING
+ *
+ * Both touch stack memory AddressSanitizer may still consider part of a
+ * previous owner's frames (or of a live frame, for the scan), and both
+ * only ever deal in whole words of pattern, so they are not instrumented.
+ */
+__attribute__((no_sanitize_address))
+static void stack_paint(uint8_t* base, uint32_t size) {
+    uint64_t* words = (uint64_t*)base;
+
+    for (uint32_t i = 0; i < size / sizeof(uint64_t); i++) {
+        words[i] = STACK_PAINT;
+    }
+}
+
+static inline bool stack_is_painted(const tcb_t* task) {
+    return rtos_mode == RTOS_MODE_CONTEXT_SWITCH && task->stack_base != NULL;
+}
+
+static uint32_t stack_recommended_size(uint32_t used) {
+    uint64_t wanted = (uint64_t)used * (100 + STACK_SAFETY_PERCENT) / 100;
+    return (uint32_t)((wanted + page_size - 1) / page_size * page_size);
+}
+
+// Check up to budget words of a task's stack (kernel lock held, so the
+// stack cannot be recycled meanwhile). Returns the words checked.
+__attribute__((no_sanitize_address))
+static uint32_t stack_scan(tcb_t* task, uint32_t budget) {
+    const uint64_t* words = (const uint64_t*)task->stack_base;
+    uint32_t mark = (task->stack_size - task->stack_high_water) / sizeof(uint64_t);
+    uint32_t pos = task->stack_scan_word;
+    uint32_t checked = 0;
+
+    // The task may be running on another core: read each word once
+    while (pos < mark && checked < budget) {
+        checked++;
+        if (__atomic_load_n(&words[pos], __ATOMIC_RELAXED) != STACK_PAINT) {
+            mark = pos;
+            break;
+        }
+        pos++;
+    }
+
+    uint32_t used = task->stack_size - mark * (uint32_t)sizeof(uint64_t);
+    if (used > task->stack_high_water) {
+        // Crossing into the safety margin is worth a word, once
+        if (stack_recommended_size(used) > task->stack_size &&
+            stack_recommended_size(task->stack_high_water) <= task->stack_size) {
+            RTOS_LOG("⚠️  Task '%s' has used %u of its %u stack bytes\n", task->name, used,
+                     task->stack_size);
+        }
+        task->stack_high_water = used;
+    }
+    task->stack_scan_word = pos < mark ? pos : 0;
+
+    return checked;
+}
+
+void stack_scan_step(void) {
+    uint32_t budget = STACK_SCAN_WORDS;
+
+    kernel_lock();
+    uint32_t slot_count = task_chunk_count * TASK_CHUNK_SIZE;
+
+    // Visit each slot at most once per pass, carrying on with the task
+    // the budget ran out in next time
+    for (uint32_t visited = 0; visited < slot_count && budget > 0; visited++) {
+        if (stack_scan_slot >= slot_count) {
+            stack_scan_slot = 0;
+        }
+
+        tcb_t* task = slot_to_tcb(stack_scan_slot);
+        if (task->task_id != 0 && stack_is_painted(task)) {
+            budget -= stack_scan(task, budget);
+            if (task->stack_scan_word != 0) {
+                break; // Not done with this one
+            }
+        } else {
+            // Looking costs a word too, or a table full of free slots or
+            // stackless tasks would hold the kernel lock for a whole pass
+            budget--;
+        }
+        stack_scan_slot++;
+    }
+    kernel_unlock();
+}
+
+int task_get_stack_usage(uint32_t task_id, stack_usage_t* out) {
+    kernel_lock();
+    tcb_t* task = task_lookup(task_id);
+    if (task == NULL) {
+        kernel_unlock();
+        return -1;
+    }
+
+    memset(out, 0, sizeof(*out));
+    if (stack_is_painted(task)) {
+        // One complete pass from the base, wherever the idle task was
+        task->stack_scan_word = 0;
+        stack_scan(task, UINT32_MAX);
+
+        out->size = task->stack_size;
+        out->used = task->stack_high_water;
+        out->recommended = stack_recommended_size(task->stack_high_water);
+    }
+    kernel_unlock();
+
+    return 0;
+}
+
+/*
+ * TASK TABLE INITIALIZATION
+ *
+ * Releases everything from a previous run so rtos_init can be called again.
+ */
+int task_table_init(void) {
+    for (uint32_t i = 0; i < task_chunk_count; i++) {
+        free(task_chunks[i]);
+    }
+    free(task_chunks);
+    free(free_slots);
+    free(id_index);
+
+    for (int i = 0; i < STACK_CLASS_COUNT; i++) {
+        free(stack_classes[i].free_stacks);
+    }
+
+    while (stack_arenas != NULL) {
+        stack_arena_t* arena = stack_arenas;
+        stack_arenas = arena->next;
+        munmap(arena->base, arena->length);
+        free(arena);
+    }
+
+    task_chunks = NULL;
+    task_chunk_count = 0;
+    task_chunk_capacity = 0;
+    free_slots = NULL;
+    free_slot_top = 0;
+    next_task_id = 1;
+    tasks_alive = 0;
+    reclaim_list = NULL;
+    id_index = NULL;
+    id_index_bits = 0;
+
+    memset(stack_classes, 0, sizeof(stack_classes));
+    stack_mapped_bytes = 0;
+    stack_scan_slot = 0;
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    if (task_table_grow() != 0 || id_index_resize(TASK_CHUNK_SHIFT + 1) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+uint32_t task_table_slot_count(void) {
+    return task_chunk_count * TASK_CHUNK_SIZE;
+}
+
+tcb_t* task_table_slot(uint32_t slot) {
+    tcb_t* task = slot_to_tcb(slot);
+    return task->task_id != 0 ? task : NULL;
+}
+
+size_t stack_pool_mapped_bytes(void) {
+    return stack_mapped_bytes;
+}
+
+/*
+ * DEFERRED RECLAIM
+ *
+ * Deleted tasks wait on reclaim_list until a batch of them is returned to
+ * the pools. Their IDs are already out of the index and their task_id is
+ * 0, so nothing can find them meanwhile.
+ */
+static void task_reclaim_batch(void) {
+    for (int i = 0; i < RECLAIM_BATCH && reclaim_list != NULL; i++) {
+        tcb_t* task = reclaim_list;
+        reclaim_list = task->next;
+
+        // Leave the stack as task_create expects to find a pooled one
+        if (stack_is_painted(task)) {
+            stack_paint(task->stack_base, task->stack_size);
+        }
+        stack_pool_free(task->stack_base, task->stack_size);
+        free_slots[free_slot_top++] = task->slot;
+        stats.tasks_reclaimed++;
+    }
+}
+
+void task_reclaim(tcb_t* task) {
+    kernel_lock();
+    task->task_id = 0;
+    task->state = TASK_TERMINATED;
+    task->next = reclaim_list;
+    reclaim_list = task;
+    kernel_unlock();
+}
+
+bool task_reclaim_drain(void) {
+    if (__atomic_load_n(&reclaim_list, __ATOMIC_RELAXED) == NULL) {
+        return false;
+    }
+
+    kernel_lock();
+    task_reclaim_batch();
+    bool pending = reclaim_list != NULL;
+    kernel_unlock();
+
+    return pending;
+}
+
+/*
+ * TASK CREATION
+ *
+ * Creates a new task and adds it to the appropriate ready queue. A
+ * stackless task (pt_function set) gets no stack; in context-switch mode
+ * it runs on its core's runner instead.
+ */
+static uint32_t task_create_common(const char* name,
+                                   void (*task_func)(void* param),
+                                   pt_function_t pt_function,
+                                   void* param,
+                                   uint8_t priority,
+                                   uint32_t stack_size) {
+
+    RTOS_LOG("📋 Creating task '%s' (priority %d)\n", name, priority);
+
+    // Validate parameters
+    if (priority >= PRIORITY_LEVELS) {
+        RTOS_LOG("❌ Invalid priority: %d (max: %d)\n", priority, PRIORITY_LEVELS - 1);
+        return 0;
+    }
+
+    if (pt_function != NULL) {
+        if (rtos_mode == RTOS_MODE_CONTEXT_SWITCH && port_init_stackless() != 0) {
+            RTOS_LOG("❌ Failed to set up the stackless task runners\n");
+            return 0;
+        }
+    } else if (stack_size == 0) {
+        stack_size = STACK_SIZE;
+    }
+
+    if (stack_size > MAX_STACK_SIZE) {
+        RTOS_LOG("❌ Stack size too large: %u (max: %d)\n", stack_size, MAX_STACK_SIZE);
+        return 0;
+    }
+
+    // Real task code runs on the stack in context-switch mode, and the C
+    // library alone needs more than a toy stack
+    if (pt_function == NULL && rtos_mode == RTOS_MODE_CONTEXT_SWITCH &&
+        stack_size < CONTEXT_STACK_MIN) {
+        stack_size = CONTEXT_STACK_MIN;
+    }
+
+    // Recycle deleted tasks before growing a pool for want of them
+    if (reclaim_list != NULL &&
+        (free_slot_top == 0 || (pt_function == NULL && !stack_pool_has_free(stack_size)))) {
+        task_reclaim_batch();
+    }
+
+    // Pop a free slot, growing the table if the stack is empty
+    if (free_slot_top == 0 && task_table_grow() != 0) {
+        RTOS_LOG("❌ No free task slots available\n");
+        return 0;
+    }
+
+    // Keep the ID index at most half full
+    if ((tasks_alive + 1) * 2 > (1u << id_index_bits) &&
+        id_index_resize(id_index_bits + 1) != 0) {
+        RTOS_LOG("❌ Out of memory growing task index\n");
+        return 0;
+    }
+
+    uint32_t actual_stack_size = 0;
+    uint8_t* stack = NULL;
+    bool recycled = false;
+    if (pt_function == NULL) {
+        stack = stack_pool_alloc(stack_size, &actual_stack_size, &recycled);
+        if (stack == NULL) {
+            RTOS_LOG("❌ Failed to allocate task stack\n");
+            return 0;
+        }
+    }
+
+    uint32_t slot = free_slots[--free_slot_top];
+
+    // Initialize TCB
+    tcb_t* tcb = slot_to_tcb(slot);
+    memset(tcb, 0, sizeof(*tcb));
+    tcb->slot = slot;
+    tcb->sleep_index = TASK_NOT_SLEEPING;
+
+    // Initialize stack
+    tcb->stack_base = stack;
+    tcb->stack_size = actual_stack_size;
+    if (stack != NULL) {
+        tcb->stack_pointer = (uint32_t*)(tcb->stack_base + actual_stack_size - 4);
+    }
+
+    tcb->task_function = task_func;
+    tcb->task_parameter = param;
+    tcb->pt_function = pt_function;
+
+    // Paint before the port writes the initial context at the top.
+    // Recycled stacks were repainted when reclaimed.
+    if (stack_is_painted(tcb) && !recycled) {
+        stack_paint(stack, actual_stack_size);
+    }
+
+    if (stack != NULL && rtos_mode == RTOS_MODE_CONTEXT_SWITCH && port_init_task(tcb) != 0) {
+        RTOS_LOG("❌ Failed to set up task context\n");
+        stack_paint(stack, actual_stack_size);
+        stack_pool_free(stack, actual_stack_size);
+        free_slots[free_slot_top++] = slot;
+        return 0;
+    }
+
+    // IDs are never 0 and never shared by two live tasks, even after wrap
+    do {
+        tcb->task_id = next_task_id++;
+    } while (tcb->task_id == 0 || task_lookup(tcb->task_id) != NULL);
+
+    id_index_insert_slot(slot);
+    tasks_alive++;
+
+    strncpy(tcb->name, name, sizeof(tcb->name) - 1);
+    tcb->name[sizeof(tcb->name) - 1] = '\0';
+
+    tcb->priority = priority;
+    tcb->base_priority = priority;
+    tcb->state = TASK_READY;
+    tcb->slice_usage = SLICE_USAGE_START;
+    task_grant_time_slice(tcb);
+    tcb->affinity_mask = TASK_AFFINITY_ANY;
+    tcb->core = TASK_NO_CORE;
+
+    // Initialize registers (simulated ARM Cortex-M context, so pointers
+    // are deliberately truncated to 32 bits on a 64-bit host)
+    tcb->registers[15] = pt_function != NULL ? (uint32_t)(uintptr_t)pt_function :
+                                               (uint32_t)(uintptr_t)task_func; // PC (Program Counter)
+    tcb->registers[14] = 0xFFFFFFFD;                           // LR (Link Register - return to thread mode)
+    tcb->registers[13] = (uint32_t)(uintptr_t)tcb->stack_pointer; // SP (Stack Pointer)
+    tcb->registers[0] = (uint32_t)(uintptr_t)param;            // R0 (first parameter)
+
+    // Initialize timing
+    tcb->last_run_time = system_tick_count;
+
+    // Add to ready queue
+    add_task_to_ready_queue(tcb);
+
+    stats.tasks_created++;
+
+    RTOS_LOG("✅ Task '%s' created (ID: %u, slot: %u)\n", name, tcb->task_id, slot);
+
+    return tcb->task_id;
+}
+
+uint32_t task_create_locked(const char* name,
+                            void (*task_func)(void* param),
+                            void* param,
+                            uint8_t priority,
+                            uint32_t stack_size) {
+    return task_create_common(name, task_func, NULL, param, priority, stack_size);
+}
+
+uint32_t task_create(const char* name,
+                     void (*task_func)(void* param),
+                     void* param,
+                     uint8_t priority,
+                     uint32_t stack_size) {
+    kernel_lock();
+    uint32_t task_id = task_create_locked(name, task_func, param, priority, stack_size);
+    kernel_unlock();
+
+    return task_id;
+}
+
+uint32_t task_create_stackless(const char* name,
+                               pt_function_t function,
+                               void* param,
+                               uint8_t priority) {
+    if (function == NULL) {
+        return 0;
+    }
+
+    kernel_lock();
+    uint32_t task_id = task_create_common(name, NULL, function, param, priority, 0);
+    kernel_unlock();
+
+    return task_id;
+}
+
+/*
+ * TASK DELETION
+ *
+ * Removes a task from the scheduler and queues its slot and stack for
+ * reclaim. Deleting the running task switches to the next ready task
+ * first; in context-switch mode that task is still executing on the stack
+ * being deleted, so the port layer queues it right after the switch
+ * instead.
+ *
+ * On SMP a task running on another core cannot be unlinked from here: it
+ * is marked, and the core running it finishes the deletion as soon as it
+ * has switched the task out.
+ */
+
+// Look up a task and return it with the kernel lock held, once it is
+// either running or completely switched out. A task that blocked or
+// yielded a moment ago may still be saving its registers on another core.
+static tcb_t* task_lookup_settled(uint32_t task_id) {
+    uint32_t spins = 0;
+
+    while (1) {
+        kernel_lock();
+
+        tcb_t* task = task_lookup(task_id);
+        if (task == NULL || task == current_task || task->state == TASK_RUNNING ||
+            !__atomic_load_n(&task->on_cpu, __ATOMIC_ACQUIRE)) {
+            return task;
+        }
+        kernel_unlock();
+        port_relax(&spins);
+    }
+}
+
+// Undo everything that ties a task to the kernel (kernel lock held; the
+// task is off the run queues)
+static void task_destroy(tcb_t* task) {
+    RTOS_LOG("🗑️  Deleting task '%s' (ID: %u)\n", task->name, task->task_id);
+
+    if (task->waiting_for_mutex != NULL) {
+        mutex_cancel_wait(task);
+    } else if (task->event_wait != NULL) {
+        event_group_cancel_wait(task);
+    } else if (task->wait_list != NULL) {
+        wait_queue_remove(task);
+    } else if (task->io_waiting) {
+        io_cancel_wait(task);
+    }
+    task_set_wake_time(task, 0);
+
+    if (task->period != 0) {
+        realtime_release(task);
+    }
+    
+    heap_release_task(task);
+
+    id_index_remove(task->task_id);
+    tasks_alive--;
+    stats.tasks_deleted++;
+    task->state = TASK_TERMINATED;
+}
+
+int task_delete(uint32_t task_id) {
+    tcb_t* task = task_lookup_settled(task_id);
+
+    if (task == NULL) {
+        kernel_unlock();
+        RTOS_LOG("❌ Cannot delete task %u: not found\n", task_id);
+        return -1;
+    }
+
+    if (task->is_idle) {
+        kernel_unlock();
+        RTOS_LOG("❌ The idle task cannot be deleted\n");
+        return -1;
+    }
+
+    // Running on another core, or taken off its run queue there a moment
+    // ago to be switched in: that core finishes the deletion
+    bool is_current = task == current_task;
+    if (!is_current && (task->state == TASK_RUNNING ||
+                        (task->state == TASK_READY && !remove_task_from_ready_queue(task)))) {
+        // Simulated cores take turns on one thread and never get to it
+        if (rtos_mode != RTOS_MODE_CONTEXT_SWITCH || !scheduler_running) {
+            kernel_unlock();
+            RTOS_LOG("❌ Cannot delete task %u: running on another core\n", task_id);
+            return -1;
+        }
+        __atomic_store_n(&task->delete_requested, true, __ATOMIC_RELEASE);
+        kernel_unlock();
+        return 0;
+    }
+
+    task_destroy(task);
+    kernel_unlock();
+
+    if (is_current) {
+        // A stackless task is switched out once its function returns
+        if (this_core()->in_stackless) {
+            return 0;
+        }
+
+        context_switch(task, scheduler_get_next_task());
+
+        // Only reached in simulated mode, where no code runs on the stack
+    }
+
+    task_reclaim(task);
+
+    return 0;
+}
+
+void task_delete_switched_out(tcb_t* task) {
+    kernel_lock();
+
+    // Deleted some other way meanwhile (its slot maybe reused, which
+    // clears the flag), or already running on another core again: it is
+    // deleted there instead
+    if (!task->delete_requested || task->task_id == 0 ||
+        task->state == TASK_TERMINATED || task->state == TASK_RUNNING) {
+        kernel_unlock();
+        return;
+    }
+
+    // Queued again, or readied by a wake-up, since it was switched out.
+    // If another core has already taken it off its queue to run it, that
+    // core deletes it instead.
+    if (task->state == TASK_READY && !remove_task_from_ready_queue(task)) {
+        kernel_unlock();
+        return;
+    }
+
+    task_destroy(task);
+    kernel_unlock();
+
+    task_reclaim(task);
+}
+
+/*
+ * SUSPEND AND RESUME
+ *
+ * The suspended flag is what keeps a task off the run queues: whoever
+ * readies it next (a wake-up, a resumed wait, a core switching it out)
+ * parks it in TASK_SUSPENDED instead. A task suspended in the middle of
+ * a wait so still receives what it waits for.
+ */
+int task_suspend(uint32_t task_id) {
+    tcb_t* task = task_lookup_settled(task_id);
+
+    if (task == NULL || task->is_idle || task->suspended) {
+        kernel_unlock();
+        return -1;
+    }
+
+    task->suspended = true;
+    RTOS_LOG("⏸️  Suspending task '%s'\n", task->name);
+
+    if (task == current_task) {
+        task->state = TASK_SUSPENDED;
+        task_block_current(); // Releases the kernel lock
+        return 0;
+    }
+
+    // Otherwise whoever readies it next parks it, and a task running on
+    // another core parks itself at its next kernel call
+    if (task->state == TASK_READY && remove_task_from_ready_queue(task)) {
+        task->state = TASK_SUSPENDED;
+    }
+    kernel_unlock();
+
+    return 0;
+}
+
+int task_resume(uint32_t task_id) {
+    kernel_lock();
+
+    tcb_t* task = task_lookup(task_id);
+    if (task == NULL || !task->suspended) {
+        kernel_unlock();
+        return -1;
+    }
+
+    task->suspended = false;
+    RTOS_LOG("▶️  Resuming task '%s'\n", task->name);
+
+    // Still blocked, or not yet switched out: it carries on by itself
+    if (task->state == TASK_SUSPENDED) {
+        task_grant_time_slice(task);
+        add_task_to_ready_queue(task);
+    }
+    kernel_unlock();
+
+    // The resumed task may outrank us
+    scheduler_reschedule();
+
+    return 0;
+}
+
+/*
+ * PRIORITY CHANGE
+ *
+ * Only the base priority is set here; mutex_priority_changed works out
+ * the effective one, which moves a ready task to its new queue and a
+ * waiting task to its new place among the waiters.
+ */
+int task_set_priority(uint32_t task_id, uint8_t new_priority) {
+    if (new_priority >= PRIORITY_LEVELS) {
+        RTOS_LOG("❌ Invalid priority: %d (max: %d)\n", new_priority, PRIORITY_LEVELS - 1);
+        return -1;
+    }
+
+    kernel_lock();
+
+    // Periodic tasks are ordered by their period or deadline instead
+    tcb_t* task = task_lookup(task_id);
+    if (task == NULL || task->is_idle || task_is_realtime(task)) {
+        kernel_unlock();
+        return -1;
+    }
+
+    task->base_priority = new_priority;
+    mutex_priority_changed(task);
+    kernel_unlock();
+
+    // Lowering ourselves, or raising another task, may hand over the CPU
+    scheduler_reschedule();
+
+    return 0;
+}
+
+/*
+ * TASK LOOKUP
+ *
+ * O(1) expected: hash the ID, then probe until an empty bucket.
+ */
+tcb_t* task_get_info(uint32_t task_id) {
+    kernel_lock();
+    tcb_t* task = task_lookup(task_id);
+    kernel_unlock();
+
+    return task;
+}
+
+tcb_t* task_lookup(uint32_t task_id) {
+    if (task_id == 0 || id_index == NULL) {
+        return NULL;
+    }
+
+    uint32_t mask = (1u << id_index_bits) - 1;
+
+    for (uint32_t i = id_hash(task_id); id_index[i] != 0; i = (i + 1) & mask) {
+        tcb_t* task = slot_to_tcb(id_index[i] - 1);
+        if (task->task_id == task_id) {
+            return task;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,319 @@
+/*
+ * RTOS Software Timers
+ *
+ * A task that only wants "call me every 50 ms" or "call me once in 2 s"
+ * would otherwise sit in a task_sleep loop, paying for a stack and a TCB
+ * to do nothing most of the time. Software timers share one service task
+ * (the timer daemon) instead: a timer is a small structure owned by the
+ * application, and its callback runs in the daemon when it expires.
+ *
+ * TIMER HEAP:
+ * Armed timers sit in a binary min-heap ordered by expiry tick, the same
+ * structure the deadline scheduler uses for periodic tasks. Starting or
+ * stopping a timer is O(log n), and the next expiry is always at the
+ * root, so the daemon never scans: it sleeps until the root is due. An
+ * idle system with thousands of armed timers costs nothing until the
+ * first one expires, and the tickless idle loop sees the daemon's wake-up
+ * like any other.
+ *
+ * BATCHING:
+ * When the daemon wakes it runs every timer that is due before sleeping
+ * again, so a hundred timers expiring on the same tick cost one wake-up
+ * and one context switch, not a hundred. A periodic timer is re-armed
+ * before its callback runs, relative to when it was due rather than when
+ * the callback ran, so periods do not drift. If the daemon fell so far
+ * behind that further expiries have already passed, they are skipped and
+ * counted as overruns instead of being run back to back.
+ *
+ * Starting a timer that expires before the daemon's current wake-up moves
+ * that wake-up forward directly; the kernel lock makes a command queue
+ * unnecessary. Callbacks run in task context, at TIMER_TASK_PRIORITY, and
+ * may start, stop or reset any timer, including their own.
+ */
+
+#define _GNU_SOURCE
+#include "rtos_internal.h"
+#include <stdlib.h>
+
+static soft_timer_t** timer_heap = NULL;      // Armed timers, earliest expiry first
+static uint32_t timer_heap_size = 0;          // Armed timers
+static uint32_t timer_heap_capacity = 0;      // Slots in timer_heap
+static uint32_t timer_count = 0;              // Created timers (each may need a slot)
+static tcb_t* timer_task = NULL;              // The daemon, created with the first timer
+static bool timer_task_started = false;       // Set by whoever creates the daemon
+
+/*
+ * TIMER HEAP
+ *
+ * Expiry ticks are compared as signed differences, so the order stays
+ * right when the tick counter wraps around.
+ */
+static inline bool expires_before(const soft_timer_t* a, const soft_timer_t* b) {
+    return (int32_t)(a->expiry - b->expiry) < 0;
+}
+
+static inline void timer_heap_place(uint32_t index, soft_timer_t* timer) {
+    timer_heap[index] = timer;
+    timer->heap_index = index;
+}
+
+static void timer_heap_sift_up(uint32_t index) {
+    soft_timer_t* timer = timer_heap[index];
+
+    while (index > 0) {
+        uint32_t parent = (index - 1) / 2;
+        if (!expires_before(timer, timer_heap[parent])) {
+            break;
+        }
+        timer_heap_place(index, timer_heap[parent]);
+        index = parent;
+    }
+    timer_heap_place(index, timer);
+}
+
+static void timer_heap_sift_down(uint32_t index) {
+    soft_timer_t* timer = timer_heap[index];
+
+    while (1) {
+        uint32_t child = 2 * index + 1;
+        if (child >= timer_heap_size) {
+            break;
+        }
+        if (child + 1 < timer_heap_size && expires_before(timer_heap[child + 1], timer_heap[child])) {
+            child++;
+        }
+        if (!expires_before(timer_heap[child], timer)) {
+            break;
+        }
+        timer_heap_place(index, timer_heap[child]);
+        index = child;
+    }
+    timer_heap_place(index, timer);
+}
+
+static void timer_heap_push(soft_timer_t* timer) {
+    // Capacity was reserved when the timer was created
+    timer_heap[timer_heap_size++] = timer;
+    timer_heap_sift_up(timer_heap_size - 1);
+}
+
+static void timer_heap_remove(soft_timer_t* timer) {
+    uint32_t index = timer->heap_index;
+    soft_timer_t* last = timer_heap[--timer_heap_size];
+
+    timer->heap_index = SOFT_TIMER_STOPPED;
+    if (last == timer) {
+        return;
+    }
+
+    timer_heap_place(index, last);
+    timer_heap_sift_up(index);
+    if (timer_heap[index] == last) {
+        timer_heap_sift_down(index);
+    }
+}
+
+/*
+ * ARMING (kernel lock held)
+ */
+static void timer_arm(soft_timer_t* timer, uint32_t expiry) {
+    if (timer->heap_index != SOFT_TIMER_STOPPED) {
+        timer_heap_remove(timer);
+    }
+    timer->expiry = expiry;
+    timer_heap_push(timer);
+
+    // The daemon may be asleep until a later expiry
+    if (timer_heap[0] == timer && timer_task != NULL) {
+        task_wake_at(timer_task, expiry);
+    }
+}
+
+// Periodic timers keep their phase; expiries that already passed are skipped
+static void timer_rearm(soft_timer_t* timer) {
+    uint32_t next = timer->expiry + timer->period;
+
+    if ((int32_t)(next - system_tick_count) <= 0) {
+        uint32_t missed = (system_tick_count - timer->expiry) / timer->period;
+        timer->overruns += missed;
+        stats.timer_overruns += missed;
+        next = timer->expiry + (missed + 1) * timer->period;
+    }
+
+    timer->expiry = next;
+    timer_heap_push(timer);
+}
+
+/*
+ * TIMER DAEMON
+ */
+static void timer_task_function(void* param) {
+    (void)param;
+    uint32_t batch = 0;
+
+    while (1) {
+        kernel_lock();
+        soft_timer_t* timer = timer_heap_size > 0 ? timer_heap[0] : NULL;
+
+        if (timer == NULL || (int32_t)(timer->expiry - system_tick_count) > 0) {
+            // Nothing (more) due: sleep until the next expiry, or until a
+            // timer is started if none is armed
+            if (batch > 0) {
+                stats.timer_batches++;
+                batch = 0;
+            }
+            task_block_until(timer != NULL ? timer->expiry : 0);
+            continue;
+        }
+
+        timer_heap_remove(timer);
+        timer->due_tick = timer->expiry;
+        if (timer->auto_reload) {
+            timer_rearm(timer);
+        }
+        stats.timer_callbacks++;
+        batch++;
+        kernel_unlock();
+
+        timer->callback(timer);
+    }
+}
+
+/*
+ * CREATE AND DESTROY
+ */
+int soft_timer_create(soft_timer_t* timer, const char* name, uint32_t period_ms,
+                      bool auto_reload, soft_timer_callback_t callback, void* param) {
+    if (timer == NULL || callback == NULL || period_ms == 0) {
+        return -1;
+    }
+    if (rtos_mode != RTOS_MODE_CONTEXT_SWITCH) {
+        RTOS_LOG("❌ Software timers need context-switch mode to run callbacks\n");
+        return -1;
+    }
+
+    timer->name = name;
+    timer->callback = callback;
+    timer->param = param;
+    timer->period = period_ms;
+    timer->auto_reload = auto_reload;
+    timer->expiry = 0;
+    timer->heap_index = SOFT_TIMER_STOPPED;
+    timer->due_tick = 0;
+    timer->overruns = 0;
+
+    kernel_lock();
+    // Reserve a heap slot now, so starting a timer never allocates
+    if (timer_count == timer_heap_capacity) {
+        uint32_t capacity = timer_heap_capacity ? timer_heap_capacity * 2 : 16;
+        soft_timer_t** grown = realloc(timer_heap, capacity * sizeof(soft_timer_t*));
+        if (grown == NULL) {
+            kernel_unlock();
+            timer->callback = NULL;
+            return -1;
+        }
+        timer_heap = grown;
+        timer_heap_capacity = capacity;
+    }
+    timer_count++;
+    bool need_task = !timer_task_started;
+    timer_task_started = true;
+    kernel_unlock();
+
+    if (need_task) {
+        uint32_t task_id = task_create("TIMER", timer_task_function, NULL,
+                                       TIMER_TASK_PRIORITY, 0);
+        kernel_lock();
+        if (task_id == 0) {
+            timer_task_started = false;
+            timer_count--;
+            kernel_unlock();
+            timer->callback = NULL;
+            return -1;
+        }
+        timer_task = task_lookup(task_id);
+        kernel_unlock();
+    }
+
+    RTOS_LOG("⏲️  Timer '%s' created (%u ms, %s)\n", name ? name : "", period_ms,
+             auto_reload ? "periodic" : "one-shot");
+    return 0;
+}
+
+void soft_timer_destroy(soft_timer_t* timer) {
+    if (timer == NULL || timer->callback == NULL) {
+        return;
+    }
+
+    kernel_lock();
+    if (timer->heap_index != SOFT_TIMER_STOPPED) {
+        timer_heap_remove(timer);
+    }
+    timer->callback = NULL;
+    timer_count--;
+    kernel_unlock();
+}
+
+/*
+ * START, STOP, RESET
+ */
+int soft_timer_start(soft_timer_t* timer) {
+    if (timer == NULL || timer->callback == NULL) {
+        return -1;
+    }
+
+    poll_host_clock(); // The period counts from now, not from a stale tick
+    kernel_lock();
+    if (timer->heap_index == SOFT_TIMER_STOPPED) {
+        timer_arm(timer, system_tick_count + timer->period);
+    }
+    kernel_unlock();
+
+    return 0;
+}
+
+int soft_timer_stop(soft_timer_t* timer) {
+    if (timer == NULL || timer->callback == NULL) {
+        return -1;
+    }
+
+    // The daemon may wake for it anyway, find nothing due and sleep again
+    kernel_lock();
+    if (timer->heap_index != SOFT_TIMER_STOPPED) {
+        timer_heap_remove(timer);
+    }
+    kernel_unlock();
+
+    return 0;
+}
+
+int soft_timer_reset(soft_timer_t* timer) {
+    if (timer == NULL || timer->callback == NULL) {
+        return -1;
+    }
+
+    poll_host_clock(); // The period counts from now, not from a stale tick
+    kernel_lock();
+    timer_arm(timer, system_tick_count + timer->period);
+    kernel_unlock();
+
+    return 0;
+}
+
+bool soft_timer_is_active(const soft_timer_t* timer) {
+    return timer != NULL && timer->callback != NULL &&
+           __atomic_load_n(&timer->heap_index, __ATOMIC_RELAXED) != SOFT_TIMER_STOPPED;
+}
+
+/*
+ * RESET (called by rtos_init, which deletes the daemon with every other task)
+ */
+void timers_reset(void) {
+    free(timer_heap);
+    timer_heap = NULL;
+    timer_heap_size = 0;
+    timer_heap_capacity = 0;
+    timer_count = 0;
+    timer_task = NULL;
+    timer_task_started = false;
+}
@@ -0,0 +1,403 @@
+/*
+ * RTOS Scheduler Trace
+ *
+ * Printing every context switch tells you what the scheduler did, but a
+ * printf takes microseconds: far longer than the switch it describes, so
+ * the act of watching changes the timing being watched. Instead, the
+ * kernel writes small binary records into memory, and they are turned into
+ * something readable later, after the run.
+ *
+ * RING BUFFERS:
+ * Every core owns a power-of-two ring of trace_event_t. A writer claims a
+ * position with one atomic increment, so even threads outside the kernel
+ * (which share core 0's ring) can record without a lock. When a ring is
+ * full the oldest events are overwritten: the trace always holds the most
+ * recent history, like an aircraft flight recorder.
+ *
+ * Each record carries its ring position + 1 in seq, written last with
+ * release ordering and cleared before the record is rewritten. A reader
+ * copies a record only if seq matches before and after the copy, so a
+ * half-written or overwritten record is skipped rather than misread.
+ *
+ * TIMESTAMPS:
+ * Events are stamped with the CPU cycle counter (port_cycles). Converting
+ * cycles to nanoseconds is left to the exporter, which calibrates the
+ * counter against the monotonic clock over the whole trace.
+ *
+ * EXPORT:
+ * rtos_trace_export_chrome writes the Chrome trace event JSON format,
+ * which both chrome://tracing and https://ui.perfetto.dev open. Each core
+ * is a thread track whose slices are the tasks it ran; wake-ups are drawn
+ * as arrows to the switch that finally ran the task, and each slice records
+ * that wake-up latency. Run queue depth appears as a counter track per
+ * core, and ticks, blocks and preemptions as instant events.
+ */
+
+#define _GNU_SOURCE
+#include "rtos_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    trace_event_t* events;                    // capacity records
+    uint32_t mask;                            // capacity - 1
+    uint32_t head;                            // Positions ever claimed
+    char pad[64];                             // Keep cores' heads apart
+} trace_ring_t;
+
+bool trace_enabled = false;
+
+static trace_ring_t trace_rings[RTOS_MAX_CORES];
+static uint32_t trace_ring_count = 0;         // Rings allocated
+static uint64_t trace_start_cycles;           // Calibration points
+static uint64_t trace_start_ns;
+
+/*
+ * RECORDING
+ */
+void trace_write(trace_type_t type, uint32_t task_id, uint32_t arg) {
+    rtos_core_t* core = this_core();
+    if (core->id >= trace_ring_count) {
+        return;
+    }
+
+    trace_ring_t* ring = &trace_rings[core->id];
+    uint32_t position = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+    trace_event_t* event = &ring->events[position & ring->mask];
+
+    __atomic_store_n(&event->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    event->timestamp = port_cycles();
+    event->task_id = task_id;
+    event->arg = arg;
+    event->depth = (uint16_t)(core->ready_count < 0xFFFF ? core->ready_count : 0xFFFF);
+    event->type = (uint8_t)type;
+    event->core = (uint8_t)core->id;
+
+    __atomic_store_n(&event->seq, position + 1, __ATOMIC_RELEASE);
+}
+
+int rtos_trace_start(uint32_t events_per_core) {
+    uint32_t capacity = 64;
+    while (capacity < events_per_core && capacity < (1u << 28)) {
+        capacity <<= 1;
+    }
+
+    // The old rings are freed below, so nothing may still be writing them
+    if (__atomic_load_n(&trace_enabled, __ATOMIC_ACQUIRE) || scheduler_running) {
+        RTOS_LOG("❌ Stop tracing and the scheduler before restarting the trace\n");
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < trace_ring_count; i++) {
+        free(trace_rings[i].events);
+    }
+    memset(trace_rings, 0, sizeof(trace_rings));
+    trace_ring_count = 0;
+
+    for (uint32_t i = 0; i < core_count; i++) {
+        trace_rings[i].events = calloc(capacity, sizeof(trace_event_t));
+        if (trace_rings[i].events == NULL) {
+            RTOS_LOG("❌ Out of memory for trace buffers\n");
+            trace_ring_count = i;
+            return -1;
+        }
+        trace_rings[i].mask = capacity - 1;
+        trace_ring_count = i + 1;
+    }
+
+    trace_start_cycles = port_cycles();
+    trace_start_ns = port_time_ns();
+    __atomic_store_n(&trace_enabled, true, __ATOMIC_RELEASE);
+
+    RTOS_LOG("🔍 Tracing %u events per core on %u cores\n", capacity, core_count);
+    return 0;
+}
+
+void rtos_trace_stop(void) {
+    __atomic_store_n(&trace_enabled, false, __ATOMIC_RELEASE);
+}
+
+uint64_t rtos_trace_overwritten(void) {
+    uint64_t overwritten = 0;
+
+    for (uint32_t i = 0; i < trace_ring_count; i++) {
+        uint32_t head = __atomic_load_n(&trace_rings[i].head, __ATOMIC_ACQUIRE);
+        uint32_t capacity = trace_rings[i].mask + 1;
+        if (head > capacity) {
+            overwritten += head - capacity;
+        }
+    }
+
+    return overwritten;
+}
+
+/*
+ * SNAPSHOT
+ *
+ * Copies every intact record still in the rings into one array sorted by
+ * time. Safe while the kernel is still recording.
+ */
+static int compare_events(const void* a, const void* b) {
+    const trace_event_t* x = a;
+    const trace_event_t* y = b;
+
+    if (x->timestamp != y->timestamp) {
+        return x->timestamp < y->timestamp ? -1 : 1;
+    }
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static trace_event_t* trace_snapshot(uint32_t* count) {
+    size_t total = 0;
+    for (uint32_t i = 0; i < trace_ring_count; i++) {
+        total += trace_rings[i].mask + 1;
+    }
+
+    trace_event_t* events = malloc((total ? total : 1) * sizeof(trace_event_t));
+    if (events == NULL) {
+        return NULL;
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < trace_ring_count; i++) {
+        trace_ring_t* ring = &trace_rings[i];
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint32_t capacity = ring->mask + 1;
+        uint32_t first = head > capacity ? head - capacity : 0;
+
+        for (uint32_t position = first; position != head; position++) {
+            trace_event_t* slot = &ring->events[position & ring->mask];
+            if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != position + 1) {
+                continue;
+            }
+            events[n] = *slot;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == position + 1) {
+                n++;
+            }
+        }
+    }
+
+    qsort(events, n, sizeof(trace_event_t), compare_events);
+    *count = n;
+    return events;
+}
+
+/*
+ * CHROME / PERFETTO EXPORT
+ */
+typedef struct {
+    FILE* out;
+    bool first;                               // No comma before the first event
+    double ns_per_cycle;
+    uint64_t base;                            // Cycle count at time zero
+} json_writer_t;
+
+static double to_us(const json_writer_t* w, uint64_t cycles) {
+    return (double)(cycles - w->base) * w->ns_per_cycle / 1000.0;
+}
+
+static void json_begin(json_writer_t* w) {
+    fputs(w->first ? "\n  " : ",\n  ", w->out);
+    w->first = false;
+}
+
+// Task names are caller-chosen, so quotes, backslashes and control
+// characters are escaped rather than allowed to break the JSON
+static void json_string(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const unsigned char* c = (const unsigned char*)text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(out, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(out, "\\u%04x", *c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// The task may be deleted while the kernel keeps recording, so
+// its name is copied under the kernel lock
+static void task_label(uint32_t task_id, char* buffer, size_t size) {
+    if (task_id == 0) {
+        snprintf(buffer, size, "none");
+        return;
+    }
+
+    kernel_lock();
+    tcb_t* task = task_lookup(task_id);
+    if (task != NULL) {
+        snprintf(buffer, size, "%.*s #%u", (int)sizeof(task->name), task->name, task_id);
+    } else {
+        snprintf(buffer, size, "task #%u", task_id);
+    }
+    kernel_unlock();
+}
+
+static void write_slice(json_writer_t* w, uint32_t core, uint32_t task_id,
+                        uint64_t start, uint64_t end, int64_t wake_latency) {
+    char name[48];
+    task_label(task_id, name, sizeof(name));
+
+    json_begin(w);
+    fprintf(w->out, "{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":", core);
+    json_string(w->out, name);
+    fprintf(w->out, ",\"ts\":%.3f,\"dur\":%.3f", to_us(w, start), to_us(w, end) - to_us(w, start));
+    if (wake_latency >= 0) {
+        fprintf(w->out, ",\"args\":{\"wake_latency_us\":%.3f}",
+                (double)wake_latency * w->ns_per_cycle / 1000.0);
+    }
+    fputs("}", w->out);
+}
+
+static void write_instant(json_writer_t* w, const trace_event_t* e, const char* what) {
+    char label[48];
+    char name[64];
+    task_label(e->task_id, label, sizeof(label));
+    snprintf(name, sizeof(name), "%s %s", what, label);
+
+    json_begin(w);
+    if (e->type == TRACE_TICK) {
+        fprintf(w->out, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"name\":\"tick\","
+                "\"ts\":%.3f,\"args\":{\"tick\":%u}}", e->core, to_us(w, e->timestamp), e->arg);
+    } else {
+        fprintf(w->out, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"name\":", e->core);
+        json_string(w->out, name);
+        fprintf(w->out, ",\"ts\":%.3f,\"args\":{\"arg\":%u}}", to_us(w, e->timestamp), e->arg);
+    }
+}
+
+int rtos_trace_export_chrome(const char* path) {
+    uint32_t count = 0;
+    trace_event_t* events = trace_snapshot(&count);
+    if (events == NULL) {
+        return -1;
+    }
+
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        free(events);
+        return -1;
+    }
+
+    json_writer_t w = {out, true, 1.0, count ? events[0].timestamp : 0};
+    uint64_t elapsed_cycles = port_cycles() - trace_start_cycles;
+    if (elapsed_cycles > 0) {
+        w.ns_per_cycle = (double)(port_time_ns() - trace_start_ns) / (double)elapsed_cycles;
+    }
+
+    // Pending wake-up time per task, indexed by task ID
+    uint32_t max_id = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (events[i].task_id > max_id) {
+            max_id = events[i].task_id;
+        }
+    }
+    uint64_t* woken_at = calloc((size_t)max_id + 1, sizeof(uint64_t));
+    uint32_t* flow_id = calloc((size_t)max_id + 1, sizeof(uint32_t));
+    uint32_t next_flow = 0;
+    if (woken_at == NULL || flow_id == NULL) {
+        free(woken_at);
+        free(flow_id);
+        free(events);
+        fclose(out);
+        return -1;
+    }
+
+    // What each core is running since when, and its last depth shown
+    uint32_t running[RTOS_MAX_CORES] = {0};
+    uint64_t since[RTOS_MAX_CORES] = {0};
+    int64_t latency[RTOS_MAX_CORES];
+    int32_t shown_depth[RTOS_MAX_CORES];
+    for (uint32_t c = 0; c < RTOS_MAX_CORES; c++) {
+        latency[c] = -1;
+        shown_depth[c] = -1;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+
+    json_begin(&w);
+    fputs("{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"RTOS\"}}", out);
+    for (uint32_t c = 0; c < trace_ring_count; c++) {
+        json_begin(&w);
+        fprintf(out, "{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\","
+                "\"args\":{\"name\":\"Core %u\"}}", c, c);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const trace_event_t* e = &events[i];
+        uint32_t c = e->core;
+
+        if (shown_depth[c] != e->depth) {
+            shown_depth[c] = e->depth;
+            json_begin(&w);
+            fprintf(out, "{\"ph\":\"C\",\"pid\":1,\"name\":\"Run queue core %u\",\"ts\":%.3f,"
+                    "\"args\":{\"tasks\":%u}}", c, to_us(&w, e->timestamp), e->depth);
+        }
+
+        switch (e->type) {
+            case TRACE_SWITCH:
+                if (running[c] != 0) {
+                    write_slice(&w, c, running[c], since[c], e->timestamp, latency[c]);
+                }
+                running[c] = e->task_id;
+                since[c] = e->timestamp;
+                latency[c] = -1;
+
+                // Close the wake-up arrow and remember how long it took
+                if (woken_at[e->task_id] != 0) {
+                    latency[c] = (int64_t)(e->timestamp - woken_at[e->task_id]);
+                    json_begin(&w);
+                    fprintf(out, "{\"ph\":\"f\",\"bp\":\"e\",\"pid\":1,\"tid\":%u,\"cat\":\"wake\","
+                            "\"name\":\"wake\",\"id\":%u,\"ts\":%.3f}",
+                            c, flow_id[e->task_id], to_us(&w, e->timestamp));
+                    woken_at[e->task_id] = 0;
+                }
+                break;
+
+            case TRACE_WAKE:
+                write_instant(&w, e, "wake");
+                if (woken_at[e->task_id] == 0) {
+                    woken_at[e->task_id] = e->timestamp;
+                    flow_id[e->task_id] = ++next_flow;
+                    json_begin(&w);
+                    fprintf(out, "{\"ph\":\"s\",\"pid\":1,\"tid\":%u,\"cat\":\"wake\","
+                            "\"name\":\"wake\",\"id\":%u,\"ts\":%.3f}",
+                            c, next_flow, to_us(&w, e->timestamp));
+                }
+                break;
+
+            case TRACE_BLOCK:
+                write_instant(&w, e, "block");
+                break;
+
+            case TRACE_PREEMPT:
+                write_instant(&w, e, "preempt");
+                break;
+
+            case TRACE_TICK:
+                write_instant(&w, e, "tick");
+                break;
+        }
+    }
+
+    // Close the slices still running at the end of the trace
+    for (uint32_t c = 0; c < RTOS_MAX_CORES; c++) {
+        if (running[c] != 0 && count > 0) {
+            write_slice(&w, c, running[c], since[c], events[count - 1].timestamp, latency[c]);
+        }
+    }
+
+    fputs("\n]}\n", out);
+    int result = ferror(out) ? -1 : (int)count;
+    fclose(out);
+
+    free(woken_at);
+    free(flow_id);
+    free(events);
+    return result;
+}
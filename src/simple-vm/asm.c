@@ -0,0 +1,415 @@
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "vm.h"
+
+#define MAX_OPERANDS 16         // Per line, for .word
+
+
+static const char* const register_names[NUM_REGS] = { "A", "B", "C", "D", "IP", "SP" };
+
+
+
+
+// LABELS
+//
+// Collected by the first pass, sorted, and looked up by the second
+
+typedef struct {
+
+    const char* name;   // Points into the source
+    int length;
+    int address;
+    int line;
+
+} label_t;
+
+
+typedef struct {
+
+    label_t* labels;
+    int count;
+    int capacity;
+
+    int* code;
+    int length;
+
+    int line;
+    char* error;
+    size_t error_size;
+
+} assembler_t;
+
+
+static int fail(assembler_t* as, const char* format, ...) {
+
+    int n = snprintf(as->error, as->error_size, "line %d: ", as->line);
+
+    if (n >= 0 && (size_t) n < as->error_size) {
+
+        va_list args;
+
+        va_start(args, format);
+        vsnprintf(as->error + n, as->error_size - n, format, args);
+        va_end(args);
+    }
+
+    return -1;
+}
+
+
+static int compare_labels(const void* a, const void* b) {
+
+    const label_t* x = a;
+    const label_t* y = b;
+    int n = x->length < y->length ? x->length : y->length;
+    int c = memcmp(x->name, y->name, n);
+
+    return c != 0 ? c : x->length - y->length;
+}
+
+
+static label_t* find_label(assembler_t* as, const char* name, int length) {
+
+    label_t key = { name, length, 0, 0 };
+
+    if (as->count == 0)
+        return NULL;
+
+    return bsearch(&key, as->labels, as->count, sizeof(label_t), compare_labels);
+}
+
+
+static int add_label(assembler_t* as, const char* name, int length, int address) {
+
+    if (as->count == as->capacity) {
+
+        int capacity = as->capacity ? 2 * as->capacity : 64;
+        label_t* labels = realloc(as->labels, capacity * sizeof(label_t));
+
+        if (labels == NULL)
+            return fail(as, "out of memory");
+
+        as->labels = labels;
+        as->capacity = capacity;
+    }
+
+    as->labels[as->count++] = (label_t) { name, length, address, as->line };
+
+    return 0;
+}
+
+
+
+
+// TOKENS
+
+typedef struct {
+
+    const char* text;
+    int length;
+
+} token_t;
+
+
+static bool is_name_char(char c) {
+
+    return isalnum((unsigned char) c) || c == '_' || c == '.';
+}
+
+
+// Split one line into tokens; a trailing ':' stays part of its token
+static int tokenize(assembler_t* as, const char* line, const char* end, token_t* tokens) {
+
+    int count = 0;
+
+    while (line < end) {
+
+        char c = *line;
+
+        if (c == ';' || c == '#')
+            break;
+
+        if (isspace((unsigned char) c) || c == ',') {
+
+            line++;
+            continue;
+        }
+
+        const char* start = line;
+
+        if (c == '-' || c == '+')
+            line++;
+
+        while (line < end && is_name_char(*line))
+            line++;
+
+        if (line < end && *line == ':')
+            line++;
+
+        if (line == start || (line == start + 1 && (c == '-' || c == '+')))
+            return fail(as, "unexpected '%c'", c);
+
+        if (count == MAX_OPERANDS + 1)
+            return fail(as, "too many operands");
+
+        tokens[count++] = (token_t) { start, (int) (line - start) };
+    }
+
+    return count;
+}
+
+
+static bool token_is(token_t t, const char* word) {
+
+    return (int) strlen(word) == t.length && strncasecmp(t.text, word, t.length) == 0;
+}
+
+
+static int find_register(token_t t) {
+
+    for (int reg = 0; reg < NUM_REGS; reg++) {
+
+        if (token_is(t, register_names[reg]))
+            return reg;
+    }
+
+    return -1;
+}
+
+
+static int find_mnemonic(token_t t) {
+
+    for (int op = 0; op < NUM_INSTRUCTIONS; op++) {
+
+        if (token_is(t, vm_mnemonics[op]))
+            return op;
+    }
+
+    return -1;
+}
+
+
+// A number, a register name or a label
+static int operand(assembler_t* as, token_t t, int* value) {
+
+    char text[64];
+    int reg = find_register(t);
+
+    if (reg >= 0) {
+
+        *value = reg;
+        return 0;
+    }
+
+    char c = t.text[0];
+
+    if (isdigit((unsigned char) c) || c == '-' || c == '+') {
+
+        if (t.length >= (int) sizeof(text))
+            return fail(as, "number too long");
+
+        memcpy(text, t.text, t.length);
+        text[t.length] = '\0';
+
+        char* end;
+
+        errno = 0;
+        long v = strtol(text, &end, 0);
+
+        // Anything from INT_MIN to UINT_MAX, the latter wrapping
+        if (*end != '\0' || errno != 0 || v < -2147483647L - 1 || v > 4294967295L)
+            return fail(as, "bad number '%s'", text);
+
+        *value = (int) (unsigned) v;
+        return 0;
+    }
+
+    label_t* label = find_label(as, t.text, t.length);
+
+    if (label == NULL)
+        return fail(as, "undefined label '%.*s'", t.length, t.text);
+
+    *value = label->address;
+
+    return 0;
+}
+
+
+
+
+// PASSES
+//
+// Both passes walk the same lines; the first only counts words and
+// records labels, the second (code != NULL) emits
+
+static int assemble_line(assembler_t* as, const char* line, const char* end) {
+
+    token_t tokens[MAX_OPERANDS + 1];
+    int count = tokenize(as, line, end, tokens);
+
+    if (count < 0)
+        return -1;
+
+    int t = 0;
+
+    while (t < count && tokens[t].text[tokens[t].length - 1] == ':') {
+
+        token_t name = { tokens[t].text, tokens[t].length - 1 };
+
+        if (as->code == NULL) {
+
+            if (name.length == 0 || !(isalpha((unsigned char) name.text[0]) || name.text[0] == '_'))
+                return fail(as, "bad label '%.*s'", tokens[t].length, tokens[t].text);
+
+            if (find_register(name) >= 0)
+                return fail(as, "register name '%.*s' used as a label", name.length, name.text);
+
+            if (add_label(as, name.text, name.length, as->length) != 0)
+                return -1;
+        }
+
+        t++;
+    }
+
+    if (t == count)
+        return 0;
+
+    token_t head = tokens[t++];
+    int operands = count - t;
+
+    if (token_is(head, ".word")) {
+
+        if (operands == 0)
+            return fail(as, ".word needs a value");
+
+        for (; t < count; t++) {
+
+            int value = 0;
+
+            if (as->code != NULL && operand(as, tokens[t], &value) != 0)
+                return -1;
+
+            if (as->code != NULL)
+                as->code[as->length] = value;
+
+            as->length++;
+        }
+
+        return 0;
+    }
+
+    int op = find_mnemonic(head);
+
+    if (op < 0)
+        return fail(as, "unknown instruction '%.*s'", head.length, head.text);
+
+    if (operands != vm_operand_count[op])
+        return fail(as, "%s takes %d operand%s", vm_mnemonics[op], vm_operand_count[op],
+                    vm_operand_count[op] == 1 ? "" : "s");
+
+    if (as->code != NULL)
+        as->code[as->length] = op;
+
+    as->length++;
+
+    for (; t < count; t++) {
+
+        int value = 0;
+
+        if (as->code != NULL && operand(as, tokens[t], &value) != 0)
+            return -1;
+
+        if (as->code != NULL)
+            as->code[as->length] = value;
+
+        as->length++;
+    }
+
+    return 0;
+}
+
+
+static int assemble_pass(assembler_t* as, const char* source) {
+
+    as->length = 0;
+    as->line = 0;
+
+    while (*source != '\0') {
+
+        const char* end = strchr(source, '\n');
+
+        if (end == NULL)
+            end = source + strlen(source);
+
+        as->line++;
+
+        if (assemble_line(as, source, end) != 0)
+            return -1;
+
+        if (as->length > PROGRAM_MAX)
+            return fail(as, "program longer than %d words", PROGRAM_MAX);
+
+        source = *end == '\n' ? end + 1 : end;
+    }
+
+    return 0;
+}
+
+
+int vm_assemble(const char* source, int** code, int* length, char* error, size_t error_size) {
+
+    assembler_t as = { 0 };
+
+    as.error = error;
+    as.error_size = error_size;
+
+    if (assemble_pass(&as, source) != 0) {
+
+        free(as.labels);
+        return -1;
+    }
+
+    if (as.count > 0)
+        qsort(as.labels, as.count, sizeof(label_t), compare_labels);
+
+    for (int i = 1; i < as.count; i++) {
+
+        if (compare_labels(&as.labels[i - 1], &as.labels[i]) == 0) {
+
+            as.line = as.labels[i].line > as.labels[i - 1].line ? as.labels[i].line :
+                                                                   as.labels[i - 1].line;
+            fail(&as, "label '%.*s' defined twice", as.labels[i].length, as.labels[i].name);
+            free(as.labels);
+            return -1;
+        }
+    }
+
+    as.code = malloc((as.length > 0 ? as.length : 1) * sizeof(int));
+
+    if (as.code == NULL) {
+
+        free(as.labels);
+        return fail(&as, "out of memory");
+    }
+
+    if (assemble_pass(&as, source) != 0) {
+
+        free(as.code);
+        free(as.labels);
+        return -1;
+    }
+
+    free(as.labels);
+
+    *code = as.code;
+    *length = as.length;
+
+    return 0;
+}
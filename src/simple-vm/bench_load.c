@@ -0,0 +1,197 @@
+/*
+ * Load Benchmark
+ *
+ * A generated program of PROGRAM_WORDS words - mostly small constants
+ * and short jumps, with a few large constants used over and over - is
+ * stored two ways: as raw 4-byte words, read() into a buffer and
+ * vm_load()ed, and in the bytecode format, mapped and decoded by
+ * vm_load_file(). Reports file size per word and load time (best of
+ * REPEATS, files in the page cache), and how fast the assembler turns
+ * the same program's source into words.
+ *
+ * Build and run:  make bench_load && ./bench_load
+ */
+
+#define _GNU_SOURCE
+#include "vm.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROGRAM_WORDS (4 * 1024 * 1024)
+#define REPEATS 5
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Blocks of pushes and arithmetic that drop their result, with a
+// forward jump now and then; every instruction is complete
+static int generate(int* code, int words) {
+    static const int large[] = { 100000, -250000, 1 << 20, 123456789 };
+    int n = 0;
+
+    srand(1);
+    while (n + 12 < words) {
+        int pick = rand() % 8;
+
+        code[n++] = PSH;
+        code[n++] = pick == 0 ? large[rand() % 4] : rand() % 100;
+        code[n++] = PSH;
+        code[n++] = rand() % 1000 - 500;
+        code[n++] = pick == 1 ? MUL : ADD;
+        code[n++] = SET;
+        code[n++] = SP;
+        code[n++] = -1;
+        if (pick == 2) {
+            code[n++] = JMP;
+            code[n] = n + 1;
+            n++;
+        }
+    }
+    code[n++] = HLT;
+    return n;
+}
+
+static char* disassemble(const int* code, int length) {
+    char* text = malloc((size_t)length * 16 + 1);
+    char* out = text;
+
+    for (int i = 0; i < length; ) {
+        int op = code[i];
+        out += sprintf(out, "    %s", vm_mnemonics[op]);
+        for (int k = 1; k <= vm_operand_count[op]; k++) {
+            out += sprintf(out, "%s%d", k == 1 ? " " : ", ", code[i + k]);
+        }
+        *out++ = '\n';
+        i += 1 + vm_operand_count[op];
+    }
+    *out = '\0';
+    return text;
+}
+
+static double load_raw(vm_t* vm, const char* path) {
+    uint64_t start = now_ns();
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        exit(1);
+    }
+
+    int* words = malloc((size_t)st.st_size);
+    size_t done = 0;
+    while (done < (size_t)st.st_size) {
+        ssize_t n = read(fd, (char*)words + done, (size_t)st.st_size - done);
+        if (n <= 0) {
+            perror(path);
+            exit(1);
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+    vm_load(vm, words, (int)(st.st_size / sizeof(int)));
+    free(words);
+
+    return (now_ns() - start) / 1e9;
+}
+
+static double load_bytecode(vm_t* vm, const char* path) {
+    uint64_t start = now_ns();
+
+    if (vm_load_file(vm, path) != 0) {
+        printf("❌ Loading %s failed\n", path);
+        exit(1);
+    }
+    return (now_ns() - start) / 1e9;
+}
+
+static double best_of(double (*load)(vm_t*, const char*), vm_t* vm, const char* path) {
+    double best = 0;
+
+    for (int r = 0; r < REPEATS; r++) {
+        double seconds = load(vm, path);
+        if (r == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+static size_t file_size(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+int main(void) {
+    char raw_path[] = "/tmp/bench_load_raw_XXXXXX";
+    char svm_path[] = "/tmp/bench_load_svm_XXXXXX";
+    int* code = malloc(PROGRAM_WORDS * sizeof(int));
+    int length = generate(code, PROGRAM_WORDS);
+    vm_t* vm = vm_create();
+
+    printf("🧪 SIMPLE VM LOAD BENCHMARK\n");
+    printf("===========================\n\n");
+
+    int raw_fd = mkstemp(raw_path);
+    int svm_fd = mkstemp(svm_path);
+    if (raw_fd < 0 || svm_fd < 0 ||
+        write(raw_fd, code, length * sizeof(int)) != (ssize_t)(length * sizeof(int)) ||
+        vm_save_file(svm_path, code, length) != 0) {
+        printf("❌ Writing the program files failed\n");
+        return 1;
+    }
+    close(raw_fd);
+    close(svm_fd);
+
+    printf("%d words, best of %d loads from the page cache\n", length, REPEATS);
+    printf("  %-26s %10s %10s %10s %12s\n", "format", "bytes", "per word", "load ms", "M words/s");
+
+    double raw_s = best_of(load_raw, vm, raw_path);
+    size_t raw_size = file_size(raw_path);
+    printf("  %-26s %10zu %10.2f %10.2f %12.1f\n", "raw words, read()", raw_size,
+           (double)raw_size / length, raw_s * 1e3, length / raw_s / 1e6);
+
+    double svm_s = best_of(load_bytecode, vm, svm_path);
+    size_t svm_size = file_size(svm_path);
+    printf("  %-26s %10zu %10.2f %10.2f %12.1f\n", "bytecode, mmap + decode", svm_size,
+           (double)svm_size / length, svm_s * 1e3, length / svm_s / 1e6);
+
+    if (vm->program_size != length || memcmp(vm->program, code, length * sizeof(int)) != 0) {
+        printf("❌ The decoded program differs from the original\n");
+        return 1;
+    }
+
+    char* source = disassemble(code, length);
+    int* assembled;
+    int assembled_length;
+    char error[256];
+    uint64_t start = now_ns();
+    if (vm_assemble(source, &assembled, &assembled_length, error, sizeof(error)) != 0) {
+        printf("❌ Assembling failed: %s\n", error);
+        return 1;
+    }
+    double asm_s = (now_ns() - start) / 1e9;
+    if (assembled_length != length || memcmp(assembled, code, length * sizeof(int)) != 0) {
+        printf("❌ The assembled program differs from the original\n");
+        return 1;
+    }
+    printf("\nAssembling the program from %zu bytes of source: %.0f ms, %.1f M words/s\n",
+           strlen(source), asm_s * 1e3, length / asm_s / 1e6);
+
+    unlink(raw_path);
+    unlink(svm_path);
+    free(assembled);
+    free(source);
+    free(code);
+    vm_destroy(vm);
+    return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * Optimizer Benchmark
+ *
+ * Assembles loop-heavy programs, profiles each with vm_profile() and
+ * runs vm_optimize() on it. Reports program words and dispatches per
+ * run before and after (both counted by vm_profile()), what the pass
+ * folded, dropped and fused, and the time per run on the verified
+ * loop before and after (best of REPEATS). The output, registers A-D
+ * and live stack of the optimized program must match the original's.
+ *
+ * Build and run:  make bench_optimize && ./bench_optimize
+ */
+
+#define _GNU_SOURCE
+#include "vm.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ITERATIONS 2000000
+#define REPEATS 3                        // Best of
+
+typedef struct {
+    const char* label;
+    const char* source;                  // %d: the iteration count
+} bench_program_t;
+
+// The ISA has no DUP, so loop counters live in stack slots that SET SP
+// brings back (see countdown.s)
+static const bench_program_t programs[] = {
+    { "countdown",
+      "        PSH %d\n"
+      "loop:   PSH 1\n"
+      "        SUB\n"
+      "        JZ done\n"
+      "        SET SP, 0\n"
+      "        JMP loop\n"
+      "done:   HLT\n" },
+    { "constant arithmetic",
+      "        PSH %d\n"
+      "loop:   PSH 7\n"
+      "        PSH 3\n"
+      "        MUL\n"
+      "        PSH 5\n"
+      "        ADD\n"
+      "        PSH 2\n"
+      "        DIV\n"
+      "        SET SP, 0\n"              // Drop the result
+      "        PSH 1\n"
+      "        SUB\n"
+      "        JZ done\n"
+      "        SET SP, 0\n"
+      "        JMP loop\n"
+      "done:   HLT\n" },
+    { "accumulate",
+      "        PSH %d\n"
+      "        PSH 0\n"
+      "        PSH 0\n"
+      "loop:   PSH 3\n"                  // Accumulator in stack[2]
+      "        ADD\n"
+      "        SET SP, 0\n"
+      "        PSH 1\n"
+      "        SUB\n"
+      "        JZ done\n"
+      "        SET SP, 2\n"
+      "        JMP loop\n"
+      "done:   SET SP, 2\n"
+      "        PRT\n"
+      "        HLT\n" },
+    { "branches and dead code",
+      "        PSH %d\n"
+      "loop:   PSH 0\n"
+      "        JZ skip\n"                // Always taken
+      "        PSH 99\n"
+      "        PRT\n"
+      "skip:   PSH 1\n"
+      "        SUB\n"
+      "        JZ done\n"
+      "        SET SP, 0\n"
+      "        JMP next\n"
+      "        HLT\n"                    // Never reached
+      "next:   JMP loop\n"
+      "done:   PSH 6\n"
+      "        PSH 7\n"
+      "        MUL\n"
+      "        PRT\n"
+      "        HLT\n"
+      "        PSH 1\n"                  // Never reached
+      "        PRT\n" },
+};
+
+typedef struct {
+    char* output;
+    int registers[D + 1];
+    int sp;
+    int stack[STACK_SIZE];
+} result_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// One run with the output captured
+static void capture(vm_t* vm, result_t* result) {
+    size_t size;
+    FILE* out = open_memstream(&result->output, &size);
+
+    vm_reset(vm);
+    vm->out = out;
+    vm_run(vm);
+    fclose(out);
+    vm->out = NULL;
+
+    memcpy(result->registers, vm->registers, sizeof(result->registers));
+    result->sp = vm->registers[SP];
+    memcpy(result->stack, vm->stack, (result->sp + 1) * sizeof(int));
+}
+
+static bool same(const result_t* a, const result_t* b) {
+    return strcmp(a->output, b->output) == 0 &&
+           memcmp(a->registers, b->registers, sizeof(a->registers)) == 0 && a->sp == b->sp &&
+           memcmp(a->stack, b->stack, (a->sp + 1) * sizeof(int)) == 0;
+}
+
+static double time_runs(vm_t* vm) {
+    double best = 0;
+
+    for (int r = 0; r < REPEATS; r++) {
+        vm_reset(vm);
+        uint64_t start = now_ns();
+        vm_run(vm);
+        double seconds = (now_ns() - start) / 1e9;
+
+        if (r == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+static void run(const bench_program_t* p) {
+    char source[1024];
+    char error[128];
+    int* code;
+    int length;
+
+    snprintf(source, sizeof(source), p->source, ITERATIONS);
+    if (vm_assemble(source, &code, &length, error, sizeof(error)) != 0) {
+        printf("❌ %s: %s\n", p->label, error);
+        exit(1);
+    }
+
+    vm_t* vm = vm_create();
+    vm->out = NULL;
+    vm_load(vm, code, length);
+    if (!vm->verified) {
+        printf("❌ %s: not verified\n", p->label);
+        exit(1);
+    }
+
+    uint64_t* profile = malloc(vm->program_size * sizeof(uint64_t));
+    uint64_t before = vm_profile(vm, profile, 0);
+    result_t expected;
+    capture(vm, &expected);
+    double before_s = time_runs(vm);
+
+    vm_optimize_stats_t stats;
+    if (vm_optimize(vm, profile, &stats) != 0) {
+        printf("❌ %s: not optimized\n", p->label);
+        exit(1);
+    }
+
+    uint64_t after = vm_profile(vm, profile, 0);
+    result_t actual;
+    capture(vm, &actual);
+    if (!same(&expected, &actual)) {
+        printf("❌ %s: the optimized program disagrees with the original\n", p->label);
+        exit(1);
+    }
+    double after_s = time_runs(vm);
+
+    char fused[64] = "";
+    for (int op = ADDI; op < NUM_INSTRUCTIONS; op++) {
+        if (stats.fused[op] > 0) {
+            size_t n = strlen(fused);
+            snprintf(fused + n, sizeof(fused) - n, "%s%s x%d", n > 0 ? ", " : "", vm_mnemonics[op],
+                     stats.fused[op]);
+        }
+    }
+
+    printf("  %-24s %5d %5d %10llu %10llu %6d %5d  %-22s %8.2f %8.2f %7.2fx\n", p->label, length,
+           stats.words_after, (unsigned long long)before, (unsigned long long)after, stats.folded,
+           stats.dead_words - (stats.words_before - length), fused[0] ? fused : "-",
+           before_s * 1e3, after_s * 1e3, before_s / after_s);
+
+    free(expected.output);
+    free(actual.output);
+    free(profile);
+    free(code);
+    vm_destroy(vm);
+}
+
+int main(void) {
+    printf("🧪 SIMPLE VM OPTIMIZER BENCHMARK\n");
+    printf("================================\n\n");
+
+    printf("%d loop iterations per run, best of %d, on the verified loop\n", ITERATIONS, REPEATS);
+    printf("  %-24s %5s %5s %10s %10s %6s %5s  %-22s %8s %8s %8s\n", "program", "words", "after",
+           "dispatches", "after", "folded", "dead", "fused", "ms", "after", "speedup");
+
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+        run(&programs[i]);
+    }
+    printf("  (words: reachable and not; dead: words dropped; fused: superinstructions made)\n");
+
+    return 0;
+}
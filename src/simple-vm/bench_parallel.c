@@ -0,0 +1,153 @@
+/*
+ * Parallel Throughput Benchmark
+ *
+ * PROGRAMS small independent programs, each summing a constant over a
+ * loop of a few dozen to a few hundred iterations, run as one batch:
+ * first one after another on the calling thread, then on thread pools
+ * of 1, 2, 4, ... threads up to the number of online CPUs. Reports
+ * programs and instructions per second; every VM's result is checked
+ * after every batch.
+ *
+ * Build and run:  make bench_parallel && ./bench_parallel
+ */
+
+#define _GNU_SOURCE
+#include "vm.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROGRAMS 10000
+#define ROUNDS 5                         // Batches per configuration
+
+static vm_t* vms[PROGRAMS];
+static int expected[PROGRAMS];
+static uint64_t instructions;            // Per batch
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// stack[0] counts down from iterations, stack[2] accumulates step;
+// SET SP moves between them since the ISA has no DUP or SWAP
+static void load_program(vm_t* vm, int iterations, int step) {
+    int code[] = {
+        PSH, iterations,
+        PSH, 0,
+        PSH, 0,
+        PSH, step,                       // 6: loop, accumulator on top
+        ADD,
+        SET, SP, 0,
+        PSH, 1,
+        SUB,
+        JZ, 22,
+        SET, SP, 2,
+        JMP, 6,
+        SET, SP, 2,                      // 22: leave the sum on top
+        HLT
+    };
+
+    vm_load(vm, code, sizeof(code) / sizeof(code[0]));
+}
+
+static void check_results(const char* label) {
+    for (int i = 0; i < PROGRAMS; i++) {
+        if (vms[i]->running || vms[i]->registers[SP] != 2 || vms[i]->stack[2] != expected[i]) {
+            printf("❌ %s: program %d left %d, expected %d\n", label, i, vms[i]->stack[2],
+                   expected[i]);
+            exit(1);
+        }
+    }
+}
+
+static void reset_all(void) {
+    for (int i = 0; i < PROGRAMS; i++) {
+        vm_reset(vms[i]);
+    }
+}
+
+static void print_row(const char* label, double seconds) {
+    printf("  %-22s %12.0f %12.1f\n", label, ROUNDS * PROGRAMS / seconds,
+           ROUNDS * instructions / seconds / 1e6);
+}
+
+static void bench_sequential(void) {
+    double seconds = 0;
+
+    for (int r = 0; r < ROUNDS; r++) {
+        reset_all();
+        uint64_t start = now_ns();
+        for (int i = 0; i < PROGRAMS; i++) {
+            vm_run(vms[i]);
+        }
+        seconds += (now_ns() - start) / 1e9;
+        check_results("sequential");
+    }
+    print_row("sequential, no pool", seconds);
+}
+
+static void bench_pool(int threads) {
+    vm_pool_t* pool = vm_pool_create(threads);
+    double seconds = 0;
+    char label[32];
+
+    if (pool == NULL) {
+        printf("❌ vm_pool_create(%d) failed\n", threads);
+        exit(1);
+    }
+
+    snprintf(label, sizeof(label), "pool, %d thread%s", threads, threads == 1 ? "" : "s");
+    for (int r = 0; r < ROUNDS; r++) {
+        reset_all();
+        uint64_t start = now_ns();
+        vm_pool_run(pool, vms, PROGRAMS);
+        seconds += (now_ns() - start) / 1e9;
+        check_results(label);
+    }
+    print_row(label, seconds);
+    vm_pool_destroy(pool);
+}
+
+int main(void) {
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    printf("🧪 SIMPLE VM PARALLEL THROUGHPUT BENCHMARK\n");
+    printf("==========================================\n\n");
+
+    for (int i = 0; i < PROGRAMS; i++) {
+        int iterations = 20 + i % 200;
+        int step = 1 + i % 7;
+
+        vms[i] = vm_create();
+        if (vms[i] == NULL) {
+            printf("❌ vm_create failed\n");
+            return 1;
+        }
+        vms[i]->out = NULL;
+        load_program(vms[i], iterations, step);
+        expected[i] = iterations * step;
+        instructions += 8 * (uint64_t)iterations + 3;
+    }
+
+    printf("%d programs per batch (%.0f instructions on average), %d batches, %d CPUs\n",
+           PROGRAMS, (double)instructions / PROGRAMS, ROUNDS, cpus);
+    printf("  %-22s %12s %12s\n", "runner", "programs/s", "M instr/s");
+
+    bench_sequential();
+    for (int threads = 1; threads < cpus; threads *= 2) {
+        bench_pool(threads);
+    }
+    bench_pool(cpus);
+    if (cpus < 2) {
+        printf("  (one host CPU: the pool cannot run programs in parallel here)\n");
+    }
+
+    for (int i = 0; i < PROGRAMS; i++) {
+        vm_destroy(vms[i]);
+    }
+    return 0;
+}
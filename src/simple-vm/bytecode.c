@@ -0,0 +1,417 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "vm.h"
+
+
+
+
+// FILE FORMAT (version 1, little-endian)
+//
+//    0  magic       "SVMB"
+//    4  version     u8
+//    5  flags       u8, none defined yet (must be 0)
+//    6  reserved    u16
+//    8  constants   u32, entries in the constant pool
+//   12  words       u32, program length in words once decoded
+//   16  code size   u32, bytes of code
+//   20  constant pool, constants x i32
+//       code, code size bytes
+//
+// The code is the program word by word. An instruction is its opcode
+// in one byte, then its operands as zigzag varints (7 bits per byte,
+// low bits first, high bit set on all but the last), so small values
+// of either sign take one byte.
+//
+// A PSH whose constant would take three bytes or more sets bit 7 of
+// the opcode and gives the constant's pool index instead; a constant
+// pushed in many places is stored once. A word that is not an
+// instruction, or an opcode whose operands run past the end, is RAW
+// followed by the word as a varint, so any program round-trips.
+
+#define HEADER_SIZE 20
+#define POOLED 0x80
+#define RAW 0xff
+#define VARINT_MAX 5
+
+
+
+
+// VARINTS
+
+static uint32_t zigzag(int v) {
+
+    return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+}
+
+
+static int unzigzag(uint32_t u) {
+
+    return (int) (u >> 1) ^ -(int) (u & 1);
+}
+
+
+static uint8_t* put_varint(uint8_t* out, uint32_t u) {
+
+    while (u >= 0x80) {
+
+        *out++ = (uint8_t) (u | 0x80);
+        u >>= 7;
+    }
+
+    *out++ = (uint8_t) u;
+
+    return out;
+}
+
+
+// NULL if the varint is cut off or longer than 32 bits
+static inline const uint8_t* get_varint(const uint8_t* in, const uint8_t* end, uint32_t* u) {
+
+    // Most operands are small: one byte
+    if (in < end && *in < 0x80) {
+
+        *u = *in;
+        return in + 1;
+    }
+
+    uint32_t value = 0;
+
+    for (int shift = 0; shift < 7 * VARINT_MAX; shift += 7) {
+
+        if (in == end)
+            return NULL;
+
+        uint8_t byte = *in++;
+
+        if (shift == 28 && byte > 0x0f)
+            return NULL;
+
+        value |= (uint32_t) (byte & 0x7f) << shift;
+
+        if (byte < 0x80) {
+
+            *u = value;
+            return in;
+        }
+    }
+
+    return NULL;
+}
+
+
+static void put_u32(uint8_t* out, uint32_t u) {
+
+    out[0] = (uint8_t) u;
+    out[1] = (uint8_t) (u >> 8);
+    out[2] = (uint8_t) (u >> 16);
+    out[3] = (uint8_t) (u >> 24);
+}
+
+
+static uint32_t get_u32(const uint8_t* in) {
+
+    return in[0] | (uint32_t) in[1] << 8 | (uint32_t) in[2] << 16 | (uint32_t) in[3] << 24;
+}
+
+
+
+
+// CONSTANT POOL
+//
+// Open addressing from constant to pool index while encoding
+
+typedef struct {
+
+    int* values;
+    int* slots;         // Pool index + 1, 0 = empty
+    uint32_t mask;
+    uint32_t count;
+
+} pool_t;
+
+
+static bool pooled(int v) {
+
+    return zigzag(v) >= (1u << 14);         // Three varint bytes or more
+}
+
+
+static uint32_t pool_index(pool_t* pool, int v) {
+
+    uint32_t slot = (zigzag(v) * 2654435761u) & pool->mask;
+
+    while (pool->slots[slot] != 0) {
+
+        if (pool->values[pool->slots[slot] - 1] == v)
+            return pool->slots[slot] - 1;
+
+        slot = (slot + 1) & pool->mask;
+    }
+
+    pool->values[pool->count] = v;
+    pool->slots[slot] = (int) ++pool->count;
+
+    return pool->count - 1;
+}
+
+
+static bool has_operands(const int* code, int length, int i) {
+
+    return code[i] >= 0 && code[i] < NUM_INSTRUCTIONS &&
+           i + vm_operand_count[code[i]] < length;
+}
+
+
+
+
+// ENCODING
+
+uint8_t* vm_encode(const int* code, int length, size_t* size) {
+
+    if (length < 0 || length > PROGRAM_MAX)
+        return NULL;
+
+    pool_t pool = { 0 };
+    uint32_t slots = 16;
+
+    while (slots < 2u * (uint32_t) length)
+        slots <<= 1;
+
+    pool.values = malloc((length + 1) * sizeof(int));
+    pool.slots = calloc(slots, sizeof(int));
+    pool.mask = slots - 1;
+
+    // Worst case: every word a 5-byte varint after a byte of opcode
+    uint8_t* buffer = malloc(HEADER_SIZE + (size_t) length * (4 + 1 + VARINT_MAX));
+
+    if (pool.values == NULL || pool.slots == NULL || buffer == NULL) {
+
+        free(pool.values);
+        free(pool.slots);
+        free(buffer);
+        return NULL;
+    }
+
+
+    // First pass: which constants go in the pool
+    for (int i = 0; i < length; ) {
+
+        if (!has_operands(code, length, i)) {
+
+            i++;
+            continue;
+        }
+
+        if (code[i] == PSH && pooled(code[i + 1]))
+            pool_index(&pool, code[i + 1]);
+
+        i += 1 + vm_operand_count[code[i]];
+    }
+
+
+    // Second pass: the code, after room for the header and pool
+    uint8_t* start = buffer + HEADER_SIZE + 4 * (size_t) pool.count;
+    uint8_t* out = start;
+
+    for (int i = 0; i < length; ) {
+
+        if (!has_operands(code, length, i)) {
+
+            *out++ = RAW;
+            out = put_varint(out, zigzag(code[i]));
+            i++;
+            continue;
+        }
+
+        int op = code[i];
+
+        if (op == PSH && pooled(code[i + 1])) {
+
+            *out++ = PSH | POOLED;
+            out = put_varint(out, pool_index(&pool, code[i + 1]));
+        } else {
+
+            *out++ = (uint8_t) op;
+
+            for (int k = 1; k <= vm_operand_count[op]; k++)
+                out = put_varint(out, zigzag(code[i + k]));
+        }
+
+        i += 1 + vm_operand_count[op];
+    }
+
+
+    memcpy(buffer, "SVMB", 4);
+    buffer[4] = VM_BYTECODE_VERSION;
+    buffer[5] = 0;
+    buffer[6] = buffer[7] = 0;
+    put_u32(buffer + 8, pool.count);
+    put_u32(buffer + 12, (uint32_t) length);
+    put_u32(buffer + 16, (uint32_t) (out - start));
+
+    for (uint32_t c = 0; c < pool.count; c++)
+        put_u32(buffer + HEADER_SIZE + 4 * c, (uint32_t) pool.values[c]);
+
+    free(pool.values);
+    free(pool.slots);
+
+    *size = (size_t) (out - buffer);
+
+    uint8_t* shrunk = realloc(buffer, *size);
+
+    return shrunk != NULL ? shrunk : buffer;
+}
+
+
+
+
+// DECODING
+
+int vm_load_bytes(vm_t* vm, const uint8_t* data, size_t size) {
+
+    if (size < HEADER_SIZE || memcmp(data, "SVMB", 4) != 0 ||
+        data[4] != VM_BYTECODE_VERSION || data[5] != 0)
+        return -1;
+
+    uint32_t constants = get_u32(data + 8);
+    uint32_t words = get_u32(data + 12);
+    uint32_t code_size = get_u32(data + 16);
+
+    if (words > PROGRAM_MAX ||
+        HEADER_SIZE + 4 * (uint64_t) constants + code_size != size)
+        return -1;
+
+    int* program = vm_load_space(vm, (int) words);
+
+    if (program == NULL)
+        return -1;
+
+    const uint8_t* pool = data + HEADER_SIZE;
+    const uint8_t* in = pool + 4 * (size_t) constants;
+    const uint8_t* end = in + code_size;
+    uint32_t w = 0;
+
+    while (in < end) {
+
+        uint8_t op = *in++;
+        uint32_t u;
+
+        if (op < NUM_INSTRUCTIONS) {
+
+            int n = vm_operand_count[op];
+
+            if (w + n >= words)
+                break;
+
+            program[w++] = op;
+
+            while (n > 0 && (in = get_varint(in, end, &u)) != NULL) {
+
+                program[w++] = unzigzag(u);
+                n--;
+            }
+
+            if (n > 0)
+                break;
+
+        } else if (op == RAW) {
+
+            if (w == words || (in = get_varint(in, end, &u)) == NULL)
+                break;
+
+            program[w++] = unzigzag(u);
+
+        } else if (op == (PSH | POOLED)) {
+
+            if (w + 1 >= words || (in = get_varint(in, end, &u)) == NULL || u >= constants)
+                break;
+
+            program[w++] = PSH;
+            program[w++] = (int) get_u32(pool + 4 * (size_t) u);
+
+        } else {
+
+            break;
+        }
+    }
+
+    if (in != end || w != words) {
+
+        vm->running = false;
+        return -1;
+    }
+
+    vm_verify(vm, NULL, 0);
+
+    return 0;
+}
+
+
+
+
+// FILES
+
+int vm_load_file(vm_t* vm, const char* path) {
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size < HEADER_SIZE) {
+
+        close(fd);
+        return -1;
+    }
+
+    // Mapped, not read: the decoder streams straight out of the page
+    // cache without copying the file into a buffer first. Populating
+    // up front takes one fault for the file instead of one per page
+    void* data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return -1;
+
+    int result = vm_load_bytes(vm, data, (size_t) st.st_size);
+
+    munmap(data, (size_t) st.st_size);
+
+    return result;
+}
+
+
+int vm_save_file(const char* path, const int* code, int length) {
+
+    size_t size;
+    uint8_t* data = vm_encode(code, length, &size);
+
+    if (data == NULL)
+        return -1;
+
+    FILE* file = fopen(path, "wb");
+    int result = -1;
+
+    if (file != NULL) {
+
+        if (fwrite(data, 1, size, file) == size)
+            result = 0;
+
+        if (fclose(file) != 0)
+            result = -1;
+    }
+
+    free(data);
+
+    return result;
+}
@@ -0,0 +1,14 @@
+; Print 5, 4, 3, 2, 1
+;
+; There is no DUP: the counter lives in stack[0], and popping leaves
+; the word there, so SET SP, 0 brings it back after PRT or JZ.
+
+        PSH 5
+loop:   PRT
+        SET SP, 0
+        PSH 1
+        SUB
+        JZ done
+        SET SP, 0
+        JMP loop
+done:   HLT
@@ -0,0 +1,7 @@
+; The demo program: 5 + 6
+
+    PSH 5
+    PSH 6
+    ADD
+    PRT
+    HLT
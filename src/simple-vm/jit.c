@@ -0,0 +1,797 @@
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vm.h"
+
+
+
+
+#if defined(__x86_64__) && defined(__unix__)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+
+
+// RUNTIME
+//
+// What the compiled code calls for output, with the VM as the first
+// argument and the value as the second
+
+static void runtime_print(vm_t* vm, int v) {
+
+    if (vm->out != NULL)
+        fprintf(vm->out, "OUT %d\n", v);
+}
+
+
+static void runtime_pop(vm_t* vm, int v) {
+
+    if (vm->out != NULL)
+        fprintf(vm->out, "POP %d\n", v);
+}
+
+
+static void runtime_halt(vm_t* vm) {
+
+    if (vm->out != NULL)
+        fprintf(vm->out, "HLT\n");
+}
+
+
+
+
+// CODE BUFFER
+
+#define INSTRUCTION_MAX 128         // Bytes of machine code per VM instruction, at most
+
+typedef struct {
+
+    int at;                 // Offset of a rel32 to patch
+    int target;             // VM address it jumps to
+
+} fixup_t;
+
+
+typedef struct {
+
+    uint8_t* code;
+    int size;
+    int capacity;
+
+    fixup_t* fixups;
+    int fixup_count;
+
+} buffer_t;
+
+
+static bool reserve(buffer_t* b, int bytes) {
+
+    if (b->size + bytes <= b->capacity)
+        return true;
+
+    int capacity = b->capacity ? 2 * b->capacity : 4096;
+
+    while (capacity < b->size + bytes)
+        capacity *= 2;
+
+    uint8_t* code = realloc(b->code, capacity);
+
+    if (code == NULL)
+        return false;
+
+    b->code = code;
+    b->capacity = capacity;
+
+    return true;
+}
+
+
+static void emit(buffer_t* b, uint8_t byte) {
+
+    b->code[b->size++] = byte;
+}
+
+
+static void emit32(buffer_t* b, uint32_t u) {
+
+    for (int i = 0; i < 4; i++)
+        emit(b, (uint8_t) (u >> 8 * i));
+}
+
+
+static void emit64(buffer_t* b, uint64_t u) {
+
+    emit32(b, (uint32_t) u);
+    emit32(b, (uint32_t) (u >> 32));
+}
+
+
+
+
+// X86-64 ENCODING
+//
+// Only the handful of instructions the templates use. Stack slots are
+// 32-bit values, so everything but the calls works on 32-bit registers.
+
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12 };
+
+
+// A REX prefix if an extended register or 64 bits need one
+static void rex(buffer_t* b, bool wide, int reg, int rm) {
+
+    uint8_t prefix = 0x40 | (wide ? 8 : 0) | (reg & 8 ? 4 : 0) | (rm & 8 ? 1 : 0);
+
+    if (prefix != 0x40)
+        emit(b, prefix);
+}
+
+
+// ModRM for [base + disp]; RSP and R12 as a base need a SIB byte
+static void memory(buffer_t* b, int reg, int base, int disp) {
+
+    bool short_disp = disp >= -128 && disp <= 127;
+
+    emit(b, (short_disp ? 0x40 : 0x80) | (reg & 7) << 3 | (base & 7));
+
+    if ((base & 7) == RSP)
+        emit(b, 0x24);
+
+    if (short_disp)
+        emit(b, (uint8_t) disp);
+    else
+        emit32(b, (uint32_t) disp);
+}
+
+
+// opcode reg, [base + disp] or the other way round, by the opcode
+static void op_memory(buffer_t* b, uint8_t opcode, int reg, int base, int disp) {
+
+    rex(b, false, reg, base);
+    emit(b, opcode);
+    memory(b, reg, base, disp);
+}
+
+
+// opcode rm, reg between two registers
+static void op_register(buffer_t* b, uint8_t opcode, int reg, int rm) {
+
+    rex(b, false, reg, rm);
+    emit(b, opcode);
+    emit(b, 0xc0 | (reg & 7) << 3 | (rm & 7));
+}
+
+
+#define LOAD    0x8b        // mov reg, rm
+#define STORE   0x89        // mov rm, reg
+#define ADDR    0x01        // add rm, reg
+#define SUBR    0x29        // sub rm, reg
+#define TEST    0x85        // test rm, reg
+
+
+static void mov_immediate(buffer_t* b, int reg, int value) {
+
+    rex(b, false, 0, reg);
+    emit(b, 0xb8 + (reg & 7));
+    emit32(b, (uint32_t) value);
+}
+
+
+static void store_immediate(buffer_t* b, int base, int disp, int value) {
+
+    rex(b, false, 0, base);
+    emit(b, 0xc7);
+    memory(b, 0, base, disp);
+    emit32(b, (uint32_t) value);
+}
+
+
+// add (extension 0) or sub (5) reg, imm32
+static void arithmetic_immediate(buffer_t* b, int extension, int reg, int value) {
+
+    rex(b, false, 0, reg);
+    emit(b, 0x81);
+    emit(b, 0xc0 | extension << 3 | (reg & 7));
+    emit32(b, (uint32_t) value);
+}
+
+
+static void imul_register(buffer_t* b, int reg, int rm) {
+
+    rex(b, false, reg, rm);
+    emit(b, 0x0f);
+    emit(b, 0xaf);
+    emit(b, 0xc0 | (reg & 7) << 3 | (rm & 7));
+}
+
+
+static void imul_immediate(buffer_t* b, int reg, int value) {
+
+    rex(b, false, reg, reg);
+    emit(b, 0x69);
+    emit(b, 0xc0 | (reg & 7) << 3 | (reg & 7));
+    emit32(b, (uint32_t) value);
+}
+
+
+// cdq; idiv rm: eax / rm into eax
+static void divide(buffer_t* b, int rm) {
+
+    emit(b, 0x99);
+    rex(b, false, 0, rm);
+    emit(b, 0xf7);
+    emit(b, 0xc0 | 7 << 3 | (rm & 7));
+}
+
+
+// A jmp (0xe9) or je (0x0f 0x84) to a VM address, patched once every
+// address has its code
+static void jump(buffer_t* b, bool if_zero, int target) {
+
+    if (if_zero) {
+
+        emit(b, 0x0f);
+        emit(b, 0x84);
+    } else {
+
+        emit(b, 0xe9);
+    }
+
+    b->fixups[b->fixup_count++] = (fixup_t) { b->size, target };
+    emit32(b, 0);
+}
+
+
+// call target(vm, esi); the VM is in rbx
+static void call(buffer_t* b, void (*target)(void)) {
+
+    emit(b, 0x48);                  // mov rdi, rbx
+    emit(b, 0x89);
+    emit(b, 0xdf);
+
+    emit(b, 0x48);                  // mov rax, target
+    emit(b, 0xb8);
+    emit64(b, (uint64_t) (uintptr_t) target);
+
+    emit(b, 0xff);                  // call rax
+    emit(b, 0xd0);
+}
+
+
+static void prologue(buffer_t* b) {
+
+    emit(b, 0x55);                  // push rbp
+    emit(b, 0x53);                  // push rbx
+    emit(b, 0x41);                  // push r12: the stack is 16-byte aligned again
+    emit(b, 0x54);
+
+    emit(b, 0x48);                  // mov rbx, rdi
+    emit(b, 0x89);
+    emit(b, 0xfb);
+
+    emit(b, 0x4c);                  // lea r12, [rdi + stack]
+    emit(b, 0x8d);
+    emit(b, 0xa7);
+    emit32(b, (uint32_t) offsetof(vm_t, stack));
+}
+
+
+static void epilogue(buffer_t* b) {
+
+    emit(b, 0x41);                  // pop r12
+    emit(b, 0x5c);
+    emit(b, 0x5b);                  // pop rbx
+    emit(b, 0x5d);                  // pop rbp
+    emit(b, 0xc3);                  // ret
+}
+
+
+
+
+// STACK CACHE
+//
+// The verifier proved every address has one stack depth, so each VM
+// stack slot is a fixed place: stack[slot] at [r12 + 4 * slot], and a
+// register of its own among CACHE_REGISTERS. Every write goes to
+// memory (so the stack always holds exactly what the interpreter's
+// would), and within a block a slot's value also stays in its
+// register, or is known to be a constant, so it is not loaded again.
+// At a jump target the cache starts empty; a call empties the
+// registers, which are all caller-saved.
+
+#define CACHE_REGISTERS 7
+
+static const int cache_registers[CACHE_REGISTERS] = { RCX, RSI, RDI, R8, R9, R10, R11 };
+
+typedef enum { IN_MEMORY, IN_REGISTER, CONSTANT } place_t;
+
+
+typedef struct {
+
+    buffer_t b;
+
+    place_t place[STACK_SIZE];
+    int constant[STACK_SIZE];
+    int owner[CACHE_REGISTERS];         // Slot in each register, or -1
+    int touched;                        // Slots above this are all IN_MEMORY
+
+} jit_t;
+
+
+#define SLOT(slot)          (4 * (slot))
+#define REGISTER(reg)       ((int) offsetof(vm_t, registers) + 4 * (reg))
+
+
+static int cache_register(int slot) {
+
+    return cache_registers[slot % CACHE_REGISTERS];
+}
+
+
+static void forget(jit_t* j, bool constants) {
+
+    for (int slot = 0; slot < j->touched; slot++) {
+
+        if (j->place[slot] == IN_REGISTER || constants)
+            j->place[slot] = IN_MEMORY;
+    }
+
+    for (int r = 0; r < CACHE_REGISTERS; r++)
+        j->owner[r] = -1;
+
+    if (constants)
+        j->touched = 0;
+}
+
+
+static void touch(jit_t* j, int slot) {
+
+    if (slot >= j->touched)
+        j->touched = slot + 1;
+}
+
+
+// The slot's register, taken from whichever slot had it
+static int claim(jit_t* j, int slot) {
+
+    int r = slot % CACHE_REGISTERS;
+
+    if (j->owner[r] >= 0 && j->owner[r] != slot)
+        j->place[j->owner[r]] = IN_MEMORY;
+
+    j->owner[r] = slot;
+    j->place[slot] = IN_REGISTER;
+    touch(j, slot);
+
+    return cache_registers[r];
+}
+
+
+static int load(jit_t* j, int slot) {
+
+    if (j->place[slot] == IN_REGISTER)
+        return cache_register(slot);
+
+    bool known = j->place[slot] == CONSTANT;
+    int reg = claim(j, slot);
+
+    if (known)
+        mov_immediate(&j->b, reg, j->constant[slot]);
+    else
+        op_memory(&j->b, LOAD, reg, R12, SLOT(slot));
+
+    return reg;
+}
+
+
+// The slot's register now holds its new value
+static void store(jit_t* j, int slot) {
+
+    op_memory(&j->b, STORE, cache_register(slot), R12, SLOT(slot));
+}
+
+
+static void store_constant(jit_t* j, int slot, int value) {
+
+    int r = slot % CACHE_REGISTERS;
+
+    store_immediate(&j->b, R12, SLOT(slot), value);
+
+    if (j->owner[r] == slot)
+        j->owner[r] = -1;
+
+    j->place[slot] = CONSTANT;
+    j->constant[slot] = value;
+    touch(j, slot);
+}
+
+
+// Into esi, for a call
+static void argument(jit_t* j, int slot) {
+
+    if (j->place[slot] == IN_REGISTER)
+        op_register(&j->b, STORE, cache_register(slot), RSI);
+    else if (j->place[slot] == CONSTANT)
+        mov_immediate(&j->b, RSI, j->constant[slot]);
+    else
+        op_memory(&j->b, LOAD, RSI, R12, SLOT(slot));
+}
+
+
+
+
+// TEMPLATES
+
+// lower op= top, into lower; folded if both are known
+static void arithmetic(jit_t* j, int op, int lower, int top) {
+
+    buffer_t* b = &j->b;
+
+    if (j->place[lower] == CONSTANT && j->place[top] == CONSTANT) {
+
+        unsigned x = (unsigned) j->constant[lower];
+        unsigned y = (unsigned) j->constant[top];
+        int x_signed = j->constant[lower];
+        int y_signed = j->constant[top];
+
+        if (op == ADD || op == SUB || op == MUL) {
+
+            store_constant(j, lower, (int) (op == ADD ? x + y : op == SUB ? x - y : x * y));
+            return;
+        }
+
+        // DIV by 0 or INT_MIN / -1 is left to trap at run time
+        if (y_signed != 0 && !(x_signed == (int) 0x80000000u && y_signed == -1)) {
+
+            store_constant(j, lower, x_signed / y_signed);
+            return;
+        }
+    }
+
+    if (op == DIV) {
+
+        int divisor = load(j, top);
+
+        if (j->place[lower] == IN_REGISTER)
+            op_register(b, STORE, cache_register(lower), RAX);
+        else if (j->place[lower] == CONSTANT)
+            mov_immediate(b, RAX, j->constant[lower]);
+        else
+            op_memory(b, LOAD, RAX, R12, SLOT(lower));
+
+        divide(b, divisor);
+        op_register(b, STORE, RAX, claim(j, lower));
+        store(j, lower);
+        return;
+    }
+
+    int reg = load(j, lower);
+
+    if (j->place[top] == CONSTANT) {
+
+        int k = j->constant[top];
+
+        if (op == MUL)
+            imul_immediate(b, reg, k);
+        else
+            arithmetic_immediate(b, op == ADD ? 0 : 5, reg, k);
+    } else {
+
+        int other = load(j, top);
+
+        if (op == MUL)
+            imul_register(b, reg, other);
+        else
+            op_register(b, op == ADD ? ADDR : SUBR, other, reg);
+    }
+
+    store(j, lower);
+}
+
+
+// je target if the slot is 0
+static void branch_if_zero(jit_t* j, int slot, int target) {
+
+    buffer_t* b = &j->b;
+
+    if (j->place[slot] == CONSTANT) {
+
+        if (j->constant[slot] == 0)
+            jump(b, false, target);
+
+        return;
+    }
+
+    if (j->place[slot] == IN_REGISTER) {
+
+        int reg = cache_register(slot);
+
+        op_register(b, TEST, reg, reg);
+    } else {
+
+        rex(b, false, 0, R12);          // cmp dword [slot], 0
+        emit(b, 0x83);
+        memory(b, 7, R12, SLOT(slot));
+        emit(b, 0);
+    }
+
+    jump(b, true, target);
+}
+
+
+// One instruction at address a with the stack depth d on entry
+static void translate(jit_t* j, const int* code, int a, int d) {
+
+    buffer_t* b = &j->b;
+    int x = code[a + 1];
+    int y = code[a + 2];
+
+    switch (code[a]) {
+
+        case HLT:
+            store_immediate(b, RBX, REGISTER(IP), a + 1);
+            store_immediate(b, RBX, REGISTER(SP), d - 1);
+
+            rex(b, false, 0, RBX);      // mov byte [running], 0
+            emit(b, 0xc6);
+            memory(b, 0, RBX, (int) offsetof(vm_t, running));
+            emit(b, 0);
+
+            call(b, (void (*)(void)) runtime_halt);
+            epilogue(b);
+            break;
+
+        case PSH:
+            store_constant(j, d, x);
+            break;
+
+        case POP:
+        case PRT:
+            argument(j, d - 1);
+            call(b, code[a] == PRT ? (void (*)(void)) runtime_print : (void (*)(void)) runtime_pop);
+            forget(j, false);
+            break;
+
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+            arithmetic(j, code[a], d - 2, d - 1);
+            break;
+
+        case SET:
+            if (x == IP)
+                jump(b, false, y);
+            else if (x != SP)           // SET SP only moves the depth the next address has
+                store_immediate(b, RBX, REGISTER(x), y);
+            break;
+
+        case MOV:
+            if (y == IP)
+                store_immediate(b, RBX, REGISTER(x), a + 3);
+            else if (y == SP)
+                store_immediate(b, RBX, REGISTER(x), d - 1);
+            else {
+
+                op_memory(b, LOAD, RAX, RBX, REGISTER(y));
+                op_memory(b, STORE, RAX, RBX, REGISTER(x));
+            }
+            break;
+
+        case JMP:
+            jump(b, false, x);
+            break;
+
+        case JZ:
+            branch_if_zero(j, d - 1, x);
+            break;
+
+        case ADDI:
+        case SUBI:
+            store_constant(j, d, x);
+            arithmetic(j, code[a] == ADDI ? ADD : SUB, d - 1, d);
+            break;
+
+        case PSH2:
+            store_constant(j, d, x);
+            store_constant(j, d + 1, y);
+            break;
+
+        case JEQI:
+            store_constant(j, d, x);
+            arithmetic(j, SUB, d - 1, d);
+            branch_if_zero(j, d - 1, y);
+            break;
+    }
+}
+
+
+static bool ends_block(const int* code, int a) {
+
+    return code[a] == HLT || code[a] == JMP || (code[a] == SET && code[a + 1] == IP);
+}
+
+
+
+
+// COMPILER
+
+int vm_jit_compile(vm_t* vm) {
+
+    vm_jit_release(vm);
+
+    int size = vm->program_size;
+    const int* code = vm->program;
+
+    if (!vm->verified)
+        return -1;
+
+    jit_t* j = calloc(1, sizeof(jit_t));
+    int* depth = malloc(size * sizeof(int));
+    bool* target = calloc(size, sizeof(bool));
+    int* native = malloc(size * sizeof(int));       // Offset of each address's code
+    int result = -1;
+
+    if (j == NULL || depth == NULL || target == NULL || native == NULL ||
+        vm_stack_depths(vm, depth) != 0)
+        goto done;
+
+    buffer_t* b = &j->b;
+    int instructions = 0;
+
+    for (int a = 0; a < size; a++) {
+
+        if (depth[a] < 0)
+            continue;
+
+        int op = code[a];
+
+        if (op == JMP || op == JZ)
+            target[code[a + 1]] = true;
+        else if (op == JEQI)
+            target[code[a + 2]] = true;
+        else if (op == SET && code[a + 1] == IP)
+            target[code[a + 2]] = true;
+
+        instructions++;
+    }
+
+    // A jump each at most, and one more where the next address is not
+    // the one control falls through to
+    b->fixups = malloc(2 * (size_t) instructions * sizeof(fixup_t));
+
+    if (b->fixups == NULL || !reserve(b, 64))
+        goto done;
+
+    prologue(b);
+
+    for (int r = 0; r < CACHE_REGISTERS; r++)
+        j->owner[r] = -1;
+
+    int next = 0;                       // Where the last instruction falls through to, or -1
+
+    for (int a = 0; a < size; a++) {
+
+        if (depth[a] < 0)
+            continue;
+
+        if (!reserve(b, INSTRUCTION_MAX))
+            goto done;
+
+        // Instructions that overlap each other's operands: the one
+        // before falls through to a later address, which is entered
+        // from two places now
+        if (next >= 0 && next != a) {
+
+            jump(b, false, next);
+            target[next] = true;
+        }
+
+        if (target[a] || next != a)
+            forget(j, true);
+
+        native[a] = b->size;
+        translate(j, code, a, depth[a]);
+
+        next = ends_block(code, a) ? -1 : a + 1 + vm_operand_count[code[a]];
+    }
+
+    for (int f = 0; f < b->fixup_count; f++) {
+
+        int at = b->fixups[f].at;
+        uint32_t rel = (uint32_t) (native[b->fixups[f].target] - (at + 4));
+
+        memcpy(b->code + at, &rel, 4);
+    }
+
+
+    // Written, then made executable: never both at once
+    long page = sysconf(_SC_PAGESIZE);
+    size_t mapped = ((size_t) b->size + page - 1) / page * page;
+    void* text = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (text == MAP_FAILED)
+        goto done;
+
+    memcpy(text, b->code, b->size);
+
+    if (mprotect(text, mapped, PROT_READ | PROT_EXEC) != 0) {
+
+        munmap(text, mapped);
+        goto done;
+    }
+
+    vm->jit = text;
+    vm->jit_size = mapped;
+    result = 0;
+
+done:
+    if (j != NULL) {
+
+        free(j->b.code);
+        free(j->b.fixups);
+    }
+
+    free(j);
+    free(depth);
+    free(target);
+    free(native);
+
+    return result;
+}
+
+
+void vm_jit_release(vm_t* vm) {
+
+    if (vm->jit != NULL)
+        munmap(vm->jit, vm->jit_size);
+
+    vm->jit = NULL;
+    vm->jit_size = 0;
+}
+
+
+void vm_run_jit(vm_t* vm) {
+
+    // Compiled for a run from the start only
+    if (vm->jit == NULL || vm->registers[IP] != 0 || vm->registers[SP] != -1) {
+
+        vm_run_verified(vm);
+        return;
+    }
+
+    if (!vm->running)
+        return;
+
+    void (*entry)(vm_t*) = (void (*)(vm_t*)) (uintptr_t) vm->jit;
+
+    entry(vm);
+}
+
+#else
+
+int vm_jit_compile(vm_t* vm) {
+
+    vm_jit_release(vm);
+
+    return -1;
+}
+
+
+void vm_jit_release(vm_t* vm) {
+
+    vm->jit = NULL;
+    vm->jit_size = 0;
+}
+
+
+void vm_run_jit(vm_t* vm) {
+
+    vm_run_verified(vm);
+}
+
+#endif
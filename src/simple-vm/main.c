@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "vm.h"
+
+
+
+
+// PROGRAM
+
+int demo[] = {
+
+    PSH, 5,
+    PSH, 6,
+    ADD,
+    PRT,
+    HLT
+
+};
+
+
+
+
+// MAIN LOOP
+//
+// vm [--switch | --jit] [program.svm]
+//
+// Runs a bytecode file, or the demo, on the threaded loop; --switch
+// uses the reference switch loop instead, --jit compiles it first
+
+
+int main(int argc, char** argv) {
+
+    vm_t* vm = vm_create();
+
+    if (vm == NULL)
+        return 1;
+
+    bool use_switch = argc > 1 && strcmp(argv[1], "--switch") == 0;
+    bool use_jit = argc > 1 && strcmp(argv[1], "--jit") == 0;
+    int first = 1 + (use_switch || use_jit);
+    const char* path = argc > first ? argv[first] : NULL;
+
+    if (path == NULL)
+        vm_load(vm, demo, sizeof(demo) / sizeof(demo[0]));
+    else if (vm_load_file(vm, path) != 0) {
+
+        fprintf(stderr, "%s: not a version %d bytecode file\n", path, VM_BYTECODE_VERSION);
+        vm_destroy(vm);
+        return 1;
+    }
+
+    if (use_switch)
+        vm_run_switch(vm);
+    else if (use_jit && vm_jit_compile(vm) == 0)
+        vm_run_jit(vm);
+    else
+        vm_run_threaded(vm);
+
+    vm_destroy(vm);
+
+    return 0;
+}
@@ -0,0 +1,508 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vm.h"
+
+
+
+
+// PROFILE
+
+uint64_t vm_profile(vm_t* vm, uint64_t* counts, uint64_t max_steps) {
+
+    memset(counts, 0, vm->program_size * sizeof(uint64_t));
+
+    vm_t* scratch = vm_create();
+
+    if (scratch == NULL)
+        return 0;
+
+    scratch->out = NULL;
+
+    if (vm_load(scratch, vm->program, vm->program_size) != 0) {
+
+        vm_destroy(scratch);
+        return 0;
+    }
+
+    uint64_t total = 0;
+
+    while (scratch->running && (max_steps == 0 || total < max_steps)) {
+
+        int ip = scratch->registers[IP];
+
+        if (ip < 0 || ip >= scratch->program_size)
+            break;
+
+        counts[ip]++;
+        total++;
+
+        int instr = fetch(scratch);
+
+        eval(scratch, instr);
+    }
+
+    vm_destroy(scratch);
+
+    return total;
+}
+
+
+
+
+// INSTRUCTION LIST
+//
+// The pass works on the reachable instructions in address order, one
+// item each. An item folded or fused from several keeps the address,
+// depth and leader flag of the first. Control only enters a sequence
+// at its first item if none of the others is a leader (a jump target),
+// so only such sequences are rewritten. An item removed outright
+// becomes a NOP of no words if it is a leader, so jumps to it land on
+// whatever follows.
+
+#define NOP -1
+
+typedef struct {
+
+    int op;
+    int operand[2];
+
+    int address;        // In the original program
+    int depth;          // Stack depth on entry
+    bool leader;
+
+} item_t;
+
+
+typedef struct {
+
+    item_t* items;
+    int count;
+
+    int exposed;        // Slots SET SP can bring back: at and above, dead words may differ
+    int folded;
+    int jumps_removed;
+
+} list_t;
+
+
+static int words(const item_t* item) {
+
+    return item->op == NOP ? 0 : 1 + vm_operand_count[item->op];
+}
+
+
+// Where a control transfer goes, or NULL
+static int* target(item_t* item) {
+
+    switch (item->op) {
+
+        case JMP:
+        case JZ:    return &item->operand[0];
+        case JEQI:  return &item->operand[1];
+        case SET:   return item->operand[0] == IP ? &item->operand[1] : NULL;
+        default:    return NULL;
+    }
+}
+
+
+// Nothing falls through from it
+static bool ends_block(const item_t* item) {
+
+    return item->op == JMP || item->op == HLT || (item->op == SET && item->operand[0] == IP);
+}
+
+
+// Replace the last n items with one, or with nothing if it is a NOP
+// and no jump lands on it
+static void replace(list_t* list, int n, int op, int x, int y) {
+
+    item_t* first = &list->items[list->count - n];
+
+    first->op = op;
+    first->operand[0] = x;
+    first->operand[1] = y;
+
+    list->count -= n - 1;
+
+    if (op == NOP && !first->leader)
+        list->count--;
+}
+
+
+
+
+// CONSTANT FOLDING
+//
+// PSH a; PSH b; op becomes PSH (a op b), PSH k; JZ becomes JMP or
+// nothing, and a JMP to what follows it goes. Folding leaves fewer
+// words written above the top of the stack, so it is only done where
+// no SET SP can bring those words back.
+
+static bool fold_arithmetic(int op, int a, int b, int* result) {
+
+    unsigned x = (unsigned) a;
+    unsigned y = (unsigned) b;
+
+    switch (op) {
+
+        case ADD:   *result = (int) (x + y); return true;
+        case SUB:   *result = (int) (x - y); return true;
+        case MUL:   *result = (int) (x * y); return true;
+
+        case DIV:
+            if (b == 0 || (a == INT_MIN && b == -1))
+                return false;               // Left for the run to trap on
+
+            *result = a / b;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+
+// Fold at the end of the list until nothing more folds
+static void fold(list_t* list) {
+
+    for (;;) {
+
+        item_t* items = list->items;
+        int n = list->count;
+        int result;
+
+        if (n >= 3 && items[n - 3].op == PSH && items[n - 2].op == PSH &&
+            !items[n - 2].leader && !items[n - 1].leader &&
+            items[n - 3].depth + 1 >= list->exposed &&
+            fold_arithmetic(items[n - 1].op, items[n - 3].operand[0], items[n - 2].operand[0], &result)) {
+
+            replace(list, 3, PSH, result, 0);
+            list->folded++;
+            continue;
+        }
+
+        if (n >= 2 && items[n - 2].op == PSH && items[n - 1].op == JZ && !items[n - 1].leader &&
+            items[n - 2].depth >= list->exposed) {
+
+            if (items[n - 2].operand[0] == 0)
+                replace(list, 2, JMP, items[n - 1].operand[0], 0);
+            else
+                replace(list, 2, NOP, 0, 0);
+
+            list->folded++;
+            continue;
+        }
+
+        // The JMP is kept in place of the item arriving after it
+        if (n >= 2 && items[n - 2].op == JMP && items[n - 2].operand[0] == items[n - 1].address) {
+
+            item_t next = items[n - 1];
+
+            list->count--;
+            replace(list, 1, NOP, 0, 0);
+            list->items[list->count++] = next;
+            list->jumps_removed++;
+            continue;
+        }
+
+        return;
+    }
+}
+
+
+
+
+// SUPERINSTRUCTIONS
+
+typedef struct {
+
+    int op;
+    int length;
+    int sequence[3];
+
+} pattern_t;
+
+
+// Longest first, so PSH k; SUB; JZ is not taken for a SUBI
+static const pattern_t patterns[] = {
+
+    { JEQI, 3, { PSH, SUB, JZ } },
+    { ADDI, 2, { PSH, ADD } },
+    { SUBI, 2, { PSH, SUB } },
+    { PSH2, 2, { PSH, PSH } },
+};
+
+#define NUM_PATTERNS (int) (sizeof(patterns) / sizeof(patterns[0]))
+
+
+static bool matches(const list_t* list, int i, const pattern_t* p) {
+
+    if (i + p->length > list->count)
+        return false;
+
+    for (int k = 0; k < p->length; k++) {
+
+        const item_t* item = &list->items[i + k];
+
+        if (item->op != p->sequence[k] || (k > 0 && item->leader))
+            return false;
+    }
+
+    return true;
+}
+
+
+// Dispatches the pattern would save over a run, if every match were
+// fused
+static uint64_t savings(const list_t* list, const pattern_t* p, const uint64_t* profile) {
+
+    uint64_t saved = 0;
+
+    for (int i = 0; i < list->count; i++) {
+
+        if (matches(list, i, p)) {
+
+            saved += profile[list->items[i].address] * (uint64_t) (p->length - 1);
+            i += p->length - 1;
+        }
+    }
+
+    return saved;
+}
+
+
+static void fuse(list_t* list, const bool* enabled, int* fused) {
+
+    int n = 0;
+
+    for (int i = 0; i < list->count; ) {
+
+        item_t item = list->items[i];
+        int length = 1;
+
+        for (int p = 0; p < NUM_PATTERNS; p++) {
+
+            if (!enabled[p] || !matches(list, i, &patterns[p]))
+                continue;
+
+            item.op = patterns[p].op;
+
+            if (item.op == PSH2)
+                item.operand[1] = list->items[i + 1].operand[0];
+            else if (item.op == JEQI)
+                item.operand[1] = list->items[i + 2].operand[0];
+
+            length = patterns[p].length;
+            fused[item.op]++;
+            break;
+        }
+
+        list->items[n++] = item;
+        i += length;
+    }
+
+    list->count = n;
+}
+
+
+
+
+// PASS
+
+int vm_optimize(vm_t* vm, const uint64_t* profile, vm_optimize_stats_t* stats) {
+
+    vm_optimize_stats_t none;
+
+    if (stats == NULL)
+        stats = &none;
+
+    memset(stats, 0, sizeof(*stats));
+
+    int size = vm->program_size;
+
+    stats->words_before = size;
+    stats->words_after = size;
+
+    if (!vm->verified)
+        return -1;
+
+    int* depth = malloc(size * sizeof(int));
+    int* owner = malloc(size * sizeof(int));        // Instruction whose word it is, or -1
+    int* map = malloc(size * sizeof(int));          // Old address to new
+    int* original = malloc((size + PROGRAM_PADDING) * sizeof(int));
+    list_t list = { malloc(size * sizeof(item_t)), 0, 0, 0, 0 };
+    int* code = NULL;
+    int result = -1;
+
+    if (depth == NULL || owner == NULL || map == NULL || original == NULL || list.items == NULL)
+        goto done;
+
+    memcpy(original, vm->program, (size + PROGRAM_PADDING) * sizeof(int));
+
+    if (vm_stack_depths(vm, depth) != 0)
+        goto done;
+
+
+    // Reachable instructions must not overlap, and nothing may read IP:
+    // its values change once the code moves
+    for (int a = 0; a < size; a++)
+        owner[a] = -1;
+
+    int reachable = 0;
+
+    for (int a = 0; a < size; a++) {
+
+        if (depth[a] < 0)
+            continue;
+
+        int op = original[a];
+
+        for (int k = 0; k <= vm_operand_count[op]; k++) {
+
+            if (owner[a + k] >= 0 || (k > 0 && depth[a + k] >= 0))
+                goto done;
+
+            owner[a + k] = a;
+        }
+
+        if (op == MOV && original[a + 2] == IP)
+            goto done;
+
+        if (op == SET && original[a + 1] == SP && original[a + 2] + 1 > list.exposed)
+            list.exposed = original[a + 2] + 1;
+
+        reachable += 1 + vm_operand_count[op];
+    }
+
+    stats->dead_words = size - reachable;
+
+
+    // Leaders: the start and every jump target
+    bool* leader = calloc(size, sizeof(bool));
+
+    if (leader == NULL)
+        goto done;
+
+    leader[0] = true;
+
+    for (int a = 0; a < size; a++) {
+
+        if (depth[a] < 0)
+            continue;
+
+        item_t item = { original[a], { original[a + 1], original[a + 2] }, a, depth[a], false };
+        int* to = target(&item);
+
+        if (to != NULL)
+            leader[*to] = true;
+    }
+
+
+    // Fold while the list is built, so folded constants fold again.
+    // Past a JMP or HLT, only a jump target is reached again; folding
+    // a branch can turn what the verifier saw as reachable dead too
+    for (int a = 0; a < size; a++) {
+
+        if (depth[a] < 0)
+            continue;
+
+        item_t item = { original[a], { original[a + 1], original[a + 2] }, a, depth[a], leader[a] };
+
+        if (vm_operand_count[item.op] < 2)
+            item.operand[1] = 0;
+
+        if (vm_operand_count[item.op] < 1)
+            item.operand[0] = 0;
+
+        if (!item.leader && list.count > 0 && ends_block(&list.items[list.count - 1])) {
+
+            stats->dead_words += words(&item);
+            continue;
+        }
+
+        list.items[list.count++] = item;
+        fold(&list);
+    }
+
+    free(leader);
+
+    stats->folded = list.folded;
+    stats->jumps_removed = list.jumps_removed;
+
+
+    // Superinstructions: those saving at least 1% of the profiled
+    // dispatches, or all of them without a profile
+    uint64_t total = 0;
+    bool enabled[NUM_PATTERNS];
+
+    if (profile != NULL) {
+
+        for (int a = 0; a < size; a++)
+            total += profile[a];
+    }
+
+    for (int p = 0; p < NUM_PATTERNS; p++) {
+
+        uint64_t saved = profile != NULL ? savings(&list, &patterns[p], profile) : 0;
+
+        enabled[p] = profile == NULL || (saved > 0 && saved * 100 >= total);
+    }
+
+    fuse(&list, enabled, stats->fused);
+
+
+    // Lay out, then point every jump at the new addresses
+    int length = 0;
+
+    for (int i = 0; i < list.count; i++) {
+
+        map[list.items[i].address] = length;
+        length += words(&list.items[i]);
+    }
+
+    code = malloc((length > 0 ? length : 1) * sizeof(int));
+
+    if (code == NULL)
+        goto done;
+
+    int w = 0;
+
+    for (int i = 0; i < list.count; i++) {
+
+        item_t* item = &list.items[i];
+        int* to = target(item);
+
+        if (item->op == NOP)
+            continue;
+
+        if (to != NULL)
+            *to = map[*to];
+
+        code[w++] = item->op;
+
+        for (int k = 0; k < vm_operand_count[item->op]; k++)
+            code[w++] = item->operand[k];
+    }
+
+    // The rewritten program must verify as the original did
+    if (vm_load(vm, code, length) != 0 || !vm->verified) {
+
+        vm_load(vm, original, size);
+        goto done;
+    }
+
+    stats->words_after = length;
+    result = 0;
+
+done:
+    free(depth);
+    free(owner);
+    free(map);
+    free(original);
+    free(list.items);
+    free(code);
+
+    return result;
+}
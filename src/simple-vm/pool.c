@@ -0,0 +1,177 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "vm.h"
+
+#define CLAIM_BATCH 8           // VMs a thread takes from the batch at a time
+
+
+
+
+// POOL
+
+struct vm_pool {
+
+    pthread_t* workers;
+    int worker_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;       // A new batch, or stopping
+    pthread_cond_t finished;    // The last worker left the batch
+
+    vm_t** vms;
+    int count;
+    int next;                   // Next unclaimed VM, taken with an atomic add
+    int busy;                   // Workers still on the batch
+    unsigned generation;        // Bumped for every batch
+
+    bool stopping;
+};
+
+
+
+
+// RUNNING A BATCH
+
+static void run_claimed(vm_pool_t* pool) {
+
+    while (1) {
+
+        int first = __atomic_fetch_add(&pool->next, CLAIM_BATCH, __ATOMIC_RELAXED);
+
+        if (first >= pool->count)
+            return;
+
+        int last = first + CLAIM_BATCH < pool->count ? first + CLAIM_BATCH : pool->count;
+
+        for (int i = first; i < last; i++)
+            vm_run(pool->vms[i]);
+    }
+}
+
+
+static void* worker(void* param) {
+
+    vm_pool_t* pool = param;
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (1) {
+
+        while (pool->generation == seen && !pool->stopping)
+            pthread_cond_wait(&pool->start, &pool->lock);
+
+        if (pool->stopping)
+            break;
+
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_claimed(pool);
+
+        pthread_mutex_lock(&pool->lock);
+
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->finished);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+
+void vm_pool_run(vm_pool_t* pool, vm_t** vms, int count) {
+
+    pthread_mutex_lock(&pool->lock);
+
+    pool->vms = vms;
+    pool->count = count;
+    pool->next = 0;
+    pool->busy = pool->worker_count;
+    pool->generation++;
+
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_claimed(pool);
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (pool->busy > 0)
+        pthread_cond_wait(&pool->finished, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+
+
+// LIFETIME
+
+vm_pool_t* vm_pool_create(int threads) {
+
+    if (threads <= 0)
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (threads <= 0)
+        threads = 1;
+
+    vm_pool_t* pool = calloc(1, sizeof(vm_pool_t));
+
+    if (pool == NULL)
+        return NULL;
+
+    pool->workers = calloc(threads, sizeof(pthread_t));
+
+    if (pool->workers == NULL) {
+
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+
+    for (int i = 0; i < threads - 1; i++) {
+
+        if (pthread_create(&pool->workers[i], NULL, worker, pool) != 0) {
+
+            vm_pool_destroy(pool);
+            return NULL;
+        }
+
+        pool->worker_count++;
+    }
+
+    return pool;
+}
+
+
+int vm_pool_threads(vm_pool_t* pool) {
+
+    return pool->worker_count + 1;
+}
+
+
+void vm_pool_destroy(vm_pool_t* pool) {
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->worker_count; i++)
+        pthread_join(pool->workers[i], NULL);
+
+    pthread_cond_destroy(&pool->finished);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+
+    free(pool->workers);
+    free(pool);
+}
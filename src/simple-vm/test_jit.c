@@ -0,0 +1,467 @@
+/*
+ * JIT Differential Test Program
+ *
+ * Runs every program twice, once on the reference switch loop and once
+ * compiled by the JIT, and checks that both print the same output and
+ * leave the same registers, the same flags and the same words in the
+ * whole stack - dead slots above the top included. The programs are
+ * hand-written ones covering every instruction, the same programs after
+ * vm_optimize(), and many random programs that pass the verifier.
+ *
+ * Build and run:  make test_jit && ./test_jit
+ */
+
+#define _GNU_SOURCE
+#include "vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RANDOM_PROGRAMS 100000
+#define RANDOM_WORDS 48
+#define STEP_LIMIT 10000                 // Random programs still running after this are skipped
+
+typedef struct {
+    const char* label;
+    const char* source;
+} test_program_t;
+
+static const test_program_t programs[] = {
+    { "demo", "PSH 5\nPSH 6\nADD\nPRT\nHLT\n" },
+    { "countdown",
+      "        PSH 5\n"
+      "loop:   PRT\n"
+      "        SET SP, 0\n"
+      "        PSH 1\n"
+      "        SUB\n"
+      "        JZ done\n"
+      "        SET SP, 0\n"
+      "        JMP loop\n"
+      "done:   HLT\n" },
+    { "arithmetic",
+      "PSH 7\nPSH 3\nMUL\nPSH -5\nADD\nPSH 4\nDIV\nPRT\n"
+      "PSH -7\nPSH 2\nDIV\nPOP\n"
+      "PSH 2147483647\nPSH 1\nADD\nPRT\n"
+      "PSH 65536\nPSH 65536\nMUL\nPRT\n"
+      "PSH 3\nPSH 10\nSUB\nHLT\n" },
+    { "arithmetic on loaded values",
+      "        PSH 9\n"
+      "        PSH 4\n"
+      "        SET SP, -1\n"             // Both back from memory, not constants
+      "        SET IP, next\n"
+      "next:   SET SP, 1\n"
+      "        MUL\n"
+      "        SET SP, 1\n"
+      "        SUB\n"
+      "        SET SP, 1\n"
+      "        DIV\n"
+      "        PRT\n"
+      "        HLT\n" },
+    { "registers",
+      "SET A, 3\nSET B, -4\nMOV C, A\nMOV D, B\nMOV A, IP\nMOV B, SP\n"
+      "PSH 1\nPSH 2\nMOV C, SP\nPRT\nPRT\nHLT\n" },
+    { "jumps",
+      "        JMP start\n"
+      "        HLT\n"
+      "start:  PSH 0\n"
+      "        JZ taken\n"
+      "        PSH 100\n"
+      "        PRT\n"
+      "taken:  PSH 1\n"
+      "        JZ never\n"
+      "        SET IP, far\n"
+      "never:  PSH 200\n"
+      "        PRT\n"
+      "far:    PSH 300\n"
+      "        PRT\n"
+      "        HLT\n" },
+    { "stale slots",
+      "PSH 1\nPSH 2\nPSH 3\nSET SP, -1\nPSH 9\nSET SP, 2\nADD\nADD\nPRT\nSET SP, 0\nPOP\nHLT\n" },
+    { "superinstructions",
+      "        PSH2 10, 3\n"
+      "        ADD\n"
+      "        ADDI 5\n"
+      "        SUBI -2\n"
+      "        PRT\n"
+      "        PSH 4\n"
+      "loop:   JEQI 0, done\n"
+      "        SET SP, 0\n"
+      "        PSH 1\n"
+      "        SUB\n"
+      "        JMP loop\n"
+      "done:   SET SP, 0\n"
+      "        PRT\n"
+      "        HLT\n" },
+    { "overlapping instructions",
+      "        PSH 42\n"
+      "        PSH 0\n"
+      "        JZ 7\n"                   // Taken, into the operand of the PSH below
+      "        PSH 1\n"                  // 7: read as PSH, with the HLT as its operand
+      "        HLT\n"
+      "        PRT\n"
+      "        HLT\n" },
+    { "accumulate",
+      "        PSH 100\n"
+      "        PSH 0\n"
+      "        PSH 0\n"
+      "loop:   PSH 3\n"
+      "        ADD\n"
+      "        SET SP, 0\n"
+      "        PSH 1\n"
+      "        SUB\n"
+      "        JZ done\n"
+      "        SET SP, 2\n"
+      "        JMP loop\n"
+      "done:   SET SP, 2\n"
+      "        PRT\n"
+      "        HLT\n" },
+};
+
+typedef struct {
+    char* output;
+    int registers[NUM_REGS];
+    int stack[STACK_SIZE];
+    bool running;
+} result_t;
+
+static int failures;
+
+static void capture(vm_t* vm, void (*run)(vm_t*), result_t* result) {
+    size_t size;
+    FILE* out = open_memstream(&result->output, &size);
+
+    vm->out = out;
+    run(vm);
+    fclose(out);
+    vm->out = NULL;
+
+    memcpy(result->registers, vm->registers, sizeof(vm->registers));
+    memcpy(result->stack, vm->stack, sizeof(vm->stack));
+    result->running = vm->running;
+}
+
+static void run_compiled(vm_t* vm) {
+    if (vm_jit_compile(vm) != 0) {
+        printf("❌ vm_jit_compile failed\n");
+        failures++;
+        return;
+    }
+    vm_run_jit(vm);
+}
+
+// Both runs on fresh VMs, so the dead slots start out the same
+static bool differ(const int* code, int length, const char* label) {
+    result_t expected, actual;
+    vm_t* reference = vm_create();
+    vm_t* compiled = vm_create();
+
+    vm_load(reference, code, length);
+    vm_load(compiled, code, length);
+    capture(reference, vm_run_switch, &expected);
+    capture(compiled, run_compiled, &actual);
+
+    bool same = strcmp(expected.output, actual.output) == 0 &&
+                memcmp(expected.registers, actual.registers, sizeof(expected.registers)) == 0 &&
+                memcmp(expected.stack, actual.stack, sizeof(expected.stack)) == 0 &&
+                expected.running == actual.running;
+
+    if (!same && label != NULL) {
+        printf("❌ %s: interpreter and JIT disagree\n", label);
+        printf("   interpreter: IP=%d SP=%d A=%d B=%d C=%d D=%d output:\n%s", expected.registers[IP],
+               expected.registers[SP], expected.registers[A], expected.registers[B],
+               expected.registers[C], expected.registers[D], expected.output);
+        printf("   JIT:         IP=%d SP=%d A=%d B=%d C=%d D=%d output:\n%s", actual.registers[IP],
+               actual.registers[SP], actual.registers[A], actual.registers[B],
+               actual.registers[C], actual.registers[D], actual.output);
+    }
+
+    free(expected.output);
+    free(actual.output);
+    vm_destroy(reference);
+    vm_destroy(compiled);
+    return !same;
+}
+
+static int* assemble(const test_program_t* p, int* length) {
+    char error[128];
+    int* code;
+
+    if (vm_assemble(p->source, &code, length, error, sizeof(error)) != 0) {
+        printf("❌ %s: %s\n", p->label, error);
+        exit(1);
+    }
+    return code;
+}
+
+/*
+ * TEST SCENARIOS
+ */
+
+void test_examples(void) {
+    printf("\n🧪 TEST 1: Hand-Written Programs\n");
+    printf("================================\n");
+
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+        int length;
+        int* code = assemble(&programs[i], &length);
+
+        if (differ(code, length, programs[i].label)) {
+            failures++;
+        } else {
+            printf("✅ %s\n", programs[i].label);
+        }
+        free(code);
+    }
+
+    // As deep as the stack goes, then back down
+    int deep[2 * STACK_SIZE + STACK_SIZE + 2];
+    int n = 0;
+    for (int i = 0; i < STACK_SIZE; i++) {
+        deep[n++] = PSH;
+        deep[n++] = i * 3 - 100;
+    }
+    for (int i = 0; i < STACK_SIZE - 1; i++) {
+        deep[n++] = i % 2 ? ADD : SUB;
+    }
+    deep[n++] = PRT;
+    deep[n++] = HLT;
+    if (differ(deep, n, "full stack")) {
+        failures++;
+    } else {
+        printf("✅ full stack\n");
+    }
+}
+
+void test_optimized(void) {
+    printf("\n🧪 TEST 2: Optimized Programs\n");
+    printf("=============================\n");
+
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+        int length;
+        int* code = assemble(&programs[i], &length);
+        vm_t* vm = vm_create();
+        vm_optimize_stats_t stats;
+
+        vm_load(vm, code, length);
+        if (vm_optimize(vm, NULL, &stats) != 0) {
+            printf("   %s: left as it is\n", programs[i].label);
+        } else if (differ(vm->program, stats.words_after, programs[i].label)) {
+            failures++;
+        } else {
+            printf("✅ %s (%d words, %d folded)\n", programs[i].label, stats.words_after, stats.folded);
+        }
+        vm_destroy(vm);
+        free(code);
+    }
+}
+
+// Random words biased towards instructions with small operands. DIV is
+// left out, and so is its opcode as an operand (a jump may land on an
+// operand): a division by zero stops both sides with SIGFPE.
+static int random_program(int* code) {
+    static const int ops[] = { PSH, PSH, PSH, POP, ADD, ADD, SUB, MUL, SET, MOV, JMP, JZ, JZ,
+                               PRT, PRT, HLT, ADDI, SUBI, PSH2, JEQI };
+    int length = 4 + rand() % (RANDOM_WORDS - 4);
+    int n = 0;
+
+    while (n < length - 1) {
+        int op = ops[rand() % (int)(sizeof(ops) / sizeof(ops[0]))];
+
+        code[n++] = op;
+        for (int k = 0; k < vm_operand_count[op] && n < length - 1; k++) {
+            int v;
+            if (op == SET && k == 0) {
+                v = rand() % NUM_REGS;
+            } else if (op == SET && code[n - 1] == SP) {
+                v = rand() % 4 - 1;
+            } else if (op == MOV) {
+                v = rand() % NUM_REGS;
+            } else if (op == JMP || op == JZ || (op == SET && code[n - 1] == IP) ||
+                       (op == JEQI && k == 1)) {
+                v = rand() % length;
+            } else {
+                v = rand() % 9 - 3;
+            }
+            code[n++] = v == DIV ? DIV + 1 : v;
+        }
+    }
+    code[n++] = HLT;
+    return n;
+}
+
+// Verified, and stops within STEP_LIMIT on the reference loop
+static bool usable(const int* code, int length) {
+    vm_t* vm = vm_create();
+    vm->out = NULL;
+    vm_load(vm, code, length);
+
+    bool verified = vm->verified;
+    for (int steps = 0; verified && vm->running && steps < STEP_LIMIT; steps++) {
+        eval(vm, fetch(vm));
+    }
+
+    bool result = verified && !vm->running;
+    vm_destroy(vm);
+    return result;
+}
+
+void test_random(void) {
+    printf("\n🧪 TEST 3: Random Verified Programs\n");
+    printf("===================================\n");
+
+    int code[RANDOM_WORDS];
+    int tested = 0;
+    int optimized = 0;
+    int differences = 0;
+
+    srand(12345);
+    for (int i = 0; i < RANDOM_PROGRAMS; i++) {
+        int length = random_program(code);
+        if (!usable(code, length)) {
+            continue;
+        }
+        tested++;
+
+        if (differ(code, length, differences < 3 ? "random program" : NULL)) {
+            differences++;
+            continue;
+        }
+
+        vm_t* vm = vm_create();
+        vm_optimize_stats_t stats;
+        vm_load(vm, code, length);
+        if (vm_optimize(vm, NULL, &stats) == 0) {
+            optimized++;
+            if (differ(vm->program, stats.words_after, differences < 3 ? "optimized random program" : NULL)) {
+                differences++;
+            }
+        }
+        vm_destroy(vm);
+    }
+
+    printf("%d of %d random programs verified and stopped, %d also optimized\n", tested,
+           RANDOM_PROGRAMS, optimized);
+    if (differences > 0) {
+        printf("❌ %d programs ran differently\n", differences);
+        failures += differences;
+    } else {
+        printf("✅ No differences\n");
+    }
+}
+
+void test_fallback(void) {
+    printf("\n🧪 TEST 4: Interpreter Fallback\n");
+    printf("===============================\n");
+
+    // Not verified (stack underflow): no code, and vm_run_jit() interprets
+    int unverified[] = { PSH, 1, ADD, PRT, HLT };
+    vm_t* vm = vm_create();
+    result_t expected, actual;
+
+    vm_load(vm, unverified, 5);
+    capture(vm, vm_run_switch, &expected);
+    vm_load(vm, unverified, 5);
+    if (vm_jit_compile(vm) == 0 || vm->jit != NULL) {
+        printf("❌ An unverified program was compiled\n");
+        failures++;
+    }
+    capture(vm, vm_run_jit, &actual);
+    if (strcmp(expected.output, actual.output) != 0) {
+        printf("❌ Fallback output differs: '%s' and '%s'\n", expected.output, actual.output);
+        failures++;
+    } else {
+        printf("✅ Unverified program interpreted: %s", actual.output);
+    }
+    free(expected.output);
+    free(actual.output);
+
+    // Off the end, and jumps outside the program, read HLT in every
+    // loop. Shorter programs are padded to PROGRAM_SIZE, so the first
+    // one fills it with pushes and runs on into the padding.
+    int off_end[PROGRAM_SIZE];
+    int far_jump[] = { PSH, 0, JZ, 1000, PRT };
+    int back_jump[] = { JMP, -7 };
+    const int* stray[] = { off_end, far_jump, back_jump };
+    int stray_length[] = { PROGRAM_SIZE, 5, 2 };
+    bool agree = true;
+
+    for (int a = 0; a < PROGRAM_SIZE; a += 2) {
+        off_end[a] = PSH;
+        off_end[a + 1] = a;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        vm_load(vm, stray[i], stray_length[i]);
+        capture(vm, vm_run_switch, &expected);
+        vm_load(vm, stray[i], stray_length[i]);
+        capture(vm, vm_run_jit, &actual);
+        if (strcmp(expected.output, actual.output) != 0 ||
+            memcmp(expected.registers, actual.registers, sizeof(expected.registers)) != 0) {
+            printf("❌ Stray program %d: switch IP=%d '%s', threaded IP=%d '%s'\n", i,
+                   expected.registers[IP], expected.output, actual.registers[IP], actual.output);
+            failures++;
+            agree = false;
+        }
+        free(expected.output);
+        free(actual.output);
+    }
+    if (agree) {
+        printf("✅ Runs off the end and out-of-range jumps stop alike\n");
+    }
+
+    // Compiled, but resumed part way: interpreted from there
+    int countdown[] = { PSH, 3, PRT, SET, SP, 0, PSH, 1, SUB, JZ, 14, SET, SP, -1, HLT };
+    vm_load(vm, countdown, 15);
+    if (vm_jit_compile(vm) != 0) {
+        printf("❌ vm_jit_compile failed\n");
+        failures++;
+    }
+    vm->registers[IP] = 2;               // At PRT with 3 on the stack
+    vm->registers[SP] = 0;
+    vm->stack[0] = 3;
+    capture(vm, vm_run_jit, &actual);
+    if (strcmp(actual.output, "OUT 3\nHLT\n") != 0) {
+        printf("❌ Resumed run printed '%s'\n", actual.output);
+        failures++;
+    } else {
+        printf("✅ Resumed run interpreted\n");
+    }
+    free(actual.output);
+
+    // Loading another program drops the code
+    vm_load(vm, unverified, 5);
+    if (vm->jit != NULL) {
+        printf("❌ Code kept after loading another program\n");
+        failures++;
+    } else {
+        printf("✅ Code released on load\n");
+    }
+    vm_destroy(vm);
+}
+
+int main(void) {
+    printf("🚀 SIMPLE VM JIT TESTS\n");
+    printf("======================\n");
+
+    vm_t* probe = vm_create();
+    int demo[] = { HLT };
+    vm_load(probe, demo, 1);
+    if (vm_jit_compile(probe) != 0) {
+        printf("No JIT on this host (x86-64 only): nothing to test\n");
+        vm_destroy(probe);
+        return 0;
+    }
+    vm_destroy(probe);
+
+    test_examples();
+    test_optimized();
+    test_random();
+    test_fallback();
+
+    if (failures > 0) {
+        printf("\n❌ %d failures\n", failures);
+        return 1;
+    }
+    printf("\n🎉 All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,277 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vm.h"
+
+
+
+
+// STATE
+//
+// depth[a] is the stack depth (SP + 1) every path reaching address a
+// has there, or -1 while no path has. An address goes on the worklist
+// the first time it gets a depth, so each instruction is looked at
+// once and the pass is linear in the program.
+
+typedef struct {
+
+    const int* code;
+    int size;
+
+    int* depth;
+    int* worklist;
+    int pending;
+
+    int max_depth;
+
+    char* error;
+    size_t error_size;
+
+} verifier_t;
+
+
+static int reject(verifier_t* v, int address, const char* format, ...) {
+
+    if (v->error == NULL || v->error_size == 0)
+        return -1;
+
+    int n = snprintf(v->error, v->error_size, "address %d: ", address);
+
+    if (n >= 0 && (size_t) n < v->error_size) {
+
+        va_list args;
+
+        va_start(args, format);
+        vsnprintf(v->error + n, v->error_size - n, format, args);
+        va_end(args);
+    }
+
+    return -1;
+}
+
+
+// Control reaches target from the instruction at from with the stack
+// depth given
+static int flow(verifier_t* v, int from, int target, int depth) {
+
+    if (target < 0 || target >= v->size)
+        return reject(v, from, "goes to %d, outside the program", target);
+
+    if (v->depth[target] < 0) {
+
+        v->depth[target] = depth;
+        v->worklist[v->pending++] = target;
+
+        if (depth > v->max_depth)
+            v->max_depth = depth;
+
+        return 0;
+    }
+
+    if (v->depth[target] != depth)
+        return reject(v, from, "reaches %d with stack depth %d, another path with %d", target,
+                      depth, v->depth[target]);
+
+    return 0;
+}
+
+
+
+
+// ONE INSTRUCTION
+
+static int step(verifier_t* v, int a) {
+
+    const int* code = v->code;
+    int op = code[a];
+    int d = v->depth[a];
+
+    if (op < 0 || op >= NUM_INSTRUCTIONS)
+        return reject(v, a, "%d is not an instruction", op);
+
+    int next = a + 1 + vm_operand_count[op];
+
+    if (next > v->size)
+        return reject(v, a, "%s operands run past the end", vm_mnemonics[op]);
+
+    // Words popped and pushed, and pushed before the pops
+    int in = 0;
+    int out = 0;
+    int ahead = 0;
+
+    switch (op) {
+
+        case HLT:
+            return 0;
+
+        case PSH:
+            out = 1;
+            break;
+
+        case POP:
+        case PRT:
+            in = 1;
+            break;
+
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+            in = 2;
+            out = 1;
+            break;
+
+        case SET: {
+
+            int reg = code[a + 1];
+            int val = code[a + 2];
+
+            if (reg == SP) {
+
+                if (val < -1 || val > STACK_SIZE - 1)
+                    return reject(v, a, "SET SP, %d leaves the stack", val);
+
+                return flow(v, a, next, val + 1);
+            }
+
+            if (reg == IP)
+                return flow(v, a, val, d);
+
+            if (reg < A || reg > D)
+                return reject(v, a, "SET of register %d", reg);
+
+            break;
+        }
+
+        case MOV: {
+
+            int r1 = code[a + 1];
+            int r2 = code[a + 2];
+
+            if (r1 < A || r1 > D)
+                return reject(v, a, "MOV into register %d", r1);
+
+            if (r2 < 0 || r2 >= NUM_REGS)
+                return reject(v, a, "MOV from register %d", r2);
+
+            break;
+        }
+
+        case JMP:
+            return flow(v, a, code[a + 1], d);
+
+        case JZ:
+            if (d < 1)
+                return reject(v, a, "JZ on an empty stack");
+
+            if (flow(v, a, code[a + 1], d - 1) != 0)
+                return -1;
+
+            in = 1;
+            break;
+
+        case ADDI:
+        case SUBI:
+            ahead = 1;
+            in = 1;
+            out = 1;
+            break;
+
+        case PSH2:
+            out = 2;
+            break;
+
+        case JEQI:
+            if (d < 1)
+                return reject(v, a, "JEQI on an empty stack");
+
+            if (flow(v, a, code[a + 2], d - 1) != 0)
+                return -1;
+
+            ahead = 1;
+            in = 1;
+            break;
+    }
+
+    if (d < in)
+        return reject(v, a, "%s needs %d on the stack, has %d", vm_mnemonics[op], in, d);
+
+    if (d + ahead > STACK_SIZE || d - in + out > STACK_SIZE)
+        return reject(v, a, "%s overflows the stack", vm_mnemonics[op]);
+
+    if (d + ahead > v->max_depth)
+        v->max_depth = d + ahead;
+
+    return flow(v, a, next, d - in + out);
+}
+
+
+
+
+// PASS
+
+// Into depth[] if given, else a buffer of its own
+static int verify(vm_t* vm, int* depth, char* error, size_t error_size) {
+
+    verifier_t v = { 0 };
+
+    vm->verified = false;
+    vm->max_depth = 0;
+
+    v.code = vm->program;
+    v.size = vm->program_size;
+    v.error = error;
+    v.error_size = error_size;
+
+    if (v.size == 0)
+        return reject(&v, 0, "no program");
+
+    v.depth = depth != NULL ? depth : malloc(v.size * sizeof(int));
+    v.worklist = malloc(v.size * sizeof(int));
+
+    if (v.depth == NULL || v.worklist == NULL) {
+
+        if (depth == NULL)
+            free(v.depth);
+
+        free(v.worklist);
+        return reject(&v, 0, "out of memory");
+    }
+
+    for (int a = 0; a < v.size; a++)
+        v.depth[a] = -1;
+
+    v.depth[0] = 0;
+    v.worklist[v.pending++] = 0;
+
+    int result = 0;
+
+    while (v.pending > 0 && result == 0)
+        result = step(&v, v.worklist[--v.pending]);
+
+    if (depth == NULL)
+        free(v.depth);
+
+    free(v.worklist);
+
+    if (result != 0)
+        return -1;
+
+    vm->verified = true;
+    vm->max_depth = v.max_depth;
+
+    return 0;
+}
+
+
+int vm_verify(vm_t* vm, char* error, size_t error_size) {
+
+    return verify(vm, NULL, error, error_size);
+}
+
+
+int vm_stack_depths(vm_t* vm, int* depth) {
+
+    return verify(vm, depth, NULL, 0);
+}
@@ -1,112 +1,122 @@
+#include <stdarg.h>
 #include <stdio.h>
-#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
-#define STACK_SIZE 256
-#define PROGRAM_SIZE 256
+#include "vm.h"
 
 
 
 
-// INSTRUCTION SET
+// INSTRUCTION TABLE
 
-typedef enum {
+const char* const vm_mnemonics[NUM_INSTRUCTIONS] = {
 
-    HLT,
-
-    PSH,
-    POP,
-
-    ADD,
-    SUB,
-    MUL,
-    DIV,
-
-    SET,
-    MOV,
+    "HLT", "PSH", "POP", "ADD", "SUB", "MUL", "DIV", "SET", "MOV", "JMP", "JZ", "PRT",
+    "ADDI", "SUBI", "PSH2", "JEQI"
+};
 
-    JMP,
-    JZ,
 
-    PRT
+const int vm_operand_count[NUM_INSTRUCTIONS] = {
 
-} InstructionSet;
+    [PSH] = 1,
+    [SET] = 2,
+    [MOV] = 2,
+    [JMP] = 1,
+    [JZ]  = 1,
 
+    [ADDI] = 1,
+    [SUBI] = 1,
+    [PSH2] = 2,
+    [JEQI] = 2
+};
 
 
 
-// REGISTERS
 
-typedef enum {
+// OUTPUT
 
-    A, B, C, D,
-    IP,
-    SP,
+static void output(vm_t* vm, const char* format, ...) {
 
-    NUM_REGS
+    if (vm->out == NULL)
+        return;
 
-} Registers;
+    va_list args;
 
+    va_start(args, format);
+    vfprintf(vm->out, format, args);
+    va_end(args);
+}
 
 
 
-// PROGRAM
 
-int program[PROGRAM_SIZE] = {
+// LIFETIME
 
-    PSH, 5,
-    PSH, 6,
-    ADD,
-    PRT,
-    HLT
+vm_t* vm_create(void) {
 
-};
+    vm_t* vm = calloc(1, sizeof(vm_t));
 
+    if (vm == NULL)
+        return NULL;
 
+    vm->out = stdout;
 
+    return vm;
+}
 
-// STATE
 
-int registers[NUM_REGS];
-int stack[STACK_SIZE];
+void vm_destroy(vm_t* vm) {
 
-bool running = true;
+    vm_jit_release(vm);
+    free(vm->program);
+    free(vm->threaded);
+    free(vm);
+}
 
 
 
 // STACK HELPERS
 
-void push(int v) {
+void push(vm_t* vm, int v) {
 
-    if (registers[SP] >= STACK_SIZE - 1) {
+    if (vm->registers[SP] >= STACK_SIZE - 1) {
 
-        printf("Stack overflow\n");
-        running = false;
+        output(vm, "Stack overflow\n");
+        vm->running = false;
         return;
     }
 
-    stack[++registers[SP]] = v;
+    vm->stack[++vm->registers[SP]] = v;
 }
 
 
-int pop() {
+int pop(vm_t* vm) {
 
-    if (registers[SP] < 0) {
+    if (vm->registers[SP] < 0) {
 
-        printf("Stack underflow\n");
-        running = false;
+        output(vm, "Stack underflow\n");
+        vm->running = false;
         return 0;
     }
 
-    return stack[registers[SP]--];
+    return vm->stack[vm->registers[SP]--];
 }
 
 
 
 // FETCH
 
-int fetch() {
+// Outside the program and its padding every word reads as HLT, as the
+// padding does
+int fetch(vm_t* vm) {
+
+    int ip = vm->registers[IP]++;
+
+    if ((unsigned) ip >= (unsigned) (vm->program_size + PROGRAM_PADDING))
+        return HLT;
 
-    return program[registers[IP]++];
+    return vm->program[ip];
 }
 
 
@@ -114,21 +124,21 @@ int fetch() {
 
 // EXECUTE
 
-void eval(int instr) {
+void eval(vm_t* vm, int instr) {
 
     switch (instr) {
 
         case HLT:
-            running = false;
-            printf("HLT\n");
+            vm->running = false;
+            output(vm, "HLT\n");
             break;
 
 
         case PSH: {
 
-            int val = fetch();
+            int val = fetch(vm);
 
-            push(val);
+            push(vm, val);
 
             break;
         }
@@ -136,9 +146,9 @@ void eval(int instr) {
 
         case POP: {
 
-            int v = pop();
+            int v = pop(vm);
 
-            printf("POP %d\n", v);
+            output(vm, "POP %d\n", v);
 
             break;
         }
@@ -146,10 +156,10 @@ void eval(int instr) {
 
         case ADD: {
 
-            int a = pop();
-            int b = pop();
+            int a = pop(vm);
+            int b = pop(vm);
 
-            push(a + b);
+            push(vm, a + b);
 
             break;
         }
@@ -157,10 +167,10 @@ void eval(int instr) {
 
         case SUB: {
 
-            int a = pop();
-            int b = pop();
+            int a = pop(vm);
+            int b = pop(vm);
 
-            push(b - a);
+            push(vm, b - a);
 
             break;
         }
@@ -168,10 +178,10 @@ void eval(int instr) {
 
         case MUL: {
 
-            int a = pop();
-            int b = pop();
+            int a = pop(vm);
+            int b = pop(vm);
 
-            push(a * b);
+            push(vm, a * b);
 
             break;
         }
@@ -179,10 +189,10 @@ void eval(int instr) {
 
         case DIV: {
 
-            int a = pop();
-            int b = pop();
+            int a = pop(vm);
+            int b = pop(vm);
 
-            push(b / a);
+            push(vm, b / a);
 
             break;
         }
@@ -190,10 +200,10 @@ void eval(int instr) {
 
         case SET: {
 
-            int reg = fetch();
-            int val = fetch();
+            int reg = fetch(vm);
+            int val = fetch(vm);
 
-            registers[reg] = val;
+            vm->registers[reg] = val;
 
             break;
         }
@@ -201,10 +211,10 @@ void eval(int instr) {
 
         case MOV: {
 
-            int r1 = fetch();
-            int r2 = fetch();
+            int r1 = fetch(vm);
+            int r2 = fetch(vm);
 
-            registers[r1] = registers[r2];
+            vm->registers[r1] = vm->registers[r2];
 
             break;
         }
@@ -212,9 +222,9 @@ void eval(int instr) {
 
         case JMP: {
 
-            int addr = fetch();
+            int addr = fetch(vm);
 
-            registers[IP] = addr;
+            vm->registers[IP] = addr;
 
             break;
         }
@@ -222,12 +232,12 @@ void eval(int instr) {
 
         case JZ: {
 
-            int addr = fetch();
+            int addr = fetch(vm);
 
-            int v = pop();
+            int v = pop(vm);
 
             if (v == 0)
-                registers[IP] = addr;
+                vm->registers[IP] = addr;
 
             break;
         }
@@ -235,9 +245,55 @@ void eval(int instr) {
 
         case PRT: {
 
-            int v = pop();
+            int v = pop(vm);
+
+            output(vm, "OUT %d\n", v);
+
+            break;
+        }
+
+
+        // Superinstructions: their sequences, stopping where the
+        // sequence would have stopped
+
+        case ADDI:
+        case SUBI: {
+
+            push(vm, fetch(vm));
+
+            if (vm->running)
+                eval(vm, instr == ADDI ? ADD : SUB);
+
+            break;
+        }
+
+
+        case PSH2: {
+
+            int a = fetch(vm);
+            int b = fetch(vm);
+
+            push(vm, a);
+
+            if (vm->running)
+                push(vm, b);
+
+            break;
+        }
+
+
+        case JEQI: {
+
+            int k = fetch(vm);
+            int addr = fetch(vm);
 
-            printf("OUT %d\n", v);
+            push(vm, k);
+
+            if (vm->running)
+                eval(vm, SUB);
+
+            if (vm->running && pop(vm) == 0)
+                vm->registers[IP] = addr;
 
             break;
         }
@@ -247,20 +303,560 @@ void eval(int instr) {
 
 
 
-// MAIN LOOP
 
 
-int main() {
 
-    registers[IP] = 0;
-    registers[SP] = -1;
 
-    while (running) {
+// LOADING
 
-        int instr = fetch();
+int vm_load(vm_t* vm, const int* code, int length) {
 
-        eval(instr);
-    }
+    int* program = vm_load_space(vm, length);
+
+    if (program == NULL)
+        return -1;
+
+    memcpy(program, code, length * sizeof(int));
+
+    vm_verify(vm, NULL, 0);
 
     return 0;
-}
\ No newline at end of file
+}
+
+
+int* vm_load_space(vm_t* vm, int length) {
+
+    if (length < 0 || length > PROGRAM_MAX)
+        return NULL;
+
+    vm_jit_release(vm);             // Compiled for the old program
+
+    int size = length > PROGRAM_SIZE ? length : PROGRAM_SIZE;
+
+    // Buffers only grow, so reloading a VM does not allocate
+    if (size > vm->capacity) {
+
+        int* program = realloc(vm->program, (size + PROGRAM_PADDING) * sizeof(int));
+
+        if (program == NULL)
+            return NULL;
+
+        vm->program = program;
+
+        void** threaded = realloc(vm->threaded, (size + PROGRAM_PADDING) * sizeof(void*));
+
+        if (threaded == NULL)
+            return NULL;
+
+        vm->threaded = threaded;
+        vm->capacity = size;
+    }
+
+    memset(vm->program + length, 0, (size + PROGRAM_PADDING - length) * sizeof(int));
+
+    vm->program_size = size;
+    vm->decoded = NULL;
+    vm->verified = false;
+    vm->max_depth = 0;
+
+    vm_reset(vm);
+
+    return vm->program;
+}
+
+
+void vm_reset(vm_t* vm) {
+
+    memset(vm->registers, 0, sizeof(vm->registers));
+    vm->registers[IP] = 0;
+    vm->registers[SP] = -1;
+
+    vm->running = true;
+}
+
+
+
+
+// SWITCH LOOP
+
+void vm_run_switch(vm_t* vm) {
+
+    while (vm->running) {
+
+        int instr = fetch(vm);
+
+        eval(vm, instr);
+    }
+}
+
+
+
+
+// THREADED LOOP
+//
+// Each program word gets the address of its handler up front (direct
+// threading, done once per load), and every handler ends in its own
+// indirect jump to the next one, so the branch predictor sees one jump
+// per opcode instead of the single one at the top of a switch.
+//
+// IP and SP live in locals. Each handler checks once that the stack
+// holds what it will pop and has room for what it will push, instead
+// of checking in every push() and pop(). Anything out of the ordinary -
+// an overflow or underflow, SET or MOV touching IP, SP or an unknown
+// register - goes through eval() for that one instruction, so it
+// prints and stops exactly as the switch loop does.
+
+#if defined(__GNUC__)
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+// Fast path only if SP lies in [lo, hi]
+#define NEED(lo, hi)    if ((unsigned) (sp - (lo)) > (unsigned) ((hi) - (lo))) goto slow
+
+#define NEXT(n)         ip += (n); goto *handlers[ip]
+#define JUMP(addr)      ip = (addr); if ((unsigned) ip >= (unsigned) end) goto off_end; goto *handlers[ip]
+
+
+void vm_run_threaded(vm_t* vm) {
+
+    static void* const labels[NUM_INSTRUCTIONS] = {
+
+        [HLT] = &&op_hlt,
+        [PSH] = &&op_psh,
+        [POP] = &&op_pop,
+        [ADD] = &&op_add,
+        [SUB] = &&op_sub,
+        [MUL] = &&op_mul,
+        [DIV] = &&op_div,
+        [SET] = &&op_set,
+        [MOV] = &&op_mov,
+        [JMP] = &&op_jmp,
+        [JZ]  = &&op_jz,
+        [PRT] = &&op_prt,
+
+        [ADDI] = &&op_addi,
+        [SUBI] = &&op_subi,
+        [PSH2] = &&op_psh2,
+        [JEQI] = &&op_jeqi
+    };
+
+
+    if (!vm->running)
+        return;
+
+    int size = vm->program_size;
+    int end = size + PROGRAM_PADDING;
+    const int* code = vm->program;
+    void** handlers = vm->threaded;
+
+    // The padding words get a handler too: an instruction in the last
+    // word may step over two operands before falling off the end, into
+    // the HLT the padding holds
+    if (vm->decoded != labels) {
+
+        for (int i = 0; i < end; i++) {
+
+            if (i >= size)
+                handlers[i] = &&op_hlt;
+            else if ((unsigned) code[i] < NUM_INSTRUCTIONS)
+                handlers[i] = labels[code[i]];
+            else
+                handlers[i] = &&op_nop;         // eval() ignores unknown opcodes
+        }
+
+        vm->decoded = labels;
+    }
+
+
+    int* registers = vm->registers;
+    int* stack = vm->stack;
+
+    int ip = registers[IP];
+    int sp = registers[SP];
+
+    JUMP(ip);
+
+
+    op_hlt:
+        vm->running = false;
+        output(vm, "HLT\n");
+        ip++;
+        goto done;
+
+
+    op_psh:
+        NEED(-1, STACK_SIZE - 2);
+        stack[++sp] = code[ip + 1];
+        NEXT(2);
+
+
+    op_pop:
+        NEED(0, STACK_SIZE - 1);
+        output(vm, "POP %d\n", stack[sp--]);
+        NEXT(1);
+
+
+    op_add: {
+        NEED(1, STACK_SIZE - 1);
+        int a = stack[sp--];
+        stack[sp] = a + stack[sp];
+        NEXT(1);
+    }
+
+
+    op_sub: {
+        NEED(1, STACK_SIZE - 1);
+        int a = stack[sp--];
+        stack[sp] = stack[sp] - a;
+        NEXT(1);
+    }
+
+
+    op_mul: {
+        NEED(1, STACK_SIZE - 1);
+        int a = stack[sp--];
+        stack[sp] = a * stack[sp];
+        NEXT(1);
+    }
+
+
+    op_div: {
+        NEED(1, STACK_SIZE - 1);
+        int a = stack[sp--];
+        stack[sp] = stack[sp] / a;
+        NEXT(1);
+    }
+
+
+    op_set: {
+        int reg = code[ip + 1];
+
+        if ((unsigned) reg < IP)
+            registers[reg] = code[ip + 2];
+        else if (reg == SP)
+            sp = code[ip + 2];
+        else
+            goto slow;
+
+        NEXT(3);
+    }
+
+
+    op_mov: {
+        int r1 = code[ip + 1];
+        int r2 = code[ip + 2];
+
+        if ((unsigned) r1 >= IP || (unsigned) r2 >= IP)
+            goto slow;
+
+        registers[r1] = registers[r2];
+        NEXT(3);
+    }
+
+
+    op_jmp:
+        JUMP(code[ip + 1]);
+
+
+    op_jz:
+        NEED(0, STACK_SIZE - 1);
+        if (stack[sp--] == 0) {
+            JUMP(code[ip + 1]);
+        }
+        NEXT(2);
+
+
+    op_prt:
+        NEED(0, STACK_SIZE - 1);
+        output(vm, "OUT %d\n", stack[sp--]);
+        NEXT(1);
+
+
+    // Superinstructions leave the constant in the slot above the top,
+    // as the PSH they replace did
+
+    op_addi:
+        NEED(0, STACK_SIZE - 2);
+        stack[sp + 1] = code[ip + 1];
+        stack[sp] += code[ip + 1];
+        NEXT(2);
+
+
+    op_subi:
+        NEED(0, STACK_SIZE - 2);
+        stack[sp + 1] = code[ip + 1];
+        stack[sp] -= code[ip + 1];
+        NEXT(2);
+
+
+    op_psh2:
+        NEED(-1, STACK_SIZE - 3);
+        stack[++sp] = code[ip + 1];
+        stack[++sp] = code[ip + 2];
+        NEXT(3);
+
+
+    op_jeqi:
+        NEED(0, STACK_SIZE - 2);
+        stack[sp + 1] = code[ip + 1];
+        stack[sp] -= code[ip + 1];
+        if (stack[sp--] == 0) {
+            JUMP(code[ip + 2]);
+        }
+        NEXT(3);
+
+
+    op_nop:
+        NEXT(1);
+
+
+    slow:
+        registers[IP] = ip + 1;
+        registers[SP] = sp;
+
+        eval(vm, code[ip]);
+
+        ip = registers[IP];
+        sp = registers[SP];
+
+        if (!vm->running)
+            goto done;
+
+        JUMP(ip);
+
+
+    // Past the padding too, fetch() reads HLT
+    off_end:
+        goto op_hlt;
+
+
+    done:
+        registers[IP] = ip;
+        registers[SP] = sp;
+}
+
+
+
+// VERIFIED LOOP
+//
+// The threaded loop with every check taken out, for programs that
+// vm_verify() accepted: it proved the stack never over- or underflows,
+// every jump lands inside the program, SET and MOV only name real
+// registers, and no path runs off the end. SET SP and SET IP with
+// their constant operands are handled inline, and MOV may only write
+// A-D, so nothing needs eval().
+
+#define GOTO(addr)      ip = (addr); goto *handlers[ip]
+
+
+void vm_run_verified(vm_t* vm) {
+
+    static void* const labels[NUM_INSTRUCTIONS] = {
+
+        [HLT] = &&op_hlt,
+        [PSH] = &&op_psh,
+        [POP] = &&op_pop,
+        [ADD] = &&op_add,
+        [SUB] = &&op_sub,
+        [MUL] = &&op_mul,
+        [DIV] = &&op_div,
+        [SET] = &&op_set,
+        [MOV] = &&op_mov,
+        [JMP] = &&op_jmp,
+        [JZ]  = &&op_jz,
+        [PRT] = &&op_prt,
+
+        [ADDI] = &&op_addi,
+        [SUBI] = &&op_subi,
+        [PSH2] = &&op_psh2,
+        [JEQI] = &&op_jeqi
+    };
+
+
+    int* registers = vm->registers;
+
+    // The proof holds for a run from the start only
+    if (!vm->verified || registers[IP] != 0 || registers[SP] != -1) {
+
+        vm_run_threaded(vm);
+        return;
+    }
+
+    if (!vm->running)
+        return;
+
+    const int* code = vm->program;
+    void** handlers = vm->threaded;
+
+    // Words the verifier never reached as instructions are never
+    // dispatched; they get HLT so the table holds no garbage
+    if (vm->decoded != labels) {
+
+        for (int i = 0; i < vm->program_size; i++)
+            handlers[i] = (unsigned) code[i] < NUM_INSTRUCTIONS ? labels[code[i]] : &&op_hlt;
+
+        vm->decoded = labels;
+    }
+
+
+    int* stack = vm->stack;
+
+    int ip = 0;
+    int sp = -1;
+
+    GOTO(ip);
+
+
+    op_hlt:
+        vm->running = false;
+        output(vm, "HLT\n");
+        ip++;
+        goto done;
+
+
+    op_psh:
+        stack[++sp] = code[ip + 1];
+        NEXT(2);
+
+
+    op_pop:
+        output(vm, "POP %d\n", stack[sp--]);
+        NEXT(1);
+
+
+    op_add: {
+        int a = stack[sp--];
+        stack[sp] = a + stack[sp];
+        NEXT(1);
+    }
+
+
+    op_sub: {
+        int a = stack[sp--];
+        stack[sp] = stack[sp] - a;
+        NEXT(1);
+    }
+
+
+    op_mul: {
+        int a = stack[sp--];
+        stack[sp] = a * stack[sp];
+        NEXT(1);
+    }
+
+
+    op_div: {
+        int a = stack[sp--];
+        stack[sp] = stack[sp] / a;
+        NEXT(1);
+    }
+
+
+    op_set: {
+        int reg = code[ip + 1];
+
+        if (reg == SP)
+            sp = code[ip + 2];
+        else if (reg == IP) {
+            GOTO(code[ip + 2]);
+        } else
+            registers[reg] = code[ip + 2];
+
+        NEXT(3);
+    }
+
+
+    // The source may be IP or SP, so both are stored first
+    op_mov:
+        registers[IP] = ip + 3;
+        registers[SP] = sp;
+        registers[code[ip + 1]] = registers[code[ip + 2]];
+        NEXT(3);
+
+
+    op_jmp:
+        GOTO(code[ip + 1]);
+
+
+    op_jz:
+        if (stack[sp--] == 0) {
+            GOTO(code[ip + 1]);
+        }
+        NEXT(2);
+
+
+    op_prt:
+        output(vm, "OUT %d\n", stack[sp--]);
+        NEXT(1);
+
+
+    op_addi:
+        stack[sp + 1] = code[ip + 1];
+        stack[sp] += code[ip + 1];
+        NEXT(2);
+
+
+    op_subi:
+        stack[sp + 1] = code[ip + 1];
+        stack[sp] -= code[ip + 1];
+        NEXT(2);
+
+
+    op_psh2:
+        stack[sp + 1] = code[ip + 1];
+        stack[sp + 2] = code[ip + 2];
+        sp += 2;
+        NEXT(3);
+
+
+    op_jeqi:
+        stack[sp + 1] = code[ip + 1];
+        stack[sp] -= code[ip + 1];
+        if (stack[sp--] == 0) {
+            GOTO(code[ip + 2]);
+        }
+        NEXT(3);
+
+
+    done:
+        registers[IP] = ip;
+        registers[SP] = sp;
+}
+
+#undef NEED
+#undef NEXT
+#undef JUMP
+#undef GOTO
+
+#pragma GCC diagnostic pop
+
+#else
+
+void vm_run_threaded(vm_t* vm) {
+
+    vm_run_switch(vm);
+}
+
+
+void vm_run_verified(vm_t* vm) {
+
+    vm_run_switch(vm);
+}
+
+#endif
+
+
+
+
+// RUN
+
+void vm_run(vm_t* vm) {
+
+    if (vm->jit != NULL)
+        vm_run_jit(vm);
+    else if (vm->verified)
+        vm_run_verified(vm);
+    else
+        vm_run_threaded(vm);
+}
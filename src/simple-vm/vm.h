@@ -0,0 +1,318 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define STACK_SIZE 256
+#define PROGRAM_SIZE 256            // Smallest program; shorter code is padded with HLT
+#define PROGRAM_MAX (1 << 24)       // Largest program, in words
+#define PROGRAM_PADDING 3           // Zero words past the end, so the last instruction's operands can be read
+
+
+
+
+// INSTRUCTION SET
+
+typedef enum {
+
+    HLT,
+
+    PSH,
+    POP,
+
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+
+    SET,
+    MOV,
+
+    JMP,
+    JZ,
+
+    PRT,
+
+
+    // Superinstructions: what vm_optimize() fuses common sequences
+    // into. Each behaves exactly as the sequence it replaces
+
+    ADDI,       // PSH k; ADD
+    SUBI,       // PSH k; SUB
+    PSH2,       // PSH a; PSH b
+    JEQI,       // PSH k; SUB; JZ addr - branch if the top equals k
+
+    NUM_INSTRUCTIONS
+
+} InstructionSet;
+
+
+extern const char* const vm_mnemonics[NUM_INSTRUCTIONS];
+extern const int vm_operand_count[NUM_INSTRUCTIONS];        // Words after the opcode
+
+
+
+
+// REGISTERS
+
+typedef enum {
+
+    A, B, C, D,
+    IP,
+    SP,
+
+    NUM_REGS
+
+} Registers;
+
+
+
+
+// STATE
+//
+// Everything a program touches lives in its vm_t, so any number of VMs
+// can run at once, one per thread
+
+typedef struct {
+
+    int* program;       // program_size words, then PROGRAM_PADDING zeros
+    int program_size;
+    int capacity;
+
+    int registers[NUM_REGS];
+    int stack[STACK_SIZE];
+
+    bool running;
+
+    FILE* out;          // HLT, POP, PRT and stack errors print here; NULL discards
+
+    void** threaded;        // Handler address per program word, for the threaded loops
+    const void* decoded;    // Label table threaded[] was filled from; NULL once stale
+
+    bool verified;          // vm_verify() accepted the program
+    int max_depth;          // Deepest the stack gets, if verified
+
+    void* jit;              // Machine code from vm_jit_compile(), or NULL
+    size_t jit_size;
+
+} vm_t;
+
+
+
+
+// LIFETIME
+
+// A zeroed VM printing to stdout; NULL if out of memory
+vm_t* vm_create(void);
+
+void vm_destroy(vm_t* vm);
+
+
+// Copy a program in, reset and verify. Programs shorter than
+// PROGRAM_SIZE are padded with zeros (HLT) to it. -1 if longer than
+// PROGRAM_MAX or out of memory
+int vm_load(vm_t* vm, const int* code, int length);
+
+
+// vm_load() for loaders that decode in place: sizes the program for
+// length words, pads and resets, and returns where the caller writes
+// them (then calls vm_verify()). NULL as vm_load() fails
+int* vm_load_space(vm_t* vm, int length);
+
+
+// Clear the registers and stack pointer for a new run from address 0
+void vm_reset(vm_t* vm);
+
+
+
+
+// INTERPRETER
+
+void push(vm_t* vm, int v);
+int pop(vm_t* vm);
+int fetch(vm_t* vm);
+void eval(vm_t* vm, int instr);
+
+
+// Run until HLT or an error, on the fastest loop available: the
+// compiled code if there is any, the verified loop if the program
+// passed vm_verify(), else the threaded one
+void vm_run(vm_t* vm);
+
+
+// The reference loop: fetch() and eval() per instruction
+void vm_run_switch(vm_t* vm);
+
+
+// Direct-threaded loop with IP and SP in locals; same semantics as
+// vm_run_switch(). Falls back to it without GCC's computed goto
+void vm_run_threaded(vm_t* vm);
+
+
+// The threaded loop without any checks, for verified programs run
+// from the start; anything else goes to vm_run_threaded()
+void vm_run_verified(vm_t* vm);
+
+
+
+
+// JIT COMPILER
+//
+// A template compiler from verified programs to x86-64 machine code in
+// mmap'd memory, written and then made executable. The depth the
+// verifier proved for every address puts each stack slot at a fixed
+// place in vm->stack, cached in a register within a block; JMP and JZ
+// become native jumps, and POP, PRT and HLT call back into C for the
+// output. Output, registers and the whole stack come out as on the
+// interpreter.
+
+
+// Compile the loaded program into vm->jit; loading another program
+// releases it. -1 if it is not verified, the host is not x86-64, or
+// out of memory
+int vm_jit_compile(vm_t* vm);
+
+
+void vm_jit_release(vm_t* vm);
+
+
+// Run the compiled code; a VM without any, or not at the start of a
+// run, goes to vm_run_verified() instead
+void vm_run_jit(vm_t* vm);
+
+
+
+
+// VERIFIER
+//
+// Abstract interpretation of the loaded program from address 0 with an
+// empty stack, tracking the stack depth at every reachable address.
+// Rejects unknown opcodes, operands past the end, jumps outside the
+// program, register operands other than A-D (SET may also set SP or
+// IP to a constant in range), stack underflow or overflow, paths that
+// run off the end, and any address reached with two different depths
+// (blocks must leave the stack as balanced as every other way in).
+
+
+// 0 and sets vm->verified and vm->max_depth if the program is safe to
+// run unchecked; otherwise -1, with the first problem and its address
+// in error[] if given
+int vm_verify(vm_t* vm, char* error, size_t error_size);
+
+
+// vm_verify() that also fills depth[] (program_size entries) with the
+// stack depth at every address, -1 where no path reaches
+int vm_stack_depths(vm_t* vm, int* depth);
+
+
+
+
+// OPTIMIZER
+//
+// A pass over a verified program: constant expressions and branches on
+// constants are folded, unreachable code is dropped, and sequences
+// the profile shows to be hot are fused into superinstructions. The
+// output, registers A-D and the live stack come out as before; jump
+// targets and so IP move, and words above the top of the stack that
+// no SET SP can bring back may hold other values.
+
+typedef struct {
+
+    int words_before;       // program_size, padding included
+    int words_after;        // Before padding
+    int dead_words;         // Never reached, padding included
+    int folded;             // Constant expressions and branches
+    int jumps_removed;      // JMPs to what follows them
+    int fused[NUM_INSTRUCTIONS];        // Superinstructions made, by opcode
+
+} vm_optimize_stats_t;
+
+
+// Run a copy of the program from the start with its output discarded,
+// counting dispatches per address into counts[] (program_size
+// entries). Stops after max_steps if not 0; returns the total
+uint64_t vm_profile(vm_t* vm, uint64_t* counts, uint64_t max_steps);
+
+
+// Rewrite the loaded program in place. A superinstruction is used if
+// its matches would save at least 1% of the dispatches in profile[]
+// (from vm_profile()), or everywhere if profile is NULL. -1, with the
+// program untouched, if it is not verified, has overlapping
+// instructions or reads IP
+int vm_optimize(vm_t* vm, const uint64_t* profile, vm_optimize_stats_t* stats);
+
+
+
+
+// BYTECODE FILES
+//
+// The format (see bytecode.c) packs opcodes into one byte and operands
+// into varints; a large constant used by PSH sits once in a constant
+// pool. Loading decodes back to exactly the words that were encoded.
+
+#define VM_BYTECODE_VERSION 1
+
+
+// Encode a program into a malloc'd buffer of *size bytes; NULL if out
+// of memory
+uint8_t* vm_encode(const int* code, int length, size_t* size);
+
+
+// Decode an encoded program into a VM, as vm_load(); -1 if the data is
+// malformed, of another version, or does not fit
+int vm_load_bytes(vm_t* vm, const uint8_t* data, size_t size);
+
+
+// Map a bytecode file and vm_load_bytes() it; -1 if it cannot be read
+int vm_load_file(vm_t* vm, const char* path);
+
+
+int vm_save_file(const char* path, const int* code, int length);
+
+
+
+
+// ASSEMBLER
+//
+// One instruction per line: a mnemonic from InstructionSet (any case)
+// and its operands, separated by spaces or commas. Operands are
+// numbers (decimal or 0x hex), register names or labels. "name:"
+// defines a label at the next word, ".word" emits raw words, and ";"
+// or "#" starts a comment.
+
+
+// Assemble into a malloc'd program (*code, *length words). On error
+// returns -1 with a message naming the line in error[]
+int vm_assemble(const char* source, int** code, int* length, char* error, size_t error_size);
+
+
+
+
+// THREAD POOL
+//
+// Worker threads that run batches of independent VMs. Workers take
+// VMs from the batch a few at a time, so one slow program does not
+// hold up the others.
+
+typedef struct vm_pool vm_pool_t;
+
+
+// threads counts the calling thread, which works on every batch;
+// 0 means one per online CPU. NULL on failure
+vm_pool_t* vm_pool_create(int threads);
+
+
+// Run every VM in vms[] with vm_run() and return once all have
+// stopped
+void vm_pool_run(vm_pool_t* pool, vm_t** vms, int count);
+
+
+int vm_pool_threads(vm_pool_t* pool);
+
+void vm_pool_destroy(vm_pool_t* pool);
+
+
+#endif
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vm.h"
+
+
+
+
+// ASSEMBLER TOOL
+//
+// vmasm source.s program.svm
+
+
+static char* read_all(const char* path) {
+
+    FILE* file = fopen(path, "rb");
+
+    if (file == NULL)
+        return NULL;
+
+    size_t size = 0;
+    size_t capacity = 4096;
+    char* text = malloc(capacity + 1);
+
+    while (text != NULL) {
+
+        size += fread(text + size, 1, capacity - size, file);
+
+        if (size < capacity)
+            break;
+
+        capacity *= 2;
+
+        char* grown = realloc(text, capacity + 1);
+
+        if (grown == NULL)
+            free(text);
+
+        text = grown;
+    }
+
+    fclose(file);
+
+    if (text != NULL)
+        text[size] = '\0';
+
+    return text;
+}
+
+
+int main(int argc, char** argv) {
+
+    if (argc != 3) {
+
+        fprintf(stderr, "usage: %s source.s program.svm\n", argv[0]);
+        return 2;
+    }
+
+    char* source = read_all(argv[1]);
+
+    if (source == NULL) {
+
+        perror(argv[1]);
+        return 1;
+    }
+
+    int* code;
+    int length;
+    char error[256];
+
+    if (vm_assemble(source, &code, &length, error, sizeof(error)) != 0) {
+
+        fprintf(stderr, "%s: %s\n", argv[1], error);
+        free(source);
+        return 1;
+    }
+
+    free(source);
+
+    // Programs the verifier rejects still run, on the checked loop
+    vm_t* vm = vm_create();
+
+    if (vm != NULL && vm_load(vm, code, length) == 0 && vm_verify(vm, error, sizeof(error)) != 0)
+        fprintf(stderr, "%s: warning: not verified, runs with checks: %s\n", argv[1], error);
+
+    if (vm != NULL)
+        vm_destroy(vm);
+
+    if (vm_save_file(argv[2], code, length) != 0) {
+
+        perror(argv[2]);
+        free(code);
+        return 1;
+    }
+
+    free(code);
+
+    return 0;
+}